@@ -0,0 +1,32 @@
+# SPDX-License-Identifier: Apache-2.0
+
+# SonicLib, BSP and simulated sensors, shared by the application and the tests
+set(CHIRP_DIR ${CMAKE_CURRENT_LIST_DIR}/..)
+
+include_directories(${CHIRP_DIR}/src/inc)
+
+file(GLOB Dir1_Sources "${CHIRP_DIR}/src/lib/*.c")
+target_sources(app PRIVATE ${Dir1_Sources})
+
+# Host build (native_sim): simulated sensors, I2C and GPIO controllers
+if(CONFIG_ARCH_POSIX)
+  file(GLOB Sim_Sources "${CHIRP_DIR}/src/sim/*.c")
+  target_sources(app PRIVATE ${Sim_Sources})
+endif()
+
+# Sensor firmware registry, collected from the CH_FW_IMAGE_REGISTER() entries
+zephyr_linker_sources(ROM_SECTIONS ${CHIRP_DIR}/src/lib/ch_fw_registry.ld)
+
+# Compressed sensor firmware images (CHDRV_FW_COMPRESSED in soniclib.h), generated from the *_fw.c arrays
+file(GLOB Fw_Sources "${CHIRP_DIR}/src/lib/*_fw.c")
+foreach(fw_source ${Fw_Sources})
+  get_filename_component(fw_name ${fw_source} NAME_WE)
+  set(fw_lz_source ${CMAKE_CURRENT_BINARY_DIR}/fw_lz/${fw_name}_lz.c)
+  add_custom_command(
+    OUTPUT ${fw_lz_source}
+    COMMAND ${PYTHON_EXECUTABLE} ${CHIRP_DIR}/scripts/ch_fw_lz.py ${fw_source} ${fw_lz_source}
+    DEPENDS ${fw_source} ${CHIRP_DIR}/scripts/ch_fw_lz.py
+    COMMENT "Compressing sensor firmware ${fw_name}"
+  )
+  target_sources(app PRIVATE ${fw_lz_source})
+endforeach()
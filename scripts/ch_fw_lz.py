@@ -0,0 +1,131 @@
+#!/usr/bin/env python3
+"""
+Compress a Chirp sensor firmware image for CHDRV_FW_COMPRESSED builds.
+
+Reads the firmware array ("const unsigned char <name>_fw[...] = {...};") from
+a *_fw.c file generated by the Chirp firmware header generator and writes a
+C file defining <name>_fw_lz[] and <name>_fw_lz_size, decoded on the host by
+chdrv_fw_unpack().
+
+Stream format (LZSS, heatshrink style), bits read MSB first:
+    1 <8 bits byte>                     literal
+    0 <8 bits offset-1> <4 bits len-2>  copy len bytes from offset bytes back
+The decoded size is the program memory size of the part, the last byte is
+padded with 0 bits.  Offsets reach back 256 bytes, the decoder window.
+
+Usage: ch_fw_lz.py <input_fw.c> <output.c>
+"""
+
+import os
+import re
+import sys
+
+WINDOW_BITS = 8         # CHDRV_FW_LZ_WINDOW_BITS
+LENGTH_BITS = 4         # CHDRV_FW_LZ_LENGTH_BITS
+MIN_MATCH = 2           # CHDRV_FW_LZ_MIN_MATCH
+
+WINDOW = 1 << WINDOW_BITS
+MAX_MATCH = (1 << LENGTH_BITS) + MIN_MATCH - 1
+LITERAL_BITS = 1 + 8
+MATCH_BITS = 1 + WINDOW_BITS + LENGTH_BITS
+
+
+def read_image(path):
+    with open(path, encoding='latin-1') as f:
+        text = f.read()
+    m = re.search(r'const\s+unsigned\s+char\s+(\w+_fw)\s*\[\s*\w+\s*\]\s*=\s*\{(.*?)\}\s*;', text, re.S)
+    if m is None:
+        sys.exit('%s: no firmware array found' % path)
+    return m.group(1), bytes(int(v, 16) for v in re.findall(r'0x([0-9a-fA-F]{1,2})', m.group(2)))
+
+
+def longest_matches(data):
+    """Longest earlier match within the window for every position, as (offset, length)."""
+    matches = []
+    for i in range(len(data)):
+        best_len, best_off = 0, 0
+        limit = min(MAX_MATCH, len(data) - i)
+        for j in range(max(0, i - WINDOW), i):
+            n = 0
+            while n < limit and data[j + n] == data[i + n]:
+                n += 1
+            if n >= best_len:                   # ties go to the nearest
+                best_len, best_off = n, i - j
+        matches.append((best_off, best_len))
+    return matches
+
+
+def compress(data):
+    """Bit-optimal parse: fewest bits from every position to the end."""
+    matches = longest_matches(data)
+    cost = [0] * (len(data) + 1)
+    step = [0] * len(data)
+    for i in range(len(data) - 1, -1, -1):
+        cost[i], step[i] = LITERAL_BITS + cost[i + 1], 1
+        offset, length = matches[i]
+        for n in range(MIN_MATCH, length + 1):
+            if MATCH_BITS + cost[i + n] < cost[i]:
+                cost[i], step[i] = MATCH_BITS + cost[i + n], n
+
+    bits = []
+    i = 0
+    while i < len(data):
+        if step[i] == 1:
+            bits.append('1' + format(data[i], '08b'))
+        else:
+            bits.append('0' + format(matches[i][0] - 1, '0%db' % WINDOW_BITS) +
+                        format(step[i] - MIN_MATCH, '0%db' % LENGTH_BITS))
+        i += step[i]
+    stream = ''.join(bits)
+    stream += '0' * (-len(stream) % 8)
+    return bytes(int(stream[k:k + 8], 2) for k in range(0, len(stream), 8))
+
+
+def decompress(packed, size):
+    pos = 0
+
+    def take(count):
+        nonlocal pos
+        value = int(''.join(format(b, '08b') for b in packed[pos // 8:(pos + count + 7) // 8 + 1])
+                    [pos % 8:pos % 8 + count], 2)
+        pos += count
+        return value
+
+    out = bytearray()
+    while len(out) < size:
+        if take(1):
+            out.append(take(8))
+        else:
+            offset = take(WINDOW_BITS) + 1
+            for _ in range(take(LENGTH_BITS) + MIN_MATCH):
+                out.append(out[-offset])
+    return bytes(out[:size])
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit(__doc__)
+    name, data = read_image(sys.argv[1])
+    packed = compress(data)
+    if decompress(packed, len(data)) != data:
+        sys.exit('%s: compression check failed' % sys.argv[1])
+
+    lines = ['// Generated by scripts/ch_fw_lz.py from %s, do not edit' % os.path.basename(sys.argv[1]),
+             '// %u bytes compressed to %u' % (len(data), len(packed)),
+             '',
+             '#include <stdint.h>',
+             '',
+             'const uint16_t %s_lz_size = %u;' % (name, len(packed)),
+             '',
+             'const uint8_t %s_lz[%u] = {' % (name, len(packed))]
+    for k in range(0, len(packed), 16):
+        lines.append(''.join('0x%02x, ' % b for b in packed[k:k + 16]).rstrip())
+    lines += ['};', '']
+
+    os.makedirs(os.path.dirname(os.path.abspath(sys.argv[2])), exist_ok=True)
+    with open(sys.argv[2], 'w') as f:
+        f.write('\n'.join(lines))
+
+
+if __name__ == '__main__':
+    main()
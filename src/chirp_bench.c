@@ -0,0 +1,768 @@
+/*
+ Chirp sensor benchmarks
+ See chirp_bench.h for the available benchmarks.
+*/
+
+#include <zephyr/kernel.h>
+#include <stdio.h>
+#include "chirp_bench.h"
+#include "zy_i2c.h"
+#ifdef CHIRP_BENCH_FW_LOAD
+#include "ch101_gpr_open.h"
+#include "ch101_gpr_sr_open.h"
+#include "ch201_gprmt.h"
+#endif
+#ifdef CONFIG_ARCH_POSIX
+#include "zy_sim.h"
+#endif
+#if defined(CHIRP_BENCH_PRECISE_RANGE) && defined(CONFIG_TIMING_FUNCTIONS)
+#include <zephyr/timing/timing.h>
+#endif
+
+#if defined(CHIRP_BENCH_IQ_READOUT) || defined(CHIRP_BENCH_THROUGHPUT) || defined(CHIRP_BENCH_BUS_SPEED) || \
+    defined(CHIRP_BENCH_PRECISE_RANGE)
+static ch_iq_sample_t bench_iq_buf[CHIRP_MAX_NUM_SENSORS][CH201_MAX_NUM_SAMPLES];
+#endif
+
+#ifdef CHIRP_BENCH_IQ_READOUT
+
+static K_SEM_DEFINE(bench_io_sem, 0, 1);
+
+static void bench_io_complete_callback(ch_group_t *grp_ptr) {
+
+	k_sem_give(&bench_io_sem);
+}
+
+/*
+ * Read one I/Q frame from every connected sensor and compare:
+ *  - busy: cycles spent in the calling thread until it is free to do other work
+ *  - total: cycles until the data is actually in memory
+ * In blocking mode both are equal.  In non-blocking mode the caller only queues
+ * the reads, the transfers complete in the background and signal ch_io_notify().
+ */
+static void bench_iq_readout(ch_group_t *grp_ptr) {
+	ch_io_complete_callback_t saved_callback = grp_ptr->io_complete_callback;
+	uint64_t busy_cyc[2] = {0, 0};
+	uint64_t total_cyc[2] = {0, 0};
+	uint32_t start;
+	uint32_t num_bytes = 0;
+
+	ch_io_complete_callback_set(grp_ptr, bench_io_complete_callback);
+
+	for (uint8_t dev_num = 0; dev_num < ch_get_num_ports(grp_ptr); dev_num++) {
+		ch_dev_t *dev_ptr = ch_get_dev_ptr(grp_ptr, dev_num);
+
+		if (ch_sensor_is_connected(dev_ptr)) {
+			num_bytes += ch_get_num_samples(dev_ptr) * sizeof(ch_iq_sample_t);
+		}
+	}
+
+	for (int iter = 0; iter < CHIRP_BENCH_ITERATIONS; iter++) {
+
+		/* Blocking */
+		start = k_cycle_get_32();
+		for (uint8_t dev_num = 0; dev_num < ch_get_num_ports(grp_ptr); dev_num++) {
+			ch_dev_t *dev_ptr = ch_get_dev_ptr(grp_ptr, dev_num);
+
+			if (ch_sensor_is_connected(dev_ptr)) {
+				ch_get_iq_data(dev_ptr, bench_iq_buf[dev_num], 0, ch_get_num_samples(dev_ptr),
+							   CH_IO_MODE_BLOCK);
+			}
+		}
+		busy_cyc[CH_IO_MODE_BLOCK] += k_cycle_get_32() - start;
+		total_cyc[CH_IO_MODE_BLOCK] = busy_cyc[CH_IO_MODE_BLOCK];
+
+		/* Non-blocking */
+		k_sem_reset(&bench_io_sem);
+		start = k_cycle_get_32();
+		for (uint8_t dev_num = 0; dev_num < ch_get_num_ports(grp_ptr); dev_num++) {
+			ch_dev_t *dev_ptr = ch_get_dev_ptr(grp_ptr, dev_num);
+
+			if (ch_sensor_is_connected(dev_ptr)) {
+				ch_get_iq_data(dev_ptr, bench_iq_buf[dev_num], 0, ch_get_num_samples(dev_ptr),
+							   CH_IO_MODE_NONBLOCK);
+			}
+		}
+		ch_io_start_nb(grp_ptr);
+		busy_cyc[CH_IO_MODE_NONBLOCK] += k_cycle_get_32() - start;
+
+		if (k_sem_take(&bench_io_sem, K_MSEC(1000)) != 0) {
+			printf("bench: non-blocking I/Q readout timed out\n");
+			break;
+		}
+		total_cyc[CH_IO_MODE_NONBLOCK] += k_cycle_get_32() - start;
+	}
+
+	grp_ptr->io_complete_callback = saved_callback;
+
+	printf("I/Q readout, %u bytes/frame, %d frames\n", num_bytes, CHIRP_BENCH_ITERATIONS);
+	printf("  blocking:     busy %6u us  total %6u us  per frame\n",
+		   k_cyc_to_us_floor32(busy_cyc[CH_IO_MODE_BLOCK] / CHIRP_BENCH_ITERATIONS),
+		   k_cyc_to_us_floor32(total_cyc[CH_IO_MODE_BLOCK] / CHIRP_BENCH_ITERATIONS));
+	printf("  non-blocking: busy %6u us  total %6u us  per frame\n",
+		   k_cyc_to_us_floor32(busy_cyc[CH_IO_MODE_NONBLOCK] / CHIRP_BENCH_ITERATIONS),
+		   k_cyc_to_us_floor32(total_cyc[CH_IO_MODE_NONBLOCK] / CHIRP_BENCH_ITERATIONS));
+}
+
+#endif	/* CHIRP_BENCH_IQ_READOUT */
+
+#ifdef CHIRP_BENCH_REG_READ
+
+/*
+ * Time the register reads done on every measurement by the application:
+ * ch_get_amplitude() and ch_get_range() are one register read each,
+ * ch_get_result() reads both in one transaction, ch_get_thresholds() reads
+ * back all CH201 threshold registers.
+ */
+static void bench_reg_read(ch_group_t *grp_ptr) {
+	ch_dev_t *dev_ptr = NULL;
+	ch_thresholds_t thresholds;
+	ch_result_t result;
+	uint64_t amp_cyc = 0;
+	uint64_t range_cyc = 0;
+	uint64_t result_cyc = 0;
+	uint64_t thresh_cyc = 0;
+	uint32_t start;
+
+	for (uint8_t dev_num = 0; dev_num < ch_get_num_ports(grp_ptr); dev_num++) {
+		if (ch_sensor_is_connected(ch_get_dev_ptr(grp_ptr, dev_num))) {
+			dev_ptr = ch_get_dev_ptr(grp_ptr, dev_num);
+			break;
+		}
+	}
+	if (dev_ptr == NULL) {
+		printf("bench: no sensor connected\n");
+		return;
+	}
+
+	for (int iter = 0; iter < CHIRP_BENCH_ITERATIONS; iter++) {
+		start = k_cycle_get_32();
+		(void) ch_get_amplitude(dev_ptr);
+		amp_cyc += k_cycle_get_32() - start;
+
+		start = k_cycle_get_32();
+		(void) ch_get_range(dev_ptr, CH_RANGE_ECHO_ONE_WAY);
+		range_cyc += k_cycle_get_32() - start;
+
+		start = k_cycle_get_32();
+		(void) ch_get_result(dev_ptr, CH_RANGE_ECHO_ONE_WAY, &result, 0);
+		result_cyc += k_cycle_get_32() - start;
+
+		if (ch_get_part_number(dev_ptr) == CH201_PART_NUMBER) {
+			start = k_cycle_get_32();
+			(void) ch_get_thresholds(dev_ptr, &thresholds);
+			thresh_cyc += k_cycle_get_32() - start;
+		}
+	}
+
+	printf("Register reads, %d iterations\n", CHIRP_BENCH_ITERATIONS);
+	printf("  ch_get_amplitude():  %6u us\n", k_cyc_to_us_floor32(amp_cyc / CHIRP_BENCH_ITERATIONS));
+	printf("  ch_get_range():      %6u us\n", k_cyc_to_us_floor32(range_cyc / CHIRP_BENCH_ITERATIONS));
+	printf("  ch_get_result():     %6u us\n", k_cyc_to_us_floor32(result_cyc / CHIRP_BENCH_ITERATIONS));
+	if (thresh_cyc != 0) {
+		printf("  ch_get_thresholds(): %6u us\n", k_cyc_to_us_floor32(thresh_cyc / CHIRP_BENCH_ITERATIONS));
+	}
+}
+
+#endif	/* CHIRP_BENCH_REG_READ */
+
+#ifdef CHIRP_BENCH_THROUGHPUT
+
+/*
+ * Read complete I/Q frames in blocking mode and report the throughput seen by
+ * the I2C layer (bytes moved / time spent inside the transfers).
+ */
+static void bench_throughput(ch_group_t *grp_ptr) {
+	struct zy_i2c_stats stats;
+
+	zy_i2c_stats_reset();
+	for (int iter = 0; iter < CHIRP_BENCH_ITERATIONS; iter++) {
+		for (uint8_t dev_num = 0; dev_num < ch_get_num_ports(grp_ptr); dev_num++) {
+			ch_dev_t *dev_ptr = ch_get_dev_ptr(grp_ptr, dev_num);
+
+			if (ch_sensor_is_connected(dev_ptr)) {
+				ch_get_iq_data(dev_ptr, bench_iq_buf[dev_num], 0, ch_get_num_samples(dev_ptr),
+							   CH_IO_MODE_BLOCK);
+			}
+		}
+	}
+	zy_i2c_stats_get(&stats);
+
+	printf("I2C throughput, %d full I/Q frames\n", CHIRP_BENCH_ITERATIONS);
+	printf("  %u bytes in %u transfers, %u us on the bus: %u bytes/s\n", stats.bytes, stats.transfers,
+		   k_cyc_to_us_floor32(stats.cycles), zy_i2c_stats_bytes_per_sec(&stats));
+}
+
+#endif	/* CHIRP_BENCH_THROUGHPUT */
+
+#ifdef CHIRP_BENCH_BUS_RECOVERY
+
+/*
+ * Time a bus clear + controller re-init on every bus.  On the host build a
+ * sensor is also made to hold SDA low, and the next register read (which has
+ * to recover the bus and retry) is timed.  Per-bus counters are printed last.
+ */
+static void bench_bus_recovery(ch_group_t *grp_ptr) {
+	struct zy_i2c_bus_stats bus_stats;
+	uint64_t reset_cyc;
+	uint32_t start;
+
+	zy_i2c_bus_stats_reset();
+	printf("I2C bus recovery, %d iterations\n", CHIRP_BENCH_ITERATIONS);
+
+	for (uint8_t bus = 0; bus < zy_i2c_num_buses(); bus++) {
+		reset_cyc = 0;
+		for (int iter = 0; iter < CHIRP_BENCH_ITERATIONS; iter++) {
+			start = k_cycle_get_32();
+			zy_i2c_reset(bus);
+			reset_cyc += k_cycle_get_32() - start;
+		}
+		printf("  bus %d: bus clear + re-init %6u us\n", bus,
+			   k_cyc_to_us_floor32(reset_cyc / CHIRP_BENCH_ITERATIONS));
+	}
+
+#ifdef CONFIG_ARCH_POSIX
+	for (uint8_t dev_num = 0; dev_num < ch_get_num_ports(grp_ptr); dev_num++) {
+		ch_dev_t *dev_ptr = ch_get_dev_ptr(grp_ptr, dev_num);
+
+		if (ch_sensor_is_connected(dev_ptr)) {
+			zy_sim_hold_sda(dev_num);
+			start = k_cycle_get_32();
+			(void) ch_get_amplitude(dev_ptr);
+			printf("  stuck SDA on sensor %d: read recovered in %6u us\n", dev_num,
+				   k_cyc_to_us_floor32(k_cycle_get_32() - start));
+			break;
+		}
+	}
+#endif
+
+	for (uint8_t bus = 0; bus < zy_i2c_num_buses(); bus++) {
+		zy_i2c_bus_stats_get(bus, &bus_stats);
+		printf("  bus %d: %u errors, %u retries, %u recoveries, %u failures\n", bus, bus_stats.errors,
+			   bus_stats.retries, bus_stats.recoveries, bus_stats.failures);
+	}
+}
+
+#endif	/* CHIRP_BENCH_BUS_RECOVERY */
+#ifdef CHIRP_BENCH_BUS_SPEED
+
+/*
+ * Blocking full I/Q readout of all connected sensors at each bus speed.
+ * The maximum frame rate counts the measurement itself (sensors measure in
+ * parallel, the longest listening time wins) followed by the readout.
+ */
+static void bench_bus_speed(ch_group_t *grp_ptr) {
+	static const uint32_t speeds[] = { I2C_SPEED_STANDARD, I2C_SPEED_FAST, I2C_SPEED_FAST_PLUS };
+	static const char *const speed_names[] = { "standard", "fast", "fast-plus" };
+	uint32_t saved_speed[CHIRP_NUM_I2C_BUSES];
+	uint32_t measure_us = 0;
+	uint32_t num_bytes = 0;
+
+	for (uint8_t dev_num = 0; dev_num < ch_get_num_ports(grp_ptr); dev_num++) {
+		ch_dev_t *dev_ptr = ch_get_dev_ptr(grp_ptr, dev_num);
+
+		if (ch_sensor_is_connected(dev_ptr) && ch_get_frequency(dev_ptr) != 0) {
+			/* one sample every 8 cycles of the operating frequency */
+			uint32_t us = (uint32_t) (((uint64_t) ch_get_num_samples(dev_ptr) * 8 * USEC_PER_SEC) /
+									  ch_get_frequency(dev_ptr));
+
+			measure_us = MAX(measure_us, us);
+			num_bytes += ch_get_num_samples(dev_ptr) * sizeof(ch_iq_sample_t);
+		}
+	}
+	for (uint8_t bus = 0; bus < zy_i2c_num_buses(); bus++) {
+		saved_speed[bus] = zy_i2c_get_speed(bus);
+	}
+
+	printf("Bus speed, %u bytes/frame, measurement %u us, %d frames\n", num_bytes, measure_us,
+		   CHIRP_BENCH_ITERATIONS);
+
+	for (uint8_t s = 0; s < ARRAY_SIZE(speeds); s++) {
+		uint64_t cyc = 0;
+		uint32_t frame_us;
+		uint32_t start;
+		int err = 0;
+
+		for (uint8_t bus = 0; bus < zy_i2c_num_buses(); bus++) {
+			err |= zy_i2c_set_speed(bus, speeds[s]);
+		}
+		if (err) {
+			printf("  %-9s: not supported by the controller\n", speed_names[s]);
+			continue;
+		}
+
+		for (int iter = 0; iter < CHIRP_BENCH_ITERATIONS; iter++) {
+			start = k_cycle_get_32();
+			for (uint8_t dev_num = 0; dev_num < ch_get_num_ports(grp_ptr); dev_num++) {
+				ch_dev_t *dev_ptr = ch_get_dev_ptr(grp_ptr, dev_num);
+
+				if (ch_sensor_is_connected(dev_ptr)) {
+					ch_get_iq_data(dev_ptr, bench_iq_buf[dev_num], 0, ch_get_num_samples(dev_ptr),
+								   CH_IO_MODE_BLOCK);
+				}
+			}
+			cyc += k_cycle_get_32() - start;
+		}
+
+		frame_us = k_cyc_to_us_floor32(cyc / CHIRP_BENCH_ITERATIONS);
+		printf("  %-9s: readout %6u us/frame, max %4u frames/s\n", speed_names[s], frame_us,
+			   (uint32_t) (USEC_PER_SEC / MAX(frame_us + measure_us, 1)));
+	}
+
+	for (uint8_t bus = 0; bus < zy_i2c_num_buses(); bus++) {
+		zy_i2c_set_speed(bus, saved_speed[bus]);
+	}
+}
+
+#endif	/* CHIRP_BENCH_BUS_SPEED */
+#ifdef CHIRP_BENCH_GROUP_START
+
+/*
+ * Time ch_group_start() (reset, detection, firmware download, frequency lock
+ * and RTC calibration of every sensor).  On the host build the first 1, 4 and
+ * 8 ports get a sensor, the others are left empty.  Then time
+ * ch_group_warm_start() on the sensors left running by the last full start.
+ * Sensors are configured again afterwards with the settings they had before
+ * the benchmark.
+ */
+static void bench_group_start(ch_group_t *grp_ptr) {
+	static const uint8_t sensor_counts[] = { 1, 4, 8 };
+	static ch_config_t saved_config[CHIRP_MAX_NUM_SENSORS];
+	uint8_t connected[CHIRP_MAX_NUM_SENSORS];
+	uint32_t start;
+	uint32_t elapsed;
+	uint8_t err;
+
+	for (uint8_t dev_num = 0; dev_num < ch_get_num_ports(grp_ptr); dev_num++) {
+		ch_dev_t *dev_ptr = ch_get_dev_ptr(grp_ptr, dev_num);
+
+		connected[dev_num] = ch_sensor_is_connected(dev_ptr);
+		if (connected[dev_num]) {
+			ch_get_config(dev_ptr, &saved_config[dev_num]);
+		}
+	}
+
+	printf("Group start, %d I2C buses\n", zy_i2c_num_buses());
+
+	for (uint8_t n = 0; n < ARRAY_SIZE(sensor_counts); n++) {
+#ifdef CONFIG_ARCH_POSIX
+		if (sensor_counts[n] > ch_get_num_ports(grp_ptr)) {
+			printf("  %d sensors: only %d ports\n", sensor_counts[n], ch_get_num_ports(grp_ptr));
+			continue;
+		}
+		for (uint8_t dev_num = 0; dev_num < ch_get_num_ports(grp_ptr); dev_num++) {
+			zy_sim_set_present(dev_num, dev_num < sensor_counts[n]);
+		}
+#endif
+		start = k_cycle_get_32();
+		err = ch_group_start(grp_ptr);
+		elapsed = k_cycle_get_32() - start;
+
+		printf("  %d sensors: %6u us%s\n", grp_ptr->sensor_count, k_cyc_to_us_floor32(elapsed),
+			   err ? " (error)" : "");
+#ifndef CONFIG_ARCH_POSIX
+		break;					/* the sensor count is fixed by the hardware */
+#endif
+	}
+
+#ifdef CONFIG_ARCH_POSIX
+	for (uint8_t dev_num = 0; dev_num < ch_get_num_ports(grp_ptr); dev_num++) {
+		zy_sim_set_present(dev_num, 1);
+	}
+	ch_group_start(grp_ptr);
+#endif
+	start = k_cycle_get_32();
+	err = ch_group_warm_start(grp_ptr);
+	elapsed = k_cycle_get_32() - start;
+
+	printf("  warm start, %d sensors: %6u us%s\n", grp_ptr->sensor_count, k_cyc_to_us_floor32(elapsed),
+		   err ? " (error)" : "");
+
+	for (uint8_t dev_num = 0; dev_num < ch_get_num_ports(grp_ptr); dev_num++) {
+		ch_dev_t *dev_ptr = ch_get_dev_ptr(grp_ptr, dev_num);
+
+		if (connected[dev_num] && ch_sensor_is_connected(dev_ptr)) {
+			ch_set_config(dev_ptr, &saved_config[dev_num]);
+		}
+	}
+}
+
+#endif	/* CHIRP_BENCH_GROUP_START */
+#ifdef CHIRP_BENCH_FW_LOAD
+
+static const struct {
+	const char *name;
+	uint16_t part_number;
+	const uint8_t *raw;
+	const uint8_t *lz;
+	const uint16_t *lz_size;
+} bench_fw_images[] = {
+	{ "ch101_gpr_open",    CH101_PART_NUMBER, ch101_gpr_open_fw,    ch101_gpr_open_fw_lz,    &ch101_gpr_open_fw_lz_size },
+	{ "ch101_gpr_sr_open", CH101_PART_NUMBER, ch101_gpr_sr_open_fw, ch101_gpr_sr_open_fw_lz, &ch101_gpr_sr_open_fw_lz_size },
+	{ "ch201_gprmt",       CH201_PART_NUMBER, ch201_gprmt_fw,       ch201_gprmt_fw_lz,       &ch201_gprmt_fw_lz_size },
+};
+
+static int bench_fw_discard(void *context, uint16_t offset, const uint8_t *data, uint16_t nbytes) {
+	return 0;
+}
+
+/* Point every connected sensor at the raw or the compressed version of its image */
+static void bench_fw_select(ch_group_t *grp_ptr, uint8_t compressed) {
+
+	for (uint8_t dev_num = 0; dev_num < ch_get_num_ports(grp_ptr); dev_num++) {
+		ch_dev_t *dev_ptr = ch_get_dev_ptr(grp_ptr, dev_num);
+
+		for (uint8_t i = 0; i < ARRAY_SIZE(bench_fw_images); i++) {
+			if ((dev_ptr->firmware == bench_fw_images[i].raw) || (dev_ptr->firmware == bench_fw_images[i].lz)) {
+				dev_ptr->firmware   = compressed ? bench_fw_images[i].lz : bench_fw_images[i].raw;
+				dev_ptr->fw_lz_size = compressed ? *bench_fw_images[i].lz_size : 0;
+			}
+		}
+	}
+}
+
+/*
+ * Flash taken by each firmware image, raw and compressed, and the CPU time
+ * to decode it.  Then time ch_group_start() (download and sampled readback
+ * included) with the raw images and with the compressed ones.  Sensors are
+ * configured again afterwards with the settings they had before the
+ * benchmark.
+ */
+static void bench_fw_load(ch_group_t *grp_ptr) {
+	static ch_config_t saved_config[CHIRP_MAX_NUM_SENSORS];
+	const uint8_t *saved_firmware[CHIRP_MAX_NUM_SENSORS];
+	uint16_t saved_fw_lz_size[CHIRP_MAX_NUM_SENSORS];
+	uint8_t connected[CHIRP_MAX_NUM_SENSORS];
+	uint32_t raw_total = 0;
+	uint32_t lz_total = 0;
+	uint32_t start;
+	uint32_t elapsed;
+	uint8_t err;
+
+	for (uint8_t dev_num = 0; dev_num < ch_get_num_ports(grp_ptr); dev_num++) {
+		ch_dev_t *dev_ptr = ch_get_dev_ptr(grp_ptr, dev_num);
+
+		connected[dev_num] = ch_sensor_is_connected(dev_ptr);
+		if (connected[dev_num]) {
+			ch_get_config(dev_ptr, &saved_config[dev_num]);
+		}
+		saved_firmware[dev_num]   = dev_ptr->firmware;
+		saved_fw_lz_size[dev_num] = dev_ptr->fw_lz_size;
+	}
+
+	printf("Firmware load\n");
+
+	for (uint8_t i = 0; i < ARRAY_SIZE(bench_fw_images); i++) {
+		ch_dev_t dev;
+		uint16_t raw_size = (bench_fw_images[i].part_number == CH101_PART_NUMBER) ? CH101_FW_SIZE : CH201_FW_SIZE;
+
+		dev.part_number = bench_fw_images[i].part_number;
+		dev.firmware    = bench_fw_images[i].lz;
+		dev.fw_lz_size  = *bench_fw_images[i].lz_size;
+
+		start = k_cycle_get_32();
+		for (uint8_t n = 0; n < CHIRP_BENCH_ITERATIONS; n++) {
+			err = chdrv_fw_unpack(&dev, bench_fw_discard, NULL);
+		}
+		elapsed = (k_cycle_get_32() - start) / CHIRP_BENCH_ITERATIONS;
+
+		printf("  %-18s %5u -> %5u bytes (-%2u%%), decode %6u us%s\n", bench_fw_images[i].name, raw_size,
+			   dev.fw_lz_size, ((raw_size - dev.fw_lz_size) * 100) / raw_size, k_cyc_to_us_floor32(elapsed),
+			   err ? " (error)" : "");
+		raw_total += raw_size;
+		lz_total  += dev.fw_lz_size;
+	}
+	printf("  all images         %5u -> %5u bytes, %u saved\n", raw_total, lz_total, raw_total - lz_total);
+
+	for (uint8_t compressed = 0; compressed < 2; compressed++) {
+		bench_fw_select(grp_ptr, compressed);
+
+		start = k_cycle_get_32();
+		err = ch_group_start(grp_ptr);
+		elapsed = k_cycle_get_32() - start;
+
+		printf("  group start, %s images, %d sensors: %6u us%s\n", compressed ? "compressed" : "raw",
+			   grp_ptr->sensor_count, k_cyc_to_us_floor32(elapsed), err ? " (error)" : "");
+	}
+
+	for (uint8_t dev_num = 0; dev_num < ch_get_num_ports(grp_ptr); dev_num++) {
+		ch_dev_t *dev_ptr = ch_get_dev_ptr(grp_ptr, dev_num);
+
+		dev_ptr->firmware   = saved_firmware[dev_num];			// same image, in the build's format
+		dev_ptr->fw_lz_size = saved_fw_lz_size[dev_num];
+		if (connected[dev_num] && ch_sensor_is_connected(dev_ptr)) {
+			ch_set_config(dev_ptr, &saved_config[dev_num]);
+		}
+	}
+}
+
+#endif	/* CHIRP_BENCH_FW_LOAD */
+
+#ifdef CHIRP_BENCH_RANGE_CONV
+
+#define BENCH_RANGE_NUM_VALUES		256
+
+static uint16_t bench_tof[BENCH_RANGE_NUM_VALUES];
+static uint16_t bench_samples[BENCH_RANGE_NUM_VALUES];
+static uint32_t bench_range[2][BENCH_RANGE_NUM_VALUES];
+static uint16_t bench_mm[2][BENCH_RANGE_NUM_VALUES];
+
+/* One-way range as ch_get_range() used to compute it: one divide per value */
+static uint32_t bench_range_divide(ch_dev_t *dev_ptr, uint16_t tof) {
+	uint32_t num = (CH_SPEEDOFSOUND_MPS * dev_ptr->group->rtc_cal_pulse_ms * (uint32_t) tof);
+	uint32_t den = ((uint32_t) dev_ptr->rtc_cal_result * (uint32_t) dev_ptr->scale_factor) >> 11;
+	uint32_t range = (num / den);
+
+	if (dev_ptr->part_number == CH201_PART_NUMBER) {
+		range *= 2;
+	}
+	range /= 2;
+	return range >> dev_ptr->oversample;
+}
+
+/* Distance as ch_samples_to_mm() used to compute it */
+static uint16_t bench_samples_divide(ch_dev_t *dev_ptr, uint16_t num_samples) {
+	uint32_t num_mm = ((uint32_t) num_samples * CH_SPEEDOFSOUND_MPS * 8 * 1000) / (dev_ptr->op_frequency * 2);
+
+	return (uint16_t) (num_mm >> dev_ptr->oversample);
+}
+
+static uint32_t bench_ns_per_value(uint32_t cycles) {
+
+	return (uint32_t) (k_cyc_to_ns_floor64(cycles) / (BENCH_RANGE_NUM_VALUES * CHIRP_BENCH_ITERATIONS));
+}
+
+/*
+ * Convert a table of TOF values and of sample counts of the first connected
+ * sensor: with a divide per value (the former ch_get_range() /
+ * ch_samples_to_mm() arithmetic), one value at a time through the
+ * precomputed multiplier (the per-measurement path), and as one array.
+ * Conversion only, no I2C.  Also reports the largest difference between the
+ * old and the new results.
+ */
+static void bench_range_conv(ch_group_t *grp_ptr) {
+	ch_dev_t *dev_ptr = NULL;
+	uint32_t div_cyc = 0;
+	uint32_t mul_cyc = 0;
+	uint32_t bulk_cyc = 0;
+	uint32_t start;
+	uint32_t max_diff = 0;
+
+	for (uint8_t dev_num = 0; dev_num < ch_get_num_ports(grp_ptr); dev_num++) {
+		if (ch_sensor_is_connected(ch_get_dev_ptr(grp_ptr, dev_num))) {
+			dev_ptr = ch_get_dev_ptr(grp_ptr, dev_num);
+			break;
+		}
+	}
+	if ((dev_ptr == NULL) || (dev_ptr->scale_factor == 0) || (dev_ptr->op_frequency == 0)) {
+		printf("bench: no calibrated sensor connected\n");
+		return;
+	}
+
+	for (uint16_t i = 0; i < BENCH_RANGE_NUM_VALUES; i++) {
+		bench_tof[i] = 1 + (i * 61);				// below the 32-bit overflow of the old arithmetic
+		bench_samples[i] = i;
+	}
+
+	for (int iter = 0; iter < CHIRP_BENCH_ITERATIONS; iter++) {
+		start = k_cycle_get_32();
+		for (uint16_t i = 0; i < BENCH_RANGE_NUM_VALUES; i++) {
+			bench_range[0][i] = bench_range_divide(dev_ptr, bench_tof[i]);
+		}
+		div_cyc += k_cycle_get_32() - start;
+
+		start = k_cycle_get_32();
+		for (uint16_t i = 0; i < BENCH_RANGE_NUM_VALUES; i++) {
+			ch_tof_to_range_bulk(dev_ptr, CH_RANGE_ECHO_ONE_WAY, &bench_tof[i], &bench_range[1][i], 1);
+		}
+		mul_cyc += k_cycle_get_32() - start;
+
+		start = k_cycle_get_32();
+		ch_tof_to_range_bulk(dev_ptr, CH_RANGE_ECHO_ONE_WAY, bench_tof, bench_range[1], BENCH_RANGE_NUM_VALUES);
+		bulk_cyc += k_cycle_get_32() - start;
+	}
+	for (uint16_t i = 0; i < BENCH_RANGE_NUM_VALUES; i++) {
+		uint32_t diff = (bench_range[0][i] > bench_range[1][i]) ? (bench_range[0][i] - bench_range[1][i]) : 
+																   (bench_range[1][i] - bench_range[0][i]);
+		max_diff = MAX(max_diff, diff);
+	}
+
+	printf("Range conversion, CH%u, %d values x %d\n", ch_get_part_number(dev_ptr), BENCH_RANGE_NUM_VALUES, 
+		   CHIRP_BENCH_ITERATIONS);
+	printf("  TOF -> range:  divide %5u ns  multiply %5u ns  bulk %5u ns  per value, max diff %u/32 mm\n",
+		   bench_ns_per_value(div_cyc), bench_ns_per_value(mul_cyc), bench_ns_per_value(bulk_cyc), max_diff);
+
+	div_cyc = 0;
+	bulk_cyc = 0;
+	max_diff = 0;
+	for (int iter = 0; iter < CHIRP_BENCH_ITERATIONS; iter++) {
+		start = k_cycle_get_32();
+		for (uint16_t i = 0; i < BENCH_RANGE_NUM_VALUES; i++) {
+			bench_mm[0][i] = bench_samples_divide(dev_ptr, bench_samples[i]);
+		}
+		div_cyc += k_cycle_get_32() - start;
+
+		start = k_cycle_get_32();
+		ch_samples_to_mm_bulk(dev_ptr, bench_samples, bench_mm[1], BENCH_RANGE_NUM_VALUES);
+		bulk_cyc += k_cycle_get_32() - start;
+	}
+	for (uint16_t i = 0; i < BENCH_RANGE_NUM_VALUES; i++) {
+		max_diff = MAX(max_diff, (uint32_t) abs(bench_mm[0][i] - bench_mm[1][i]));
+	}
+
+	printf("  samples -> mm: divide %5u ns  bulk %5u ns  per value, max diff %u mm\n",
+		   bench_ns_per_value(div_cyc), bench_ns_per_value(bulk_cyc), max_diff);
+}
+
+#endif	/* CHIRP_BENCH_RANGE_CONV */
+
+#ifdef CHIRP_BENCH_PRECISE_RANGE
+
+#define BENCH_ECHO_WIDTH			4			// half width of the synthetic echo, in samples
+#define BENCH_ECHO_AMPLITUDE		3000
+#define BENCH_ECHO_STEP_Q8			37			// echo position step between frames, in 1/256 sample
+
+/*
+ * Synthetic echo at pos_q8 (1/256 sample): triangular envelope, carrier advancing a quarter period 
+ * per sample, like the simulated sensors.
+ */
+static void bench_make_echo(ch_iq_sample_t *iq_ptr, uint16_t num_samples, uint32_t pos_q8) {
+	const int32_t width_q8 = BENCH_ECHO_WIDTH << 8;
+
+	for (uint16_t n = 0; n < num_samples; n++) {
+		int32_t dist = abs(((int32_t) n << 8) - (int32_t) pos_q8);
+		int16_t amp = (dist < width_q8) ? (int16_t) ((BENCH_ECHO_AMPLITUDE * (width_q8 - dist)) / width_q8) : 0;
+
+		iq_ptr[n].i = ((n & 3) == 0) ? amp : (((n & 3) == 2) ? -amp : 0);
+		iq_ptr[n].q = ((n & 3) == 1) ? amp : (((n & 3) == 3) ? -amp : 0);
+	}
+}
+
+/* One-way range (mm * 32) of an I/Q sample position (1/256 sample) */
+static uint32_t bench_pos_to_range(ch_dev_t *dev_ptr, uint32_t pos_q8) {
+	uint64_t num = (uint64_t) pos_q8 * ch_group_get_speed_of_sound(dev_ptr->group) * 8 * 32;
+	uint64_t den = (uint64_t) dev_ptr->op_frequency * 2 * 256;
+
+	return (uint32_t) (num / den) >> dev_ptr->oversample;
+}
+
+/*
+ * CPU cycle counter for timing calls of a few hundred cycles: DWT CYCCNT on the nRF52840 with 
+ * CONFIG_TIMING_FUNCTIONS.  k_cycle_get_32() is the 32.768 kHz RTC1 there, ~1950 CPU cycles per 
+ * tick, and is only used when the timing API is not available.
+ */
+static uint32_t bench_cpu_cycles(void) {
+#ifdef CONFIG_TIMING_FUNCTIONS
+	return (uint32_t) timing_counter_get();
+#else
+	return k_cycle_get_32();
+#endif
+}
+
+static uint64_t bench_cpu_cycles_to_ns(uint64_t cycles) {
+#ifdef CONFIG_TIMING_FUNCTIONS
+	return timing_cycles_to_ns(cycles);
+#else
+	return k_cyc_to_ns_floor64(cycles);
+#endif
+}
+
+/*
+ * Refine the range of a synthetic echo of the first connected sensor, moved by a fraction of a 
+ * sample from frame to frame.  The reported range is that of the sample before the echo peak, as 
+ * the sensor would report it.  Computation only, no I2C.  Reports the cycles per call and the 
+ * largest error of the reported and of the refined range.
+ */
+static void bench_precise_range(ch_group_t *grp_ptr) {
+	ch_iq_sample_t *iq_ptr = bench_iq_buf[0];
+	ch_dev_t *dev_ptr = NULL;
+	uint16_t num_samples;
+	uint32_t cyc;
+	uint64_t total_cyc = 0;
+	uint32_t avg_ns;
+	uint32_t max_cyc = 0;
+	uint32_t coarse_err = 0;
+	uint32_t fine_err = 0;
+
+	for (uint8_t dev_num = 0; dev_num < ch_get_num_ports(grp_ptr); dev_num++) {
+		if (ch_sensor_is_connected(ch_get_dev_ptr(grp_ptr, dev_num))) {
+			dev_ptr = ch_get_dev_ptr(grp_ptr, dev_num);
+			break;
+		}
+	}
+	if ((dev_ptr == NULL) || (dev_ptr->scale_factor == 0) || (dev_ptr->op_frequency == 0)) {
+		printf("bench: no calibrated sensor connected\n");
+		return;
+	}
+
+	num_samples = MIN(ch_get_num_samples(dev_ptr), CH201_MAX_NUM_SAMPLES);
+	if (num_samples < (4 * BENCH_ECHO_WIDTH)) {
+		num_samples = CH101_MAX_NUM_SAMPLES;
+	}
+
+#ifdef CONFIG_TIMING_FUNCTIONS
+	timing_init();
+	timing_start();
+#endif
+	for (int iter = 0; iter < CHIRP_BENCH_ITERATIONS; iter++) {
+		uint32_t pos_q8 = ((2 * BENCH_ECHO_WIDTH) << 8) + 
+						  ((iter * BENCH_ECHO_STEP_Q8) % ((num_samples - (4 * BENCH_ECHO_WIDTH)) << 8));
+		uint32_t true_range = bench_pos_to_range(dev_ptr, pos_q8);
+		uint32_t range = bench_pos_to_range(dev_ptr, pos_q8 & ~0xFF);
+
+		bench_make_echo(iq_ptr, num_samples, pos_q8);
+		coarse_err = MAX(coarse_err, (uint32_t) abs((int32_t) (range - true_range)));
+
+		cyc = bench_cpu_cycles();
+		range = ch_get_precise_range(dev_ptr, CH_RANGE_ECHO_ONE_WAY, range, iq_ptr, num_samples);
+		cyc = bench_cpu_cycles() - cyc;
+
+		total_cyc += cyc;
+		max_cyc = MAX(max_cyc, cyc);
+		fine_err = MAX(fine_err, (uint32_t) abs((int32_t) (range - true_range)));
+	}
+#ifdef CONFIG_TIMING_FUNCTIONS
+	timing_stop();
+#endif
+	avg_ns = (uint32_t) (bench_cpu_cycles_to_ns(total_cyc) / CHIRP_BENCH_ITERATIONS);
+
+	printf("Precise range, CH%u, %u samples, %d frames\n", ch_get_part_number(dev_ptr), num_samples, 
+		   CHIRP_BENCH_ITERATIONS);
+	printf("  per call: %u cycles avg, %u max (%u ns avg), %u us/s per sensor at 50 Hz\n", 
+		   (uint32_t) (total_cyc / CHIRP_BENCH_ITERATIONS), max_cyc, avg_ns, avg_ns * 50 / 1000);
+	printf("  max error: reported %u/32 mm, refined %u/32 mm\n", coarse_err, fine_err);
+}
+
+#endif	/* CHIRP_BENCH_PRECISE_RANGE */
+
+void chirp_bench_run(ch_group_t *grp_ptr) {
+
+#ifdef CHIRP_BENCH_IQ_READOUT
+	bench_iq_readout(grp_ptr);
+#endif
+#ifdef CHIRP_BENCH_REG_READ
+	bench_reg_read(grp_ptr);
+#endif
+#ifdef CHIRP_BENCH_THROUGHPUT
+	bench_throughput(grp_ptr);
+#endif
+#ifdef CHIRP_BENCH_BUS_RECOVERY
+	bench_bus_recovery(grp_ptr);
+#endif
+#ifdef CHIRP_BENCH_BUS_SPEED
+	bench_bus_speed(grp_ptr);
+#endif
+#ifdef CHIRP_BENCH_GROUP_START
+	bench_group_start(grp_ptr);
+#endif
+#ifdef CHIRP_BENCH_FW_LOAD
+	bench_fw_load(grp_ptr);
+#endif
+#ifdef CHIRP_BENCH_RANGE_CONV
+	bench_range_conv(grp_ptr);
+#endif
+#ifdef CHIRP_BENCH_PRECISE_RANGE
+	bench_precise_range(grp_ptr);
+#endif
+	(void) grp_ptr;
+}
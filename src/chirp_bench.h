@@ -0,0 +1,49 @@
+/*
+ Chirp sensor benchmarks
+
+ Small timing benchmarks for the SonicLib / board support layer, run once
+ from main() after the sensors have been configured.  Each benchmark is
+ enabled by its own CHIRP_BENCH_* build option below and prints its results
+ on the console.
+*/
+
+#ifndef __CHIRP_BENCH_H
+#define __CHIRP_BENCH_H
+
+#include "soniclib.h"
+
+/*============================= Benchmark Selection ============================*/
+
+/* I/Q readout: CPU-busy time and total latency per frame, blocking vs. non-blocking I/O */
+// #define CHIRP_BENCH_IQ_READOUT
+
+/* Register reads: latency of single register reads (amplitude, range) and of a full threshold readback */
+// #define CHIRP_BENCH_REG_READ
+
+/* Large transfers: effective I2C throughput (bytes/s) for full-frame blocking I/Q reads */
+// #define CHIRP_BENCH_THROUGHPUT
+
+/* Bus recovery: bus clear + re-init time per bus, recovery of a stuck bus (host build), error/retry counters */
+// #define CHIRP_BENCH_BUS_RECOVERY
+
+/* Bus speed: I/Q frame readout time and maximum frame rate in standard, fast and fast-plus mode */
+// #define CHIRP_BENCH_BUS_SPEED
+
+/* Group start: ch_group_start() time with 1, 4 and 8 sensors (host build; the connected sensors only on hardware), ch_group_warm_start() time */
+// #define CHIRP_BENCH_GROUP_START
+
+/* Firmware load: flash size of the compressed images, decode time, ch_group_start() time with raw vs. compressed images */
+// #define CHIRP_BENCH_FW_LOAD
+
+/* Range conversion: time per TOF -> range and samples -> mm conversion, divide per value vs. precomputed multiplier */
+// #define CHIRP_BENCH_RANGE_CONV
+
+/* Precise range: cycles per ch_get_precise_range() call on a synthetic I/Q frame, error before and after interpolation */
+// #define CHIRP_BENCH_PRECISE_RANGE
+
+#define CHIRP_BENCH_ITERATIONS		32		// frames / operations measured per benchmark
+
+
+void chirp_bench_run(ch_group_t *grp_ptr);
+
+#endif /* __CHIRP_BENCH_H */
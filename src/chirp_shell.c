@@ -0,0 +1,74 @@
+/*
+ Chirp sensor shell commands
+ See chirp_shell.h for the available commands.
+*/
+
+#include <zephyr/kernel.h>
+#include <zephyr/shell/shell.h>
+#include <stdlib.h>
+#include "chirp_shell.h"
+
+static ch_group_t *shell_grp_ptr;
+
+void chirp_shell_init(ch_group_t *grp_ptr) {
+
+	shell_grp_ptr = grp_ptr;
+}
+
+static int cmd_chirp_boot(const struct shell *sh, size_t argc, char **argv) {
+	ch_boot_profile_t profile;
+
+	if (shell_grp_ptr == NULL) {
+		shell_error(sh, "sensor group not started");
+		return -ENODEV;
+	}
+
+	shell_print(sh, "ch_group_start: %u us", ch_group_get_boot_time(shell_grp_ptr));
+
+	for (uint8_t dev_num = 0; dev_num < ch_get_num_ports(shell_grp_ptr); dev_num++) {
+		ch_dev_t *dev_ptr = ch_get_dev_ptr(shell_grp_ptr, dev_num);
+
+		if (ch_get_boot_profile(dev_ptr, &profile) != 0) {
+			shell_error(sh, "boot profile not available (CHDRV_BOOT_PROFILE)");
+			return -ENOTSUP;
+		}
+
+		shell_print(sh, "port %u: %s, %u us", dev_num,
+					ch_sensor_is_connected(dev_ptr) ? "connected" : "not connected", profile.total_us);
+		for (uint8_t phase = 0; phase < CH_BOOT_NUM_PHASES; phase++) {
+			shell_print(sh, "  %-12s %8u us", ch_boot_phase_name(phase), profile.phase_us[phase]);
+		}
+	}
+
+	return 0;
+}
+
+static int cmd_chirp_temp(const struct shell *sh, size_t argc, char **argv) {
+	uint8_t humidity_pct = CH_HUMIDITY_UNKNOWN;
+	uint8_t rebuilt;
+
+	if (shell_grp_ptr == NULL) {
+		shell_error(sh, "sensor group not started");
+		return -ENODEV;
+	}
+
+	if (argc > 1) {
+		if (argc > 2) {
+			humidity_pct = (uint8_t) CLAMP(strtol(argv[2], NULL, 10), 0, 100);
+		}
+		rebuilt = ch_group_set_temperature(shell_grp_ptr, (int16_t) (strtod(argv[1], NULL) * 100), humidity_pct);
+		shell_print(sh, "%s", rebuilt ? "conversion constants rebuilt" : "change below the rebuild step");
+	}
+	shell_print(sh, "speed of sound: %u mm/s", ch_group_get_speed_of_sound(shell_grp_ptr));
+
+	return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(chirp_cmds,
+	SHELL_CMD(boot, NULL, "Time per phase of the last ch_group_start(), per sensor", cmd_chirp_boot),
+	SHELL_CMD_ARG(temp, NULL, "Show the speed of sound, or set the air temperature: temp [<deg C> [<RH %>]]",
+				  cmd_chirp_temp, 1, 2),
+	SHELL_SUBCMD_SET_END
+);
+
+SHELL_CMD_REGISTER(chirp, &chirp_cmds, "Chirp sensor commands", NULL);
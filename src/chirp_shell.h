@@ -0,0 +1,19 @@
+/*
+ Chirp sensor shell commands
+
+ "chirp boot": time spent in each phase of the last ch_group_start(), per
+ sensor (see ch_get_boot_profile()).
+ "chirp temp [<deg C> [<RH %>]]": speed of sound used for the ranges, or set
+ the air temperature (see ch_group_set_temperature()).
+ Built when CONFIG_SHELL is enabled.
+*/
+
+#ifndef __CHIRP_SHELL_H
+#define __CHIRP_SHELL_H
+
+#include "soniclib.h"
+
+/* Sensor group the commands report on */
+void chirp_shell_init(ch_group_t *grp_ptr);
+
+#endif /* __CHIRP_SHELL_H */
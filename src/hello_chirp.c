@@ -46,13 +46,17 @@
 
 
 /* Bit flags used in main loop to check for completion of sensor I/O.  */
-#define DATA_READY_FLAG		(1 << 0)
+#define DATA_READY_FLAG		(1 << 0)	/* all sensors measured, results not read yet */
 #define IQ_READY_FLAG		(1 << 1)
+#define RESULTS_READY_FLAG	(1 << 2)	/* results of all sensors in chirp_results[] */
 
 
 /* Array of structs to hold measurement data, one for each possible device */
 chirp_data_t	chirp_data[CHIRP_MAX_NUM_SENSORS];		
 
+/* Range and amplitude of each possible device, filled by the group result readout */
+static ch_result_t chirp_results[CHIRP_MAX_NUM_SENSORS];
+
 /* Array of ch_dev_t device descriptors, one for each possible device */
 ch_dev_t	chirp_devices[CHIRP_MAX_NUM_SENSORS];		
 
@@ -93,8 +97,10 @@ static uint32_t data_ready_devices;
 /* Forward declarations */
 static void    sensor_int_callback(ch_group_t *grp_ptr, uint8_t dev_num);
 static void    io_complete_callback(ch_group_t *grp_ptr);
+static void    result_callback(ch_group_t *grp_ptr, ch_result_t *results_ptr);
 static void    periodic_timer_callback(void);
 static uint8_t display_config_info(ch_dev_t *dev_ptr);
+static void    read_results(ch_group_t *grp_ptr);
 static uint8_t handle_data_ready(ch_group_t *grp_ptr);
 static uint8_t handle_iq_data(ch_group_t *grp_ptr);
 
@@ -238,6 +244,12 @@ int example_main(void) {
 	ch_io_complete_callback_set(grp_ptr, io_complete_callback);
 
 
+	/* Register callback function called when the range and amplitude of all
+	 *   sensors have been read in the background (see sensor_int_callback())
+	 */
+	ch_result_callback_set(grp_ptr, result_callback);
+
+
 	/* Configure each sensor with its operating parameters 
 	 *   Initialize a ch_config_t structure with values defined in the
 	 *   hello_chirp.h header file, then write the configuration to the 
@@ -316,12 +328,13 @@ int example_main(void) {
 	 *   execution.  The processor is put in a low-power sleep mode between 
 	 *   measurement cycles and is awakened by interrupt events.  
 	 *
-	 *   The interrupt may be the periodic timer (set up above), a data-ready 
-	 *   interrupt from a sensor, or the completion of a non-blocking I/O 
-	 *   operation.  This loop will check flags that are set during the 
-	 *   callback functions for the data-ready interrupt and the non-blocking 
-	 *   I/O complete.  Based on the flags that are set, this loop will call 
-	 *   the appropriate routines to handle and/or display sensor data.
+	 *   The callbacks wake it with chbsp_proc_wakeup() when they have work 
+	 *   for it: normally once per measurement, when the results of all 
+	 *   sensors have been read in the background, and once more when a 
+	 *   non-blocking I/Q readout completes.  This loop will check flags that 
+	 *   are set during the callback functions.  Based on the flags that are 
+	 *   set, this loop will call the appropriate routines to handle and/or 
+	 *   display sensor data.
 	 */
 	while (1) {		/* LOOP FOREVER */
 		/*
@@ -335,12 +348,20 @@ int example_main(void) {
 			/* We only continue here after an interrupt wakes the processor */
 		}
 
-		/* Check for sensor data-ready interrupt(s) */
+		/* Check for sensor data-ready interrupt(s) not read in the background */
 		if (taskflags & DATA_READY_FLAG) {
 
-			/* All sensors have interrupted - handle sensor data */
+			/* All sensors have interrupted - read results */
 			taskflags &= ~DATA_READY_FLAG;		// clear flag
-			handle_data_ready(grp_ptr);			// read and display measurement
+			read_results(grp_ptr);
+			taskflags |= RESULTS_READY_FLAG;
+		}
+
+		/* Check for results of all sensors */
+		if (taskflags & RESULTS_READY_FLAG) {
+
+			taskflags &= ~RESULTS_READY_FLAG;	// clear flag
+			handle_data_ready(grp_ptr);			// display measurement, read I/Q
 		}
 
 		/* Check for non-blocking I/Q readout complete */
@@ -393,19 +414,44 @@ static void sensor_int_callback(ch_group_t *grp_ptr, uint8_t dev_num) {
 		/* All active sensors have interrupted after performing a measurement */
 		data_ready_devices = 0;
 
-		/* Set data-ready flag - it will be checked in main() loop */
-		taskflags |= DATA_READY_FLAG;
-
 		/* Disable interrupt unless in free-running mode
 		 *   It will automatically be re-enabled during the next trigger 
 		 */
 		if (ch_get_mode(dev_ptr) != CH_MODE_FREERUN) {
 			chbsp_group_io_interrupt_disable(grp_ptr);
 		}
+
+		/* Read range and amplitude of all sensors in the background
+		 *   result_callback() is called when they are all available.  If the
+		 *   readout cannot start (e.g. an I/Q readout is still running), set 
+		 *   the data-ready flag so that the main() loop reads them.
+		 */
+		if (ch_group_get_results_nb(grp_ptr, CH_RANGE_ECHO_ONE_WAY, chirp_results) != 0) {
+			taskflags |= DATA_READY_FLAG;
+			chbsp_proc_wakeup();
+		}
 	}
 }
 
 
+/*
+ * result_callback() - group result readout complete callback routine
+ *
+ * This function is called by SonicLib when the range and amplitude of all 
+ * sensors have been read and converted into the chirp_results array.  It sets 
+ * a flag that will be detected and handled in the main() loop, which only 
+ * wakes up here once per measurement.
+ *
+ * This callback function is registered by the call to 
+ * ch_result_callback_set() in main().
+ */
+static void result_callback(ch_group_t *grp_ptr, ch_result_t *results_ptr) {
+
+	taskflags |= RESULTS_READY_FLAG;
+	chbsp_proc_wakeup();
+}
+
+
 /*
  * io_complete_callback() - non-blocking I/O complete callback routine
  *
@@ -422,6 +468,7 @@ static void sensor_int_callback(ch_group_t *grp_ptr, uint8_t dev_num) {
 static void io_complete_callback(ch_group_t *grp_ptr) {
 
 	taskflags |= IQ_READY_FLAG;
+	chbsp_proc_wakeup();
 }
 
 
@@ -501,13 +548,38 @@ static uint8_t display_config_info(ch_dev_t *dev_ptr) {
 
 
 /*
- * handle_data_ready() - get data from all sensors
+ * read_results() - read range and amplitude from all sensors
+ *
+ * This routine is called from the main() loop when the results could not be 
+ * read in the background (see sensor_int_callback()).  It fills the 
+ * chirp_results array with blocking reads, one I2C transaction per sensor.
+ */
+static void read_results(ch_group_t *grp_ptr) {
+
+	for (uint8_t dev_num = 0; dev_num < ch_get_num_ports(grp_ptr); dev_num++) {
+		ch_dev_t *dev_ptr = ch_get_dev_ptr(grp_ptr, dev_num);
+
+		/* For sensor in transmit/receive mode, report one-way echo 
+		 *   distance,  For sensor(s) in receive-only mode, report direct 
+		 *   one-way distance from transmitting sensor 
+		 */
+		if (ch_get_mode(dev_ptr) == CH_MODE_TRIGGERED_RX_ONLY) {
+			ch_get_result(dev_ptr, CH_RANGE_DIRECT, &chirp_results[dev_num], 0);
+		} else {
+			ch_get_result(dev_ptr, CH_RANGE_ECHO_ONE_WAY, &chirp_results[dev_num], 0);
+		}
+	}
+}
+
+
+/*
+ * handle_data_ready() - display data from all sensors
  *
- * This routine is called from the main() loop after all sensors have 
- * interrupted. It shows how to read the sensor data once a measurement is 
- * complete.  This routine always reads out the range and amplitude, and 
- * optionally performs either a blocking or non-blocking read of the raw I/Q 
- * data.   See the comments in hello_chirp.h for information about the
+ * This routine is called from the main() loop once the range and amplitude 
+ * of all sensors are in the chirp_results array. It shows how to use the 
+ * sensor data once a measurement is complete.  This routine always reports 
+ * the range and amplitude, and optionally performs either a blocking or 
+ * non-blocking read of the raw I/Q data.   See the comments in hello_chirp.h for information about the
  * I/Q readout build options.
  *
  * If a blocking I/Q read is requested, this function will read the data from 
@@ -545,34 +617,21 @@ static uint8_t handle_data_ready(ch_group_t *grp_ptr) {
 
 		if (ch_sensor_is_connected(dev_ptr)) {
 
-			/* Get measurement results from each connected sensor 
-			 *   For sensor in transmit/receive mode, report one-way echo 
-			 *   distance,  For sensor(s) in receive-only mode, report direct 
-			 *   one-way distance from transmitting sensor 
+			/* Measurement results of each connected sensor, already read 
+			 *   (one-way echo distance, or direct distance for sensors in 
+			 *   receive-only mode)
 			 */
-			
-			if (ch_get_mode(dev_ptr) == CH_MODE_TRIGGERED_RX_ONLY) {
-				chirp_data[dev_num].range = ch_get_range(dev_ptr, 
-														CH_RANGE_DIRECT);
-			} else {
-				chirp_data[dev_num].range = ch_get_range(dev_ptr, 
-														CH_RANGE_ECHO_ONE_WAY);
-			}
+			chirp_data[dev_num].range = chirp_results[dev_num].range;
+			chirp_data[dev_num].amplitude = chirp_results[dev_num].amplitude;	/* 0 if no target */
 
 			if (chirp_data[dev_num].range == CH_NO_TARGET) {
 				/* No target object was detected - no range value */
 
-				chirp_data[dev_num].amplitude = 0;  /* no updated amplitude */
-
 				printf("Port %d:          no target found        ", dev_num);
 
 			} else {
 				/* Target object was successfully detected (range available) */
 
-				 /* Get the new amplitude value - it's only updated if range 
-				  * was successfully measured.  */
-				chirp_data[dev_num].amplitude = ch_get_amplitude(dev_ptr);
-
 				printf("Port %d:  Range: %0.1f mm  Amplitude: %u  ", dev_num, 
 						(float) chirp_data[dev_num].range/32.0f,
 					   	chirp_data[dev_num].amplitude);
@@ -594,6 +653,23 @@ static uint8_t handle_data_ready(ch_group_t *grp_ptr) {
 			if (!error) {
 				printf("     %d IQ samples copied", num_samples);
 
+#if (MAX_TARGETS_PER_SENSOR > 0)
+				/* All echoes above the detection thresholds, not only the nearest one */
+				ch_target_t targets[MAX_TARGETS_PER_SENSOR];
+				uint8_t num_targets;
+
+				num_targets = ch_get_targets(dev_ptr, 
+						(ch_get_mode(dev_ptr) == CH_MODE_TRIGGERED_RX_ONLY) ? CH_RANGE_DIRECT : CH_RANGE_ECHO_ONE_WAY, 
+						chirp_data[dev_num].iq_data, num_samples, 
+						(ch_get_part_number(dev_ptr) == CH201_PART_NUMBER) ? &chirp_ch201_thresholds : NULL, 
+						targets, MAX_TARGETS_PER_SENSOR);
+
+				for (uint8_t i = 0; i < num_targets; i++) {
+					printf("\n        Target %u:  Range: %0.1f mm  Amplitude: %u  Width: %u samples", i, 
+						   (float) targets[i].range/32.0f, targets[i].amplitude, targets[i].width);
+				}
+#endif
+
 #ifdef OUTPUT_IQ_DATA_CSV
 				/* Output IQ values in CSV format, one pair (sample) per line */
 				ch_iq_sample_t *iq_ptr;
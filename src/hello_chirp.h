@@ -178,6 +178,13 @@ extern chirp_data_t	chirp_data[];
 
 // #define OUTPUT_IQ_DATA_CSV		/* define to output I/Q data in CSV format*/
 
+/* Targets found in the I/Q data of each sensor
+ *   With a blocking I/Q read, up to this many echoes above the detection 
+ *   thresholds are listed per sensor, nearest first (see ch_get_targets()).  
+ *   Set to 0 to list none.
+ */
+#define MAX_TARGETS_PER_SENSOR		4
+
 
 #endif /* __HELLO_CHIRP_H */
 
@@ -53,11 +53,21 @@
 #define CH101_GPR_OPEN_REG_CAL_RESULT 		0x0A
 #define CH101_GPR_OPEN_REG_DATA 			0x1C
 
+/* Registers only written by the host, mirrored in the driver register cache */
+#define CH101_GPR_OPEN_REG_CACHE_MASK	(CHDRV_REG_MASK(CH101_GPR_OPEN_REG_OPMODE, 1) | \
+										 CHDRV_REG_MASK(CH101_GPR_OPEN_REG_TICK_INTERVAL, 2) | \
+										 CHDRV_REG_MASK(CH101_GPR_OPEN_REG_PERIOD, 1) | \
+										 CHDRV_REG_MASK(CH101_GPR_OPEN_REG_MAX_RANGE, 1) | \
+										 CHDRV_REG_MASK(CH101_GPR_OPEN_REG_CALC, 2) | \
+										 CHDRV_REG_MASK(CH101_GPR_OPEN_REG_ST_RANGE, 2))	// static range + stationary coeff.
+
 #define	CH101_GPR_OPEN_CTR					(0x2B368)
 #define CH101_GPR_OPEN_MAX_SAMPLES			(150)
 
 extern const char *ch101_gpr_open_version;		// version string in fw .c file
 extern const uint8_t ch101_gpr_open_fw[CH101_FW_SIZE];
+extern const uint8_t ch101_gpr_open_fw_lz[];		// compressed image, generated from the fw .c file at build time
+extern const uint16_t ch101_gpr_open_fw_lz_size;
 
 uint16_t get_ch101_gpr_open_fw_ram_init_addr(void);
 uint16_t get_ch101_gpr_open_fw_ram_init_size(void);
@@ -66,7 +76,7 @@ const unsigned char * get_ram_ch101_gpr_open_init_ptr(void);
 
 uint8_t ch101_gpr_open_init(ch_dev_t *dev_ptr, ch_group_t *grp_ptr, uint8_t i2c_addr, uint8_t dev_num, uint8_t i2c_bus_index);
 
-void ch101_gpr_open_store_pt_result(ch_dev_t *dev_ptr);
+void ch101_gpr_open_store_pt_result(ch_dev_t *dev_ptr, ch_cal_result_t *cal_ptr);
 
 
 
@@ -57,11 +57,24 @@
 #define CH201_GPRMT_REG_AMPLITUDE 		0x26
 #define CH201_GPRMT_REG_DATA 			0x28
 
+/* Registers only written by the host, mirrored in the driver register cache */
+#define CH201_GPRMT_REG_CACHE_MASK		(CHDRV_REG_MASK(CH201_GPRMT_REG_OPMODE, 1) | \
+										 CHDRV_REG_MASK(CH201_GPRMT_REG_TICK_INTERVAL, 2) | \
+										 CHDRV_REG_MASK(CH201_GPRMT_REG_PERIOD, 1) | \
+										 CHDRV_REG_MASK(CH201_GPRMT_REG_MAX_RANGE, 1) | \
+										 CHDRV_REG_MASK(CH201_GPRMT_REG_THRESH_LEN_0, 2) | \
+										 CHDRV_REG_MASK(CH201_GPRMT_REG_THRESH_LEN_2, 2) | \
+										 CHDRV_REG_MASK(CH201_GPRMT_REG_ST_RANGE, 1) | \
+										 CHDRV_REG_MASK(CH201_GPRMT_REG_THRESH_LEN_4, 1) | \
+										 CHDRV_REG_MASK(CH201_GPRMT_REG_THRESHOLDS, (2 * CH201_GPRMT_NUM_THRESHOLDS)))
+
 #define CH201_GPRMT_MAX_SAMPLES			(450)	// max number of samples
 #define CH201_GPRMT_NUM_THRESHOLDS		(6)		// total number of thresholds
 
 extern const char *ch201_gprmt_version;		// version string in fw .c file
 extern const uint8_t ch201_gprmt_fw[CH201_FW_SIZE];
+extern const uint8_t ch201_gprmt_fw_lz[];		// compressed image, generated from the fw .c file at build time
+extern const uint16_t ch201_gprmt_fw_lz_size;
 
 uint16_t get_ch201_gprmt_fw_ram_init_addr(void);
 uint16_t get_ch201_gprmt_fw_ram_init_size(void);
@@ -108,19 +108,23 @@ uint32_t ch_common_get_range(ch_dev_t *dev_ptr, ch_range_t range_type);
 
 uint16_t ch_common_get_amplitude(ch_dev_t *dev_ptr);
 
+uint8_t ch_common_get_result(ch_dev_t *dev_ptr, ch_range_t range_type, ch_result_t *result_ptr, uint8_t options);
+
+uint8_t ch_common_queue_result(ch_dev_t *dev_ptr);
+
 uint8_t ch_common_get_locked_state(ch_dev_t *dev_ptr);
 
 uint32_t ch_common_get_op_freq(ch_dev_t *dev_ptr);
 
 void ch_common_prepare_pulse_timer(ch_dev_t *dev_ptr);
 
-void ch_common_store_pt_result(ch_dev_t *dev_ptr);
+void ch_common_store_pt_result(ch_dev_t *dev_ptr, ch_cal_result_t *cal_ptr);
 
-void ch_common_store_op_freq(ch_dev_t *dev_ptr);
+void ch_common_store_op_freq(ch_dev_t *dev_ptr, ch_cal_result_t *cal_ptr);
 
-void ch_common_store_bandwidth(ch_dev_t *dev_ptr);
+void ch_common_store_bandwidth(ch_dev_t *dev_ptr, ch_cal_result_t *cal_ptr);
 
-void ch_common_store_scale_factor(ch_dev_t *dev_ptr);
+void ch_common_store_scale_factor(ch_dev_t *dev_ptr, ch_cal_result_t *cal_ptr);
 
 uint8_t ch_common_set_thresholds(ch_dev_t *dev_ptr, ch_thresholds_t *thresholds_ptr);
 
@@ -130,7 +134,7 @@ uint16_t ch_common_mm_to_samples(ch_dev_t *dev_ptr, uint16_t num_mm);
 
 uint16_t ch_common_samples_to_mm(ch_dev_t *dev_ptr, uint16_t num_samples);
 
-uint8_t ch_common_get_iq_data(ch_dev_t *dev_ptr, ch_iq_sample_t *buf_ptr, uint16_t start_sample, uint16_t num_samples, uint8_t nonblock);
+uint8_t ch_common_get_iq_data(ch_dev_t *dev_ptr, ch_iq_sample_t *buf_ptr, uint16_t start_sample, uint16_t num_samples, ch_io_mode_t mode);
 
 #endif
 
@@ -57,6 +57,8 @@
 #define CHDRV_NB_TRANS_TYPE_STD			(0)		/*!< standard non-blocking I/O transaction */
 #define CHDRV_NB_TRANS_TYPE_PROG		(1)		/*!< non-blocking I/O via low-level programming interface */
 #define CHDRV_NB_TRANS_TYPE_EXTERNAL	(2)		/*!< externally requested non-blocking I/O transaction */
+#define CHDRV_NB_TRANS_TYPE_RESULT		(3)		/*!< result read of a group readout (standard I/O, see 
+														 \a chdrv_group_results_claim()) */
 
 /* Programming interface register addresses */
 #define CH_PROG_REG_PING 		0x00			/*!< Read-only register used during device discovery. */
@@ -72,22 +74,81 @@
 
 #define CH_PROG_XFER_SIZE      (256)         	/*!< max size of a read operation via programming interface */
 
+#define CHDRV_FW_VERIFY_BLOCK	(64)			/*!< bytes read back per programming interface read when verifying a broadcast download */
+#define CHDRV_WARM_VERIFY_SAMPLE	(32)		/*!< bytes compared at each end of the firmware image when resuming a running sensor */
+#ifdef CHDRV_FW_VERIFY_SAMPLED
+#define CHDRV_FW_VERIFY_SAMPLE	(32)			/*!< bytes compared per verified firmware block (sampled verification only) */
+#define CHDRV_FW_VERIFY_STRIDE	(256)			/*!< distance between verified firmware blocks (sampled verification only) */
+#endif
+
+#define CHDRV_FW_LZ_WINDOW_BITS	(8)				/*!< compressed firmware: bits of a back-reference offset (see scripts/ch_fw_lz.py) */
+#define CHDRV_FW_LZ_LENGTH_BITS	(4)				/*!< compressed firmware: bits of a back-reference length */
+#define CHDRV_FW_LZ_MIN_MATCH	(2)				/*!< compressed firmware: shortest back-reference */
+#define CHDRV_FW_LZ_WINDOW		(1 << CHDRV_FW_LZ_WINDOW_BITS)	/*!< decoder RAM window, also the size of the decoded chunks */
+
 #define CHDRV_DEBUG_PIN_NUM		(0)				/*!< debug pin number (index) to use for debug indication */
 
 
-#define CHDRV_MAX_I2C_QUEUE_LENGTH 	CHIRP_MAX_NUM_SENSORS /*!< Max queued non-blocking I2C transactions - value from chirp_board_config.h */
+#define CHDRV_MAX_I2C_QUEUE_LENGTH 	(2 * CHIRP_MAX_NUM_SENSORS) /*!< Max queued non-blocking I2C transactions: a result and an 
+																	 I/Q read per sensor - value from chirp_board_config.h */
 
 #define CHDRV_FREQLOCK_TIMEOUT_MS 	100 		/*!< Time to wait in chdrv_group_start() for sensor 
 											  			initialization, in milliseconds.  */
+#define CHDRV_RTC_CAL_IDLE			0			/*!< No background RTC calibration running */
+#define CHDRV_RTC_CAL_PULSE			1			/*!< Background RTC calibration pulse on the INT lines */
+#define CHDRV_RTC_CAL_READOUT		2			/*!< Background RTC calibration pulse done, results not read yet */
+#define CHDRV_RTC_CAL_SCHEDULED		3			/*!< Recalibration pulse scheduled for the next idle window */
+#define CHDRV_RTC_CAL_READOUT_MS	100			/*!< Time allowed to read the results of a background RTC 
+														calibration after the pulse, in milliseconds.  */
+
+#define CHDRV_RECAL_PERIOD_MIN_MS	(10000)		/*!< Shortest recalibration period, in milliseconds. */
+#define CHDRV_RECAL_PERIOD_MAX_MS	(3600000)	/*!< Longest recalibration period, in milliseconds. */
+#define CHDRV_RECAL_DRIFT_LOW_PPM	(200)		/*!< Below this RTC drift between calibrations, the period doubles. */
+#define CHDRV_RECAL_DRIFT_HIGH_PPM	(1000)		/*!< Above this RTC drift between calibrations, the period halves. */
+#define CHDRV_RECAL_MIN_PULSE_MS	(10)		/*!< Idle windows shorter than this are not used for calibration. */
+#define CHDRV_RECAL_MEAS_MARGIN_MS	(5)			/*!< Time allowed after the echo time of the maximum range 
+														for the sensors to finish a measurement, in milliseconds. */
+#define CHDRV_RECAL_GUARD_MS		(5)			/*!< Time kept free between the end of a calibration pulse 
+														and the next trigger, in milliseconds. */
+
+#define CHDRV_SOS_TEMP_STEP_CC		(50)		/*!< Default temperature change that rebuilds the range conversion 
+														constants, in 0.01 deg C (0.5 deg C, about 0.1 % of the speed). */
+#define CHDRV_SOS_HUMIDITY_STEP		(20)		/*!< Relative humidity change that rebuilds the range conversion 
+														constants, in % (20 % is about 0.07 % of the speed). */
+#define CHDRV_SOS_HUMIDITY_DEFAULT	(50)		/*!< Relative humidity assumed when it is not measured, in %. */
+#define CHDRV_SOS_TEMP_MIN_CC		(-4000)		/*!< Temperatures are limited to this range, in 0.01 deg C */
+#define CHDRV_SOS_TEMP_MAX_CC		(8500)
+
+#define CHDRV_IQ_POS_FRAC_BITS		(8)			/*!< Fractional bits of an I/Q sample position (1/256 sample). */
+#define CHDRV_IQ_PEAK_WINDOW		(4)			/*!< Samples searched for the echo peak on each side of the sample 
+														given by the reported range, see \a chdrv_precise_range(). */
+
+#define CHDRV_FREQLOCK_POLL_MS		1			/*!< Interval between frequency lock polls of the group, 
+														in milliseconds.  */
+#define CHDRV_FREQLOCK_MARGIN_MS	2			/*!< Polling starts this long before the lock time learned 
+														at the previous start, in milliseconds.  */
 #define CHDRV_BANDWIDTH_INDEX_1		6 			/*!< Index of first sample to use for calculating bandwidth. */
 #define CHDRV_BANDWIDTH_INDEX_2    	(CHDRV_BANDWIDTH_INDEX_1 + 1)	/*!< Index of second sample to 
 																	  use for calculating bandwidth. */
 
 #define CHDRV_SCALEFACTOR_INDEX     4 		/*!< Index for calculating scalefactor. */
 
+#define CHDRV_BATCH_REG_SPACE		64			/*!< Size of application register space covered by a write batch, 
+												  	 in bytes (registers above this use direct writes). */
+
+#define CHDRV_REG_CACHE_SIZE		CHDRV_BATCH_REG_SPACE	/*!< Size of register space covered by the 
+															 	 configuration register cache, in bytes. */
+#define CHDRV_REG_MASK(reg, num_bytes)	((((uint64_t) 1 << (num_bytes)) - 1) << (reg))
+												/*!< Macro to build a register cache mask for \a num_bytes 
+												  	 bytes starting at register \a reg. */
+
 /* Incomplete definitions of structs in ch_api.h, to resolve include order */
 typedef struct ch_dev_t   ch_dev_t;
 typedef struct ch_group_t ch_group_t;
+typedef struct ch_result_t ch_result_t;
+typedef struct ch_iq_sample_t ch_iq_sample_t;
+typedef struct ch_thresholds_t ch_thresholds_t;
+typedef struct ch_target_t ch_target_t;
 
 
 //! Hook routine pointer typedefs
@@ -106,6 +167,14 @@ typedef struct chdrv_i2c_transaction {
 } chdrv_i2c_transaction_t;
 
 
+//!  Register write batch, collects writes to one sensor and sends contiguous ranges as bursts
+typedef struct chdrv_batch {
+	ch_dev_t *dev_ptr;					/*!< Pointer to ch_dev_t descriptor structure for the sensor */
+	uint64_t dirty;						/*!< Bit mask of register bytes written since last flush */
+	uint8_t	 data[CHDRV_BATCH_REG_SPACE];	/*!< Register image, indexed by register address */
+} chdrv_batch_t;
+
+
 //!  I2C queue structure, for non-blocking access
 typedef struct chdrv_i2c_queue {
 	uint8_t read_pending;				/*!< Read transaction status: non-zero if read operation is pending */
@@ -115,6 +184,62 @@ typedef struct chdrv_i2c_queue {
 	chdrv_i2c_transaction_t transaction[CHDRV_MAX_I2C_QUEUE_LENGTH];	/*!< List of transactions in queue */
 } chdrv_i2c_queue_t;
 
+//! Recalibration scheduler state (see \a chdrv_group_set_recal_period()).
+typedef struct {
+	uint32_t period_ms;					/*!< Time between calibrations, adapted to the drift (0 = disabled) */
+	uint32_t last_cal_ms;				/*!< Timestamp of the last completed calibration */
+	uint32_t trigger_ms;				/*!< Timestamp of the last hardware trigger (0 = none yet) */
+	uint32_t trigger_interval_ms;		/*!< Time between the last two hardware triggers */
+	uint16_t pulse_ms;					/*!< Length of the pulse scheduled or running */
+	uint16_t acc_ms;					/*!< Pulse time accumulated for the calibration in progress */
+	uint32_t acc_counts[CHIRP_MAX_NUM_SENSORS];	/*!< Sensor RTC counts accumulated, per port */
+} chdrv_recal_t;
+
+//! Speed of sound model of a group (see \a chdrv_group_set_environment()).
+typedef struct {
+	uint32_t speed_mmps;				/*!< Speed of sound the conversion constants are built for, in mm/s 
+											 (0 = \a CH_SPEEDOFSOUND_MPS) */
+	int16_t	 temp_cc;					/*!< Temperature \a speed_mmps was computed for, in 0.01 deg C */
+	uint8_t	 humidity_pct;				/*!< Relative humidity \a speed_mmps was computed for, in % */
+	uint16_t temp_step_cc;				/*!< Temperature change that rebuilds the constants (0 = 
+											 \a CHDRV_SOS_TEMP_STEP_CC) */
+} chdrv_sos_t;
+
+//! Range conversion constants of a sensor, see \a chdrv_range_prepare().
+typedef struct {
+	uint32_t tof_mult;					/*!< TOF count to round-trip range (mm * 32) multiplier, 0 if not calibrated */
+	uint32_t sample_mult;				/*!< Sample count to mm multiplier, 0 if not calibrated */
+	uint32_t iq_mult;					/*!< One-way range (mm * 32) to I/Q sample position (1/256 sample) multiplier, 
+											 0 if not calibrated */
+	uint8_t	 tof_shift;					/*!< Right shift after \a tof_mult, oversampling included */
+	uint8_t	 sample_shift;				/*!< Right shift after \a sample_mult, oversampling included */
+	uint8_t	 iq_shift;					/*!< Right shift after \a iq_mult, oversampling included */
+} chdrv_range_conv_t;
+
+//! Start-up state of one sensor, see \a chdrv_retained_t.
+typedef struct {
+	uint8_t		connected;
+	uint8_t		i2c_address;
+	uint16_t	part_number;
+	uint32_t	fw_checksum;			/*!< Checksum of the firmware image as stored in the host */
+	uint32_t	op_frequency;
+	uint16_t	rtc_cal_result;
+	uint16_t	bandwidth;
+	uint16_t	scale_factor;
+} chdrv_retained_dev_t;
+
+//! State kept in memory retained through a host reset, for \a chdrv_group_warm_start() (see \a chbsp_retained_mem()).
+typedef struct {
+	uint32_t	magic;
+	uint16_t	rtc_cal_pulse_ms;
+	uint8_t		num_ports;
+	chdrv_retained_dev_t dev[CHIRP_MAX_NUM_SENSORS];
+	uint32_t	checksum;				/*!< Checksum of the fields above, must be last */
+} chdrv_retained_t;
+
+//! Multiply a 16-bit sensor value by a conversion multiplier and scale down (see \a chdrv_range_conv_t).
+#define CHDRV_RANGE_MUL(value, mult, shift)	((uint32_t) (((uint64_t) (value) * (mult)) >> (shift)))
+
 
 /*!
  * \brief  Calibrate the sensor real-time clock against the host microcontroller clock.
@@ -133,6 +258,119 @@ typedef struct chdrv_i2c_queue {
  */
 void chdrv_group_measure_rtc(ch_group_t *grp_ptr);
 
+/*!
+ * \brief Start a real-time clock calibration pulse in the background.
+ *
+ * \param grp_ptr 		pointer to the ch_group_t config structure for a group of sensors
+ *
+ * \return 0 if the pulse started, non-zero if a calibration is already running or the BSP has no 
+ * calibration timer (see \a chbsp_rtc_cal_timer_start())
+ *
+ * This function starts the same pulse as \a chdrv_group_measure_rtc() but returns at once.  The BSP 
+ * ends the pulse with \a chdrv_group_measure_rtc_end() and then reads the results with 
+ * \a chdrv_group_measure_rtc_finish().  The new calibration values replace the old ones in one 
+ * step for each sensor, and are passed to \a chbsp_cal_store().
+ *
+ * Hardware triggers are refused while the pulse is on the INT lines, and API calls accessing the 
+ * sensors wait for the calibration to finish (see \a chdrv_group_cal_hold()).
+ */
+int chdrv_group_measure_rtc_start(ch_group_t *grp_ptr);
+
+/*!
+ * \brief End a background real-time clock calibration pulse.
+ *
+ * \param grp_ptr 		pointer to the ch_group_t config structure for a group of sensors
+ *
+ * This function is called by the BSP from its calibration timer interrupt, \a pulse_ms milliseconds 
+ * after \a chbsp_rtc_cal_timer_start().  It only drives the INT lines.
+ */
+void chdrv_group_measure_rtc_end(ch_group_t *grp_ptr);
+
+/*!
+ * \brief Read the results of a background real-time clock calibration.
+ *
+ * \param grp_ptr 		pointer to the ch_group_t config structure for a group of sensors
+ *
+ * This function is called by the BSP from a thread, at least 1 ms after \a chdrv_group_measure_rtc_end().
+ */
+void chdrv_group_measure_rtc_finish(ch_group_t *grp_ptr);
+
+/*!
+ * \brief Set the period of the background recalibration.
+ *
+ * \param grp_ptr 		pointer to the ch_group_t config structure for a group of sensors
+ * \param period_ms	initial time between calibrations, in milliseconds (0 to disable)
+ *
+ * While the group is triggered with \a chdrv_group_hw_trigger(), the RTC calibration is repeated 
+ * without stopping the measurements: once the period has elapsed, each trigger schedules a pulse 
+ * in the idle time after the measurement and before the next trigger, the interval between 
+ * triggers being learned from the triggers themselves.  When the idle time is shorter than the 
+ * calibration pulse, the pulse is split over several windows and the sensor counts are added up.
+ *
+ * After each calibration, the change of \a rtc_cal_result of every sensor is stored in its 
+ * \a rtc_cal_drift_ppm field.  The period doubles when the largest change is below 
+ * \a CHDRV_RECAL_DRIFT_LOW_PPM and halves when it is above \a CHDRV_RECAL_DRIFT_HIGH_PPM, within 
+ * \a CHDRV_RECAL_PERIOD_MIN_MS and \a CHDRV_RECAL_PERIOD_MAX_MS.
+ *
+ * The BSP must implement \a chbsp_rtc_cal_work_schedule(), \a chbsp_rtc_cal_timer_start() and 
+ * \a chbsp_timestamp_ms().
+ */
+void chdrv_group_set_recal_period(ch_group_t *grp_ptr, uint32_t period_ms);
+
+/*!
+ * \brief Start a scheduled recalibration pulse.
+ *
+ * \param grp_ptr 		pointer to the ch_group_t config structure for a group of sensors
+ *
+ * This function is called by the BSP from the calibration thread, \a delay_ms milliseconds after 
+ * \a chbsp_rtc_cal_work_schedule().  It arms the sensors and starts the pulse, unless the window 
+ * before the next trigger has become too short.
+ */
+void chdrv_group_recal_run(ch_group_t *grp_ptr);
+
+/*!
+ * \brief Keep background calibration pulses away from a sensor access.
+ *
+ * \param grp_ptr 		pointer to the ch_group_t config structure for a group of sensors
+ *
+ * This function waits until a background calibration pulse and the readout of its results are over, 
+ * then keeps new pulses from starting until \a chdrv_group_cal_release().  A recalibration pulse due 
+ * in the meantime is skipped, the next trigger schedules it again.  Calls may be nested.
+ *
+ * The API functions writing to the sensors, or asserting PROG, call it so they neither disturb a 
+ * calibration nor have their writes overlap with one.  Only called from thread context.
+ */
+void chdrv_group_cal_hold(ch_group_t *grp_ptr);
+
+/*!
+ * \brief End a sensor access started with \a chdrv_group_cal_hold().
+ *
+ * \param grp_ptr 		pointer to the ch_group_t config structure for a group of sensors
+ */
+void chdrv_group_cal_release(ch_group_t *grp_ptr);
+
+/*!
+ * \brief Get the calibration values of a sensor.
+ *
+ * \param dev_ptr 		pointer to the ch_dev_t descriptor structure for a sensor
+ * \param cal_ptr		pointer to the structure to receive the values
+ *
+ * The values are copied together in the critical section used by a background calibration to 
+ * replace them, so they are never a mix of old and new values.
+ */
+void chdrv_cal_get(ch_dev_t *dev_ptr, ch_cal_result_t *cal_ptr);
+
+/*!
+ * \brief Replace the calibration values of a sensor.
+ *
+ * \param dev_ptr 		pointer to the ch_dev_t descriptor structure for a sensor
+ * \param cal_ptr		pointer to the new values
+ *
+ * The values change together for any thread or interrupt handler using them, then the range 
+ * conversion constants are recomputed with \a chdrv_range_prepare().
+ */
+void chdrv_cal_apply(ch_dev_t *dev_ptr, const ch_cal_result_t *cal_ptr);
+
 /*!
  * \brief Convert the sensor register values to a range using the calibration data in the ch_dev_t struct.
  *
@@ -148,6 +386,123 @@ void chdrv_group_measure_rtc(ch_group_t *grp_ptr);
  */
 uint32_t chdrv_one_way_range(ch_dev_t *dev_ptr, uint16_t tof, uint16_t tof_sf);
 
+/*!
+ * \brief Precompute the range conversion constants of a sensor.
+ *
+ * \param dev_ptr 		pointer to the ch_dev_t descriptor structure for a sensor
+ *
+ * Turns the calibration values (\a rtc_cal_result, \a scale_factor, \a op_frequency), the RTC 
+ * calibration pulse length, the part and the oversampling into a multiplier and a shift for each 
+ * conversion, so that converting a TOF or a sample count is a multiply and a shift instead of a 
+ * divide.  Called whenever the calibration values change.
+ */
+void chdrv_range_prepare(ch_dev_t *dev_ptr);
+
+/*!
+ * \brief Get the speed of sound used by the range conversions of a group.
+ *
+ * \param grp_ptr 		pointer to the ch_group_t descriptor structure for a group of sensors
+ *
+ * \return speed of sound, in mm/s
+ */
+uint32_t chdrv_group_speed_of_sound(ch_group_t *grp_ptr);
+
+/*!
+ * \brief Update the air temperature and humidity seen by a group of sensors.
+ *
+ * \param grp_ptr 		pointer to the ch_group_t descriptor structure for a group of sensors
+ * \param temp_cc		air temperature, in 0.01 deg C
+ * \param humidity_pct	relative humidity, in %, or \a CH_HUMIDITY_UNKNOWN
+ *
+ * \return 1 if the speed of sound changed, 0 if the change is below the rebuild step
+ *
+ * The speed of sound is modelled as c = 331.3 * sqrt(1 + T / 273.15) + 0.0124 * RH (m/s), the 
+ * humidity term being a linear fit around room temperature.  When the temperature moved by at least the group step (see 
+ * \a chdrv_sos_t) or the humidity by at least \a CHDRV_SOS_HUMIDITY_STEP since the last rebuild, the 
+ * speed is recomputed and \a chdrv_range_prepare() is run for every connected sensor, so the 
+ * per-measurement conversions stay a multiply and a shift.  Smaller changes are ignored and cost 
+ * nothing.  The check and the rebuild run inside \a chbsp_critical_enter(), so this may be called 
+ * from more than one thread.
+ */
+uint8_t chdrv_group_set_environment(ch_group_t *grp_ptr, int16_t temp_cc, uint8_t humidity_pct);
+
+/*!
+ * \brief Get the range conversion constants of a sensor.
+ *
+ * \param dev_ptr 		pointer to the ch_dev_t descriptor structure for a sensor
+ * \param conv_ptr		pointer to the structure to receive the constants
+ *
+ * The constants are copied together, so they are consistent even if a calibration completes at the 
+ * same time.
+ */
+void chdrv_range_conv_get(ch_dev_t *dev_ptr, chdrv_range_conv_t *conv_ptr);
+
+/*!
+ * \brief Convert TOF register values to ranges.
+ *
+ * \param dev_ptr 		pointer to the ch_dev_t descriptor structure for a sensor
+ * \param tof_ptr		pointer to the TOF values
+ * \param range_ptr		pointer to the array receiving the ranges (mm * 32), \a CH_NO_TARGET for a TOF of UINT16_MAX
+ * \param count			number of values
+ * \param one_way		1 for one-way ranges, 0 for round-trip ranges
+ *
+ * \return 0 if successful, non-zero if the sensor is not calibrated
+ */
+int chdrv_tof_to_range_bulk(ch_dev_t *dev_ptr, const uint16_t *tof_ptr, uint32_t *range_ptr, uint16_t count, 
+							uint8_t one_way);
+
+/*!
+ * \brief Convert sample counts to distances.
+ *
+ * \param dev_ptr 		pointer to the ch_dev_t descriptor structure for a sensor
+ * \param samples_ptr	pointer to the sample counts
+ * \param mm_ptr		pointer to the array receiving the distances, in mm
+ * \param count			number of values
+ *
+ * \return 0 if successful, non-zero if the sensor is not calibrated
+ */
+int chdrv_samples_to_mm_bulk(ch_dev_t *dev_ptr, const uint16_t *samples_ptr, uint16_t *mm_ptr, uint16_t count);
+
+/*!
+ * \brief Refine a one-way range with the I/Q data of the same measurement.
+ *
+ * \param dev_ptr 		pointer to the ch_dev_t descriptor structure for a sensor
+ * \param iq_ptr		pointer to the I/Q frame, starting at sample 0
+ * \param num_samples	number of samples in the frame
+ * \param range			one-way range reported by the sensor, in mm * 32
+ *
+ * \return refined one-way range in mm * 32, or \a range unchanged if the sensor is not calibrated, 
+ * \a range is \a CH_NO_TARGET or no peak with two neighbours in the frame is found
+ *
+ * The magnitude peak is searched within \a CHDRV_IQ_PEAK_WINDOW samples of the sample given by \a range 
+ * (squared magnitudes, no root), then placed between samples by a parabola through the magnitudes of 
+ * the peak and its two neighbours.  Integer only: three square roots and one divide per frame, plus a 
+ * multiply and add per searched sample.
+ */
+uint32_t chdrv_precise_range(ch_dev_t *dev_ptr, const ch_iq_sample_t *iq_ptr, uint16_t num_samples, uint32_t range);
+
+/*!
+ * \brief Extract the targets above the detection thresholds from an I/Q frame.
+ *
+ * \param dev_ptr 		pointer to the ch_dev_t descriptor structure for a sensor
+ * \param iq_ptr		pointer to the I/Q frame, starting at sample 0
+ * \param num_samples	number of samples in the frame, at most \a max_samples of the sensor (larger values 
+ * 						are reduced to it)
+ * \param thresh_ptr	threshold segments, or NULL for \a CH_TARGET_LEVEL_DEFAULT from the static range on; 
+ * 						the segments used end before the first one not starting after the previous one
+ * \param targets_ptr	pointer to the array receiving the targets
+ * \param max_targets	number of entries in \a targets_ptr
+ * \param one_way		1 for one-way ranges, 0 for round-trip ranges
+ *
+ * \return number of targets found
+ *
+ * Single pass over the frame: one squared magnitude and compare per sample against the squared level 
+ * of the current segment, a square root and an interpolation per target.
+ */
+uint8_t chdrv_find_targets(ch_dev_t *dev_ptr, const ch_iq_sample_t *iq_ptr, uint16_t num_samples, 
+						   const ch_thresholds_t *thresh_ptr, ch_target_t *targets_ptr, uint8_t max_targets, 
+						   uint8_t one_way);
+
 /*!
  * \brief Convert the sensor register values to a round-trip range using the calibration data in the ch_dev_t struct.
  *
@@ -200,6 +555,31 @@ int chdrv_group_i2c_queue(ch_group_t *grp_ptr, ch_dev_t *instance, uint8_t rd_wr
 int chdrv_external_i2c_queue(ch_group_t *grp_ptr, ch_dev_t *instance, uint8_t rd_wrb, uint16_t addr, 
 						     uint16_t nbytes, uint8_t *data);
 
+/*!
+ * \brief Reserve the non-blocking queues of a group for a result readout.
+ *
+ * \param grp_ptr 		pointer to the ch_group_t descriptor structure for a group of sensors
+ * \param results_ptr	array receiving the results, one entry per port
+ * \param one_way		1 for one-way ranges (direct ranges for receive-only sensors), 0 for round-trip ranges
+ *
+ * \return 0 if successful, non-zero if a readout or other non-blocking I/O is already queued
+ *
+ * The result reads are then queued with type \a CHDRV_NB_TRANS_TYPE_RESULT, each one adding its 
+ * port to \a grp_ptr->results_queued, and started with \a chdrv_group_i2c_start_nb().  When the 
+ * queues are empty, \a chdrv_group_i2c_irq_handler() converts the TOF values read into 
+ * \a dev_ptr->result_regs with the calibration constants of each sensor, fills \a results_ptr and 
+ * calls the group result callback.  The I/O complete callback is only called if other 
+ * transactions were queued too.
+ */
+int chdrv_group_results_claim(ch_group_t *grp_ptr, ch_result_t *results_ptr, uint8_t one_way);
+
+/*!
+ * \brief Give up a result readout reserved by \a chdrv_group_results_claim() before it was started.
+ *
+ * \param grp_ptr 		pointer to the ch_group_t descriptor structure for a group of sensors
+ */
+void chdrv_group_results_release(ch_group_t *grp_ptr);
+
 /*!
  * \brief Start a non-blocking sensor readout
  *
@@ -236,14 +616,17 @@ int chdrv_wait_for_lock(ch_dev_t *dev_ptr, uint16_t timeout_ms );
 /*!
  * \brief Wait for all sensors to finish start-up procedure.
  *
- * \param grp_ptr 	pointer to the ch_group_t descriptor structure for a group of sensors
+ * \param grp_ptr 		pointer to the ch_group_t config structure for a group of sensors
  *
  * \return 0 if startup sequence finished on all detected sensors, non-zero if startup sequence 
  * timed out on any sensor(s).
  *
  * After each sensor is programmed, it executes an internal start-up and self-test sequence. This 
- * function waits for all sensor devices to finish this sequence.  For each device, the maximum 
- * time to wait is \a CHDRV_FREQLOCK_TIMEOUT_MS milliseconds.
+ * function waits for all sensor devices to finish this sequence, polling every sensor not yet locked 
+ * once every \a CHDRV_FREQLOCK_POLL_MS milliseconds, and returns as soon as the last one locks.  The 
+ * lock time of each sensor, measured with \a chbsp_timestamp_ms() from the start of the wait, is 
+ * stored in its \a freqlock_time_ms field.  The maximum time to wait is \a CHDRV_FREQLOCK_TIMEOUT_MS 
+ * milliseconds of real time, whatever the number of sensors polled.
  */
 int chdrv_group_wait_for_lock(ch_group_t *grp_ptr);
 
@@ -376,6 +759,19 @@ int chdrv_group_prepare(ch_group_t* grp_ptr);
  */
 int chdrv_group_start(ch_group_t *grp_ptr);
 
+/*!
+ * \brief Resume a group of sensors that kept running through a host reset.
+ *
+ * \param grp_ptr 		pointer to the ch_group_t config structure for a group of sensors
+ *
+ * \return 0 if successful, non-zero otherwise
+ *
+ * If every sensor found by the last \a chdrv_group_start() is still running the same firmware, 
+ * the calibration saved by that function is restored and the sensors are not restarted.  
+ * Otherwise, this does a full \a chdrv_group_start().
+ */
+int chdrv_group_warm_start(ch_group_t *grp_ptr);
+
 /*!
  * \brief Write byte to a sensor application register.
  *
@@ -446,6 +842,65 @@ int chdrv_burst_read(ch_dev_t *dev_ptr, uint16_t mem_addr, uint8_t *data, uint16
  */
 int chdrv_burst_write(ch_dev_t *dev_ptr, uint16_t mem_addr, uint8_t *data, uint8_t len);
 
+/*!
+ * \brief Start a register write batch for a sensor.
+ *
+ * \param batch_ptr 	pointer to the chdrv_batch_t structure to initialize
+ * \param dev_ptr 		pointer to the ch_dev_t descriptor structure for a sensor
+ *
+ * Register writes added to the batch with \a chdrv_batch_write_byte() and \a chdrv_batch_write_word()
+ * are held until \a chdrv_batch_flush() is called.
+ */
+void chdrv_batch_init(chdrv_batch_t *batch_ptr, ch_dev_t *dev_ptr);
+
+/*!
+ * \brief Add a byte write to a register write batch.
+ *
+ * \param batch_ptr 	pointer to the chdrv_batch_t structure
+ * \param reg_addr 		sensor register address
+ * \param data 			data value to write
+ *
+ * \return 0 if successful, non-zero if the register is outside the batch register space
+ *
+ * A later write to the same register replaces the earlier value.
+ */
+int chdrv_batch_write_byte(chdrv_batch_t *batch_ptr, uint16_t reg_addr, uint8_t data);
+
+/*!
+ * \brief Add a 16-bit write to a register write batch.
+ *
+ * \param batch_ptr 	pointer to the chdrv_batch_t structure
+ * \param reg_addr 		sensor register address
+ * \param data 			data value to write
+ *
+ * \return 0 if successful, non-zero if the register is outside the batch register space
+ */
+int chdrv_batch_write_word(chdrv_batch_t *batch_ptr, uint16_t reg_addr, uint16_t data);
+
+/*!
+ * \brief Write all batched registers to the sensor.
+ *
+ * \param batch_ptr 	pointer to the chdrv_batch_t structure
+ *
+ * \return 0 if successful, non-zero otherwise
+ *
+ * Each run of contiguous batched registers is sent as one \a chdrv_burst_write() transaction, in 
+ * ascending register order.  The batch is empty afterwards and can be reused.
+ */
+int chdrv_batch_flush(chdrv_batch_t *batch_ptr);
+
+/*!
+ * \brief Discard the cached copy of a sensor's configuration registers.
+ *
+ * \param dev_ptr 	pointer to the ch_dev_t descriptor structure for a sensor
+ *
+ * When \a CHDRV_REG_CACHE is defined, writes to the configuration registers listed in the
+ * device's \a reg_cache_mask are mirrored in \a reg_cache.  Reads of those registers are then
+ * served from memory and writes of an unchanged value are skipped.  This function must be
+ * called whenever the sensor registers return to their firmware defaults (reset, firmware load).
+ */
+void chdrv_reg_cache_invalidate(ch_dev_t *dev_ptr);
+
 /*!
  * \brief Perform a soft reset on a sensor.
  *
@@ -566,6 +1021,42 @@ int chdrv_prog_i2c_read_nb(ch_dev_t *dev_ptr, uint8_t *message, uint16_t len);
  */
 int chdrv_prog_mem_write(ch_dev_t *dev_ptr, uint16_t addr, uint8_t *message, uint16_t nbytes);
 
+/*!
+ * \brief Read from sensor memory.
+ * 
+ * \param dev_ptr	pointer to the ch_dev_t config structure for a sensor
+ * \param addr		sensor memory start address
+ * \param message	pointer to a buffer where read bytes will be placed
+ * \param nbytes	number of bytes to read
+ *
+ * \return 0 if read from sensor succeeded, non-zero otherwise
+ *
+ * This function reads sensor memory using burst reads of up to \a CH_PROG_XFER_SIZE bytes on the 
+ * low-level programming interface.  The PROG line for the device must have been asserted before 
+ * this function is called, and must not be asserted for any other device on the same bus.
+ */
+int chdrv_prog_mem_read(ch_dev_t *dev_ptr, uint16_t addr, uint8_t *message, uint16_t nbytes);
+
+//! Consumer of decoded firmware, see \a chdrv_fw_unpack().
+typedef int (*chdrv_fw_sink_t)(void *context, uint16_t offset, const uint8_t *data, uint16_t nbytes);
+
+/*!
+ * \brief Decode a compressed firmware image.
+ *
+ * \param dev_ptr 		pointer to the ch_dev_t config structure for a sensor
+ * \param sink			function receiving the decoded image
+ * \param context		value passed to \a sink
+ *
+ * \return 0 if successful, non-zero if the image is corrupt or \a sink returned non-zero
+ *
+ * This function decodes \a dev_ptr->firmware, \a dev_ptr->fw_lz_size bytes compressed by 
+ * scripts/ch_fw_lz.py, into a window of \a CHDRV_FW_LZ_WINDOW bytes on the stack.  Each time the 
+ * window is full, and at the end of the image, \a sink is called with the offset of the chunk in 
+ * the image, its data and its size.  The chunks follow each other in order and, except the 
+ * last one, are \a CHDRV_FW_LZ_WINDOW bytes long.
+ */
+int chdrv_fw_unpack(ch_dev_t *dev_ptr, chdrv_fw_sink_t sink, void *context);
+
 
 /*!
  * \brief Register a hook routine to be called after device discovery.
@@ -16,8 +16,14 @@
 #ifndef CHIRP_BOARD_CONFIG_H_
 #define CHIRP_BOARD_CONFIG_H_
 
-/* Settings for the Chirp SmartSonic board */
-#define CHIRP_MAX_NUM_SENSORS  1   // maximum possible number of sensor devices
-#define CHIRP_NUM_I2C_BUSES    1   // number of I2C buses used by sensors
+#include <zephyr/devicetree.h>
+
+/* Settings generated from the "chirp,sensor-board" devicetree node (dts/bindings) */
+#define CHIRP_BOARD_NODE       DT_NODELABEL(chirp_board)
+
+#define CHIRP_BOARD_COUNT_ONE(node_id)  + 1
+
+#define CHIRP_MAX_NUM_SENSORS  (0 DT_FOREACH_CHILD(CHIRP_BOARD_NODE, CHIRP_BOARD_COUNT_ONE))   // one per child node
+#define CHIRP_NUM_I2C_BUSES    DT_PROP_LEN(CHIRP_BOARD_NODE, i2c_buses)                          // number of I2C buses used by sensors
 
 #endif /* CHIRP_BOARD_CONFIG_H_ */
@@ -398,6 +398,33 @@ void chbsp_delay_ms(uint32_t ms);
  */
 uint32_t chbsp_timestamp_ms(void);
 
+/*!
+ * \brief Return a free-running cycle counter value.
+ *
+ * \return a 32-bit free-running counter value, in counter cycles
+ *
+ * This function should return a high resolution hardware counter (e.g. the CPU cycle counter).  The 
+ * counter may wrap: the driver only uses the difference between two values, over intervals much 
+ * shorter than the wrap period.  See \a chbsp_cycles_to_us().
+ *
+ * If \a CHDRV_BOOT_PROFILE is defined, this function is used by the SonicLib driver to time the 
+ * phases of \a ch_group_start() (see \a ch_get_boot_profile()).
+ *
+ * This function is OPTIONAL.  The default implementation counts milliseconds (\a chbsp_timestamp_ms()).
+ */
+uint32_t chbsp_cycle_count(void);
+
+/*!
+ * \brief Convert a number of cycles of \a chbsp_cycle_count() to microseconds.
+ *
+ * \param cycles	number of counter cycles
+ *
+ * \return the duration in microseconds
+ *
+ * This function is OPTIONAL.  It must be implemented together with \a chbsp_cycle_count().
+ */
+uint32_t chbsp_cycles_to_us(uint32_t cycles);
+
 /*!
  * \brief Initialize the host's I2C hardware.
  *
@@ -470,6 +497,27 @@ uint8_t chbsp_i2c_get_info(ch_group_t *grp_ptr, uint8_t dev_num, ch_i2c_info_t *
  */
 int chbsp_i2c_write(ch_dev_t *dev_ptr, uint8_t *data, uint16_t num_bytes);
 
+/*!
+ * \brief Write bytes to an I2C slave to check whether it is present.
+ * 
+ * \param dev_ptr 		pointer to the ch_dev_t config structure for a sensor
+ * \param data 			data to be transmitted
+ * \param num_bytes 	length of data to be transmitted
+ *
+ * \return 0 if successful, 1 on error or NACK
+ *
+ * This function should write the bytes like \a chbsp_i2c_write(), in a single attempt.  It is 
+ * used by sensor discovery, where a NACK from a port with no sensor fitted is the expected 
+ * result: it must be returned at once, without the bus recovery and retries the BSP may apply 
+ * to other transfers.
+ *
+ * This function is OPTIONAL.  The default implementation calls \a chbsp_i2c_write().
+ *
+ * \note Implementations of this function should use the \a ch_get_i2c_address() function to obtain
+ * the device I2C address.
+ */
+int chbsp_i2c_probe(ch_dev_t *dev_ptr, uint8_t *data, uint16_t num_bytes);
+
 /*!
  * \brief Write bytes to an I2C slave using memory addressing.
  * 
@@ -492,6 +540,29 @@ int chbsp_i2c_write(ch_dev_t *dev_ptr, uint8_t *data, uint16_t num_bytes);
  */
 int chbsp_i2c_mem_write(ch_dev_t *dev_ptr, uint16_t mem_addr, uint8_t *data, uint16_t num_bytes);
 
+/*!
+ * \brief Write a header and a data payload to an I2C slave in a single transaction.
+ * 
+ * \param dev_ptr 		pointer to the ch_dev_t config structure for a sensor
+ * \param hdr 			header bytes to be transmitted first (e.g. register address and count)
+ * \param hdr_bytes 	length of header
+ * \param data 			data to be transmitted after the header
+ * \param num_bytes 	length of data
+ *
+ * \return 0 if successful, 1 on error or NACK
+ *
+ * This function should write the header followed by the data as one I2C write transaction,
+ * without a repeated start between them.  The two buffers are separate so that no copy of
+ * the data is needed to place it behind the header (e.g. using two I2C message segments).
+ * The I2C interface will have already been initialized using \a chbsp_i2c_init().
+ *
+ * This function is OPTIONAL.  It is required if \a chdrv_burst_write() is used.
+ *
+ * \note Implementations of this function should use the \a ch_get_i2c_address() function to obtain
+ * the device I2C address.
+ */
+int chbsp_i2c_write_hdr(ch_dev_t *dev_ptr, uint8_t *hdr, uint16_t hdr_bytes, uint8_t *data, uint16_t num_bytes);
+
 
 /*!
  * \brief Write bytes to an I2C slave, non-blocking.
@@ -663,6 +734,145 @@ void chbsp_external_i2c_irq_handler(chdrv_i2c_transaction_t *trans);
 //!
 void chbsp_i2c_reset(ch_dev_t *dev_ptr);
 
+/*!
+ * \brief Run a task once for each I2C bus of a group.
+ *
+ * \param grp_ptr 		pointer to the ch_group_t config structure for a group of sensors
+ * \param task		routine to run, called with each bus index from 0 to \a num_i2c_buses - 1
+ * \param arg		argument passed unchanged to every call of \a task
+ *
+ * This function calls \a task for every I2C bus of the group and returns when all calls have 
+ * completed.  The BSP may run the calls concurrently (e.g. one thread per bus), so a task must 
+ * only access the sensors on its own bus.  SonicLib uses this to program the sensors on different 
+ * buses in parallel in \a chdrv_group_detect_and_program().
+ *
+ * \note OPTIONAL - The default implementation in chbsp_dummy.c runs the tasks one after the 
+ * other in the calling thread.
+ */
+void chbsp_i2c_bus_run(ch_group_t *grp_ptr, ch_bus_task_t task, void *arg);
+
+/*!
+ * \brief Get memory retained through a reset of the host.
+ *
+ * \param size		number of bytes needed
+ *
+ * \return pointer to at least \a size bytes, or NULL if not available
+ *
+ * This function returns memory that keeps its contents through a reset of the host MCU alone 
+ * (watchdog, firmware update, etc.), such as a no-init RAM section.  The contents are undefined 
+ * after a power cycle.  SonicLib saves the sensor start-up state there in \a chdrv_group_start() 
+ * for \a ch_group_warm_start().
+ *
+ * \note OPTIONAL - The default implementation in chbsp_dummy.c returns NULL, so 
+ * \a ch_group_warm_start() always does a full start.
+ */
+void *chbsp_retained_mem(uint16_t size);
+
+/*!
+ * \brief Get the part number of the sensor fitted on a port.
+ *
+ * \param dev_ptr 		pointer to the ch_dev_t config structure for a sensor
+ *
+ * \return CH101_PART_NUMBER or CH201_PART_NUMBER, 0 if not known
+ *
+ * CH101 and CH201 sensors use the same ASIC, so they cannot be told apart on the programming 
+ * interface.  For sensors initialized with \a ch_init_auto(), \a ch_group_start() binds the 
+ * firmware registered for the part returned by this function.
+ *
+ * \note OPTIONAL - The default implementation in chbsp_dummy.c returns 0, so the first registered 
+ * firmware image is used for every sensor.
+ */
+uint16_t chbsp_part_number(ch_dev_t *dev_ptr);
+
+/*!
+ * \brief Start the timer ending a background RTC calibration pulse.
+ *
+ * \param grp_ptr 		pointer to the ch_group_t config structure for a group of sensors
+ * \param pulse_ms		pulse length, in milliseconds
+ *
+ * \return 0 if successful, 1 if not supported
+ *
+ * This function starts a one-shot timer.  When it expires, \a pulse_ms milliseconds later, the BSP 
+ * must call \a chdrv_group_measure_rtc_end() from the timer interrupt, and then 
+ * \a chdrv_group_measure_rtc_finish() from a thread (not the one running the application) at least 
+ * 1 ms later.  The pulse length sets the calibration accuracy, so the timer should be precise.
+ *
+ * \note OPTIONAL - The default implementation in chbsp_dummy.c returns 1, so SonicLib only 
+ * calibrates during \a ch_group_start(), blocking for the pulse.
+ */
+uint8_t chbsp_rtc_cal_timer_start(ch_group_t *grp_ptr, uint16_t pulse_ms);
+
+/*!
+ * \brief Schedule the start of a recalibration pulse.
+ *
+ * \param grp_ptr 		pointer to the ch_group_t config structure for a group of sensors
+ * \param delay_ms		delay before the pulse, in milliseconds
+ *
+ * \return 0 if successful, 1 if not supported
+ *
+ * This function is called from \a chdrv_group_hw_trigger(), possibly in interrupt context, when 
+ * a periodic recalibration is due (see \a ch_group_set_recal_period()).  The BSP must call 
+ * \a chdrv_group_recal_run() from a thread \a delay_ms milliseconds later.  The pulse itself is 
+ * timed by \a chbsp_rtc_cal_timer_start(), which must be implemented too, as well as 
+ * \a chbsp_timestamp_ms().
+ *
+ * \note OPTIONAL - The default implementation in chbsp_dummy.c returns 1, so the sensors are only 
+ * calibrated by \a ch_group_start().
+ */
+uint8_t chbsp_rtc_cal_work_schedule(ch_group_t *grp_ptr, uint16_t delay_ms);
+
+/*!
+ * \brief Get the cached calibration values of a sensor.
+ *
+ * \param dev_ptr 		pointer to the ch_dev_t config structure for a sensor
+ * \param cal_ptr		pointer to the structure receiving the values
+ *
+ * \return 0 if values were found for this sensor, 1 otherwise
+ *
+ * This function returns the values last passed to \a chbsp_cal_store() for the same sensor 
+ * (same port, part number and I2C address) and RTC calibration pulse length, for example from 
+ * non-volatile storage.  If every sensor has cached values, \a ch_group_start() uses them at once 
+ * and calibrates again in the background, instead of blocking for the calibration pulse.
+ *
+ * \note OPTIONAL - The default implementation in chbsp_dummy.c returns 1.
+ */
+int chbsp_cal_load(ch_dev_t *dev_ptr, ch_cal_result_t *cal_ptr);
+
+/*!
+ * \brief Save the calibration values of a sensor.
+ *
+ * \param dev_ptr 		pointer to the ch_dev_t config structure for a sensor
+ * \param cal_ptr		pointer to the values
+ *
+ * This function is called after every RTC calibration, from the thread running the calibration.
+ *
+ * \note OPTIONAL - The default implementation in chbsp_dummy.c does nothing.
+ */
+void chbsp_cal_store(ch_dev_t *dev_ptr, const ch_cal_result_t *cal_ptr);
+
+/*!
+ * \brief Enter a critical section.
+ *
+ * \return key to pass to \a chbsp_critical_exit()
+ *
+ * This function keeps other threads and interrupt handlers from running until 
+ * \a chbsp_critical_exit(), e.g. by locking interrupts.  SonicLib uses it to swap in new 
+ * calibration values.  Calls may be nested.
+ *
+ * \note OPTIONAL - The default implementation in chbsp_dummy.c does nothing, which is only 
+ * correct when no background calibration runs (see \a chbsp_rtc_cal_timer_start()).
+ */
+uint32_t chbsp_critical_enter(void);
+
+/*!
+ * \brief Leave a critical section.
+ *
+ * \param key		value returned by the matching \a chbsp_critical_enter()
+ *
+ * \note OPTIONAL - The default implementation in chbsp_dummy.c does nothing.
+ */
+void chbsp_critical_exit(uint32_t key);
+
 
 /*!
  * \brief Initialize periodic timer.
@@ -774,11 +984,27 @@ void chbsp_periodic_timer_handler(void);
  *
  * This function is RECOMMENDED.
  *
+ * With an RTOS, the function may instead block the calling thread until \a chbsp_proc_wakeup() is 
+ * called, so that the main loop only runs when an application callback has work for it.
+ *
  * \note RECOMMENDED - This function is not called by SonicLib functions, so it is not required.
  * However, it is used in examples and other applications from Chirp.
  */
 void chbsp_proc_sleep(void);
 
+/*!
+ * \brief Wake up the processor from \a chbsp_proc_sleep().
+ *
+ * Called by the application, typically from a callback that set a task flag for the main loop, 
+ * e.g. when a group result readout completed (see \a ch_group_get_results_nb()).  May be called 
+ * from interrupt context.  Does nothing if \a chbsp_proc_sleep() returns on any interrupt.
+ *
+ * This function is RECOMMENDED.
+ *
+ * \note RECOMMENDED - This function is not called by SonicLib functions, so it is not required.
+ */
+void chbsp_proc_wakeup(void);
+
 /*!
  * \brief Turn on an LED on the board.
  *
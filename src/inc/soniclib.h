@@ -81,6 +81,7 @@
 /* Preliminary structure type definitions to resolve include order */
 typedef struct ch_dev_t ch_dev_t;
 typedef struct ch_group_t ch_group_t;
+typedef struct ch_cal_result_t ch_cal_result_t;
 
 
 /*==============  Chirp header files for installed sensor firmware packages ===================
@@ -98,6 +99,11 @@ typedef struct ch_group_t ch_group_t;
 
 /* Miscellaneous header files */
 //#define CHDRV_DEBUG				// uncomment this line to enable driver debug messages
+#define CHDRV_REG_CACHE			// comment out this line to disable the configuration register cache
+#define CHDRV_FW_BROADCAST		// comment out this line to program identical sensors on a bus one at a time
+#define CHDRV_FW_VERIFY_SAMPLED	// comment out this line to read back the whole firmware image after a broadcast download
+#define CHDRV_FW_COMPRESSED		// comment out this line to link the sensor firmware images uncompressed
+#define CHDRV_BOOT_PROFILE		// comment out this line to disable the ch_group_start() phase timing
 #include "chirp_board_config.h"		/* Header from board support package containing h/w params */
 #include "ch_driver.h"				/* Internal Chirp driver defines */
 #include <stdint.h>
@@ -129,7 +135,9 @@ typedef struct ch_group_t ch_group_t;
 #define CH_SIG_BYTE_1		(0x02)			/*!< Signature byte in sensor (2 of 2). */
 
 #define CH_NUM_THRESHOLDS	(6)				/*!< Number of internal detection thresholds (CH201 only). */
-#define CH_SPEEDOFSOUND_MPS (343) 			/*!< Speed of sound, in meters per second. */
+#define CH_SPEEDOFSOUND_MPS (343) 			/*!< Speed of sound, in meters per second, until a temperature is 
+												 set (see \a ch_group_set_temperature()). */
+#define CH_HUMIDITY_UNKNOWN	(0xFF)			/*!< Relative humidity value when it is not measured. */
 
 //! Return value codes.
 typedef enum {
@@ -180,7 +188,7 @@ typedef struct {
 
 
 //! Sensor I/Q data value.
-typedef struct {
+typedef struct ch_iq_sample_t {					/* [note tag name matches type, declared in ch_driver.h] */
 	int16_t q;										/*!< Q component of sample */
 	int16_t i;										/*!< I component of sample */
 } ch_iq_sample_t;
@@ -194,10 +202,56 @@ typedef struct {
 
 
 //! Multiple detection threshold structure (CH201 only).
-typedef struct {
+typedef struct ch_thresholds_t {	/* [note tag name matches type, declared in ch_driver.h] */
 	ch_thresh_t		threshold[CH_NUM_THRESHOLDS];
 } ch_thresholds_t;
 
+//! Measurement result, see \a ch_get_result() and \a ch_group_get_results_nb().
+typedef struct ch_result_t {		/* [note tag name matches type, declared in ch_driver.h] */
+	uint32_t		range;				/*!< range in mm * 32, or \a CH_NO_TARGET */
+	uint16_t		amplitude;			/*!< amplitude of the detected echo, 0 if no target */
+	uint16_t		tof_sf;				/*!< TOF scale factor of the measurement, 0 if not read */
+} ch_result_t;
+
+#define CH_RESULT_READ_TOF_SF	(0x01)	/*!< \a ch_get_result() option: also read the TOF scale factor */
+
+//! Target found in the I/Q data of a measurement, see \a ch_get_targets().
+typedef struct ch_target_t {		/* [note tag name matches type, declared in ch_driver.h] */
+	uint32_t		range;				/*!< range of the echo peak, in mm * 32 */
+	uint16_t		amplitude;			/*!< magnitude of the echo peak */
+	uint16_t		width;				/*!< number of consecutive samples above the threshold */
+} ch_target_t;
+
+#define CH_TARGET_LEVEL_DEFAULT	(150)	/*!< \a ch_get_targets() threshold without a threshold table (CH101), 
+											 the fixed level of the CH101 GPR firmware */
+
+//! Sensor calibration values, measured with the RTC calibration pulse.
+typedef struct ch_cal_result_t {
+	uint16_t		rtc_cal_result;		/*!< real-time clock calibration result */
+	uint32_t		op_frequency;		/*!< operating frequency, in Hz */
+	uint16_t		bandwidth;			/*!< bandwidth */
+	uint16_t		scale_factor;		/*!< scale factor */
+} ch_cal_result_t;
+
+//! Phases of \a ch_group_start(), see \a ch_get_boot_profile().
+typedef enum {
+	CH_BOOT_PHASE_RESET			= 0,		/*!< RESET_N pulse, all sensors */
+	CH_BOOT_PHASE_IDLE			= 1,		/*!< idle loop load (\a chdrv_set_idle()), per I2C bus */
+	CH_BOOT_PHASE_PING			= 2,		/*!< detection on the programming interface */
+	CH_BOOT_PHASE_RAM_INIT		= 3,		/*!< RAM init data download */
+	CH_BOOT_PHASE_FW_WRITE		= 4,		/*!< firmware download, including the readback check of a broadcast load */
+	CH_BOOT_PHASE_CHARGE_PUMP	= 5,		/*!< charge pump sequence before the firmware starts */
+	CH_BOOT_PHASE_FREQ_LOCK		= 6,		/*!< wait for frequency lock */
+	CH_BOOT_PHASE_RTC_CAL		= 7,		/*!< RTC calibration (or restore of the cached values), all sensors */
+	CH_BOOT_NUM_PHASES			= 8
+} ch_boot_phase_t;
+
+//! Time spent by a sensor in each phase of \a ch_group_start().
+typedef struct {
+	uint32_t		phase_us[CH_BOOT_NUM_PHASES];	/*!< time per phase, in microseconds */
+	uint32_t		total_us;						/*!< sum of the phases */
+} ch_boot_profile_t;
+
 //! Combined configuration structure.
 typedef struct {
 	ch_mode_t		mode;				/*!< operating mode */
@@ -212,6 +266,36 @@ typedef struct {
 typedef uint8_t (*ch_fw_init_func_t)(ch_dev_t *dev_ptr, ch_group_t *grp_ptr, uint8_t i2c_addr, 
 		 					         uint8_t dev_num, uint8_t i2c_bus_index);
 
+/* Sensor firmware capabilities (ch_fw_image_t) */
+#define CH_FW_CAP_STATIC_RANGE	(1 << 0)		/*!< static target rejection, see \a ch_set_static_range() */
+#define CH_FW_CAP_THRESHOLDS	(1 << 1)		/*!< programmable detection thresholds, see \a ch_set_thresholds() */
+#define CH_FW_CAP_SHORT_RANGE	(1 << 2)		/*!< short range, oversampled measurements */
+
+//! Firmware registry entry, see \a CH_FW_IMAGE_REGISTER().
+typedef struct ch_fw_image {
+	const char		  *name;				/*!< Name of the firmware, e.g. "ch201_gprmt" */
+	uint16_t		   part_number;			/*!< Part the firmware runs on (CH101_PART_NUMBER or CH201_PART_NUMBER) */
+	uint16_t		   caps;				/*!< Capabilities, CH_FW_CAP_* bits */
+	ch_fw_init_func_t  init_func;			/*!< Firmware init function, as passed to \a ch_init() */
+} ch_fw_image_t;
+
+/*!
+ * \brief Register a sensor firmware image for \a ch_init_auto().
+ *
+ * \param _name		name of the firmware, the init function is \a _name \a _init()
+ * \param _part		part number the firmware runs on
+ * \param _caps		capabilities, CH_FW_CAP_* bits
+ *
+ * The entry is placed in the ch_fw_image iterable linker section (see ch_fw_registry.ld), where 
+ * \a ch_group_start() looks for the image matching each sensor.  Only the registered images are 
+ * linked: register in the application the images the board may need, e.g.
+ * CH_FW_IMAGE_REGISTER(ch201_gprmt, CH201_PART_NUMBER, CH_FW_CAP_THRESHOLDS);
+ */
+#define CH_FW_IMAGE_REGISTER(_name, _part, _caps) \
+	const ch_fw_image_t _ch_fw_image_##_name \
+	__attribute__((section("._ch_fw_image.static." #_name), used, aligned(4))) = { \
+		.name = #_name, .part_number = (_part), .caps = (_caps), .init_func = _name##_init }
+
 //! API function pointer typedefs.
 typedef uint8_t	 (*ch_fw_load_func_t)(ch_dev_t *dev_ptr);
 typedef uint8_t	 (*ch_get_config_func_t)(ch_dev_t *dev_ptr, ch_config_t *config_ptr);
@@ -223,6 +307,9 @@ typedef uint8_t	 (*ch_set_max_range_func_t)(ch_dev_t *dev_ptr, uint16_t max_rang
 typedef uint8_t	 (*ch_set_static_range_func_t)(ch_dev_t *dev_ptr, uint16_t static_range);
 typedef uint32_t (*ch_get_range_func_t)(ch_dev_t *dev_ptr, ch_range_t range_type);
 typedef uint16_t (*ch_get_amplitude_func_t)(ch_dev_t *dev_ptr);
+typedef uint8_t  (*ch_get_result_func_t)(ch_dev_t *dev_ptr, ch_range_t range_type, ch_result_t *result_ptr, 
+										  uint8_t options);
+typedef uint8_t  (*ch_queue_result_func_t)(ch_dev_t *dev_ptr);
 typedef uint32_t (*ch_get_frequency_func_t)(ch_dev_t *dev_ptr);
 typedef uint8_t	 (*ch_get_iq_data_func_t)(ch_dev_t *dev_ptr, ch_iq_sample_t *buf_ptr, 
 										  uint16_t start_sample, uint16_t num_samples, 
@@ -243,6 +330,8 @@ typedef struct {
 	ch_set_static_range_func_t	set_static_range;
 	ch_get_range_func_t			get_range;
 	ch_get_amplitude_func_t		get_amplitude;
+	ch_get_result_func_t		get_result;
+	ch_queue_result_func_t		queue_result;
 	ch_get_frequency_func_t		get_frequency;
 	ch_get_iq_data_func_t		get_iq_data;
 	ch_samples_to_mm_func_t		samples_to_mm;
@@ -258,8 +347,14 @@ typedef void (*ch_io_int_callback_t)(ch_group_t *grp_ptr, uint8_t io_index);
 //! Non-blocking I/O complete callback routine pointer.
 typedef void (*ch_io_complete_callback_t)(ch_group_t *grp_ptr);		
 //
+//! Group result readout complete callback routine pointer, see \a ch_group_get_results_nb().
+typedef void (*ch_result_callback_t)(ch_group_t *grp_ptr, ch_result_t *results_ptr);
+//
 //! Periodic timer callback routine pointer.
 typedef void (*ch_timer_callback_t)(void);			
+//
+//! Per-bus task routine pointer, see \a chbsp_i2c_bus_run().
+typedef void (*ch_bus_task_t)(ch_group_t *grp_ptr, uint8_t bus_index, void *arg);
 
 
 //!  Chirp sensor group configuration structure.
@@ -275,10 +370,28 @@ typedef struct ch_group_t {		/* [note tag name matches type to help Doxygen link
 	uint16_t i2c_drv_flags;					/*!< Flags for special I2C handling by Chirp driver, from 
 											     \a chbsp_get_i2c_info()*/
 	uint16_t rtc_cal_pulse_ms; 				/*!< Real-time clock calibration pulse length (in ms) */
+	uint16_t freqlock_min_ms;				/*!< Shortest frequency lock time at the last start (in ms), 
+											     0 if unknown - see \a chdrv_group_wait_for_lock() */
+	volatile uint8_t rtc_cal_state;			/*!< Background RTC calibration state (CHDRV_RTC_CAL_*) - see 
+											     \a chdrv_group_measure_rtc_start() */
+	volatile uint8_t rtc_cal_hold;			/*!< Sensor accesses keeping calibration pulses from starting - 
+											     see \a chdrv_group_cal_hold() */
+	chdrv_recal_t recal;					/*!< Recalibration scheduler state */
+	chdrv_sos_t sos;						/*!< Speed of sound model */
+#ifdef CHDRV_BOOT_PROFILE
+	uint32_t boot_cycles;					/*!< Duration of the last \a ch_group_start(), in BSP cycles */
+#endif
 	chdrv_discovery_hook_t disco_hook;		/*!< Addr of hook routine to call when device found on bus */
 	ch_io_int_callback_t io_int_callback;			/*!< Addr of routine to call when sensor interrupts */
 	ch_io_complete_callback_t io_complete_callback;	/*!< Addr of routine to call when non-blocking I/O 
 													     completes */
+	ch_result_callback_t result_callback;			/*!< Addr of routine to call when a group result 
+													     readout completes */
+	ch_result_t *results_ptr;				/*!< Array filled by the group result readout in progress, 
+											     NULL if none - see \a chdrv_group_results_claim() */
+	uint32_t results_queued;				/*!< Bit mask of the ports read by the group result readout */
+	uint8_t results_one_way;				/*!< Group result readout reports one-way ranges */
+	uint8_t io_complete_pending;			/*!< Non-blocking transactions other than result reads queued */
 	ch_dev_t *device[CHIRP_MAX_NUM_SENSORS];		/*!< Array of pointers to ch_dev_t structures for 
 													     individual sensors */
 	uint8_t num_connected[CHIRP_NUM_I2C_BUSES];		/*!< Array of counters for connected sensors per bus */
@@ -294,9 +407,17 @@ typedef struct ch_dev_t {		/* [note tag name matches type to help Doxygen linkag
 	uint16_t	static_range;		/*!< Static target rejection range, in samples (0 if unused) */
 	uint16_t 	sample_interval;	/*!< Sample interval (in ms), only if in free-running mode */
 	uint16_t 	rtc_cal_result; 	/*!< Real-time clock calibration result for the sensor. */
+	uint16_t	freqlock_time_ms;	/*!< Time the sensor took to reach frequency lock at start-up, in ms. */
+	int32_t		rtc_cal_drift_ppm;	/*!< Change of \a rtc_cal_result at the last recalibration, in ppm. */
+#ifdef CHDRV_BOOT_PROFILE
+	uint32_t	boot_cycles[CH_BOOT_NUM_PHASES];	/*!< Time spent in each phase of the last \a ch_group_start(), 
+												     in BSP cycles (see \a chbsp_cycle_count()). */
+#endif
 	uint32_t 	op_frequency; 		/*!< Operating frequency for the sensor. */
 	uint16_t 	bandwidth; 			/*!< Bandwidth for the sensor. */
 	uint16_t 	scale_factor; 		/*!< Scale factor for the sensor. */
+	chdrv_range_conv_t range_conv;	/*!< Range conversion constants, from the calibration values. */
+	uint16_t	result_regs[2];		/*!< TOF and amplitude registers read by a group result readout */
 	uint8_t  	i2c_address; 		/*!< Current I2C addresses. */
 	uint8_t  	app_i2c_address;	/*!< Assigned application I2C address for device in normal operation*/
 	uint16_t	i2c_drv_flags;		/*!< Flags for special I2C handling by Chirp driver */
@@ -308,24 +429,39 @@ typedef struct ch_dev_t {		/* [note tag name matches type to help Doxygen linkag
 	uint8_t  	i2c_bus_index; 		/*!< Index value identifying which I2C bus is used for this device. */
 	uint16_t 	max_samples; 		/*!< Maximum number of receiver samples for this sensor firmware */
 	uint16_t 	num_rx_samples; 	/*!< Number of receiver samples for the current max range setting. */
+#ifdef CHDRV_REG_CACHE
+	uint64_t	reg_cache_mask;		/*!< Configuration registers mirrored in \a reg_cache (bit n = register n), 
+									     set by the firmware init function. */
+	uint64_t	reg_cache_valid;	/*!< Bit mask of \a reg_cache bytes known to match the sensor. */
+	uint8_t		reg_cache[CHDRV_REG_CACHE_SIZE];	/*!< Write-through copy of sensor configuration registers. */
+#endif
 
 	/* Sensor Firmware-specific Linkage Definitions */
 	const char	  *fw_version_string;		/*!< Pointer to string identifying sensor firmware version. */
+	const ch_fw_image_t *fw_image;		/*!< Registry entry of the firmware, if chosen by \a ch_init_auto() */
+	uint16_t	   fw_caps;					/*!< Capabilities required by \a ch_init_auto() */
+	uint8_t		   fw_auto;					/*!< Firmware chosen at start-up for the detected part */
 	const uint8_t *firmware;				/*!< Pointer to start of sensor firmware image to be loaded */
+	uint16_t	   fw_lz_size;				/*!< Size of \a firmware if compressed (see \a chdrv_fw_unpack()), 
+											     0 if not. */
+	uint32_t	   fw_checksum;				/*!< Checksum of \a firmware as stored, computed at start-up */
 	const uint8_t *ram_init;				/*!< Pointer to ram initialization data */
 	void     (*prepare_pulse_timer)(ch_dev_t *dev_ptr);	/*!< Pointer to function preparing sensor pulse 
 														     timer to measure real-time clock (RTC) 
 															 calibration pulse sent to device. */
-	void     (*store_pt_result)(ch_dev_t *dev_ptr);	/*!< Pointer to function to read RTC calibration 
-													     pulse timer result from sensor and place value 
-														 in the \a rtc_cal_result field. */
-	void     (*store_op_freq)(ch_dev_t *dev_ptr);	/*!< Pointer to function to read operating 
-													     frequency and place value in the
-														 \a op_frequency field. */
-	void     (*store_bandwidth)(ch_dev_t *dev_ptr);	/*!< Pointer to function to read operating bandwidth 
-													     and place value in the \a bandwidth field. */
-	void     (*store_scalefactor)(ch_dev_t *dev_ptr);	/*!< Pointer to function to calculate scale factor
-														     and place value in \a scalefactor field. */
+	void     (*store_pt_result)(ch_dev_t *dev_ptr, ch_cal_result_t *cal_ptr);	/*!< Pointer to function to read 
+													     RTC calibration pulse timer result from sensor 
+														 and place value in the \a rtc_cal_result field 
+														 of \a cal_ptr. */
+	void     (*store_op_freq)(ch_dev_t *dev_ptr, ch_cal_result_t *cal_ptr);	/*!< Pointer to function to read 
+													     operating frequency and place value in the
+														 \a op_frequency field of \a cal_ptr. */
+	void     (*store_bandwidth)(ch_dev_t *dev_ptr, ch_cal_result_t *cal_ptr);	/*!< Pointer to function to read 
+													     operating bandwidth and place value in the 
+														 \a bandwidth field of \a cal_ptr. */
+	void     (*store_scalefactor)(ch_dev_t *dev_ptr, ch_cal_result_t *cal_ptr);	/*!< Pointer to function to read 
+														     scale factor and place value in the 
+															 \a scale_factor field of \a cal_ptr. */
 	uint8_t  (*get_locked_state)(ch_dev_t *dev_ptr);	/*!< Pointer to function returning locked state 
 														     for sensor. */
 	uint16_t (*get_fw_ram_init_size)(void);			/*!< Pointer to function returning ram init size 
@@ -383,6 +519,28 @@ typedef struct ch_dev_t {		/* [note tag name matches type to help Doxygen linkag
  */
 uint8_t	ch_init(ch_dev_t *dev_ptr, ch_group_t *grp_ptr, uint8_t dev_num, ch_fw_init_func_t fw_init_func);
 
+/*!
+ * \brief Initialize the device descriptor for a sensor, firmware chosen at start-up.
+ *
+ * \param dev_ptr 		pointer to the ch_dev_t descriptor structure
+ * \param grp_ptr 		pointer to the ch_group_t descriptor for sensor group to join
+ * \param dev_num		number of the device within the sensor group (identifies which physical sensor)
+ * \param fw_caps		capabilities the firmware must have (CH_FW_CAP_* bits, 0 for any)
+ *
+ * \return 0 if success, 1 if error
+ *
+ * This function is like \a ch_init(), except that the firmware is not fixed here.  When 
+ * \a ch_group_start() finds a sensor on the port, it takes the part number from the board support 
+ * package (see \a chbsp_part_number()) and binds the first image registered with 
+ * \a CH_FW_IMAGE_REGISTER() for that part with all of \a fw_caps.  If the board does not know the 
+ * part, the first registered image with \a fw_caps is used.  A sensor without a matching image is 
+ * left unconnected.
+ *
+ * A board mixing CH101 and CH201 sensors can thus be served without rebuilding the application for 
+ * each combination.
+ */
+uint8_t ch_init_auto(ch_dev_t *dev_ptr, ch_group_t *grp_ptr, uint8_t dev_num, uint16_t fw_caps);
+
 /*!
  * \brief	Program and start a group of sensors.
  *
@@ -402,13 +560,33 @@ uint8_t	ch_init(ch_dev_t *dev_ptr, ch_group_t *grp_ptr, uint8_t dev_num, ch_fw_i
  * - Assign unique I2C address to sensor (specified by board support package, see \a chbsp_i2c_get_info()).
  * - Start sensor execution.
  * - Wait for sensor to lock (complete initialization, including self-test).
- * - Send timed pulse on INT line to calibrate sensor Real-Time Clock (RTC).
+ * - Send timed pulse on INT line to calibrate sensor Real-Time Clock (RTC).  If the board support 
+ *   package has cached calibration values for every sensor (see \a chbsp_cal_load()), these are 
+ *   used at once and the pulse runs in the background.
  * 
  * After this routine returns successfully, the sensor configuration may be set and ultrasonic 
  * measurements may begin.
  */
 uint8_t	ch_group_start(ch_group_t *grp_ptr);
 
+/*!
+ * \brief	Resume a group of sensors after a reset of the host only.
+ *
+ * \param	grp_ptr pointer to the ch_group_t descriptor for sensor group to be started
+ *
+ * \return 0 if successful, 1 if error
+ *
+ * This function may be called instead of \a ch_group_start() when the host restarts (watchdog, 
+ * firmware update) while the sensors stay powered.  If the sensors found by the last 
+ * \a ch_group_start() are still running the same firmware, their calibration is restored from 
+ * memory retained by the board support package (see \a chbsp_retained_mem()) and they are not 
+ * reprogrammed or recalibrated, so measurements can resume within a few milliseconds.  Otherwise, 
+ * this function does a full \a ch_group_start().
+ *
+ * The sensor configuration (mode, range, etc.) is not restored and must be set again.
+ */
+uint8_t	ch_group_warm_start(ch_group_t *grp_ptr);
+
 /*!
  * \brief Get current configuration settings for a sensor
  *
@@ -820,6 +998,26 @@ uint32_t ch_get_range(ch_dev_t *dev_ptr, ch_range_t range_type);
  */
 uint16_t ch_get_amplitude(ch_dev_t *dev_ptr);
 
+/*!
+ * \brief Get the range and amplitude measured by a sensor in one register read.
+ *
+ * \param dev_ptr 		pointer to the ch_dev_t descriptor structure
+ * \param range_type	the range type to be reported (e.g. one-way vs. round-trip), see \a ch_get_range()
+ * \param result_ptr	pointer to the ch_result_t structure to receive the result
+ * \param options		0, or \a CH_RESULT_READ_TOF_SF to read the TOF scale factor of the measurement too
+ *
+ * \return 0 if successful, non-zero on error (\a result_ptr->range is then \a CH_NO_TARGET)
+ *
+ * The TOF and amplitude registers (and the TOF scale factor just before them) are adjacent, so this 
+ * function reads them in a single I2C transaction where \a ch_get_range() followed by 
+ * \a ch_get_amplitude() needs two.  The range is converted with the constants cached at calibration 
+ * (see \a ch_get_range()).  With \a CH_RESULT_READ_TOF_SF, the scale factor of the measurement is 
+ * returned and used for the conversion when it differs from the calibrated one.
+ *
+ * If no target was detected, the range is \a CH_NO_TARGET and the amplitude is 0.
+ */
+uint8_t ch_get_result(ch_dev_t *dev_ptr, ch_range_t range_type, ch_result_t *result_ptr, uint8_t options);
+
 /*!
  * \brief Get the operating frequency of a sensor.
  *
@@ -845,6 +1043,115 @@ uint32_t ch_get_frequency(ch_dev_t *dev_ptr);
  */
 uint16_t ch_get_rtc_cal_result(ch_dev_t *dev_ptr);
 
+/*!
+ * \brief Get the frequency lock time
+ *
+ * \param dev_ptr pointer to the ch_dev_t descriptor structure
+ *
+ * \return 	frequency lock time, in milliseconds
+ *
+ * This function returns the time the sensor took to finish its start-up sequence and lock its 
+ * operating frequency during \a ch_group_start(), counted from the end of the firmware download 
+ * for the group.  The resolution is \a CHDRV_FREQLOCK_POLL_MS.  UINT16_MAX means the sensor did not 
+ * lock in time.
+ */
+uint16_t ch_get_freqlock_time(ch_dev_t *dev_ptr);
+
+/*!
+ * \brief Get the real-time clock drift
+ *
+ * \param dev_ptr pointer to the ch_dev_t descriptor structure
+ *
+ * \return 	change of the RTC calibration value at the last recalibration, in parts per million
+ *
+ * This function returns how much the RTC calibration value changed between the last two 
+ * calibrations of the sensor (see \a ch_group_set_recal_period()).
+ */
+int32_t ch_get_rtc_cal_drift(ch_dev_t *dev_ptr);
+
+/*!
+ * \brief Get the time spent in each phase of the last start-up
+ *
+ * \param dev_ptr 		pointer to the ch_dev_t descriptor structure
+ * \param profile_ptr	pointer to the ch_boot_profile_t structure to receive the phase times
+ *
+ * \return 0 if successful, non-zero if the profile is not available (\a CHDRV_BOOT_PROFILE not defined)
+ *
+ * This function returns, for each phase of the last \a ch_group_start() (see \a ch_boot_phase_t), 
+ * the time spent on this sensor.  Phases repeated by a retry are added up.  Phases done for several 
+ * sensors at once (reset, idle loop, broadcast download, RTC calibration) count in full for each of 
+ * them, and sensors on different I2C buses are started in parallel, so the group start-up time 
+ * (\a ch_group_get_boot_time()) is not the sum of the sensor profiles.
+ */
+uint8_t ch_get_boot_profile(ch_dev_t *dev_ptr, ch_boot_profile_t *profile_ptr);
+
+/*!
+ * \brief Get the name of a start-up phase
+ *
+ * \param phase		start-up phase
+ *
+ * \return 	short name of the phase, e.g. "fw write"
+ */
+const char *ch_boot_phase_name(ch_boot_phase_t phase);
+
+/*!
+ * \brief Get the duration of the last start-up
+ *
+ * \param grp_ptr 	pointer to the ch_group_t descriptor for the sensor group
+ *
+ * \return 	duration of the last \a ch_group_start(), in microseconds (0 if not available)
+ */
+uint32_t ch_group_get_boot_time(ch_group_t *grp_ptr);
+
+/*!
+ * \brief Recalibrate the sensors periodically without stopping measurements.
+ *
+ * \param grp_ptr 	pointer to the ch_group_t descriptor for the sensor group
+ * \param period_ms	initial time between calibrations, in milliseconds (0 to disable)
+ *
+ * Once enabled, every \a ch_group_trigger() checks whether a new RTC calibration is due and, if 
+ * so, schedules the calibration pulse in the idle time between the end of the measurement and the 
+ * next trigger.  The period then adapts to the drift observed between calibrations.  Only hardware 
+ * triggered modes are supported.  See \a chdrv_group_set_recal_period().
+ */
+void ch_group_set_recal_period(ch_group_t *grp_ptr, uint32_t period_ms);
+
+/*!
+ * \brief Set the air temperature and humidity for the range calculations of a group.
+ *
+ * \param grp_ptr 		pointer to the ch_group_t descriptor for the sensor group
+ * \param temp_cc		air temperature, in 0.01 degrees C
+ * \param humidity_pct	relative humidity, in %, or \a CH_HUMIDITY_UNKNOWN
+ *
+ * \return 1 if the range conversion constants were rebuilt, 0 if the change was too small
+ *
+ * Until this function is called, ranges are computed for a speed of sound of \a CH_SPEEDOFSOUND_MPS, 
+ * which is only right at about 20 degrees C (the speed changes by about 0.18 % per degree).  The 
+ * conversion constants of the sensors are only rebuilt when the temperature moved by more than the 
+ * step set by \a ch_group_set_temperature_step(), so this function can be called with every new 
+ * reading.  See \a chdrv_group_set_environment().
+ *
+ * The BSP may also feed the group from a temperature sensor on its own.
+ */
+uint8_t ch_group_set_temperature(ch_group_t *grp_ptr, int16_t temp_cc, uint8_t humidity_pct);
+
+/*!
+ * \brief Set the temperature change that rebuilds the range conversion constants.
+ *
+ * \param grp_ptr 		pointer to the ch_group_t descriptor for the sensor group
+ * \param step_cc		temperature step, in 0.01 degrees C (0 for the default, \a CHDRV_SOS_TEMP_STEP_CC)
+ */
+void ch_group_set_temperature_step(ch_group_t *grp_ptr, uint16_t step_cc);
+
+/*!
+ * \brief Get the speed of sound used for the range calculations of a group.
+ *
+ * \param grp_ptr 		pointer to the ch_group_t descriptor for the sensor group
+ *
+ * \return speed of sound, in mm/s
+ */
+uint32_t ch_group_get_speed_of_sound(ch_group_t *grp_ptr);
+
 /*!
  * \brief Get the real-time clock calibration pulse length
  *
@@ -980,6 +1287,90 @@ uint16_t ch_samples_to_mm(ch_dev_t *dev_ptr, uint16_t num_samples);
  */
 uint16_t ch_mm_to_samples(ch_dev_t *dev_ptr, uint16_t num_mm);
 
+/*!
+ * \brief Convert an array of time-of-flight values to ranges.
+ *
+ * \param dev_ptr 		pointer to the ch_dev_t descriptor structure
+ * \param range_type	the range type to be reported (e.g. one-way vs. round-trip), see \a ch_get_range()
+ * \param tof_ptr		pointer to the TOF register values
+ * \param range_ptr		pointer to the array receiving the ranges, in millimeters times 32
+ * \param count			number of values
+ *
+ * \return 0 if successful, non-zero if the sensor is not calibrated (nothing is converted)
+ *
+ * Converts TOF register values (e.g. collected from several measurements) the way \a ch_get_range() 
+ * does, without reading the sensor.  A TOF of UINT16_MAX gives \a CH_NO_TARGET.  Each conversion is a 
+ * multiply and a shift with constants computed when the sensor was calibrated.
+ */
+uint8_t ch_tof_to_range_bulk(ch_dev_t *dev_ptr, ch_range_t range_type, const uint16_t *tof_ptr, 
+							 uint32_t *range_ptr, uint16_t count);
+
+/*!
+ * \brief Convert an array of sample counts to distances.
+ *
+ * \param dev_ptr 		pointer to the ch_dev_t descriptor structure
+ * \param samples_ptr	pointer to the sample counts (or sample indices)
+ * \param mm_ptr		pointer to the array receiving the distances, in millimeters
+ * \param count			number of values
+ *
+ * \return 0 if successful, non-zero if the sensor is not calibrated (nothing is converted)
+ *
+ * Same conversion as \a ch_samples_to_mm(), for a whole array.
+ */
+uint8_t ch_samples_to_mm_bulk(ch_dev_t *dev_ptr, const uint16_t *samples_ptr, uint16_t *mm_ptr, uint16_t count);
+
+/*!
+ * \brief Refine a range to a fraction of a sample using the I/Q data of the measurement.
+ *
+ * \param dev_ptr 		pointer to the ch_dev_t descriptor structure
+ * \param range_type	the range type of \a range and of the result, see \a ch_get_range()
+ * \param range			range reported for the measurement (\a ch_get_range(), \a ch_get_result()), 
+ * 						in millimeters times 32
+ * \param iq_ptr		pointer to the I/Q data of the same measurement, read by \a ch_get_iq_data() 
+ * 						starting at sample 0
+ * \param num_samples	number of I/Q samples in \a iq_ptr
+ *
+ * \return refined range in millimeters times 32, or \a range unchanged if it is \a CH_NO_TARGET, 
+ * the sensor is not calibrated, or the echo peak is not found in the I/Q data
+ *
+ * The range reported by the sensor has the resolution of one sample (several millimeters).  This 
+ * function looks for the magnitude peak of the echo in the I/Q data near the reported range and 
+ * places it between two samples by parabolic interpolation on the magnitudes.  The computation is 
+ * integer only and does not access the sensor, its cost is a few hundred cycles per call.
+ */
+uint32_t ch_get_precise_range(ch_dev_t *dev_ptr, ch_range_t range_type, uint32_t range, const ch_iq_sample_t *iq_ptr, 
+							  uint16_t num_samples);
+
+/*!
+ * \brief Find all targets in the I/Q data of a measurement.
+ *
+ * \param dev_ptr 		pointer to the ch_dev_t descriptor structure
+ * \param range_type	the range type to be reported, see \a ch_get_range()
+ * \param iq_ptr		pointer to the I/Q data of the measurement, read by \a ch_get_iq_data() 
+ * 						starting at sample 0
+ * \param num_samples	number of I/Q samples in \a iq_ptr
+ * \param thresh_ptr	detection thresholds (e.g. from \a ch_get_thresholds() on a CH201), or NULL 
+ * 						for the fixed level \a CH_TARGET_LEVEL_DEFAULT
+ * \param targets_ptr	pointer to the array receiving the targets, nearest first
+ * \param max_targets	number of entries in \a targets_ptr
+ *
+ * \return number of targets found (0 if none, or if the sensor is not calibrated)
+ *
+ * \a ch_get_range() reports the nearest target only.  This function scans the magnitude of every 
+ * I/Q sample against the threshold of its segment in \a thresh_ptr, like the CH201 firmware does.  
+ * Without \a thresh_ptr a single level applies from the static target rejection range on, like the 
+ * CH101 firmware.  Each run of consecutive samples above the threshold is one target: its range is 
+ * that of the magnitude peak, interpolated between samples (see \a ch_get_precise_range()), its 
+ * width the length of the run.  Echoes close enough to overlap above the threshold are reported 
+ * as one target.
+ *
+ * The data is scanned once, comparing squared magnitudes, and the search stops when 
+ * \a max_targets targets are found.  The thresholds are not read from the sensor: on a CH201, read 
+ * them once with \a ch_get_thresholds() and pass them with every frame.
+ */
+uint8_t ch_get_targets(ch_dev_t *dev_ptr, ch_range_t range_type, const ch_iq_sample_t *iq_ptr, uint16_t num_samples, 
+					   const ch_thresholds_t *thresh_ptr, ch_target_t *targets_ptr, uint8_t max_targets);
+
 
 /*!
  * \brief Start non-blocking I/O operation(s) for a group of sensors
@@ -1041,6 +1432,40 @@ void ch_io_complete_callback_set(ch_group_t *grp_ptr, ch_io_complete_callback_t
  */
 void ch_io_notify(ch_group_t *grp_ptr, uint8_t i2c_bus_index);
 
+/*!
+ * \brief Register the group result readout complete callback routine for a group of sensors
+ *
+ * \param grp_ptr pointer to the ch_group_t group descriptor structure
+ * \param callback_func_ptr pointer to callback function to be called when a result readout completes
+ *
+ * See \a ch_group_get_results_nb().
+ */
+void ch_result_callback_set(ch_group_t *grp_ptr, ch_result_callback_t callback_func_ptr);
+
+/*!
+ * \brief Read the results of all sensors in a group without blocking
+ *
+ * \param grp_ptr 		pointer to the ch_group_t group descriptor structure
+ * \param range_type	range type reported by sensors in transmit/receive modes, see \a ch_get_range() 
+ * 						(sensors in \a CH_MODE_TRIGGERED_RX_ONLY mode always report \a CH_RANGE_DIRECT)
+ * \param results_ptr	array of \a ch_get_num_ports() entries to receive the results, indexed by device number
+ *
+ * \return 0 if the readout was started, non-zero if no callback is registered, a readout or other 
+ * non-blocking I/O is still in progress, or no sensor is connected
+ *
+ * This function queues one read of the TOF and amplitude registers per connected sensor (see 
+ * \a ch_get_result()) and starts them in the background, on all I2C buses at once, using the same 
+ * non-blocking I/O as \a ch_get_iq_data().  It can be called from the sensor interrupt callback once 
+ * all sensors have interrupted.  When every read has completed, the ranges are converted with the 
+ * calibration constants of each sensor and the callback registered with \a ch_result_callback_set() 
+ * is called once with the filled \a results_ptr array.  The entries of sensors that are not 
+ * connected, or not calibrated, have a range of \a CH_NO_TARGET.
+ *
+ * The BSP must provide \a chbsp_i2c_mem_read_nb() and call \a ch_io_notify() as for non-blocking 
+ * I/Q reads.
+ */
+uint8_t ch_group_get_results_nb(ch_group_t *grp_ptr, ch_range_t range_type, ch_result_t *results_ptr);
+
 /*!
  * \brief Get detection thresholds (CH201 only).
  *
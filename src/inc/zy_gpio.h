@@ -1,8 +1,8 @@
 
-
 #ifndef _ZY_GPIO_
 #define _ZY_GPIO_
 
+#include <zephyr/drivers/gpio.h>
 #include "../inc/soniclib.h"
 
 typedef enum zy_gpio_interrupt{ 
@@ -12,7 +12,7 @@ typedef enum zy_gpio_interrupt{
 
 typedef enum zy_gpio_direction {
     ZY_GPIO_INPUT,
-    ZY_GPIO_OUTUPUT
+    ZY_GPIO_OUTPUT
 } zy_gpio_direction_e;
 
 typedef enum zy_gpio_int_type {
@@ -20,24 +20,28 @@ typedef enum zy_gpio_int_type {
     ZY_GPIO_EDGE_F
 } zy_gpio_int_type_e;
 
+// Called from the GPIO ISR with the index of the sensor whose INT line fired
+typedef void (*zy_gpio_int_cb_t)(uint8_t sensor);
+
 int zy_gpio_init_all();
 int zy_gpio_init(
-    struct gpio_dt_spec *dev, 
+    const struct gpio_dt_spec *dev, 
     zy_gpio_interrupt_e gpio_int,
     zy_gpio_direction_e dir,
     zy_gpio_int_type_e int_type,
+    struct gpio_callback *cb_data,
     gpio_callback_handler_t int_cb
     );
 
-int zy_gpio_write_prg(uint8_t val);
+int zy_gpio_write_prg(uint8_t sensor, uint8_t val);
 int zy_gpio_write_rst(uint8_t val);
-int zy_gpio_write_int(uint8_t val);
-int zy_gpio_set_int_dir(zy_gpio_direction_e dir);
-int zy_gpio_set_prg_dir(zy_gpio_direction_e dir);
+int zy_gpio_write_int(uint8_t sensor, uint8_t val);
+int zy_gpio_set_int_dir(uint8_t sensor, zy_gpio_direction_e dir);
+int zy_gpio_set_prg_dir(uint8_t sensor, zy_gpio_direction_e dir);
 int zy_gpio_set_rst_dir(zy_gpio_direction_e dir);
-int zy_gpio_int_enable_int(zy_gpio_int_type_e int_typ);
-int zy_gpio_int_disable_int();
-int zy_gpio_set_int_cb(ch_io_int_callback_t int_cb);
+int zy_gpio_int_enable_int(uint8_t sensor, zy_gpio_int_type_e int_typ);
+int zy_gpio_int_disable_int(uint8_t sensor);
+int zy_gpio_set_int_cb(zy_gpio_int_cb_t int_cb);
 
 
-#endif // _ZY_GPIO_
\ No newline at end of file
+#endif // _ZY_GPIO_
@@ -1,20 +1,101 @@
+
 #ifndef _ZY_I2C_
 #define _ZY_I2C_
 
 #include <zephyr/kernel.h>
 #include <zephyr/drivers/i2c.h>
 
-#define CHIRP_I2C      DT_NODELABEL(chirp)
-#define CHIRP_CONF_I2C DT_NODELABEL(chirp_conf)
+#include "chirp_board_config.h"     // CHIRP_BOARD_NODE
+
+#define ZY_I2C_NB_STACK_SIZE    1024    // stack of the thread completing non-blocking transfers
+#define ZY_I2C_NB_PRIORITY      K_PRIO_COOP(7)
+
+/*
+    The data of a transaction is sent as a single message, up to
+    ZY_I2C_MAX_XFER_SIZE bytes (the 16-bit EasyDMA counter of the nRF52840
+    TWIM); larger transfers are rejected with -EINVAL. The firmware image
+    (2 KB) and a full CH201 I/Q frame (1800 bytes) fit in one message.
+    A header is a second write message without RESTART, which the nRF TWIM
+    driver merges through its concatenation buffer (zephyr,concat-buf-size,
+    see the board overlay).
+*/
+#define ZY_I2C_MAX_XFER_SIZE    0xFFFF
+#define ZY_I2C_MAX_MSGS         2       // header / register address + data
+
+/*
+    Failed transfers are retried after a bus recovery (clock pulses until SDA
+    is released, STOP, controller re-initialized) and a backoff doubling from
+    ZY_I2C_BACKOFF_MIN_US up to ZY_I2C_BACKOFF_MAX_US, at most ZY_I2C_MAX_RETRIES
+    times: a wedged bus costs at most a few ms before the error is reported.
+    zy_i2c_probe() makes a single attempt: the address NACK of an empty port
+    during sensor discovery is returned at once and not counted as an error.
+*/
+#define ZY_I2C_MAX_RETRIES      3
+#define ZY_I2C_BACKOFF_MIN_US   50
+#define ZY_I2C_BACKOFF_MAX_US   1000
+
+/*
+    Bus speed (I2C_SPEED_STANDARD / FAST / FAST_PLUS) is selected at run time.
+    Transfers that fail and then succeed on a retry point to a marginal bus
+    (long harness, weak pull-ups): after ZY_I2C_FALLBACK_ERRORS of them at one
+    speed the bus drops to the next slower speed, down to standard mode.
+    Transfers that never succeed (absent device) do not count.
+*/
+#define ZY_I2C_FALLBACK_ERRORS  8
+
+/*
+    Completion callback for non-blocking transfers.
+    Always called from the zy_i2c work queue thread (never from the I2C ISR),
+    so it is allowed to start the next transfer.
+*/
+typedef void (*zy_i2c_nb_cb_t)(int result, void *user_data);
+
+// Blocking transfer statistics, used to report the effective throughput (summed over all buses;
+// the time is the sum of the time spent in transfers on each bus)
+struct zy_i2c_stats {
+    uint32_t bytes;
+    uint32_t cycles;
+    uint32_t transfers;
+};
+
+// Error and recovery counters of one bus
+struct zy_i2c_bus_stats {
+    uint32_t errors;        // failed transfer attempts
+    uint32_t retries;       // attempts repeated after a failure
+    uint32_t recoveries;    // bus clear + controller re-init
+    uint32_t failures;      // transfers still failing after all retries
+    uint32_t fallbacks;     // speed reductions after repeated errors
+};
 
 int zy_i2c_init();
+uint8_t zy_i2c_num_buses();
+uint8_t zy_i2c_sensor_bus(uint8_t sensor);
+uint8_t zy_i2c_sensor_address(uint8_t sensor);
+
+/*
+    Transfers address a device by bus index (position in the devicetree
+    "i2c-buses" list) and 7-bit I2C address.
+*/
+int zy_i2c_reset(uint8_t bus);
+int zy_i2c_set_speed(uint8_t bus, uint32_t speed);
+uint32_t zy_i2c_get_speed(uint8_t bus);
+int zy_i2c_send(uint8_t bus, uint16_t addr, uint8_t *msg, uint32_t size);
+int zy_i2c_probe(uint8_t bus, uint16_t addr, uint8_t *msg, uint32_t size);
+int zy_i2c_write_hdr(uint8_t bus, uint16_t addr, uint8_t *hdr, uint8_t hdr_len, uint8_t *data, uint32_t size);
+int zy_i2c_recv(uint8_t bus, uint16_t addr, uint8_t *msg, uint32_t size);
+int zy_i2c_mem_read(uint8_t bus, uint16_t addr, uint8_t reg, uint8_t *data, uint32_t size);
 
-int zy_i2c_send_chirp(char* const msg, uint8_t size);
-int zy_i2c_send_chirp_conf(char* const msg, uint8_t size);
-int zy_i2c_recv_chirp(char* msg, uint8_t size);
-int zy_i2c_recv_chirp_conf(char* msg, uint8_t size);
+int zy_i2c_mem_read_nb(uint8_t bus, uint16_t addr, uint8_t reg, uint8_t *data, uint32_t size,
+                       zy_i2c_nb_cb_t cb, void *user_data);
+int zy_i2c_mem_write_nb(uint8_t bus, uint16_t addr, uint8_t reg, uint8_t *data, uint32_t size,
+                        zy_i2c_nb_cb_t cb, void *user_data);
+int zy_i2c_recv_nb(uint8_t bus, uint16_t addr, uint8_t *data, uint32_t size, zy_i2c_nb_cb_t cb, void *user_data);
+int zy_i2c_send_nb(uint8_t bus, uint16_t addr, uint8_t *data, uint32_t size, zy_i2c_nb_cb_t cb, void *user_data);
 
-uint8_t zy_i2c_chirp_address();
-uint8_t zy_i2c_chirp_conf_address();
+void zy_i2c_stats_get(struct zy_i2c_stats *out);
+void zy_i2c_stats_reset();
+uint32_t zy_i2c_stats_bytes_per_sec(const struct zy_i2c_stats *s);
+void zy_i2c_bus_stats_get(uint8_t bus, struct zy_i2c_bus_stats *out);
+void zy_i2c_bus_stats_reset();
 
 #endif // _ZY_I2C_
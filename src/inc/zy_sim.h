@@ -0,0 +1,76 @@
+
+#ifndef _ZY_SIM_
+#define _ZY_SIM_
+
+/*
+    Simulated Chirp sensors for native_sim builds.
+
+    The sensors sit behind a simulated I2C controller ("zy,sim-i2c") and a
+    simulated GPIO controller ("zy,sim-gpio"), so zy_i2c, zy_gpio, chirp_bsp
+    and SonicLib run unchanged on the host. The sensor ports are the children
+    of the chirp_board devicetree node, exactly as on the real board.
+
+    Each simulated sensor emulates:
+     - the programming interface at CH_I2C_ADDR_PROG (CH_PROG_REG_* registers,
+       single and burst memory access, CPU reset / halt / run)
+     - the application registers of the loaded firmware (gpr_open, gpr_sr_open
+       or gprmt, recognized from the image written to program memory)
+     - frequency lock, RTC calibration against the INT pulse, triggered and
+       free-running measurements signalled by a pulse on INT
+     - an echo scene giving TOF, amplitude and I/Q data
+    The I2C controller adds the bus time of every transfer (bit rate from
+    i2c_configure() / clock-frequency, plus a fixed latency per transfer).
+*/
+
+#include <zephyr/kernel.h>
+#include <zephyr/drivers/i2c.h>
+#include <zephyr/drivers/gpio.h>
+
+#define ZY_SIM_MAX_TARGETS      4
+
+#define ZY_SIM_RTC_HZ           16000       // sensor real-time clock
+#define ZY_SIM_CH101_OP_FREQ    175000      // acoustic operating frequency, Hz
+#define ZY_SIM_CH201_OP_FREQ    85000
+#define ZY_SIM_LOCK_MS          20          // frequency lock time after the firmware starts
+#define ZY_SIM_CH101_THRESHOLD  150         // fixed detection threshold of the CH101 firmware
+#define ZY_SIM_ECHO_WIDTH       4           // default half width of an echo, in samples
+
+struct zy_sim_target {
+    uint16_t range_mm;      // one-way distance
+    uint16_t amplitude;     // peak echo amplitude, in I/Q units
+    uint8_t width;          // half width of the echo in samples, 0 = ZY_SIM_ECHO_WIDTH
+};
+
+struct zy_sim_scene {
+    uint8_t num_targets;
+    struct zy_sim_target targets[ZY_SIM_MAX_TARGETS];
+    uint16_t noise;         // peak noise added to every I and Q value
+};
+
+// Echo scene seen by one sensor port, takes effect at the next measurement
+void zy_sim_set_scene(uint8_t sensor, const struct zy_sim_scene *scene);
+void zy_sim_get_scene(uint8_t sensor, struct zy_sim_scene *scene);
+
+// Remove / insert the sensor of a port (an absent sensor never answers on the bus)
+void zy_sim_set_present(uint8_t sensor, uint8_t present);
+
+/*
+    Sensor interrupted in the middle of a byte (e.g. brown-out): it keeps SDA
+    low, so every transfer on its bus fails until the bus is cleared with
+    i2c_recover_bus().
+*/
+void zy_sim_hold_sda(uint8_t sensor);
+
+// Number of measurements completed by a sensor since start-up
+uint32_t zy_sim_measurement_count(uint8_t sensor);
+
+/*
+    Hooks between the simulated controllers and the sensor model, not for
+    application use.
+*/
+int zy_sim_sensor_transfer(uint32_t bus_ord, struct i2c_msg *msgs, uint8_t num_msgs, uint16_t addr);
+void zy_sim_sensor_bus_clear(uint32_t bus_ord);
+void zy_sim_sensor_pin_changed(gpio_pin_t pin, int level);
+void zy_sim_gpio_drive(gpio_pin_t pin, int level);
+
+#endif // _ZY_SIM_
@@ -11,7 +11,13 @@ uint8_t ch101_gpr_open_init(ch_dev_t *dev_ptr, ch_group_t *grp_ptr, uint8_t i2c_
 	dev_ptr->i2c_bus_index = i2c_bus_index;
 
 	/* Init firmware-specific function pointers */
+#ifdef CHDRV_FW_COMPRESSED
+	dev_ptr->firmware 					= ch101_gpr_open_fw_lz;
+	dev_ptr->fw_lz_size					= ch101_gpr_open_fw_lz_size;
+#else
 	dev_ptr->firmware 					= ch101_gpr_open_fw;
+	dev_ptr->fw_lz_size					= 0;
+#endif
 	dev_ptr->fw_version_string			= ch101_gpr_open_version;
 	dev_ptr->ram_init 					= get_ram_ch101_gpr_open_init_ptr();
 	dev_ptr->get_fw_ram_init_size 		= get_ch101_gpr_open_fw_ram_init_size;
@@ -33,6 +39,8 @@ uint8_t ch101_gpr_open_init(ch_dev_t *dev_ptr, ch_group_t *grp_ptr, uint8_t i2c_
 	dev_ptr->api_funcs.set_static_range = ch_common_set_static_range;
 	dev_ptr->api_funcs.get_range        = ch_common_get_range;
 	dev_ptr->api_funcs.get_amplitude    = ch_common_get_amplitude;
+	dev_ptr->api_funcs.get_result       = ch_common_get_result;
+	dev_ptr->api_funcs.queue_result     = ch_common_queue_result;
 	dev_ptr->api_funcs.get_iq_data      = ch_common_get_iq_data;
 	dev_ptr->api_funcs.samples_to_mm    = ch_common_samples_to_mm;
 	dev_ptr->api_funcs.mm_to_samples    = ch_common_mm_to_samples;
@@ -45,6 +53,12 @@ uint8_t ch101_gpr_open_init(ch_dev_t *dev_ptr, ch_group_t *grp_ptr, uint8_t i2c_
 	/* This firmware does not use oversampling */
 	dev_ptr->oversample = 0;
 
+#ifdef CHDRV_REG_CACHE
+	/* Configuration registers kept in the driver register cache */
+	dev_ptr->reg_cache_mask = CH101_GPR_OPEN_REG_CACHE_MASK;
+	dev_ptr->reg_cache_valid = 0;
+#endif
+
 	/* Init device and group descriptor linkage */
 	dev_ptr->group						= grp_ptr;			// set parent group pointer
 	grp_ptr->device[io_index] 	   		= dev_ptr;			// add to parent group
@@ -52,7 +66,7 @@ uint8_t ch101_gpr_open_init(ch_dev_t *dev_ptr, ch_group_t *grp_ptr, uint8_t i2c_
 	return 0;
 }
 
-void ch101_gpr_open_store_pt_result(ch_dev_t *dev_ptr) {
+void ch101_gpr_open_store_pt_result(ch_dev_t *dev_ptr, ch_cal_result_t *cal_ptr) {
 	uint16_t rtc_cal_result;
 	uint16_t calc_val;
 	uint32_t count;
@@ -64,6 +78,6 @@ void ch101_gpr_open_store_pt_result(ch_dev_t *dev_ptr) {
 	calc_val =  (uint16_t)((uint32_t)CH101_GPR_OPEN_CTR * 16U * CH101_FREQCOUNTERCYCLES / count);
 	chdrv_write_word(dev_ptr, CH101_GPR_OPEN_REG_CALC, calc_val);
 
-	dev_ptr->rtc_cal_result = rtc_cal_result;
+	cal_ptr->rtc_cal_result = rtc_cal_result;
 }
 
@@ -10,7 +10,13 @@ uint8_t ch201_gprmt_init(ch_dev_t *dev_ptr, ch_group_t *grp_ptr, uint8_t i2c_add
 	dev_ptr->i2c_bus_index = i2c_bus_index;
 
 	/* Init firmware-specific function pointers */
+#ifdef CHDRV_FW_COMPRESSED
+	dev_ptr->firmware 					= ch201_gprmt_fw_lz;
+	dev_ptr->fw_lz_size					= ch201_gprmt_fw_lz_size;
+#else
 	dev_ptr->firmware 					= ch201_gprmt_fw;
+	dev_ptr->fw_lz_size					= 0;
+#endif
 	dev_ptr->fw_version_string			= ch201_gprmt_version;
 	dev_ptr->ram_init 					= get_ram_ch201_gprmt_init_ptr();
 	dev_ptr->get_fw_ram_init_size 		= get_ch201_gprmt_fw_ram_init_size;
@@ -32,6 +38,8 @@ uint8_t ch201_gprmt_init(ch_dev_t *dev_ptr, ch_group_t *grp_ptr, uint8_t i2c_add
 	dev_ptr->api_funcs.set_static_range = NULL;								// not supported
 	dev_ptr->api_funcs.get_range        = ch_common_get_range;
 	dev_ptr->api_funcs.get_amplitude    = ch_common_get_amplitude;
+	dev_ptr->api_funcs.get_result       = ch_common_get_result;
+	dev_ptr->api_funcs.queue_result     = ch_common_queue_result;
 	dev_ptr->api_funcs.get_iq_data      = ch_common_get_iq_data;
 	dev_ptr->api_funcs.samples_to_mm    = ch_common_samples_to_mm;
 	dev_ptr->api_funcs.mm_to_samples    = ch_common_mm_to_samples;
@@ -44,6 +52,12 @@ uint8_t ch201_gprmt_init(ch_dev_t *dev_ptr, ch_group_t *grp_ptr, uint8_t i2c_add
 	/* This firmware does not use oversampling */
 	dev_ptr->oversample = 0;
 
+#ifdef CHDRV_REG_CACHE
+	/* Configuration registers kept in the driver register cache */
+	dev_ptr->reg_cache_mask = CH201_GPRMT_REG_CACHE_MASK;
+	dev_ptr->reg_cache_valid = 0;
+#endif
+
 	/* Init device and group descriptor linkage */
 	dev_ptr->group						= grp_ptr;			// set parent group pointer
 	grp_ptr->device[io_index] 	   		= dev_ptr;			// add to parent group
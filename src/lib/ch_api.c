@@ -53,6 +53,10 @@ uint8_t	ch_init(ch_dev_t *dev_ptr, ch_group_t *grp_ptr, uint8_t dev_num, ch_fw_i
 			/* Save special handling flags for Chirp driver */
 			grp_ptr->i2c_drv_flags = i2c_info.drv_flags;
 
+			/* Firmware fixed by the caller */
+			dev_ptr->fw_image = NULL;
+			dev_ptr->fw_auto  = 0;
+
 			/* Call asic f/w init function passed in as parameter */
 			ret_val = (*fw_init_func)(dev_ptr, grp_ptr, i2c_info.address, dev_num, i2c_info.bus_num);
 		}
@@ -61,6 +65,35 @@ uint8_t	ch_init(ch_dev_t *dev_ptr, ch_group_t *grp_ptr, uint8_t dev_num, ch_fw_i
 	return ret_val;
 }
 
+uint8_t ch_init_auto(ch_dev_t *dev_ptr, ch_group_t *grp_ptr, uint8_t dev_num, uint16_t fw_caps) {
+	ch_i2c_info_t	i2c_info;
+
+	/* Get I2C parameters from BSP */
+	uint8_t ret_val = chbsp_i2c_get_info(grp_ptr, dev_num, &i2c_info);
+
+	if (ret_val == RET_OK) {
+		/* Save special handling flags for Chirp driver */
+		grp_ptr->i2c_drv_flags = i2c_info.drv_flags;
+
+		/* Only what is needed to find the sensor, the firmware init function is called at start-up */
+		dev_ptr->part_number 	 = 0;
+		dev_ptr->app_i2c_address = i2c_info.address;
+		dev_ptr->io_index 		 = dev_num;
+		dev_ptr->i2c_bus_index 	 = i2c_info.bus_num;
+		dev_ptr->firmware 		 = NULL;
+		dev_ptr->fw_lz_size 	 = 0;
+		dev_ptr->fw_image 		 = NULL;
+		dev_ptr->fw_caps 		 = fw_caps;
+		dev_ptr->fw_auto 		 = 1;
+
+		/* Init device and group descriptor linkage */
+		dev_ptr->group 			 = grp_ptr;
+		grp_ptr->device[dev_num] = dev_ptr;
+	}
+
+	return ret_val;
+}
+
 
 uint8_t	ch_get_config(ch_dev_t *dev_ptr, ch_config_t *config_ptr) {
 	uint8_t ret_val = 0;
@@ -78,6 +111,8 @@ uint8_t	ch_get_config(ch_dev_t *dev_ptr, ch_config_t *config_ptr) {
 uint8_t	ch_set_config(ch_dev_t *dev_ptr, ch_config_t *config_ptr) {
 	uint8_t ret_val = 0;
 
+	chdrv_group_cal_hold(dev_ptr->group);									// no calibration pulse during the writes
+
 	ret_val = ch_set_mode(dev_ptr, config_ptr->mode);						// set operating mode
 
 	if (!ret_val) {
@@ -109,6 +144,8 @@ uint8_t	ch_set_config(ch_dev_t *dev_ptr, ch_config_t *config_ptr) {
 		}
 	}
 
+	chdrv_group_cal_release(dev_ptr->group);
+
 	return ret_val;
 }
 
@@ -123,6 +160,14 @@ uint8_t	ch_group_start(ch_group_t *grp_ptr) {
 	return ret_val;
 }
 
+uint8_t	ch_group_warm_start(ch_group_t *grp_ptr) {
+	uint8_t ret_val;
+
+	ret_val = chdrv_group_warm_start(grp_ptr);
+
+	return ret_val;
+}
+
 void ch_trigger(ch_dev_t *dev_ptr) {
 	chdrv_hw_trigger(dev_ptr);
 }
@@ -136,7 +181,9 @@ void ch_reset(ch_dev_t *dev_ptr, ch_reset_t reset_type) {
 	if (reset_type == CH_RESET_HARD) {
 		chdrv_group_hard_reset(dev_ptr->group); 			// TODO need single device hard reset
 	} else {
+		chdrv_group_cal_hold(dev_ptr->group);
 		chdrv_soft_reset(dev_ptr);
+		chdrv_group_cal_release(dev_ptr->group);
 	}
 }
 
@@ -144,7 +191,9 @@ void ch_group_reset(ch_group_t *grp_ptr, ch_reset_t reset_type) {
 	if (reset_type == CH_RESET_HARD) {
 		chdrv_group_hard_reset(grp_ptr);
 	} else {
+		chdrv_group_cal_hold(grp_ptr);
 		chdrv_group_soft_reset(grp_ptr);
+		chdrv_group_cal_release(grp_ptr);
 	}
 }
 
@@ -204,7 +253,9 @@ uint8_t ch_set_mode(ch_dev_t *dev_ptr, ch_mode_t mode) {
 	ch_set_mode_func_t func_ptr = dev_ptr->api_funcs.set_mode;
 
 	if (func_ptr != NULL) {
+		chdrv_group_cal_hold(dev_ptr->group);
 		ret_val = (*func_ptr)(dev_ptr, mode);
+		chdrv_group_cal_release(dev_ptr->group);
 	}
 
 	return ret_val;
@@ -226,7 +277,9 @@ uint8_t ch_set_sample_interval(ch_dev_t *dev_ptr, uint16_t sample_interval) {
 	ch_set_sample_interval_func_t func_ptr = dev_ptr->api_funcs.set_sample_interval;
 
 	if (func_ptr != NULL) {
+		chdrv_group_cal_hold(dev_ptr->group);
 		ret_val = (*func_ptr)(dev_ptr, sample_interval);
+		chdrv_group_cal_release(dev_ptr->group);
 	}
 
 	return ret_val;
@@ -242,7 +295,9 @@ uint8_t ch_set_num_samples(ch_dev_t *dev_ptr, uint16_t num_samples) {
 	ch_set_num_samples_func_t func_ptr = dev_ptr->api_funcs.set_num_samples;
 
 	if (func_ptr != NULL) {
+		chdrv_group_cal_hold(dev_ptr->group);
 		ret_val = (*func_ptr)(dev_ptr, num_samples);
+		chdrv_group_cal_release(dev_ptr->group);
 	}
 
 	dev_ptr->max_range = ch_samples_to_mm(dev_ptr, num_samples);	// store corresponding range in mm
@@ -261,7 +316,9 @@ uint8_t ch_set_max_range(ch_dev_t *dev_ptr, uint16_t max_range) {
 	ch_set_max_range_func_t func_ptr = dev_ptr->api_funcs.set_max_range;
 
 	if (func_ptr != NULL) {
+		chdrv_group_cal_hold(dev_ptr->group);
 		ret_val = (*func_ptr)(dev_ptr, max_range);
+		chdrv_group_cal_release(dev_ptr->group);
 	}
 
 	return ret_val;
@@ -277,7 +334,9 @@ uint8_t ch_set_static_range(ch_dev_t *dev_ptr, uint16_t num_samples) {
 	ch_set_static_range_func_t func_ptr = dev_ptr->api_funcs.set_static_range;
 
 	if (func_ptr != NULL) {
+		chdrv_group_cal_hold(dev_ptr->group);
 		ret_val = (*func_ptr)(dev_ptr, num_samples);
+		chdrv_group_cal_release(dev_ptr->group);
 	}
 
 	return ret_val;
@@ -294,6 +353,19 @@ uint32_t ch_get_range(ch_dev_t *dev_ptr, ch_range_t range_type) {
 	return range;
 }
 
+uint8_t ch_get_result(ch_dev_t *dev_ptr, ch_range_t range_type, ch_result_t *result_ptr, uint8_t options) {
+	uint8_t ret_val = RET_ERR;
+	ch_get_result_func_t func_ptr = dev_ptr->api_funcs.get_result;
+
+	if (func_ptr != NULL) {
+		ret_val = (*func_ptr)(dev_ptr, range_type, result_ptr, options);
+	} else {
+		memset(result_ptr, 0, sizeof(ch_result_t));
+	}
+
+	return ret_val;
+}
+
 uint16_t ch_get_amplitude(ch_dev_t *dev_ptr) {
 	int	amplitude = 0;
 	ch_get_amplitude_func_t func_ptr = dev_ptr->api_funcs.get_amplitude;
@@ -306,8 +378,10 @@ uint16_t ch_get_amplitude(ch_dev_t *dev_ptr) {
 }
 
 uint32_t ch_get_frequency(ch_dev_t *dev_ptr) {
+	ch_cal_result_t cal;
 
-	return dev_ptr->op_frequency;
+	chdrv_cal_get(dev_ptr, &cal);
+	return cal.op_frequency;
 }
 
 uint16_t ch_get_rtc_cal_pulselength(ch_dev_t *dev_ptr) {
@@ -317,8 +391,70 @@ uint16_t ch_get_rtc_cal_pulselength(ch_dev_t *dev_ptr) {
 
 
 uint16_t ch_get_rtc_cal_result(ch_dev_t *dev_ptr) {
+	ch_cal_result_t cal;
+
+	chdrv_cal_get(dev_ptr, &cal);
+	return cal.rtc_cal_result;
+}
+
+uint16_t ch_get_freqlock_time(ch_dev_t *dev_ptr) {
 
-	return dev_ptr->rtc_cal_result;
+	return dev_ptr->freqlock_time_ms;
+}
+
+int32_t ch_get_rtc_cal_drift(ch_dev_t *dev_ptr) {
+
+	return dev_ptr->rtc_cal_drift_ppm;
+}
+
+void ch_group_set_recal_period(ch_group_t *grp_ptr, uint32_t period_ms) {
+
+	chdrv_group_set_recal_period(grp_ptr, period_ms);
+}
+
+uint8_t ch_group_set_temperature(ch_group_t *grp_ptr, int16_t temp_cc, uint8_t humidity_pct) {
+
+	return chdrv_group_set_environment(grp_ptr, temp_cc, humidity_pct);
+}
+
+void ch_group_set_temperature_step(ch_group_t *grp_ptr, uint16_t step_cc) {
+
+	grp_ptr->sos.temp_step_cc = step_cc;
+}
+
+uint32_t ch_group_get_speed_of_sound(ch_group_t *grp_ptr) {
+
+	return chdrv_group_speed_of_sound(grp_ptr);
+}
+
+uint8_t ch_get_boot_profile(ch_dev_t *dev_ptr, ch_boot_profile_t *profile_ptr) {
+#ifdef CHDRV_BOOT_PROFILE
+	profile_ptr->total_us = 0;
+	for (uint8_t phase = 0; phase < CH_BOOT_NUM_PHASES; phase++) {
+		profile_ptr->phase_us[phase] = chbsp_cycles_to_us(dev_ptr->boot_cycles[phase]);
+		profile_ptr->total_us += profile_ptr->phase_us[phase];
+	}
+	return 0;
+#else
+	memset(profile_ptr, 0, sizeof(ch_boot_profile_t));
+	return 1;
+#endif
+}
+
+const char *ch_boot_phase_name(ch_boot_phase_t phase) {
+	static const char *const names[CH_BOOT_NUM_PHASES] = {
+		"reset", "idle", "ping", "ram init", "fw write", "charge pump", "freq lock", "rtc cal"
+	};
+
+	return (phase < CH_BOOT_NUM_PHASES) ? names[phase] : "?";
+}
+
+uint32_t ch_group_get_boot_time(ch_group_t *grp_ptr) {
+#ifdef CHDRV_BOOT_PROFILE
+	return chbsp_cycles_to_us(grp_ptr->boot_cycles);
+#else
+	return 0;
+#endif
 }
 
 
@@ -327,7 +463,13 @@ uint8_t ch_get_iq_data(ch_dev_t *dev_ptr, ch_iq_sample_t *buf_ptr, uint16_t star
 	ch_get_iq_data_func_t func_ptr = dev_ptr->api_funcs.get_iq_data;
 
 	if (func_ptr != NULL) {
-		ret_val = (*func_ptr)(dev_ptr, buf_ptr, start_sample, num_samples, mode);
+		if (mode == CH_IO_MODE_BLOCK) {
+			chdrv_group_cal_hold(dev_ptr->group);		// the read may assert PROG
+			ret_val = (*func_ptr)(dev_ptr, buf_ptr, start_sample, num_samples, mode);
+			chdrv_group_cal_release(dev_ptr->group);
+		} else {
+			ret_val = (*func_ptr)(dev_ptr, buf_ptr, start_sample, num_samples, mode);
+		}
 	}
 
 	return ret_val;
@@ -355,13 +497,50 @@ uint16_t ch_mm_to_samples(ch_dev_t *dev_ptr, uint16_t num_mm) {
 	return num_samples;
 }
 
+uint8_t ch_tof_to_range_bulk(ch_dev_t *dev_ptr, ch_range_t range_type, const uint16_t *tof_ptr, 
+							 uint32_t *range_ptr, uint16_t count) {
+
+	return chdrv_tof_to_range_bulk(dev_ptr, tof_ptr, range_ptr, count, (range_type == CH_RANGE_ECHO_ONE_WAY));
+}
+
+uint8_t ch_samples_to_mm_bulk(ch_dev_t *dev_ptr, const uint16_t *samples_ptr, uint16_t *mm_ptr, uint16_t count) {
+
+	return chdrv_samples_to_mm_bulk(dev_ptr, samples_ptr, mm_ptr, count);
+}
+
+uint32_t ch_get_precise_range(ch_dev_t *dev_ptr, ch_range_t range_type, uint32_t range, const ch_iq_sample_t *iq_ptr, 
+							  uint16_t num_samples) {
+
+	if ((range != CH_NO_TARGET) && (range_type != CH_RANGE_ECHO_ONE_WAY)) {
+		/* Round-trip and direct ranges are twice the one-way distance of the same sample */
+		uint32_t one_way = range / 2;
+		uint32_t refined = chdrv_precise_range(dev_ptr, iq_ptr, num_samples, one_way);
+
+		if (refined != one_way) {
+			range = refined * 2;
+		}
+	} else {
+		range = chdrv_precise_range(dev_ptr, iq_ptr, num_samples, range);
+	}
+	return range;
+}
+
+uint8_t ch_get_targets(ch_dev_t *dev_ptr, ch_range_t range_type, const ch_iq_sample_t *iq_ptr, uint16_t num_samples, 
+					   const ch_thresholds_t *thresh_ptr, ch_target_t *targets_ptr, uint8_t max_targets) {
+
+	return chdrv_find_targets(dev_ptr, iq_ptr, num_samples, thresh_ptr, targets_ptr, max_targets, 
+							  (range_type == CH_RANGE_ECHO_ONE_WAY));
+}
+
 
 uint8_t ch_set_thresholds(ch_dev_t *dev_ptr, ch_thresholds_t *thresh_ptr) {
 	int	ret_val = RET_ERR;
 	ch_set_thresholds_func_t func_ptr = dev_ptr->api_funcs.set_thresholds;
 
 	if ((func_ptr != NULL) && (thresh_ptr != NULL)) {
+		chdrv_group_cal_hold(dev_ptr->group);
 		ret_val = (*func_ptr)(dev_ptr, thresh_ptr);
+		chdrv_group_cal_release(dev_ptr->group);
 		}
 
 	return ret_val;
@@ -435,5 +614,37 @@ void ch_io_notify(ch_group_t *grp_ptr, uint8_t i2c_bus_index) {
 	chdrv_group_i2c_irq_handler(grp_ptr, i2c_bus_index);
 }
 
+void ch_result_callback_set(ch_group_t *grp_ptr, ch_result_callback_t callback_func_ptr) {
+
+	grp_ptr->result_callback = callback_func_ptr;
+}
+
+uint8_t ch_group_get_results_nb(ch_group_t *grp_ptr, ch_range_t range_type, ch_result_t *results_ptr) {
+	uint8_t ret_val = RET_ERR;
+
+	if ((grp_ptr->result_callback != NULL) && (results_ptr != NULL) && 
+		!chdrv_group_results_claim(grp_ptr, results_ptr, (range_type == CH_RANGE_ECHO_ONE_WAY))) {
+
+		ret_val = RET_OK;
+		for (uint8_t dev_num = 0; dev_num < grp_ptr->num_ports; dev_num++) {
+			ch_dev_t *dev_ptr = grp_ptr->device[dev_num];
+			ch_queue_result_func_t func_ptr = dev_ptr->api_funcs.queue_result;
+
+			if (dev_ptr->sensor_connected && (func_ptr != NULL)) {
+				ret_val |= (*func_ptr)(dev_ptr);
+			}
+		}
+
+		if ((ret_val == RET_OK) && (grp_ptr->results_queued != 0)) {
+			chdrv_group_i2c_start_nb(grp_ptr);
+		} else {
+			chdrv_group_results_release(grp_ptr);
+			ret_val = RET_ERR;
+		}
+	}
+
+	return ret_val;
+}
+
 
 
@@ -52,35 +52,51 @@ uint8_t ch_common_set_mode(ch_dev_t *dev_ptr, ch_mode_t mode) {
 	}
 
 	if (dev_ptr->sensor_connected) {
+		chdrv_batch_t batch;
+
+		chdrv_batch_init(&batch, dev_ptr);
+
 		switch (mode) {
 			case CH_MODE_IDLE:
-				chdrv_write_byte(dev_ptr, opmode_reg, CH_MODE_IDLE);
-				chdrv_write_byte(dev_ptr, period_reg, 0);
-				chdrv_write_word(dev_ptr, tick_interval_reg, 2048);		// XXX need define
+				chdrv_batch_write_byte(&batch, opmode_reg, CH_MODE_IDLE);
+				chdrv_batch_write_byte(&batch, period_reg, 0);
+				chdrv_batch_write_word(&batch, tick_interval_reg, 2048);		// XXX need define
 				break;
 
 			case CH_MODE_FREERUN:
-				chdrv_write_byte(dev_ptr, opmode_reg, CH_MODE_FREERUN);
+				chdrv_batch_write_byte(&batch, opmode_reg, CH_MODE_FREERUN);
 					// XXX need to set period / tick interval (?)
 				break;
 
 			case CH_MODE_TRIGGERED_TX_RX:
-				chdrv_write_byte(dev_ptr, opmode_reg, CH_MODE_TRIGGERED_TX_RX);
+				chdrv_batch_write_byte(&batch, opmode_reg, CH_MODE_TRIGGERED_TX_RX);
 				break;
 
 			case CH_MODE_TRIGGERED_RX_ONLY:
-				chdrv_write_byte(dev_ptr, opmode_reg, CH_MODE_TRIGGERED_RX_ONLY);
+				chdrv_batch_write_byte(&batch, opmode_reg, CH_MODE_TRIGGERED_RX_ONLY);
 				break;
 
 			default:
 				ret_val = RET_ERR;				// return non-zero to indicate error
 				break;
 		}
+
+		if (!ret_val) {
+			ret_val = chdrv_batch_flush(&batch);
+		}
 	}
 
 	return ret_val;
 }
 
+/* Write one decoded chunk of a compressed firmware image to program memory */
+static int ch_common_fw_write_chunk(void *context, uint16_t offset, const uint8_t *data, uint16_t nbytes) {
+	ch_dev_t *dev_ptr = (ch_dev_t *) context;
+	uint16_t prog_mem_addr = (dev_ptr->part_number == CH101_PART_NUMBER) ? CH101_PROG_MEM_ADDR : CH201_PROG_MEM_ADDR;
+
+	return chdrv_prog_mem_write(dev_ptr, (prog_mem_addr + offset), (uint8_t *) data, nbytes);
+}
+
 uint8_t ch_common_fw_load(ch_dev_t *dev_ptr) {
 	uint8_t	ch_err = 0;
 	uint16_t prog_mem_addr;
@@ -94,7 +110,12 @@ uint8_t ch_common_fw_load(ch_dev_t *dev_ptr) {
 		fw_size 	  = CH201_FW_SIZE;
 	}
 
-	ch_err = chdrv_prog_mem_write(dev_ptr, prog_mem_addr, (uint8_t *) dev_ptr->firmware, fw_size);
+	if (dev_ptr->fw_lz_size != 0) {
+		/* Compressed image: decoded chunk by chunk, each written as it is complete */
+		ch_err = (chdrv_fw_unpack(dev_ptr, ch_common_fw_write_chunk, dev_ptr) != 0);
+	} else {
+		ch_err = chdrv_prog_mem_write(dev_ptr, prog_mem_addr, (uint8_t *) dev_ptr->firmware, fw_size);
+	}
 	return ch_err;
 }
 
@@ -113,7 +134,11 @@ uint8_t ch_common_set_sample_interval(ch_dev_t *dev_ptr, uint16_t interval_ms) {
 	}
 
 	if (dev_ptr->sensor_connected) {
-		uint32_t sample_interval = dev_ptr->rtc_cal_result * interval_ms / dev_ptr->group->rtc_cal_pulse_ms;
+		ch_cal_result_t cal;
+
+		chdrv_cal_get(dev_ptr, &cal);
+
+		uint32_t sample_interval = cal.rtc_cal_result * interval_ms / dev_ptr->group->rtc_cal_pulse_ms;
 		uint32_t period = (sample_interval / 2048) + 1;				// XXX need define
 
 		if (period > UINT8_MAX) {		/* check if result fits in register */
@@ -129,8 +154,12 @@ uint8_t ch_common_set_sample_interval(ch_dev_t *dev_ptr, uint16_t interval_ms) {
 			chbsp_print_str(cbuf);
 #endif
 
-			chdrv_write_byte(dev_ptr, period_reg, (uint8_t) period);
-			chdrv_write_word(dev_ptr, tick_interval_reg, (uint16_t) tick_interval);
+			chdrv_batch_t batch;
+
+			chdrv_batch_init(&batch, dev_ptr);
+			chdrv_batch_write_byte(&batch, period_reg, (uint8_t) period);
+			chdrv_batch_write_word(&batch, tick_interval_reg, (uint16_t) tick_interval);
+			ret_val = chdrv_batch_flush(&batch);				// both registers in one transaction
 		}
 	}
 
@@ -201,9 +230,11 @@ uint8_t ch_common_set_max_range(ch_dev_t *dev_ptr, uint16_t max_range_mm) {
 uint16_t ch_common_mm_to_samples(ch_dev_t *dev_ptr, uint16_t num_mm) {
 	uint8_t err;
 	uint16_t scale_factor;
+	ch_cal_result_t cal;
 	uint32_t num_samples = 0;
 	uint32_t divisor1;
-	uint32_t divisor2 = (dev_ptr->group->rtc_cal_pulse_ms * CH_SPEEDOFSOUND_MPS);
+	uint32_t divisor2 = (uint32_t) ((((uint64_t) dev_ptr->group->rtc_cal_pulse_ms * 
+									  chdrv_group_speed_of_sound(dev_ptr->group)) + 500) / 1000);
 
 	err = (!dev_ptr) || (!dev_ptr->sensor_connected);
 
@@ -214,17 +245,18 @@ uint16_t ch_common_mm_to_samples(ch_dev_t *dev_ptr, uint16_t num_mm) {
 			divisor1 = 0x4000;			// (4*16*128*2)  XXX need define(s)
 		}
 
-		if (dev_ptr->scale_factor == 0) {
-			ch_common_store_scale_factor(dev_ptr);
+		chdrv_cal_get(dev_ptr, &cal);
+		if (cal.scale_factor == 0) {
+			ch_common_store_scale_factor(dev_ptr, &cal);
+			chdrv_cal_apply(dev_ptr, &cal);
 		}
-
-		scale_factor = dev_ptr->scale_factor;
+		scale_factor = cal.scale_factor;
 	}
 
 	if (!err) {
 		// Two steps of division to avoid needing a type larger than 32 bits
 		// Ceiling division to ensure result is at least enough samples to meet specified range
-		num_samples = ((dev_ptr->rtc_cal_result * scale_factor) + (divisor1 - 1)) / divisor1;
+		num_samples = ((cal.rtc_cal_result * scale_factor) + (divisor1 - 1)) / divisor1;
 		num_samples = ((num_samples * num_mm) + (divisor2 - 1)) / divisor2;
 		err = num_samples > UINT16_MAX;
 	}
@@ -246,17 +278,12 @@ uint16_t ch_common_mm_to_samples(ch_dev_t *dev_ptr, uint16_t num_mm) {
 
 
 uint16_t ch_common_samples_to_mm(ch_dev_t *dev_ptr, uint16_t num_samples) {
-	uint32_t	num_mm = 0;
-	uint32_t	op_freq = dev_ptr->op_frequency;
-
-	if (op_freq != 0) {
-		num_mm = ((uint32_t) num_samples * CH_SPEEDOFSOUND_MPS * 8 * 1000) / (op_freq * 2);
-	}
+	uint16_t	num_mm = 0;
 
-	/* Adjust for oversampling, if used */
-	num_mm >>= dev_ptr->oversample;
+	/* Precomputed from the operating frequency, oversampling included (see chdrv_range_prepare()) */
+	chdrv_samples_to_mm_bulk(dev_ptr, &num_samples, &num_mm, 1);
 
-	return (uint16_t) num_mm;
+	return num_mm;
 }
 
 
@@ -266,12 +293,12 @@ uint8_t ch_common_set_static_range(ch_dev_t *dev_ptr, uint16_t samples) {
 
 	if (dev_ptr->part_number == CH101_PART_NUMBER) {			// CH101 only
 		if (dev_ptr->sensor_connected) {
-			ret_val = chdrv_write_byte(dev_ptr, CH101_COMMON_REG_STAT_RANGE, samples);
+			chdrv_batch_t batch;
 
-			if (!ret_val) {
-				ret_val = chdrv_write_byte(dev_ptr, CH101_COMMON_REG_STAT_COEFF, 
-						                   CH101_COMMON_STAT_COEFF_DEFAULT);
-			}
+			chdrv_batch_init(&batch, dev_ptr);
+			chdrv_batch_write_byte(&batch, CH101_COMMON_REG_STAT_RANGE, samples);
+			chdrv_batch_write_byte(&batch, CH101_COMMON_REG_STAT_COEFF, CH101_COMMON_STAT_COEFF_DEFAULT);
+			ret_val = chdrv_batch_flush(&batch);				// adjacent registers, one transaction
 
 			if (!ret_val) {
 				dev_ptr->static_range = samples;
@@ -281,11 +308,28 @@ uint8_t ch_common_set_static_range(ch_dev_t *dev_ptr, uint16_t samples) {
 	return ret_val;
 }
 
+/*
+ * Range conversion constants of a sensor, computed on first use if the sensor was not calibrated 
+ * through chdrv_group_start() (tof_mult still 0 if it cannot be calibrated).
+ */
+static void ch_common_range_conv(ch_dev_t *dev_ptr, chdrv_range_conv_t *conv_ptr) {
+
+	chdrv_range_conv_get(dev_ptr, conv_ptr);
+	if (conv_ptr->tof_mult == 0) {					// not calibrated yet
+		ch_cal_result_t cal;
+
+		chdrv_cal_get(dev_ptr, &cal);
+		ch_common_store_scale_factor(dev_ptr, &cal);
+		chdrv_cal_apply(dev_ptr, &cal);				// also prepares the range conversion
+		chdrv_range_conv_get(dev_ptr, conv_ptr);
+	}
+}
+
 uint32_t ch_common_get_range(ch_dev_t *dev_ptr, ch_range_t range_type) {
 	uint8_t		tof_reg;
 	uint32_t	range = CH_NO_TARGET;
 	uint16_t 	time_of_flight;
-	uint16_t 	scale_factor;
+	chdrv_range_conv_t conv;
 	int 		err;
 
 	if (dev_ptr->sensor_connected) {
@@ -300,28 +344,16 @@ uint32_t ch_common_get_range(ch_dev_t *dev_ptr, ch_range_t range_type) {
 
 		if (!err && (time_of_flight != UINT16_MAX)) { // If object detected
 
-			if (dev_ptr->scale_factor == 0) {
-				ch_common_store_scale_factor(dev_ptr);
-			}
-			scale_factor = dev_ptr->scale_factor;
-
-			if (scale_factor != 0) {
-				uint32_t num = (CH_SPEEDOFSOUND_MPS * dev_ptr->group->rtc_cal_pulse_ms * (uint32_t) time_of_flight);
-				uint32_t den = ((uint32_t) dev_ptr->rtc_cal_result * (uint32_t) scale_factor) >> 11;		// XXX need define
+			ch_common_range_conv(dev_ptr, &conv);
 
-				range = (num / den);
-
-				if (dev_ptr->part_number == CH201_PART_NUMBER) {
-					range *= 2;
-				}
+			if (conv.tof_mult != 0) {
+				/* Multiplier from the calibration, CH201 TOF encoding and oversampling included (see chdrv_range_prepare()) */
+				uint8_t shift = conv.tof_shift;
 
 				if (range_type == CH_RANGE_ECHO_ONE_WAY) {
-					range /= 2;
+					shift++;							// half of the round trip
 				}
-
-				/* Adjust for oversampling, if used */
-				range >>= dev_ptr->oversample;
-
+				range = CHDRV_RANGE_MUL(time_of_flight, conv.tof_mult, shift);
 			}
 		}
 	}
@@ -347,6 +379,91 @@ uint16_t ch_common_get_amplitude(ch_dev_t *dev_ptr) {
 }
 
 
+uint8_t ch_common_get_result(ch_dev_t *dev_ptr, ch_range_t range_type, ch_result_t *result_ptr, uint8_t options) {
+	uint16_t	regs[3];				// TOF_SF, TOF, AMPLITUDE: adjacent in every firmware
+	uint8_t		first_reg;
+	uint8_t		first_idx;
+	uint16_t 	time_of_flight;
+	chdrv_range_conv_t conv;
+	int 		err = !dev_ptr->sensor_connected;
+
+	result_ptr->range = 0;
+	result_ptr->amplitude = 0;
+	result_ptr->tof_sf = 0;
+
+	if (!err) {
+		if (dev_ptr->part_number == CH101_PART_NUMBER) {
+			first_reg = CH101_COMMON_REG_TOF_SF;
+		} else {
+			first_reg = CH201_COMMON_REG_TOF_SF;
+		}
+		first_idx = (options & CH_RESULT_READ_TOF_SF) ? 0 : 1;
+
+		err = chdrv_burst_read(dev_ptr, first_reg + (2 * first_idx), (uint8_t *) &regs[first_idx], 
+							   (3 - first_idx) * sizeof(uint16_t));
+	}
+
+	if (!err) {
+		time_of_flight = regs[1];
+		if (options & CH_RESULT_READ_TOF_SF) {
+			result_ptr->tof_sf = regs[0];
+		}
+
+		if (time_of_flight == UINT16_MAX) {			// no target detected
+			result_ptr->range = CH_NO_TARGET;
+		} else {
+			ch_common_range_conv(dev_ptr, &conv);
+			err = (conv.tof_mult == 0);
+		}
+	}
+
+	if (!err && (result_ptr->range != CH_NO_TARGET)) {
+		if ((options & CH_RESULT_READ_TOF_SF) && (regs[0] != dev_ptr->scale_factor)) {
+			/* Scale factor moved since the calibration, convert with the one of this measurement */
+			result_ptr->range = chdrv_one_way_range(dev_ptr, time_of_flight, regs[0]);
+			if (range_type != CH_RANGE_ECHO_ONE_WAY) {
+				result_ptr->range *= 2;
+			}
+		} else {
+			uint8_t shift = conv.tof_shift;
+
+			if (range_type == CH_RANGE_ECHO_ONE_WAY) {
+				shift++;								// half of the round trip
+			}
+			result_ptr->range = CHDRV_RANGE_MUL(time_of_flight, conv.tof_mult, shift);
+		}
+		result_ptr->amplitude = regs[2];
+	}
+
+	if (err) {
+		result_ptr->range = CH_NO_TARGET;		// not a target at 0 mm
+	}
+
+	return err ? RET_ERR : RET_OK;
+}
+
+
+uint8_t ch_common_queue_result(ch_dev_t *dev_ptr) {
+	ch_group_t *grp_ptr = dev_ptr->group;
+	uint8_t	tof_reg;
+	int 	err;
+
+	if (dev_ptr->part_number == CH101_PART_NUMBER) {
+		tof_reg = CH101_COMMON_REG_TOF;
+	} else {
+		tof_reg = CH201_COMMON_REG_TOF;
+	}
+
+	/* TOF and AMPLITUDE in one read, converted when the group readout completes */
+	err = chdrv_group_i2c_queue(grp_ptr, dev_ptr, 1, CHDRV_NB_TRANS_TYPE_RESULT, tof_reg, 
+								sizeof(dev_ptr->result_regs), (uint8_t *) dev_ptr->result_regs);
+	if (!err) {
+		grp_ptr->results_queued |= (1UL << dev_ptr->io_index);
+	}
+	return err;
+}
+
+
 uint8_t ch_common_get_locked_state(ch_dev_t *dev_ptr) {
 	uint8_t ready_reg;
 	uint8_t lock_mask;
@@ -382,7 +499,7 @@ void ch_common_prepare_pulse_timer(ch_dev_t *dev_ptr) {
 	chdrv_write_byte(dev_ptr, cal_trig_reg, 0);
 }
 
-void ch_common_store_pt_result(ch_dev_t *dev_ptr) {
+void ch_common_store_pt_result(ch_dev_t *dev_ptr, ch_cal_result_t *cal_ptr) {
 	uint8_t pt_result_reg;
 	uint16_t rtc_cal_result;
 
@@ -393,10 +510,10 @@ void ch_common_store_pt_result(ch_dev_t *dev_ptr) {
 	}
 
 	chdrv_read_word(dev_ptr, pt_result_reg, &rtc_cal_result);
-	dev_ptr->rtc_cal_result = rtc_cal_result;
+	cal_ptr->rtc_cal_result = rtc_cal_result;
 }
 
-void ch_common_store_op_freq(ch_dev_t *dev_ptr){
+void ch_common_store_op_freq(ch_dev_t *dev_ptr, ch_cal_result_t *cal_ptr){
 	uint8_t	 tof_sf_reg;
 	uint16_t raw_freq;		// aka scale factor
 	uint32_t freq_counter_cycles;
@@ -414,21 +531,21 @@ void ch_common_store_op_freq(ch_dev_t *dev_ptr){
 
 	chdrv_read_word(dev_ptr, tof_sf_reg, &raw_freq);
 
-	num = (uint32_t)(((dev_ptr->rtc_cal_result)*1000U) / (16U * freq_counter_cycles)) * (uint32_t)(raw_freq);
+	num = (uint32_t)(((cal_ptr->rtc_cal_result)*1000U) / (16U * freq_counter_cycles)) * (uint32_t)(raw_freq);
 	den = (uint32_t)(dev_ptr->group->rtc_cal_pulse_ms);
 	op_freq = (num/den);
 
-	dev_ptr->op_frequency = op_freq;
+	cal_ptr->op_frequency = op_freq;
 }
 
 
-void ch_common_store_bandwidth(ch_dev_t *dev_ptr) {
+void ch_common_store_bandwidth(ch_dev_t *dev_ptr, ch_cal_result_t *cal_ptr) {
 /*
  * Not supported in current GPR firmware
  */
 }
 
-void ch_common_store_scale_factor(ch_dev_t *dev_ptr) {
+void ch_common_store_scale_factor(ch_dev_t *dev_ptr, ch_cal_result_t *cal_ptr) {
 	uint8_t	err;
 	uint8_t	tof_sf_reg;
 	uint16_t scale_factor;
@@ -441,9 +558,9 @@ void ch_common_store_scale_factor(ch_dev_t *dev_ptr) {
 
 	err = chdrv_read_word(dev_ptr, tof_sf_reg, &scale_factor);
 	if (!err) {
-		dev_ptr->scale_factor = scale_factor;
+		cal_ptr->scale_factor = scale_factor;
 	} else {
-		dev_ptr->scale_factor = 0;
+		cal_ptr->scale_factor = 0;
 	}
 }
 
@@ -458,6 +575,7 @@ uint8_t ch_common_set_thresholds(ch_dev_t *dev_ptr, ch_thresholds_t *thresholds_
 	uint8_t thresh_len;
 	uint16_t thresh_level;
 	uint16_t start_sample = 0;
+	chdrv_batch_t batch;
 
 	if (dev_ptr->sensor_connected) {
 		
@@ -469,6 +587,8 @@ uint8_t ch_common_set_thresholds(ch_dev_t *dev_ptr, ch_thresholds_t *thresholds_
 			max_num_thresholds = CH201_COMMON_NUM_THRESHOLDS;
 		}
 
+		chdrv_batch_init(&batch, dev_ptr);
+
 		for (thresh_num = 0; thresh_num < max_num_thresholds; thresh_num++) {
 
 			if (thresh_num < (max_num_thresholds - 1)) {
@@ -497,14 +617,15 @@ uint8_t ch_common_set_thresholds(ch_dev_t *dev_ptr, ch_thresholds_t *thresholds_
 			}
 
 			if (thresh_len_reg != 0) {
-				chdrv_write_byte(dev_ptr, thresh_len_reg, thresh_len); 	// set the length field (if any) for this threshold
+				chdrv_batch_write_byte(&batch, thresh_len_reg, thresh_len); 	// set the length field (if any) for this threshold
 			}
 			// write level to this threshold's entry in register array
 			thresh_level = thresholds_ptr->threshold[thresh_num].level;
-			chdrv_write_word(dev_ptr, (thresh_level_reg + (thresh_num * sizeof(uint16_t))), thresh_level);
+			chdrv_batch_write_word(&batch, (thresh_level_reg + (thresh_num * sizeof(uint16_t))), thresh_level);
 		}
 
-		ret_val = 0;	// return OK
+		/* Lengths 0-1, lengths 2-3, and length 4 + level array each go out as one burst */
+		ret_val = chdrv_batch_flush(&batch);
 	}
 	return ret_val;
 }
@@ -29,6 +29,134 @@
 #include "soniclib.h"
 #include "chirp_bsp.h"
 #include "ch_driver.h"
+#include "ch101.h"
+#include "ch201.h"
+
+static void chdrv_group_retain(ch_group_t *grp_ptr);
+
+
+/*
+ * Configuration register cache helpers.  A read or a redundant write is only served from
+ * the cache when every byte of the range is a cacheable register with a known value, so
+ * status and measurement registers always go to the sensor.  When CHDRV_REG_CACHE is not
+ * defined the helpers do nothing and every access reaches the sensor.
+ */
+static uint8_t chdrv_reg_cache_covers(ch_dev_t *dev_ptr, uint16_t mem_addr, uint16_t num_bytes) {
+#ifdef CHDRV_REG_CACHE
+	uint64_t mask;
+
+	if ((num_bytes == 0) || ((mem_addr + num_bytes) > CHDRV_REG_CACHE_SIZE)) {
+		return 0;
+	}
+	mask = (num_bytes == CHDRV_REG_CACHE_SIZE) ? UINT64_MAX : CHDRV_REG_MASK(mem_addr, num_bytes);
+
+	return (((dev_ptr->reg_cache_mask & dev_ptr->reg_cache_valid) & mask) == mask);
+#else
+	return 0;
+#endif
+}
+
+static uint8_t chdrv_reg_cache_read(ch_dev_t *dev_ptr, uint16_t mem_addr, uint8_t *data, uint16_t num_bytes) {
+#ifdef CHDRV_REG_CACHE
+	if (chdrv_reg_cache_covers(dev_ptr, mem_addr, num_bytes)) {
+		memcpy(data, &(dev_ptr->reg_cache[mem_addr]), num_bytes);
+		return 1;
+	}
+#endif
+	return 0;
+}
+
+static uint8_t chdrv_reg_cache_unchanged(ch_dev_t *dev_ptr, uint16_t mem_addr, const uint8_t *data, 
+										 uint16_t num_bytes) {
+#ifdef CHDRV_REG_CACHE
+	return (chdrv_reg_cache_covers(dev_ptr, mem_addr, num_bytes) && 
+			(memcmp(&(dev_ptr->reg_cache[mem_addr]), data, num_bytes) == 0));
+#else
+	return 0;
+#endif
+}
+
+// Record register bytes just written to or read from the sensor
+static void chdrv_reg_cache_store(ch_dev_t *dev_ptr, uint16_t mem_addr, const uint8_t *data, uint16_t num_bytes) {
+#ifdef CHDRV_REG_CACHE
+	for (uint16_t i = 0; (i < num_bytes) && ((mem_addr + i) < CHDRV_REG_CACHE_SIZE); i++) {
+		uint64_t bit = ((uint64_t) 1 << (mem_addr + i));
+
+		if (dev_ptr->reg_cache_mask & bit) {
+			dev_ptr->reg_cache[mem_addr + i] = data[i];
+			dev_ptr->reg_cache_valid |= bit;
+		}
+	}
+#endif
+}
+
+/*!
+ * \brief Discard the cached copy of a sensor's configuration registers.
+ *
+ * \param dev_ptr 	pointer to the ch_dev_t config structure for a sensor
+ */
+void chdrv_reg_cache_invalidate(ch_dev_t *dev_ptr) {
+#ifdef CHDRV_REG_CACHE
+	dev_ptr->reg_cache_valid = 0;
+#endif
+}
+
+/*
+ * Start-up phase timing helpers (see ch_get_boot_profile()).  Times are kept in cycles of 
+ * chbsp_cycle_count() and only converted when read.  When CHDRV_BOOT_PROFILE is not defined the 
+ * helpers do nothing.
+ */
+#define CHDRV_PROFILE_ALL_BUSES		(0xFF)
+
+static uint32_t chdrv_profile_now(void) {
+#ifdef CHDRV_BOOT_PROFILE
+	return chbsp_cycle_count();
+#else
+	return 0;
+#endif
+}
+
+static uint32_t chdrv_profile_get(ch_dev_t *dev_ptr, ch_boot_phase_t phase) {
+#ifdef CHDRV_BOOT_PROFILE
+	return dev_ptr->boot_cycles[phase];
+#else
+	return 0;
+#endif
+}
+
+// Add the time between two counter values to a phase of a sensor
+static void chdrv_profile_add(ch_dev_t *dev_ptr, ch_boot_phase_t phase, uint32_t start, uint32_t end) {
+#ifdef CHDRV_BOOT_PROFILE
+	dev_ptr->boot_cycles[phase] += (end - start);
+#endif
+}
+
+// Same for every port on an I2C bus (CHDRV_PROFILE_ALL_BUSES for every port of the group)
+static void chdrv_group_profile_add(ch_group_t *grp_ptr, uint8_t bus_index, ch_boot_phase_t phase, 
+									uint32_t start, uint32_t end) {
+#ifdef CHDRV_BOOT_PROFILE
+	for (uint8_t i = 0; i < grp_ptr->num_ports; i++) {
+		if ((bus_index == CHDRV_PROFILE_ALL_BUSES) || (grp_ptr->device[i]->i2c_bus_index == bus_index)) {
+			chdrv_profile_add(grp_ptr->device[i], phase, start, end);
+		}
+	}
+#endif
+}
+
+static void chdrv_group_profile_clear(ch_group_t *grp_ptr) {
+#ifdef CHDRV_BOOT_PROFILE
+	for (uint8_t i = 0; i < grp_ptr->num_ports; i++) {
+		memset(grp_ptr->device[i]->boot_cycles, 0, sizeof(grp_ptr->device[i]->boot_cycles));
+	}
+	grp_ptr->boot_cycles = 0;
+#endif
+}
+
+static void chdrv_group_profile_end(ch_group_t *grp_ptr, uint32_t start) {
+#ifdef CHDRV_BOOT_PROFILE
+	grp_ptr->boot_cycles = chdrv_profile_now() - start;
+#endif
+}
 
 
 /*!
@@ -108,8 +236,15 @@ int chdrv_prog_i2c_read_nb(ch_dev_t *dev_ptr, uint8_t *message, uint16_t len) {
 int chdrv_write_byte(ch_dev_t *dev_ptr, uint16_t mem_addr, uint8_t data_value) {
 	uint8_t message[] = { sizeof(data_value), data_value };		// insert byte count (1) at start of data
 
+	if (chdrv_reg_cache_unchanged(dev_ptr, mem_addr, &data_value, 1)) {
+		return 0;												// sensor already holds this value
+	}
+
 	int ch_err = chbsp_i2c_mem_write(dev_ptr, mem_addr, message, sizeof(message));
 
+	if (!ch_err) {
+		chdrv_reg_cache_store(dev_ptr, mem_addr, &data_value, 1);
+	}
 	return ch_err;
 }
 
@@ -125,13 +260,107 @@ int chdrv_write_byte(ch_dev_t *dev_ptr, uint16_t mem_addr, uint8_t data_value) {
  */
 int chdrv_burst_write(ch_dev_t *dev_ptr, uint16_t mem_addr, uint8_t *data, uint8_t len){
 
-	uint8_t message[CHDRV_I2C_MAX_WRITE_BYTES + 1];
-	message[0] = (uint8_t) mem_addr;
-	message[1] = len;
-	memcpy(&(message[2]), data, len);
+	/* Register address and byte count precede the data in the same transaction */
+	uint8_t header[] = { (uint8_t) mem_addr, len };
+
+	if (chdrv_reg_cache_unchanged(dev_ptr, mem_addr, data, len)) {
+		return 0;
+	}
+
+	int ch_err = chbsp_i2c_write_hdr(dev_ptr, header, sizeof(header), data, len);
+
+	if (!ch_err) {
+		chdrv_reg_cache_store(dev_ptr, mem_addr, data, len);
+	}
+	return ch_err;
+}
+
+/*!
+ * \brief Start a register write batch for a sensor.
+ *
+ * \param batch_ptr 	pointer to the chdrv_batch_t structure to initialize
+ * \param dev_ptr 		pointer to the ch_dev_t config structure for a sensor
+ */
+void chdrv_batch_init(chdrv_batch_t *batch_ptr, ch_dev_t *dev_ptr) {
+
+	batch_ptr->dev_ptr = dev_ptr;
+	batch_ptr->dirty = 0;
+}
+
+/*!
+ * \brief Add a byte write to a register write batch.
+ *
+ * \param batch_ptr 	pointer to the chdrv_batch_t structure
+ * \param reg_addr 		sensor register address
+ * \param data 			data value to write
+ *
+ * \return 0 if successful, non-zero if the register is outside the batch register space
+ */
+int chdrv_batch_write_byte(chdrv_batch_t *batch_ptr, uint16_t reg_addr, uint8_t data) {
+
+	if (reg_addr >= CHDRV_BATCH_REG_SPACE) {
+		return 1;
+	}
+
+	batch_ptr->data[reg_addr] = data;
+	batch_ptr->dirty |= ((uint64_t) 1 << reg_addr);
+
+	return 0;
+}
+
+/*!
+ * \brief Add a 16-bit write to a register write batch.
+ *
+ * \param batch_ptr 	pointer to the chdrv_batch_t structure
+ * \param reg_addr 		sensor register address
+ * \param data 			data value to write
+ *
+ * \return 0 if successful, non-zero if the register is outside the batch register space
+ */
+int chdrv_batch_write_word(chdrv_batch_t *batch_ptr, uint16_t reg_addr, uint16_t data) {
+
+	// Sensor is little-endian, so LSB goes in at the lower address
+	return (chdrv_batch_write_byte(batch_ptr, reg_addr, (uint8_t) data) ||
+			chdrv_batch_write_byte(batch_ptr, (reg_addr + 1), (uint8_t) (data >> 8)));
+}
+
+/*!
+ * \brief Write all batched registers to the sensor.
+ *
+ * \param batch_ptr 	pointer to the chdrv_batch_t structure
+ *
+ * \return 0 if successful, non-zero otherwise
+ *
+ * Each run of contiguous batched registers goes out as a single burst write.  Registers at
+ * either end of a run that already hold the batched value (per the register cache) are
+ * trimmed and runs that are unchanged as a whole are skipped.  Unchanged registers inside 
+ * a run are rewritten, which costs less than starting a new transaction.
+ */
+int chdrv_batch_flush(chdrv_batch_t *batch_ptr) {
+	uint64_t dirty = batch_ptr->dirty;
+	uint8_t  start;
+	uint8_t  end;
+	int ch_err = 0;
 
-	int ch_err = chbsp_i2c_write(dev_ptr, message, len+2);
+	while ((dirty != 0) && !ch_err) {
+		start = (uint8_t) __builtin_ctzll(dirty);					// first batched register
+		end = start;
+		while ((end < CHDRV_BATCH_REG_SPACE) && (dirty & ((uint64_t) 1 << end))) {
+			dirty &= ~((uint64_t) 1 << end);
+			end++;
+		}
+		while ((start < end) && chdrv_reg_cache_unchanged(batch_ptr->dev_ptr, start, &(batch_ptr->data[start]), 1)) {
+			start++;
+		}
+		while ((end > start) && chdrv_reg_cache_unchanged(batch_ptr->dev_ptr, (end - 1), &(batch_ptr->data[end - 1]), 1)) {
+			end--;
+		}
+		if (start < end) {
+			ch_err = chdrv_burst_write(batch_ptr->dev_ptr, start, &(batch_ptr->data[start]), (end - start));
+		}
+	}
 
+	batch_ptr->dirty = 0;
 	return ch_err;
 }
 
@@ -151,8 +380,15 @@ int chdrv_write_word(ch_dev_t *dev_ptr, uint16_t mem_addr, uint16_t data_value)
 	// Sensor is little-endian, so LSB goes in at the lower address
 	uint8_t message[] = { sizeof(data_value), (uint8_t) data_value, (uint8_t) (data_value >> 8) }; 
 
+	if (chdrv_reg_cache_unchanged(dev_ptr, mem_addr, &message[1], sizeof(data_value))) {
+		return 0;
+	}
+
 	int ch_err = chbsp_i2c_mem_write(dev_ptr, mem_addr, message, sizeof(message));
 
+	if (!ch_err) {
+		chdrv_reg_cache_store(dev_ptr, mem_addr, &message[1], sizeof(data_value));
+	}
 	return ch_err;
 }
 
@@ -167,7 +403,7 @@ int chdrv_write_word(ch_dev_t *dev_ptr, uint16_t mem_addr, uint16_t data_value)
  */
 int chdrv_read_byte(ch_dev_t *dev_ptr, uint16_t mem_addr, uint8_t *data) {
 
-	return (chbsp_i2c_mem_read(dev_ptr, mem_addr, data, 1));
+	return chdrv_burst_read(dev_ptr, mem_addr, data, 1);
 }
 
 /*!
@@ -182,7 +418,16 @@ int chdrv_read_byte(ch_dev_t *dev_ptr, uint16_t mem_addr, uint8_t *data) {
  */
 int chdrv_burst_read(ch_dev_t *dev_ptr, uint16_t mem_addr, uint8_t *data, uint16_t num_bytes) {
 
-	return (chbsp_i2c_mem_read(dev_ptr, mem_addr, data, num_bytes));
+	if (chdrv_reg_cache_read(dev_ptr, mem_addr, data, num_bytes)) {
+		return 0;
+	}
+
+	int ch_err = chbsp_i2c_mem_read(dev_ptr, mem_addr, data, num_bytes);
+
+	if (!ch_err) {
+		chdrv_reg_cache_store(dev_ptr, mem_addr, data, num_bytes);
+	}
+	return ch_err;
 }
 
 /*!
@@ -196,7 +441,7 @@ int chdrv_burst_read(ch_dev_t *dev_ptr, uint16_t mem_addr, uint8_t *data, uint16
  */
 int chdrv_read_word(ch_dev_t *dev_ptr, uint16_t mem_addr, uint16_t * data) {
 	//
-	return (chbsp_i2c_mem_read(dev_ptr, mem_addr, (uint8_t *) data, 2));
+	return chdrv_burst_read(dev_ptr, mem_addr, (uint8_t *) data, 2);
 }
 
 /*!
@@ -241,726 +486,2193 @@ void chdrv_group_measure_rtc(ch_group_t *grp_ptr) {
 	chbsp_delay_ms(1);
 
 	for (i = 0; i < grp_ptr->num_ports; i++) {
-		if (grp_ptr->device[i]->sensor_connected) {
-			grp_ptr->device[i]->store_pt_result(grp_ptr->device[i]);
-			grp_ptr->device[i]->store_op_freq(grp_ptr->device[i]);
-			grp_ptr->device[i]->store_bandwidth(grp_ptr->device[i]);
-			grp_ptr->device[i]->store_scalefactor(grp_ptr->device[i]);
+		ch_dev_t *dev_ptr = grp_ptr->device[i];
+
+		if (dev_ptr->sensor_connected) {
+			ch_cal_result_t cal;
+
+			chdrv_cal_get(dev_ptr, &cal);
+			dev_ptr->store_pt_result(dev_ptr, &cal);
+			dev_ptr->store_op_freq(dev_ptr, &cal);
+			dev_ptr->store_bandwidth(dev_ptr, &cal);
+			dev_ptr->store_scalefactor(dev_ptr, &cal);
+			chdrv_cal_apply(dev_ptr, &cal);
 		}
 	}
 }
 
-/*!
- * \brief Convert register values to a range using the calibration data.
- *
- * \param dev_ptr 	pointer to the ch_dev_t config structure for a sensor
- * \param tof 		value of sensor TOF register
- * \param tof_sf 	value of sensor TOF_SF register
- *
- * \return range in millimeters, or \a CH_NO_TARGET (0xFFFFFFFF) if no object is detected.  
- *
- * The range result format is fixed point with 5 binary fractional digits (divide by 32 to 
- * convert to mm).
- *
- * This function takes the time-of-flight and scale factor values from the sensor,
- * and computes the actual one-way range based on the formulas given in the sensor 
- * datasheet.
- */
-uint32_t chdrv_one_way_range(ch_dev_t *dev_ptr, uint16_t tof, uint16_t tof_sf) {
-	uint32_t num = (CH_SPEEDOFSOUND_MPS * dev_ptr->group->rtc_cal_pulse_ms * (uint32_t) tof);
-	uint32_t den = ((uint32_t) dev_ptr->rtc_cal_result * (uint32_t) tof_sf) >> 10;
-	uint32_t range = (num / den);
+void chdrv_cal_get(ch_dev_t *dev_ptr, ch_cal_result_t *cal_ptr) {
+	uint32_t key = chbsp_critical_enter();
 
-	if (tof == UINT16_MAX) {
-		return CH_NO_TARGET;
-	}
+	cal_ptr->rtc_cal_result = dev_ptr->rtc_cal_result;
+	cal_ptr->op_frequency   = dev_ptr->op_frequency;
+	cal_ptr->bandwidth      = dev_ptr->bandwidth;
+	cal_ptr->scale_factor   = dev_ptr->scale_factor;
 
-	if (dev_ptr->part_number == 201) {
-		range *= 2;				// CH-201 range (TOF) encoding is 1/2 of CH-101 value
-	}
+	chbsp_critical_exit(key);
+}
 
-#ifdef CHDRV_DEBUG
-	char cbuf[80];
+void chdrv_cal_apply(ch_dev_t *dev_ptr, const ch_cal_result_t *cal_ptr) {
+	uint32_t key = chbsp_critical_enter();
 
-	snprintf(cbuf, sizeof(cbuf), "%u:%u: timeOfFlight=%u, scaleFactor=%u, num=%lu, den=%lu, range=%lu\n", 
-				dev_ptr->i2c_bus_index, dev_ptr->i2c_address, tof, tof_sf, num, den, range);
-	chbsp_print_str(cbuf);
-#endif
+	dev_ptr->rtc_cal_result = cal_ptr->rtc_cal_result;
+	dev_ptr->op_frequency   = cal_ptr->op_frequency;
+	dev_ptr->bandwidth      = cal_ptr->bandwidth;
+	dev_ptr->scale_factor   = cal_ptr->scale_factor;
 
-	return range;
+	chbsp_critical_exit(key);
+
+	chdrv_range_prepare(dev_ptr);
 }
 
 /*!
- * \brief Add an I2C transaction to the non-blocking queue
- *
- * \param grp_ptr 	pointer to the ch_group_t config structure for a group of sensors
- * \param dev_ptr 	pointer to an individual ch_dev_t config structure for a sensor
- * \param rd_wrb 	read/write indicator: 0 if write operation, 1 if read operation
- * \param type		type of I2C transaction (standard, program interface, or external)
- * \param addr		I2C address
- * \param nbytes 	number of bytes to read/write
- * \param data 		pointer to buffer to receive data or containing data to send
- *
- * \return 0 if successful, non-zero otherwise
+ * \brief Pass the calibration values of all connected sensors to the BSP cache.
  */
-int chdrv_group_i2c_queue(ch_group_t *grp_ptr, ch_dev_t *dev_ptr, uint8_t rd_wrb, uint8_t type, 
-						  uint16_t addr, uint16_t nbytes, uint8_t *data) {
+static void chdrv_group_cal_store(ch_group_t *grp_ptr) {
 
-	uint8_t bus_num = ch_get_i2c_bus(dev_ptr);
-	int	ret_val;
+	for (uint8_t i = 0; i < grp_ptr->num_ports; i++) {
+		ch_dev_t *dev_ptr = grp_ptr->device[i];
 
-	chdrv_i2c_queue_t *q = &(grp_ptr->i2c_queue[bus_num]);
-	chdrv_i2c_transaction_t *t = &(q->transaction[q->len]);
+		if (dev_ptr->sensor_connected) {
+			ch_cal_result_t cal;
 
-	if (q->len < CHDRV_MAX_I2C_QUEUE_LENGTH) {
-		t->databuf = data;
-		t->dev_ptr = dev_ptr;
-		t->addr = addr;
-		t->nbytes = nbytes;
-		t->rd_wrb = rd_wrb;
-		t->type = type;
-		t->xfer_num = 0;
-		q->len++;
-		ret_val = 0;
-	} else {
-		ret_val = 1;
+			chdrv_cal_get(dev_ptr, &cal);
+			chbsp_cal_store(dev_ptr, &cal);
+		}
 	}
-
-	return ret_val;
 }
 
-
 /*!
- * \brief Start a non-blocking sensor readout
+ * \brief Apply cached calibration values to all connected sensors.
  *
- * \param grp_ptr 	pointer to the ch_group_t config structure for a group of sensors
- *
- * This function starts a non-blocking I/O operation on the specified group of sensors.
+ * \return 0 if the BSP had values for every connected sensor, non-zero otherwise (nothing is applied)
  */
-void chdrv_group_i2c_start_nb(ch_group_t *grp_ptr) {
+static int chdrv_group_cal_restore(ch_group_t *grp_ptr) {
+	ch_cal_result_t cal[CHIRP_MAX_NUM_SENSORS];
+	int ch_err = 0;
 
-	for (int bus_num = 0; bus_num < grp_ptr->num_i2c_buses; bus_num++) {
-		chdrv_i2c_queue_t *q = &(grp_ptr->i2c_queue[bus_num]);
+	for (uint8_t i = 0; !ch_err && (i < grp_ptr->num_ports); i++) {
+		if (grp_ptr->device[i]->sensor_connected) {
+			ch_err = chbsp_cal_load(grp_ptr->device[i], &cal[i]);
+		}
+	}
 
-		if ((q->len != 0) && !(q->running)) {
-			chdrv_group_i2c_irq_handler(grp_ptr, bus_num);
+	for (uint8_t i = 0; !ch_err && (i < grp_ptr->num_ports); i++) {
+		if (grp_ptr->device[i]->sensor_connected) {
+			chdrv_cal_apply(grp_ptr->device[i], &cal[i]);
 		}
 	}
+	return ch_err;
 }
 
 /*!
- * \brief Continue a non-blocking readout
- *
- * \param grp_ptr 				pointer to the ch_group_t config structure for a group of sensors
- * \param i2c_bus_index		index value identifying I2C bus within group
+ * \brief Arm the sensors and start a background calibration pulse of \a recal.pulse_ms.
  *
- * Call this function once from your I2C interrupt handler each time it executes.
- * It will call the user's callback routine (grp_ptr->io_complete_callback) when all transactions 
- * are complete.
+ * The caller has set the state to \a CHDRV_RTC_CAL_PULSE.
  */
-void chdrv_group_i2c_irq_handler(ch_group_t *grp_ptr, uint8_t i2c_bus_index) {
-	int i;
-	int transactions_pending;
-	chdrv_i2c_queue_t *q = &(grp_ptr->i2c_queue[i2c_bus_index]);
-	chdrv_i2c_transaction_t *t = &(q->transaction[q->idx]);
-	ch_dev_t *dev_ptr = q->transaction[q->idx].dev_ptr;
-
+static int chdrv_group_rtc_pulse_start(ch_group_t *grp_ptr) {
+	int ch_err;
 
-    chbsp_program_disable(dev_ptr);					// de-assert PROG pin, possibly only briefly
+	/* Configure the host's side of the IO pin as a low output */
+	chbsp_group_io_clear(grp_ptr);
+	chbsp_group_set_io_dir_out(grp_ptr);
 
-    if (q->idx < q->len) {
-    	dev_ptr = q->transaction[q->idx].dev_ptr;
-		q->running = 1;
+	for (uint8_t i = 0; i < grp_ptr->num_ports; i++) {
+		if (grp_ptr->device[i]->sensor_connected) {
+			grp_ptr->device[i]->prepare_pulse_timer(grp_ptr->device[i]);
+		}
+	}
 
-		if (t->type == CHDRV_NB_TRANS_TYPE_EXTERNAL) {
-			/* Externally-requested transfer */
+	chbsp_group_io_set(grp_ptr);
+	ch_err = chbsp_rtc_cal_timer_start(grp_ptr, grp_ptr->recal.pulse_ms);
 
-			(q->idx)++;
-			chbsp_external_i2c_irq_handler(t);
-    		t->xfer_num++;			// count this transfer
+	if (ch_err) {									// no timer, results are not read
+		chbsp_group_io_clear(grp_ptr);
+		chbsp_group_set_io_dir_in(grp_ptr);
+		grp_ptr->rtc_cal_state = CHDRV_RTC_CAL_IDLE;
+	}
+	return ch_err;
+}
 
-		} else if (t->type == CHDRV_NB_TRANS_TYPE_PROG) {
-			/* Programming interface transfer */
+/*!
+ * \brief Start a real-time clock calibration pulse in the background.
+ *
+ * \param grp_ptr 		pointer to the ch_group_t config structure for a group of sensors
+ *
+ * \return 0 if the pulse started, non-zero otherwise
+ */
+int chdrv_group_measure_rtc_start(ch_group_t *grp_ptr) {
+	uint32_t key = chbsp_critical_enter();
+	int ch_err = (grp_ptr->rtc_cal_state != CHDRV_RTC_CAL_IDLE) || (grp_ptr->rtc_cal_hold != 0);
 
-			/* programming interface has max transfer size - check if still more to do during this transaction */
-			uint8_t total_xfers = (t->nbytes + (CH_PROG_XFER_SIZE - 1)) / CH_PROG_XFER_SIZE;
+	if (!ch_err) {
+		grp_ptr->rtc_cal_state = CHDRV_RTC_CAL_PULSE;
+	}
+	chbsp_critical_exit(key);
 
+	if (!ch_err) {
+		grp_ptr->recal.pulse_ms = grp_ptr->rtc_cal_pulse_ms;		// whole pulse at once
+		grp_ptr->recal.acc_ms = 0;
+		for (uint8_t i = 0; i < CHIRP_MAX_NUM_SENSORS; i++) {
+			grp_ptr->recal.acc_counts[i] = 0;
+		}
 
-			if (t->xfer_num < total_xfers) {
-				/* still need to complete this transaction */
+		ch_err = chdrv_group_rtc_pulse_start(grp_ptr);
+	}
+	return ch_err;
+}
 
-				uint16_t bytes_left;
-				uint16_t xfer_bytes;
+/*!
+ * \brief End a background real-time clock calibration pulse.
+ *
+ * \param grp_ptr 		pointer to the ch_group_t config structure for a group of sensors
+ */
+void chdrv_group_measure_rtc_end(ch_group_t *grp_ptr) {
 
-				bytes_left = (t->nbytes - (t->xfer_num * CH_PROG_XFER_SIZE));
+	chbsp_group_io_clear(grp_ptr);
+	chbsp_group_set_io_dir_in(grp_ptr);
 
-				if (t->rd_wrb) {			// only read operations supported for now
+	grp_ptr->rtc_cal_state = CHDRV_RTC_CAL_READOUT;
+}
 
-					if (grp_ptr->i2c_drv_flags & I2C_DRV_FLAG_RESET_AFTER_NB) {
-			    		chbsp_i2c_reset(dev_ptr);					// reset I2C bus if BSP says it's needed */
-					}
+/*!
+ * \brief Adapt the recalibration period to the largest drift seen at the last calibration.
+ */
+static void chdrv_group_recal_adapt(ch_group_t *grp_ptr, uint32_t max_drift_ppm) {
+	chdrv_recal_t *recal = &grp_ptr->recal;
 
-					chbsp_program_enable(dev_ptr);					// assert PROG pin
+	if (recal->period_ms == 0) {
+		return;
+	}
+	if ((max_drift_ppm < CHDRV_RECAL_DRIFT_LOW_PPM) && (recal->period_ms <= (CHDRV_RECAL_PERIOD_MAX_MS / 2))) {
+		recal->period_ms *= 2;
+	} else if ((max_drift_ppm > CHDRV_RECAL_DRIFT_HIGH_PPM) && (recal->period_ms >= (CHDRV_RECAL_PERIOD_MIN_MS * 2))) {
+		recal->period_ms /= 2;
+	}
+}
 
-	        		uint8_t message[] = { (0x80 | CH_PROG_REG_CTL), 0x09 };      // read burst command
+/*!
+ * \brief Read the results of a background real-time clock calibration.
+ *
+ * \param grp_ptr 		pointer to the ch_group_t config structure for a group of sensors
+ *
+ * The sensor counts of the pulse are added to those of the earlier parts of the calibration (see 
+ * \a chdrv_group_set_recal_period()).  Once the pulses add up to the calibration pulse length, 
+ * the counts are scaled to that length and the results are stored into a \a ch_cal_result_t by the 
+ * firmware-specific store routines, then swapped in with \a chdrv_cal_apply(), so range 
+ * calculations never see a mix of old and new values.
+ */
+void chdrv_group_measure_rtc_finish(ch_group_t *grp_ptr) {
+	chdrv_recal_t *recal = &grp_ptr->recal;
+	uint32_t max_drift_ppm = 0;
+	uint8_t done;
 
-	        		if (bytes_left > CH_PROG_XFER_SIZE) {
-	                		xfer_bytes = CH_PROG_XFER_SIZE;
-	        		} else {
-	                		xfer_bytes = bytes_left;
-	        		}
-	        		chdrv_prog_write(dev_ptr, CH_PROG_REG_ADDR, (t->addr + (t->xfer_num * CH_PROG_XFER_SIZE)));
-	        		chdrv_prog_write(dev_ptr, CH_PROG_REG_CNT, (xfer_bytes - 1));
-	        		(void) chdrv_prog_i2c_write(dev_ptr, message, sizeof(message));
-	        		(void) chdrv_prog_i2c_read_nb(dev_ptr, (t->databuf + (t->xfer_num * CH_PROG_XFER_SIZE)), xfer_bytes);
+	recal->acc_ms += recal->pulse_ms;
+	done = (recal->acc_ms >= grp_ptr->rtc_cal_pulse_ms);
+
+	for (uint8_t i = 0; i < grp_ptr->num_ports; i++) {
+		ch_dev_t *dev_ptr = grp_ptr->device[i];
+
+		if (dev_ptr->sensor_connected) {
+			ch_cal_result_t cal;
+
+			chdrv_cal_get(dev_ptr, &cal);
+			dev_ptr->store_pt_result(dev_ptr, &cal);
+			recal->acc_counts[i] += cal.rtc_cal_result;
+
+			if (done) {
+				int32_t drift_ppm = 0;
+
+				cal.rtc_cal_result = (uint16_t) (((recal->acc_counts[i] * grp_ptr->rtc_cal_pulse_ms) + 
+								   (recal->acc_ms / 2)) / recal->acc_ms);
+				dev_ptr->store_op_freq(dev_ptr, &cal);
+				dev_ptr->store_bandwidth(dev_ptr, &cal);
+				dev_ptr->store_scalefactor(dev_ptr, &cal);
+
+				if (dev_ptr->rtc_cal_result != 0) {
+					drift_ppm = (int32_t) ((((int64_t) cal.rtc_cal_result - dev_ptr->rtc_cal_result) * 1000000) / 
+										   dev_ptr->rtc_cal_result);
+				}
+				dev_ptr->rtc_cal_drift_ppm = drift_ppm;
+				if ((uint32_t) ((drift_ppm < 0) ? -drift_ppm : drift_ppm) > max_drift_ppm) {
+					max_drift_ppm = (drift_ppm < 0) ? -drift_ppm : drift_ppm;
 				}
 
-	    		t->xfer_num++;			// count this transfer
+				chdrv_cal_apply(dev_ptr, &cal);
+				chbsp_cal_store(dev_ptr, &cal);
+			}
+		}
+	}
+
+	if (done) {
+		recal->acc_ms = 0;
+		for (uint8_t i = 0; i < CHIRP_MAX_NUM_SENSORS; i++) {
+			recal->acc_counts[i] = 0;
+		}
+		recal->last_cal_ms = chbsp_timestamp_ms();
+		chdrv_group_recal_adapt(grp_ptr, max_drift_ppm);
+		chdrv_group_retain(grp_ptr);				// warm starts must restore the new values
+	}
+
+	grp_ptr->rtc_cal_state = CHDRV_RTC_CAL_IDLE;
+}
+
+/*!
+ * \brief Time a measurement of the group takes after the trigger, in milliseconds.
+ *
+ * Round trip of sound to the largest maximum range of the sensors, plus 
+ * \a CHDRV_RECAL_MEAS_MARGIN_MS.
+ */
+static uint32_t chdrv_group_meas_time_ms(ch_group_t *grp_ptr) {
+	uint32_t max_range_mm = 0;
+
+	for (uint8_t i = 0; i < grp_ptr->num_ports; i++) {
+		ch_dev_t *dev_ptr = grp_ptr->device[i];
+
+		if (dev_ptr->sensor_connected && (dev_ptr->max_range > max_range_mm)) {
+			max_range_mm = dev_ptr->max_range;
+		}
+	}
+	const uint32_t speed_mmps = chdrv_group_speed_of_sound(grp_ptr);
+
+	return ((2 * max_range_mm * 1000) + speed_mmps - 1) / speed_mmps + CHDRV_RECAL_MEAS_MARGIN_MS;
+}
+
+/*!
+ * \brief Schedule a calibration pulse after a trigger if one is due.
+ *
+ * \param grp_ptr 		pointer to the ch_group_t config structure for a group of sensors
+ *
+ * Called from \a chdrv_group_hw_trigger(), possibly in interrupt context.  The pulse starts 
+ * when the measurement is over and ends \a CHDRV_RECAL_GUARD_MS before the next trigger, 
+ * expected one trigger interval after this one.
+ */
+static void chdrv_group_recal_on_trigger(ch_group_t *grp_ptr) {
+	chdrv_recal_t *recal = &grp_ptr->recal;
+	const uint32_t now = chbsp_timestamp_ms();
+	uint32_t meas_ms;
+	uint32_t window_ms;
+	uint32_t pulse_ms;
+
+	if (recal->trigger_ms != 0) {
+		recal->trigger_interval_ms = now - recal->trigger_ms;
+	}
+	recal->trigger_ms = now;
+
+	if ((recal->period_ms == 0) || (recal->trigger_interval_ms == 0) || 
+		(grp_ptr->rtc_cal_state != CHDRV_RTC_CAL_IDLE)) {
+		return;
+	}
+	if ((recal->acc_ms == 0) && ((now - recal->last_cal_ms) < recal->period_ms)) {
+		return;														// not due, and no calibration in progress
+	}
+
+	meas_ms = chdrv_group_meas_time_ms(grp_ptr);
+	if (recal->trigger_interval_ms < (meas_ms + CHDRV_RECAL_GUARD_MS + CHDRV_RECAL_MIN_PULSE_MS)) {
+		return;														// no usable idle window
+	}
+	window_ms = recal->trigger_interval_ms - meas_ms - CHDRV_RECAL_GUARD_MS;
+
+	pulse_ms = grp_ptr->rtc_cal_pulse_ms - recal->acc_ms;
+	if (pulse_ms < CHDRV_RECAL_MIN_PULSE_MS) {
+		pulse_ms = CHDRV_RECAL_MIN_PULSE_MS;						// short pulses lose accuracy, overshoot instead
+	}
+	if (pulse_ms > window_ms) {
+		pulse_ms = window_ms;
+	}
+
+	recal->pulse_ms = (uint16_t) pulse_ms;
+	grp_ptr->rtc_cal_state = CHDRV_RTC_CAL_SCHEDULED;
+	if (chbsp_rtc_cal_work_schedule(grp_ptr, (uint16_t) meas_ms)) {
+		grp_ptr->rtc_cal_state = CHDRV_RTC_CAL_IDLE;
+	}
+}
+
+void chdrv_group_set_recal_period(ch_group_t *grp_ptr, uint32_t period_ms) {
+
+	if ((period_ms != 0) && (period_ms < CHDRV_RECAL_PERIOD_MIN_MS)) {
+		period_ms = CHDRV_RECAL_PERIOD_MIN_MS;
+	} else if (period_ms > CHDRV_RECAL_PERIOD_MAX_MS) {
+		period_ms = CHDRV_RECAL_PERIOD_MAX_MS;
+	}
+	grp_ptr->recal.period_ms = period_ms;
+}
+
+void chdrv_group_recal_run(ch_group_t *grp_ptr) {
+	chdrv_recal_t *recal = &grp_ptr->recal;
+	uint32_t key = chbsp_critical_enter();
+	uint8_t run = 0;
+
+	if (grp_ptr->rtc_cal_state == CHDRV_RTC_CAL_SCHEDULED) {
+		/* The work may run late, and the pulse must end before the next trigger */
+		run = (grp_ptr->rtc_cal_hold == 0) && 
+			  (((chbsp_timestamp_ms() - recal->trigger_ms) + recal->pulse_ms + CHDRV_RECAL_GUARD_MS) <= 
+			   recal->trigger_interval_ms);
+		grp_ptr->rtc_cal_state = run ? CHDRV_RTC_CAL_PULSE : CHDRV_RTC_CAL_IDLE;
+	}
+	chbsp_critical_exit(key);
+
+	if (run) {
+		chbsp_group_io_interrupt_disable(grp_ptr);		// re-enabled by the next trigger
+		chdrv_group_rtc_pulse_start(grp_ptr);
+	}
+}
+
+/*!
+ * \brief Restart the recalibration schedule after a blocking calibration.
+ */
+static void chdrv_group_recal_reset(ch_group_t *grp_ptr) {
+	chdrv_recal_t *recal = &grp_ptr->recal;
+
+	recal->trigger_ms = 0;
+	recal->trigger_interval_ms = 0;
+	recal->acc_ms = 0;
+	for (uint8_t i = 0; i < CHIRP_MAX_NUM_SENSORS; i++) {
+		recal->acc_counts[i] = 0;
+	}
+	recal->last_cal_ms = chbsp_timestamp_ms();
+}
+
+/*!
+ * \brief Wait for a background real-time clock calibration to finish.
+ *
+ * \param grp_ptr 		pointer to the ch_group_t config structure for a group of sensors
+ *
+ * Gives up after the pulse length plus \a CHDRV_RTC_CAL_READOUT_MS (BSP timer lost).
+ */
+static void chdrv_group_measure_rtc_wait(ch_group_t *grp_ptr) {
+	uint32_t waited_ms = 0;
+	uint32_t key = chbsp_critical_enter();
+
+	if (grp_ptr->rtc_cal_state == CHDRV_RTC_CAL_SCHEDULED) {
+		grp_ptr->rtc_cal_state = CHDRV_RTC_CAL_IDLE;		// pulse not started yet, drop it
+	}
+	chbsp_critical_exit(key);
+
+	while ((grp_ptr->rtc_cal_state != CHDRV_RTC_CAL_IDLE) && 
+		   (waited_ms < ((uint32_t) grp_ptr->rtc_cal_pulse_ms + CHDRV_RTC_CAL_READOUT_MS))) {
+		chbsp_delay_ms(1);
+		waited_ms++;
+	}
+	grp_ptr->rtc_cal_state = CHDRV_RTC_CAL_IDLE;
+}
+
+void chdrv_group_cal_hold(ch_group_t *grp_ptr) {
+	uint32_t waited_ms = 0;
+	uint32_t key = chbsp_critical_enter();
+
+	while ((grp_ptr->rtc_cal_state == CHDRV_RTC_CAL_PULSE) || (grp_ptr->rtc_cal_state == CHDRV_RTC_CAL_READOUT)) {
+		chbsp_critical_exit(key);
+		if (waited_ms < ((uint32_t) grp_ptr->rtc_cal_pulse_ms + CHDRV_RTC_CAL_READOUT_MS)) {
+			chbsp_delay_ms(1);
+			waited_ms++;
+		} else {
+			grp_ptr->rtc_cal_state = CHDRV_RTC_CAL_IDLE;		// BSP timer lost, as in chdrv_group_measure_rtc_wait()
+		}
+		key = chbsp_critical_enter();
+	}
+	grp_ptr->rtc_cal_hold++;
+	chbsp_critical_exit(key);
+}
+
+void chdrv_group_cal_release(ch_group_t *grp_ptr) {
+	uint32_t key = chbsp_critical_enter();
+
+	if (grp_ptr->rtc_cal_hold != 0) {
+		grp_ptr->rtc_cal_hold--;
+	}
+	chbsp_critical_exit(key);
+}
+
+/*!
+ * \brief Convert register values to a range using the calibration data.
+ *
+ * \param dev_ptr 	pointer to the ch_dev_t config structure for a sensor
+ * \param tof 		value of sensor TOF register
+ * \param tof_sf 	value of sensor TOF_SF register
+ *
+ * \return range in millimeters, or \a CH_NO_TARGET (0xFFFFFFFF) if no object is detected.  
+ *
+ * The range result format is fixed point with 5 binary fractional digits (divide by 32 to 
+ * convert to mm).
+ *
+ * This function takes the time-of-flight and scale factor values from the sensor,
+ * and computes the actual one-way range based on the formulas given in the sensor 
+ * datasheet.  While \a tof_sf matches the calibrated scale factor, the precomputed constants 
+ * are used (see \a chdrv_range_prepare()), otherwise the range is computed from \a tof_sf.
+ */
+uint32_t chdrv_one_way_range(ch_dev_t *dev_ptr, uint16_t tof, uint16_t tof_sf) {
+	chdrv_range_conv_t conv;
+	ch_cal_result_t cal;
+	uint32_t range;
+
+	if (tof == UINT16_MAX) {
+		return CH_NO_TARGET;
+	}
+
+	chdrv_range_conv_get(dev_ptr, &conv);
+
+	if ((tof_sf == dev_ptr->scale_factor) && (conv.tof_mult != 0)) {
+		range = CHDRV_RANGE_MUL(tof, conv.tof_mult, conv.tof_shift + 1);
+	} else {
+		chdrv_cal_get(dev_ptr, &cal);
+
+		uint64_t num = ((uint64_t) chdrv_group_speed_of_sound(dev_ptr->group) * dev_ptr->group->rtc_cal_pulse_ms * tof);
+		uint64_t den = (uint64_t) (((uint32_t) cal.rtc_cal_result * (uint32_t) tof_sf) >> 10) * 1000;
+
+		range = (den != 0) ? (uint32_t) (num / den) : 0;
+		if (dev_ptr->part_number == CH201_PART_NUMBER) {
+			range *= 2;				// CH-201 range (TOF) encoding is 1/2 of CH-101 value
+		}
+		range >>= dev_ptr->oversample;
+	}
+
+#ifdef CHDRV_DEBUG
+	char cbuf[80];
+
+	snprintf(cbuf, sizeof(cbuf), "%u:%u: timeOfFlight=%u, scaleFactor=%u, range=%lu\n", 
+				dev_ptr->i2c_bus_index, dev_ptr->i2c_address, tof, tof_sf, range);
+	chbsp_print_str(cbuf);
+#endif
+
+	return range;
+}
+
+/*
+ * num / den as mult / 2^shift, with mult as large as fits in 32 bits (rounded to nearest).  
+ * Returns 0 if den or num is 0.
+ */
+static uint32_t chdrv_reciprocal(uint32_t num, uint32_t den, uint8_t *shift_ptr) {
+	uint64_t mult = 0;
+	int shift = 0;
+
+	if ((num != 0) && (den != 0)) {
+		shift = 31 + __builtin_clz(num) - __builtin_clz(den);		// num / den < 2^(32 - shift)
+		if (shift < 0) {
+			shift = 0;
+		}
+		mult = (((uint64_t) num << shift) + (den / 2)) / den;
+		if (mult > UINT32_MAX) {									// rounded up to 2^32
+			shift--;
+			mult = (((uint64_t) num << shift) + (den / 2)) / den;
+		}
+	}
+
+	*shift_ptr = (uint8_t) shift;
+	return (uint32_t) mult;
+}
+
+void chdrv_range_prepare(ch_dev_t *dev_ptr) {
+	chdrv_range_conv_t conv;
+	ch_cal_result_t cal;
+	uint32_t key;
+	const uint32_t speed_mmps = chdrv_group_speed_of_sound(dev_ptr->group);
+
+	chdrv_cal_get(dev_ptr, &cal);
+
+	/* Round-trip range (mm * 32) = TOF * speed (mm/s) * pulse length / (((rtc_cal_result * scale_factor) >> 11) * 1000) */
+	uint64_t tof_num = (uint64_t) speed_mmps * dev_ptr->group->rtc_cal_pulse_ms;
+	uint32_t tof_den = (((uint32_t) cal.rtc_cal_result * (uint32_t) cal.scale_factor) >> 11) * 1000;	// XXX need define
+	/* Distance (mm) = samples * speed (mm/s) * 8 / (op_frequency * 2) */
+	uint32_t sample_num = speed_mmps * 8 / 2;
+
+	if (dev_ptr->part_number == CH201_PART_NUMBER) {
+		tof_num *= 2;					// CH-201 range (TOF) encoding is 1/2 of CH-101 value
+	}
+	while (tof_num > UINT32_MAX) {		// only with very long calibration pulses
+		tof_num >>= 1;
+		tof_den >>= 1;
+	}
+
+	conv.tof_mult = chdrv_reciprocal((uint32_t) tof_num, tof_den, &conv.tof_shift);
+	conv.tof_shift += dev_ptr->oversample;
+	conv.sample_mult = chdrv_reciprocal(sample_num, cal.op_frequency, &conv.sample_shift);
+	conv.sample_shift += dev_ptr->oversample;
+	/* I/Q sample position (1/256 sample) = range (mm * 32) * 8 * op_frequency / (speed (mm/s) * 4) */
+	conv.iq_mult = chdrv_reciprocal(cal.op_frequency << (CHDRV_IQ_POS_FRAC_BITS - 5), sample_num, 
+									&conv.iq_shift);
+	if (conv.iq_shift >= dev_ptr->oversample) {
+		conv.iq_shift -= dev_ptr->oversample;
+	}
+
+	key = chbsp_critical_enter();
+	dev_ptr->range_conv = conv;
+	chbsp_critical_exit(key);
+}
+
+/*
+ * Integer square root, rounded down.
+ */
+static uint32_t chdrv_isqrt(uint64_t value) {
+	uint64_t root = 0;
+	uint64_t bit = (uint64_t) 1 << 62;
+
+	while (bit > value) {
+		bit >>= 2;
+	}
+	while (bit != 0) {
+		if (value >= root + bit) {
+			value -= root + bit;
+			root = (root >> 1) + bit;
+		} else {
+			root >>= 1;
+		}
+		bit >>= 2;
+	}
+	return (uint32_t) root;
+}
+
+uint32_t chdrv_group_speed_of_sound(ch_group_t *grp_ptr) {
+	uint32_t speed_mmps = grp_ptr->sos.speed_mmps;
+
+	return (speed_mmps != 0) ? speed_mmps : (CH_SPEEDOFSOUND_MPS * 1000);
+}
+
+uint8_t chdrv_group_set_environment(ch_group_t *grp_ptr, int16_t temp_cc, uint8_t humidity_pct) {
+	chdrv_sos_t *sos = &grp_ptr->sos;
+	const int32_t temp_step = (sos->temp_step_cc != 0) ? sos->temp_step_cc : CHDRV_SOS_TEMP_STEP_CC;
+	int32_t temp_diff;
+	int32_t humidity_diff;
+	uint32_t key;
+
+	if (temp_cc < CHDRV_SOS_TEMP_MIN_CC) {
+		temp_cc = CHDRV_SOS_TEMP_MIN_CC;
+	} else if (temp_cc > CHDRV_SOS_TEMP_MAX_CC) {
+		temp_cc = CHDRV_SOS_TEMP_MAX_CC;
+	}
+	if (humidity_pct > 100) {
+		humidity_pct = CHDRV_SOS_HUMIDITY_DEFAULT;		// CH_HUMIDITY_UNKNOWN
+	}
+
+	/* Callers may run in different threads; the rebuild below is arithmetic only, no bus access */
+	key = chbsp_critical_enter();
+	temp_diff = (int32_t) temp_cc - sos->temp_cc;
+	humidity_diff = (int32_t) humidity_pct - sos->humidity_pct;
+	if ((sos->speed_mmps != 0) && (temp_diff > -temp_step) && (temp_diff < temp_step) && 
+		(humidity_diff > -CHDRV_SOS_HUMIDITY_STEP) && (humidity_diff < CHDRV_SOS_HUMIDITY_STEP)) {
+		chbsp_critical_exit(key);
+		return 0;
+	}
+
+	/* c = 331.3 m/s * sqrt(T(K) / 273.15 K) + 0.0124 m/s per % RH */
+	sos->temp_cc = temp_cc;
+	sos->humidity_pct = humidity_pct;
+	sos->speed_mmps = chdrv_isqrt(((uint64_t) 331300 * 331300 * (uint32_t) (27315 + temp_cc)) / 27315) + 
+					  ((124 * humidity_pct) + 5) / 10;
+
+	for (uint8_t i = 0; i < grp_ptr->num_ports; i++) {
+		ch_dev_t *dev_ptr = grp_ptr->device[i];
+
+		if ((dev_ptr != NULL) && dev_ptr->sensor_connected) {
+			chdrv_range_prepare(dev_ptr);
+		}
+	}
+	chbsp_critical_exit(key);
+	return 1;
+}
+
+void chdrv_range_conv_get(ch_dev_t *dev_ptr, chdrv_range_conv_t *conv_ptr) {
+	uint32_t key = chbsp_critical_enter();
+
+	*conv_ptr = dev_ptr->range_conv;
+	chbsp_critical_exit(key);
+}
+
+int chdrv_tof_to_range_bulk(ch_dev_t *dev_ptr, const uint16_t *tof_ptr, uint32_t *range_ptr, uint16_t count, 
+							uint8_t one_way) {
+	chdrv_range_conv_t conv;
+
+	chdrv_range_conv_get(dev_ptr, &conv);
+	if (conv.tof_mult == 0) {
+		return 1;
+	}
+
+	const uint32_t mult = conv.tof_mult;
+	const uint8_t shift = conv.tof_shift + (one_way ? 1 : 0);
+
+	for (uint16_t i = 0; i < count; i++) {
+		range_ptr[i] = (tof_ptr[i] != UINT16_MAX) ? CHDRV_RANGE_MUL(tof_ptr[i], mult, shift) : CH_NO_TARGET;
+	}
+	return 0;
+}
+
+int chdrv_samples_to_mm_bulk(ch_dev_t *dev_ptr, const uint16_t *samples_ptr, uint16_t *mm_ptr, uint16_t count) {
+	chdrv_range_conv_t conv;
+
+	chdrv_range_conv_get(dev_ptr, &conv);
+	if (conv.sample_mult == 0) {
+		return 1;
+	}
+
+	for (uint16_t i = 0; i < count; i++) {
+		mm_ptr[i] = (uint16_t) CHDRV_RANGE_MUL(samples_ptr[i], conv.sample_mult, conv.sample_shift);
+	}
+	return 0;
+}
+
+/*
+ * Squared magnitude of an I/Q sample (at most 2^31, so it fits unsigned).
+ */
+static inline uint32_t chdrv_iq_mag2(const ch_iq_sample_t *sample_ptr) {
+
+	return (uint32_t) ((int32_t) sample_ptr->i * sample_ptr->i) + (uint32_t) ((int32_t) sample_ptr->q * sample_ptr->q);
+}
+
+/*
+ * Integer square root of a 32-bit value, rounded down.
+ */
+static uint32_t chdrv_isqrt32(uint32_t value) {
+	uint32_t root = 0;
+	uint32_t bit;
+
+	if (value == 0) {
+		return 0;
+	}
+	bit = (uint32_t) 1 << ((31 - __builtin_clz(value)) & ~1);
+	while (bit != 0) {
+		if (value >= root + bit) {
+			value -= root + bit;
+			root = (root >> 1) + bit;
+		} else {
+			root >>= 1;
+		}
+		bit >>= 2;
+	}
+	return root;
+}
+
+/*
+ * Position of the magnitude peak of an I/Q frame between samples first and last, in 1/256 sample.  
+ * Returns 0 if the peak has no neighbour on either side in the frame.
+ */
+static uint32_t chdrv_iq_peak_pos(const ch_iq_sample_t *iq_ptr, uint16_t num_samples, uint16_t first, uint16_t last) {
+	const int32_t half = 1 << (CHDRV_IQ_POS_FRAC_BITS - 1);
+	uint32_t peak_mag2 = 0;
+	uint16_t peak = 0;
+	uint32_t pos = 0;
+
+	for (uint16_t n = first; n <= last; n++) {
+		uint32_t mag2 = chdrv_iq_mag2(&iq_ptr[n]);
+
+		if (mag2 > peak_mag2) {
+			peak_mag2 = mag2;
+			peak = n;
+		}
+	}
+
+	if ((peak > 0) && (peak < (num_samples - 1))) {
+		int32_t mag_prev = (int32_t) chdrv_isqrt32(chdrv_iq_mag2(&iq_ptr[peak - 1]));
+		int32_t mag_peak = (int32_t) chdrv_isqrt32(peak_mag2);
+		int32_t mag_next = (int32_t) chdrv_isqrt32(chdrv_iq_mag2(&iq_ptr[peak + 1]));
+		int32_t curve = (2 * mag_peak) - mag_prev - mag_next;
+		int32_t frac = 0;
+
+		/* Vertex of the parabola through the three points: (next - prev) / (2 * curve) samples */
+		if (curve > 0) {
+			frac = ((mag_next - mag_prev) * half) / curve;
+			if (frac > half) {
+				frac = half;
+			} else if (frac < -half) {
+				frac = -half;
+			}
+		}
+		pos = (uint32_t) (((int32_t) peak << CHDRV_IQ_POS_FRAC_BITS) + frac);
+	}
+	return pos;
+}
+
+uint32_t chdrv_precise_range(ch_dev_t *dev_ptr, const ch_iq_sample_t *iq_ptr, uint16_t num_samples, uint32_t range) {
+	chdrv_range_conv_t conv;
+	uint32_t center;
+	uint32_t pos = 0;
+
+	chdrv_range_conv_get(dev_ptr, &conv);
+
+	if ((range != CH_NO_TARGET) && (conv.iq_mult != 0) && (iq_ptr != NULL) && (num_samples > 2)) {
+		center = (CHDRV_RANGE_MUL(range, conv.iq_mult, conv.iq_shift) + (1 << (CHDRV_IQ_POS_FRAC_BITS - 1))) 
+				 >> CHDRV_IQ_POS_FRAC_BITS;
+		if (center < num_samples) {
+			uint16_t first = (center > CHDRV_IQ_PEAK_WINDOW) ? (center - CHDRV_IQ_PEAK_WINDOW) : 0;
+			uint16_t last = ((center + CHDRV_IQ_PEAK_WINDOW) < num_samples) ? (center + CHDRV_IQ_PEAK_WINDOW) : 
+																			   (num_samples - 1);
+
+			pos = chdrv_iq_peak_pos(iq_ptr, num_samples, first, last);
+		}
+	}
+
+	if (pos != 0) {
+		range = CHDRV_RANGE_MUL(pos, conv.sample_mult, conv.sample_shift + CHDRV_IQ_POS_FRAC_BITS - 5);
+	}
+	return range;
+}
+
+/*
+ * First sample of the threshold segment after \a thresh_num, or UINT16_MAX if it is the last one: the 
+ * segments end at the first one that does not start after the previous one (unused, zeroed entries).
+ */
+static uint16_t chdrv_next_segment_start(const ch_thresholds_t *thresh_ptr, uint8_t thresh_num) {
+	uint16_t next_start = UINT16_MAX;
+
+	if ((thresh_num < (CH_NUM_THRESHOLDS - 1)) && 
+		(thresh_ptr->threshold[thresh_num + 1].start_sample > thresh_ptr->threshold[thresh_num].start_sample)) {
+		next_start = thresh_ptr->threshold[thresh_num + 1].start_sample;
+	}
+	return next_start;
+}
+
+uint8_t chdrv_find_targets(ch_dev_t *dev_ptr, const ch_iq_sample_t *iq_ptr, uint16_t num_samples, 
+						   const ch_thresholds_t *thresh_ptr, ch_target_t *targets_ptr, uint8_t max_targets, 
+						   uint8_t one_way) {
+	chdrv_range_conv_t conv;
+	uint8_t num_targets = 0;
+	uint8_t thresh_num = 0;
+	uint16_t next_start = UINT16_MAX;		// first sample of the next threshold segment
+	uint32_t level2 = (uint32_t) CH_TARGET_LEVEL_DEFAULT * CH_TARGET_LEVEL_DEFAULT;
+	uint16_t first = 0;						// first sample of the current echo
+	uint16_t peak = 0;
+	uint32_t peak_mag2 = 0;					// 0 while outside an echo
+	uint16_t n = 0;
+
+	chdrv_range_conv_get(dev_ptr, &conv);
+	if ((conv.sample_mult == 0) || (iq_ptr == NULL) || (targets_ptr == NULL)) {
+		max_targets = 0;
+	}
+	if (num_samples > dev_ptr->max_samples) {
+		num_samples = dev_ptr->max_samples;		// also keeps n <= num_samples from wrapping
+	}
+
+	if (thresh_ptr != NULL) {
+		level2 = (uint32_t) thresh_ptr->threshold[0].level * thresh_ptr->threshold[0].level;
+		next_start = chdrv_next_segment_start(thresh_ptr, 0);
+	} else {
+		n = dev_ptr->static_range;			// CH101 firmware: no detection below the static range
+	}
+
+	/* One more pass with a zero magnitude closes an echo still open at the end of the frame */
+	for (; (n <= num_samples) && (num_targets < max_targets); n++) {
+		uint32_t mag2 = (n < num_samples) ? chdrv_iq_mag2(&iq_ptr[n]) : 0;
+
+		while (n >= next_start) {
+			thresh_num++;
+			level2 = (uint32_t) thresh_ptr->threshold[thresh_num].level * thresh_ptr->threshold[thresh_num].level;
+			next_start = chdrv_next_segment_start(thresh_ptr, thresh_num);
+		}
+
+		if ((mag2 >= level2) && (mag2 != 0)) {
+			if (peak_mag2 == 0) {
+				first = n;
+			}
+			if (mag2 > peak_mag2) {
+				peak_mag2 = mag2;
+				peak = n;
+			}
+		} else if (peak_mag2 != 0) {
+			ch_target_t *target_ptr = &targets_ptr[num_targets++];
+			uint32_t pos = chdrv_iq_peak_pos(iq_ptr, num_samples, peak, peak);
+
+			if (pos == 0) {
+				pos = (uint32_t) peak << CHDRV_IQ_POS_FRAC_BITS;		// peak at the edge of the frame
+			}
+			target_ptr->range = CHDRV_RANGE_MUL(pos, conv.sample_mult, 
+												conv.sample_shift + CHDRV_IQ_POS_FRAC_BITS - 5 - (one_way ? 0 : 1));
+			target_ptr->amplitude = (uint16_t) chdrv_isqrt32(peak_mag2);
+			target_ptr->width = n - first;
+			peak_mag2 = 0;
+		}
+	}
+	return num_targets;
+}
+
+/*!
+ * \brief Add an I2C transaction to the non-blocking queue
+ *
+ * \param grp_ptr 	pointer to the ch_group_t config structure for a group of sensors
+ * \param dev_ptr 	pointer to an individual ch_dev_t config structure for a sensor
+ * \param rd_wrb 	read/write indicator: 0 if write operation, 1 if read operation
+ * \param type		type of I2C transaction (standard, program interface, or external)
+ * \param addr		I2C address
+ * \param nbytes 	number of bytes to read/write
+ * \param data 		pointer to buffer to receive data or containing data to send
+ *
+ * \return 0 if successful, non-zero otherwise
+ */
+int chdrv_group_i2c_queue(ch_group_t *grp_ptr, ch_dev_t *dev_ptr, uint8_t rd_wrb, uint8_t type, 
+						  uint16_t addr, uint16_t nbytes, uint8_t *data) {
+
+	uint8_t bus_num = ch_get_i2c_bus(dev_ptr);
+	int	ret_val;
+
+	chdrv_i2c_queue_t *q = &(grp_ptr->i2c_queue[bus_num]);
+	chdrv_i2c_transaction_t *t = &(q->transaction[q->len]);
+
+	if (q->len < CHDRV_MAX_I2C_QUEUE_LENGTH) {
+		t->databuf = data;
+		t->dev_ptr = dev_ptr;
+		t->addr = addr;
+		t->nbytes = nbytes;
+		t->rd_wrb = rd_wrb;
+		t->type = type;
+		t->xfer_num = 0;
+		q->len++;
+		if (type != CHDRV_NB_TRANS_TYPE_RESULT) {
+			grp_ptr->io_complete_pending = 1;		// not only a group result readout
+		}
+		ret_val = 0;
+	} else {
+		ret_val = 1;
+	}
+
+	return ret_val;
+}
+
+
+int chdrv_group_results_claim(ch_group_t *grp_ptr, ch_result_t *results_ptr, uint8_t one_way) {
+	uint32_t key = chbsp_critical_enter();
+	int busy = (grp_ptr->results_ptr != NULL);
+
+	for (uint8_t bus_num = 0; bus_num < grp_ptr->num_i2c_buses; bus_num++) {
+		busy |= (grp_ptr->i2c_queue[bus_num].len != 0);
+	}
+	if (!busy) {
+		grp_ptr->results_ptr = results_ptr;
+		grp_ptr->results_one_way = one_way;
+		grp_ptr->results_queued = 0;
+	}
+	chbsp_critical_exit(key);
+
+	return busy;
+}
+
+void chdrv_group_results_release(ch_group_t *grp_ptr) {
+	uint32_t key = chbsp_critical_enter();
+
+	for (uint8_t bus_num = 0; bus_num < grp_ptr->num_i2c_buses; bus_num++) {
+		grp_ptr->i2c_queue[bus_num].len = 0;			// drop the reads already queued, none started
+		grp_ptr->i2c_queue[bus_num].idx = 0;
+	}
+	grp_ptr->results_ptr = NULL;
+	grp_ptr->results_queued = 0;
+	chbsp_critical_exit(key);
+}
+
+/*
+ * Convert the registers read by a group result readout and hand the results to the application.  
+ * Called once all non-blocking transactions of the group have completed.
+ */
+static void chdrv_group_results_complete(ch_group_t *grp_ptr, ch_result_t *results_ptr, uint32_t queued) {
+	chdrv_range_conv_t conv;
+
+	for (uint8_t dev_num = 0; dev_num < grp_ptr->num_ports; dev_num++) {
+		ch_dev_t *dev_ptr = grp_ptr->device[dev_num];
+		ch_result_t *result_ptr = &results_ptr[dev_num];
+
+		result_ptr->range = CH_NO_TARGET;			// also if not read or not calibrated
+		result_ptr->amplitude = 0;
+		result_ptr->tof_sf = 0;
+
+		if (queued & (1UL << dev_num)) {
+			uint16_t tof = dev_ptr->result_regs[0];
+
+			chdrv_range_conv_get(dev_ptr, &conv);
+			if ((tof != UINT16_MAX) && (conv.tof_mult != 0)) {
+				uint8_t shift = conv.tof_shift;
+
+				if (grp_ptr->results_one_way && (dev_ptr->mode != CH_MODE_TRIGGERED_RX_ONLY)) {
+					shift++;						// half of the round trip
+				}
+				result_ptr->range = CHDRV_RANGE_MUL(tof, conv.tof_mult, shift);
+				result_ptr->amplitude = dev_ptr->result_regs[1];
+			}
+		}
+	}
+
+	if (grp_ptr->result_callback != NULL) {
+		(*grp_ptr->result_callback)(grp_ptr, results_ptr);
+	}
+}
+
+/*!
+ * \brief Start a non-blocking sensor readout
+ *
+ * \param grp_ptr 	pointer to the ch_group_t config structure for a group of sensors
+ *
+ * This function starts a non-blocking I/O operation on the specified group of sensors.
+ */
+void chdrv_group_i2c_start_nb(ch_group_t *grp_ptr) {
+
+	for (int bus_num = 0; bus_num < grp_ptr->num_i2c_buses; bus_num++) {
+		chdrv_i2c_queue_t *q = &(grp_ptr->i2c_queue[bus_num]);
+
+		if ((q->len != 0) && !(q->running)) {
+			chdrv_group_i2c_irq_handler(grp_ptr, bus_num);
+		}
+	}
+}
+
+/*!
+ * \brief Continue a non-blocking readout
+ *
+ * \param grp_ptr 				pointer to the ch_group_t config structure for a group of sensors
+ * \param i2c_bus_index		index value identifying I2C bus within group
+ *
+ * Call this function once from your I2C interrupt handler each time it executes.
+ * It will call the user's callback routine (grp_ptr->io_complete_callback) when all transactions 
+ * are complete.
+ */
+void chdrv_group_i2c_irq_handler(ch_group_t *grp_ptr, uint8_t i2c_bus_index) {
+	int i;
+	int transactions_pending;
+	chdrv_i2c_queue_t *q = &(grp_ptr->i2c_queue[i2c_bus_index]);
+	chdrv_i2c_transaction_t *t;
+	ch_dev_t *dev_ptr;
+
+    if (q->idx < q->len) {
+		t = &(q->transaction[q->idx]);			// only valid while transactions remain (idx may equal queue size)
+    	dev_ptr = t->dev_ptr;
+		q->running = 1;
+
+	    chbsp_program_disable(dev_ptr);				// de-assert PROG pin, possibly only briefly
+
+		if (t->type == CHDRV_NB_TRANS_TYPE_EXTERNAL) {
+			/* Externally-requested transfer */
+
+			(q->idx)++;
+			chbsp_external_i2c_irq_handler(t);
+    		t->xfer_num++;			// count this transfer
+
+		} else if (t->type == CHDRV_NB_TRANS_TYPE_PROG) {
+			/* Programming interface transfer */
+
+			/* programming interface has max transfer size - check if still more to do during this transaction */
+			uint8_t total_xfers = (t->nbytes + (CH_PROG_XFER_SIZE - 1)) / CH_PROG_XFER_SIZE;
+
+
+			if (t->xfer_num < total_xfers) {
+				/* still need to complete this transaction */
+
+				uint16_t bytes_left;
+				uint16_t xfer_bytes;
+
+				bytes_left = (t->nbytes - (t->xfer_num * CH_PROG_XFER_SIZE));
+
+				if (t->rd_wrb) {			// only read operations supported for now
+
+					if (grp_ptr->i2c_drv_flags & I2C_DRV_FLAG_RESET_AFTER_NB) {
+			    		chbsp_i2c_reset(dev_ptr);					// reset I2C bus if BSP says it's needed */
+					}
+
+					chbsp_program_enable(dev_ptr);					// assert PROG pin
+
+	        		uint8_t message[] = { (0x80 | CH_PROG_REG_CTL), 0x09 };      // read burst command
+
+	        		if (bytes_left > CH_PROG_XFER_SIZE) {
+	                		xfer_bytes = CH_PROG_XFER_SIZE;
+	        		} else {
+	                		xfer_bytes = bytes_left;
+	        		}
+	        		chdrv_prog_write(dev_ptr, CH_PROG_REG_ADDR, (t->addr + (t->xfer_num * CH_PROG_XFER_SIZE)));
+	        		chdrv_prog_write(dev_ptr, CH_PROG_REG_CNT, (xfer_bytes - 1));
+	        		(void) chdrv_prog_i2c_write(dev_ptr, message, sizeof(message));
+	        		if (chdrv_prog_i2c_read_nb(dev_ptr, (t->databuf + (t->xfer_num * CH_PROG_XFER_SIZE)), xfer_bytes)) {
+						/* BSP could not start the transfer - do it now and continue the queue directly */
+						(void) chdrv_prog_i2c_read(dev_ptr, (t->databuf + (t->xfer_num * CH_PROG_XFER_SIZE)), xfer_bytes);
+						t->xfer_num++;
+						if (t->xfer_num >= total_xfers) {
+							(q->idx)++;
+						}
+						chdrv_group_i2c_irq_handler(grp_ptr, i2c_bus_index);
+						return;
+					}
+				}
+
+	    		t->xfer_num++;			// count this transfer
+
+	    		/* if this is the last transfer in this transaction, advance queue index */
+	    		if (t->xfer_num >= total_xfers) {
+					(q->idx)++;
+	    		}
+
+			}
+
+		} else {
+			/* Standard transfer */
+			int nb_err;
+
+			(q->idx)++;
+    		t->xfer_num++;			// count this transfer
+			if (t->rd_wrb) {
+				nb_err = chbsp_i2c_mem_read_nb(t->dev_ptr, t->addr, t->databuf, t->nbytes);
+			} else {
+				nb_err = chbsp_i2c_mem_write_nb(t->dev_ptr, t->addr, t->databuf, t->nbytes);
+			}
+
+			if (nb_err) {
+				/* BSP could not start the transfer - do it now and continue the queue directly */
+				if (t->rd_wrb) {
+					(void) chbsp_i2c_mem_read(t->dev_ptr, t->addr, t->databuf, t->nbytes);
+				} else {
+					(void) chbsp_i2c_mem_write(t->dev_ptr, t->addr, t->databuf, t->nbytes);
+				}
+				chdrv_group_i2c_irq_handler(grp_ptr, i2c_bus_index);
+				return;
+			}
+		}
+		transactions_pending = 1;
+	} else {
+
+		if (q->idx >= 1) {
+			dev_ptr = q->transaction[(q->idx - 1)].dev_ptr;		// get dev_ptr for previous completed transaction
+			if (dev_ptr != NULL) {
+			    chbsp_program_disable(dev_ptr);					// de-assert PROG pin for completed transaction
+
+					if (grp_ptr->i2c_drv_flags & I2C_DRV_FLAG_RESET_AFTER_NB) {
+			    		chbsp_i2c_reset(dev_ptr);				// reset I2C bus if BSP requires it
+					}
+			}
+		}
+
+		q->len = 0;
+		q->idx = 0;
+		q->running = 0;
+		transactions_pending = 0;
+
+		for (i = 0; i < grp_ptr->num_i2c_buses; i++) {
+			if (grp_ptr->i2c_queue[i].len) {
+				transactions_pending = 1;
+				break;
+			}
+		}
+	}
+
+	if (!transactions_pending) {
+		ch_io_complete_callback_t func_ptr = grp_ptr->io_complete_callback;
+		uint32_t key = chbsp_critical_enter();		// the last buses may finish together, report once
+		ch_result_t *results_ptr = grp_ptr->results_ptr;
+		uint32_t results_queued = grp_ptr->results_queued;
+		uint8_t io_complete = grp_ptr->io_complete_pending;
+
+		grp_ptr->results_ptr = NULL;
+		grp_ptr->io_complete_pending = 0;
+		chbsp_critical_exit(key);
+
+		if (results_ptr != NULL) {
+			chdrv_group_results_complete(grp_ptr, results_ptr, results_queued);
+		}
+		if (io_complete && (func_ptr != NULL)) {
+			(*func_ptr)(grp_ptr);
+		}
+	}
+
+}
+
+
+/*!
+ * \brief Wait for an individual sensor to finish start-up procedure.
+ * 
+ * \param dev_ptr 			pointer to the ch_dev_t config structure for a sensor
+ * \param timeout_ms 	number of milliseconds to wait for sensor to finish start-up before returning failure
+ *
+ * \return 0 if startup sequence finished, non-zero if startup sequence timed out or sensor is not connected
+ *
+ * After the sensor is programmed, it executes an internal start-up and self-test sequence. This function waits the
+ * specified time in milliseconds for the sensor to finish this sequence.
+ */
+int chdrv_wait_for_lock(ch_dev_t *dev_ptr, uint16_t timeout_ms) {
+	uint32_t start_time = chbsp_timestamp_ms();
+	int ch_err = !(dev_ptr->sensor_connected);
+
+	while (!ch_err && !(dev_ptr->get_locked_state(dev_ptr))) {
+		chbsp_delay_ms(10);
+		ch_err = ((chbsp_timestamp_ms() - start_time) > timeout_ms);
+	}
+
+#ifdef CHDRV_DEBUG
+	if (ch_err) {
+		char cbuf[80];
+		snprintf(cbuf, sizeof(cbuf), "Sensor %hhu initialization timed out or missing\n", dev_ptr->io_index);
+		chbsp_print_str(cbuf);
+	}
+#endif
+
+	return ch_err;
+}
+
+/* Milliseconds since \a start_ms (a chbsp_timestamp_ms() value), below UINT16_MAX ("not locked") */
+static uint16_t chdrv_freqlock_elapsed_ms(uint32_t start_ms) {
+	uint32_t elapsed_ms = chbsp_timestamp_ms() - start_ms;
+
+	return (elapsed_ms < UINT16_MAX) ? (uint16_t) elapsed_ms : (UINT16_MAX - 1);
+}
+
+/*!
+ * \brief Wait for all sensors to finish start-up procedure.
+ *
+ * \param grp_ptr 		pointer to the ch_group_t config structure for a group of sensors
+ *
+ * \return 0 if startup sequence finished on all detected sensors, non-zero if startup sequence 
+ * timed out on any sensor(s).
+ *
+ * After each sensor is programmed, it executes an internal start-up and self-test sequence. This 
+ * function waits for all sensor devices to finish this sequence, polling every sensor not yet locked 
+ * once every \a CHDRV_FREQLOCK_POLL_MS milliseconds, and returns as soon as the last one locks.  The 
+ * lock time of each sensor, measured with \a chbsp_timestamp_ms() from the start of the wait, is 
+ * stored in its \a freqlock_time_ms field.  The maximum time to wait is \a CHDRV_FREQLOCK_TIMEOUT_MS 
+ * milliseconds of real time, whatever the number of sensors polled.
+ */
+int chdrv_group_wait_for_lock(ch_group_t *grp_ptr) {
+	const uint32_t wait_start = chdrv_profile_now();
+	const uint32_t wait_start_ms = chbsp_timestamp_ms();
+	uint16_t first_lock_ms = UINT16_MAX;
+	uint8_t num_waiting = 0;
+	int ch_err = 0;
+
+	for (uint8_t i = 0; i < grp_ptr->num_ports; i++) {
+		ch_dev_t *dev_ptr = grp_ptr->device[i];
+
+		dev_ptr->freqlock_time_ms = UINT16_MAX;		// not locked yet
+		if (dev_ptr->sensor_connected) {
+			num_waiting++;
+		}
+	}
+
+	/* Skip the part of the start-up no sensor got through at the last start */
+	if (grp_ptr->freqlock_min_ms > CHDRV_FREQLOCK_MARGIN_MS) {
+		chbsp_delay_ms(grp_ptr->freqlock_min_ms - CHDRV_FREQLOCK_MARGIN_MS);
+	}
+
+	/* Times are read from the clock: the polls themselves take time, more with more sensors */
+	while (num_waiting > 0) {
+		for (uint8_t i = 0; i < grp_ptr->num_ports; i++) {
+			ch_dev_t *dev_ptr = grp_ptr->device[i];
+
+			if (dev_ptr->sensor_connected && (dev_ptr->freqlock_time_ms == UINT16_MAX) && 
+				dev_ptr->get_locked_state(dev_ptr)) {
+				uint16_t elapsed_ms = chdrv_freqlock_elapsed_ms(wait_start_ms);
+
+				dev_ptr->freqlock_time_ms = elapsed_ms;
+				chdrv_profile_add(dev_ptr, CH_BOOT_PHASE_FREQ_LOCK, wait_start, chdrv_profile_now());
+				num_waiting--;
+				if (elapsed_ms < first_lock_ms) {
+					first_lock_ms = elapsed_ms;
+				}
+			}
+		}
+
+		if (num_waiting == 0) {
+			break;
+		}
+		if (chdrv_freqlock_elapsed_ms(wait_start_ms) >= CHDRV_FREQLOCK_TIMEOUT_MS) {
+			ch_err = 1;
+			break;
+		}
+		chbsp_delay_ms(CHDRV_FREQLOCK_POLL_MS);
+	}
+
+	/* A sensor that timed out waited the whole time */
+	for (uint8_t i = 0; ch_err && (i < grp_ptr->num_ports); i++) {
+		ch_dev_t *dev_ptr = grp_ptr->device[i];
+
+		if (dev_ptr->sensor_connected && (dev_ptr->freqlock_time_ms == UINT16_MAX)) {
+			chdrv_profile_add(dev_ptr, CH_BOOT_PHASE_FREQ_LOCK, wait_start, chdrv_profile_now());
+		}
+	}
+
+#ifdef CHDRV_DEBUG
+	for (uint8_t i = 0; i < grp_ptr->num_ports; i++) {
+		ch_dev_t *dev_ptr = grp_ptr->device[i];
+
+		if (dev_ptr->sensor_connected && (dev_ptr->freqlock_time_ms == UINT16_MAX)) {
+			char cbuf[80];
+			snprintf(cbuf, sizeof(cbuf), "Sensor %hhu initialization timed out\n", dev_ptr->io_index);
+			chbsp_print_str(cbuf);
+		}
+	}
+#endif
+
+	/* Learn where to start polling next time; a timeout starts over from 0 */
+	grp_ptr->freqlock_min_ms = (ch_err || (first_lock_ms == UINT16_MAX)) ? 0 : first_lock_ms;
+
+	return ch_err;
+}
+
+/*!
+ * \brief Start a measurement in hardware triggered mode.
+ * 
+ * \param grp_ptr 		pointer to the ch_group_t config structure for a group of sensors
+ *
+ * \return 0 if success, non-zero if \a grp_ptr pointer is invalid or an RTC calibration pulse is in progress
+ *
+ * This function starts a triggered measurement on each sensor in a group, by briefly asserting the INT line to each device.  
+ * Each sensor must have already been placed in hardware triggered mode before this function is called.
+ *
+ * If periodic recalibration is enabled, a calibration pulse may be scheduled after the measurement 
+ * (see \a chdrv_group_set_recal_period()).
+ */
+int chdrv_group_hw_trigger(ch_group_t *grp_ptr) {
+	int ch_err = !grp_ptr || (grp_ptr->rtc_cal_state == CHDRV_RTC_CAL_PULSE);
+
+	if (!ch_err) {
+		//Disable pin interrupt before triggering pulse
+		chbsp_group_io_interrupt_disable(grp_ptr);
+
+		// Generate pulse
+		chbsp_group_set_io_dir_out(grp_ptr);
+		chbsp_group_io_set(grp_ptr);
+		chbsp_delay_us(5); 					// Pulse needs to be a minimum of 800ns long
+		chbsp_group_io_clear(grp_ptr);
+		chbsp_group_set_io_dir_in(grp_ptr);
+
+		// Delay a bit before re-enabling pin interrupt to avoid possibly triggering on falling-edge noise
+		chbsp_delay_us(10);
+
+		chbsp_group_io_interrupt_enable(grp_ptr);
+
+		chdrv_group_recal_on_trigger(grp_ptr);
+	}
+	return ch_err;
+}
+
+/*!
+ * \brief Start a measurement in hardware triggered mode on one sensor.
+ *
+ * \param dev_ptr 		pointer to the ch_dev_t config structure for a sensor
+ *
+ * \return 0 if success, non-zero if \a dev_ptr pointer is invalid or an RTC calibration pulse is in progress
+ *
+ * This function starts a triggered measurement on a single sensor, by briefly asserting the INT line to the device.
+ * The sensor must have already been placed in hardware triggered mode before this function is called.
+ *
+ * \note This function requires implementing the optional BSP functions to control the INT pin direction
+ *       and level for individual sensors (\a chbsp_set_io_dir_in(), \a chbsp_set_io_dir_out(), \a chbsp_io_set(), and
+ *       \a chbsp_io_clear()).
+ */
+int chdrv_hw_trigger(ch_dev_t *dev_ptr) {
+	int ch_err = !dev_ptr || (dev_ptr->group->rtc_cal_state == CHDRV_RTC_CAL_PULSE);
+
+	if (!ch_err) {
+		//Disable pin interrupt before triggering pulse
+		chbsp_io_interrupt_disable(dev_ptr);
+
+		// Generate pulse
+		chbsp_set_io_dir_out(dev_ptr);
+		chbsp_io_set(dev_ptr);
+		chbsp_delay_us(5); 					// Pulse needs to be a minimum of 800ns long  // XXX need define
+		chbsp_io_clear(dev_ptr);
+		chbsp_set_io_dir_in(dev_ptr);
+
+		// Delay a bit before re-enabling pin interrupt to avoid possibly triggering on falling-edge noise
+		chbsp_delay_us(10);			// XXX need define
+
+		chbsp_io_interrupt_enable(dev_ptr);
+	}
+	return ch_err;
+}
+
+/*!
+ * \brief Write to a sensor programming register.
+ * 
+ * \param dev_ptr 		pointer to the ch_dev_t config structure for a sensor
+ * \param reg_addr 	sensor programming register address.
+ * \param data 		8-bit or 16-bit data to transmit.
+ *
+ * \return 0 if write to sensor succeeded, non-zero otherwise
+ *
+ * This local function writes a value to a sensor programming register.
+ */
+int chdrv_prog_write(ch_dev_t *dev_ptr, uint8_t reg_addr, uint16_t data) {
+	/* Set register address write bit */
+	reg_addr |= 0x80;
+	
+	/* Write the register address, followed by the value to be written */
+	uint8_t message[] = { reg_addr, (uint8_t) data, (uint8_t) (data >> 8) };
+
+	/* For the 2-byte registers, we also need to also write MSB after the LSB */
+	return chdrv_prog_i2c_write(dev_ptr, message, (1 + CH_PROG_SIZEOF(reg_addr)));
+}
+
+/*!
+ * \brief Write to sensor memory.
+ * 
+ * \param dev_ptr	pointer to the ch_dev_t config structure for a sensor
+ * \param addr		sensor programming register start address
+ * \param message	pointer to data to transmit
+ * \param nbytes	number of bytes to write
+ *
+ * \return 0 if write to sensor succeeded, non-zero otherwise
+ *
+ * This function writes to sensor memory using the low-level programming interface.  The type 
+ * of write is automatically determined based on data length and target address alignment.
+ */
+int chdrv_prog_mem_write(ch_dev_t *dev_ptr, uint16_t addr, uint8_t *message, uint16_t nbytes) {
+	int ch_err = (nbytes == 0);
+
+	if (!ch_err) {
+		ch_err = chdrv_prog_write(dev_ptr, CH_PROG_REG_ADDR, addr);
+	}
+
+	if (nbytes == 1 || (nbytes == 2 && !(addr & 1))) {
+		uint16_t data = *((uint16_t*) message);
+		if (!ch_err) {
+			ch_err = chdrv_prog_write(dev_ptr, CH_PROG_REG_DATA, data);
+		}
+		if (!ch_err) {
+			uint8_t opcode = (0x03 | ((nbytes == 1) ? 0x08 : 0x00));			// XXX need define
+
+			ch_err = chdrv_prog_write(dev_ptr, CH_PROG_REG_CTL, opcode);
+		}
+	} else {
+		static const uint8_t burst_hdr[2] = {0xC4, 0x0B};			// XXX need define
+
+		if (!ch_err) {
+			ch_err = chdrv_prog_write(dev_ptr, CH_PROG_REG_CNT, (nbytes - 1));
+		}
+		if (!ch_err) {
+			ch_err = chdrv_prog_i2c_write(dev_ptr, (uint8_t *) burst_hdr, sizeof(burst_hdr));
+		}
+		if (!ch_err) {
+			ch_err = chdrv_prog_i2c_write(dev_ptr, message, nbytes);
+		}
+	}
+	return ch_err;
+}
+
+/*!
+ * \brief Read from sensor memory.
+ * 
+ * \param dev_ptr	pointer to the ch_dev_t config structure for a sensor
+ * \param addr		sensor memory start address
+ * \param message	pointer to a buffer where read bytes will be placed
+ * \param nbytes	number of bytes to read
+ *
+ * \return 0 if read from sensor succeeded, non-zero otherwise
+ *
+ * This function reads sensor memory using burst reads on the low-level programming interface.
+ */
+int chdrv_prog_mem_read(ch_dev_t *dev_ptr, uint16_t addr, uint8_t *message, uint16_t nbytes) {
+	static const uint8_t burst_hdr[2] = {(0x80 | CH_PROG_REG_CTL), 0x09};		// read burst command
+	int ch_err = (nbytes == 0);
+
+	while (!ch_err && (nbytes > 0)) {
+		uint16_t xfer_bytes = (nbytes > CH_PROG_XFER_SIZE) ? CH_PROG_XFER_SIZE : nbytes;
+
+		ch_err = chdrv_prog_write(dev_ptr, CH_PROG_REG_ADDR, addr) ||
+				 chdrv_prog_write(dev_ptr, CH_PROG_REG_CNT, (xfer_bytes - 1)) ||
+				 chdrv_prog_i2c_write(dev_ptr, (uint8_t *) burst_hdr, sizeof(burst_hdr)) ||
+				 chdrv_prog_i2c_read(dev_ptr, message, xfer_bytes);
+
+		addr    += xfer_bytes;
+		message += xfer_bytes;
+		nbytes  -= xfer_bytes;
+	}
+	return ch_err;
+}
+
+/*!
+ * \brief Read from a sensor programming register.
+ * 
+ * \param dev_ptr 		pointer to the ch_dev_t config structure for a sensor
+ * \param reg_addr 	sensor programming register address
+ * \param data	 	pointer to a buffer where read bytes will be placed
+ *
+ * \return 0 if read from sensor succeeded, non-zero otherwise
+ *
+ * This local function reads a value from a sensor programming register.
+ */
+static int chdrv_prog_read(ch_dev_t *dev_ptr, uint8_t reg_addr, uint16_t *data) {
+	uint8_t nbytes = CH_PROG_SIZEOF(reg_addr);
+
+	uint8_t read_data[2];
+	uint8_t message[1] = { 0x7F & reg_addr };
+
+	int ch_err = chdrv_prog_i2c_write(dev_ptr, message, sizeof(message));
+
+	if (!ch_err) {
+		ch_err = chdrv_prog_i2c_read(dev_ptr, read_data, nbytes);
+	}
+
+	if (!ch_err) {
+		*data = read_data[0];
+		if (nbytes > 1) {
+			*data |= (((uint16_t) read_data[1]) << 8);
+		}
+	}
+
+	return ch_err;
+}
+/*!
+ * \brief Transfer firmware to the sensor on-chip memory.
+ * 
+ * \param dev_ptr 		pointer to the ch_dev_t config structure for a sensor
+ *
+ * \return 0 if firmware write succeeded, non-zero otherwise
+ *
+ * This local function writes the sensor firmware image to the device.
+ */
+/*!
+ */
+static int chdrv_write_firmware(ch_dev_t *dev_ptr) {
+	ch_fw_load_func_t func_ptr = dev_ptr->api_funcs.fw_load;	// pointer to firmware load function
+	int ch_err = ((func_ptr == NULL) || (!dev_ptr->sensor_connected));
+
+#ifdef CHDRV_DEBUG
+	char cbuf[80];
+	uint32_t prog_time;
+
+	if (!ch_err) {
+		chbsp_print_str("chdrv_write_firmware\n");
+	}
+#endif
+
+	if (!ch_err) {
+#ifdef CHDRV_DEBUG
+		chbsp_print_str("Programming Chirp sensor...\n");
+		prog_time = chbsp_timestamp_ms();
+#endif
+		if (func_ptr != NULL) {
+			ch_err = (*func_ptr)(dev_ptr);
+		} else {
+			ch_err = 1;			// indicate error
+		}
+}
+
+#ifdef CHDRV_DEBUG
+	if (!ch_err) {
+		prog_time = chbsp_timestamp_ms() - prog_time;
+		snprintf(cbuf, sizeof(cbuf), "Wrote %u bytes in %lu ms.\n", CH101_FW_SIZE, prog_time);
+		chbsp_print_str(cbuf);
+	}
+#endif
+
+	return ch_err;
+}
+
+/*!
+ * \brief Initialize sensor memory contents.
+ * 
+ * \param dev_ptr 		pointer to the ch_dev_t config structure for a sensor
+ *
+ * \return 0 if memory write succeeded, non-zero otherwise
+ *
+ * This local function initializes memory locations in the Chirp sensor, as required by the firmware image.
+ */
+static int chdrv_init_ram(ch_dev_t *dev_ptr) {
+	int ch_err = ! dev_ptr || ! dev_ptr->sensor_connected;
 
-	    		/* if this is the last transfer in this transaction, advance queue index */
-	    		if (t->xfer_num >= total_xfers) {
-					(q->idx)++;
-	    		}
+#ifdef CHDRV_DEBUG
+	char cbuf[80];
+	uint32_t prog_time;
+	if (!ch_err) {
+		chbsp_print_str("chdrv_init_ram\n");
+	}
+#endif
 
-			}
+	if ((!ch_err) && (dev_ptr->get_fw_ram_init_size() != 0)) {		// if size is not zero, ram init data exists
+		uint16_t ram_address;
+		uint16_t ram_bytecount;
 
-		} else {
-			/* Standard transfer */
-			if (t->rd_wrb) {
-				(q->idx)++;
-				chbsp_i2c_mem_read_nb(t->dev_ptr, t->addr, t->databuf, t->nbytes);
+		ram_address = dev_ptr->get_fw_ram_init_addr();
+		ram_bytecount = dev_ptr->get_fw_ram_init_size();
 
-			} else {
-				(q->idx)++;
-				chbsp_i2c_mem_write_nb(t->dev_ptr, t->addr, t->databuf, t->nbytes);
+		if (!ch_err) {
+#ifdef CHDRV_DEBUG
+			chbsp_print_str("Loading RAM init data...\n");
+			prog_time = chbsp_timestamp_ms();
+#endif
+			ch_err = chdrv_prog_mem_write(dev_ptr, ram_address, (uint8_t *) dev_ptr->ram_init, ram_bytecount);
+#ifdef CHDRV_DEBUG
+			if (!ch_err) {
+				prog_time = chbsp_timestamp_ms() - prog_time;
+				snprintf(cbuf, sizeof(cbuf), "Wrote %u bytes in %lu ms.\n", sizeof(message), prog_time);
+				chbsp_print_str(cbuf);
 			}
-    		t->xfer_num++;			// count this transfer
+#endif
 		}
-		transactions_pending = 1;
-	} else {
+	}
+	return ch_err;
+}
 
-		if (q->idx >= 1) {
-			dev_ptr = q->transaction[(q->idx - 1)].dev_ptr;		// get dev_ptr for previous completed transaction
-			if (dev_ptr != NULL) {
-			    chbsp_program_disable(dev_ptr);					// de-assert PROG pin for completed transaction
+/*!
+ * \brief Reset and halt a sensor
+ * 
+ * \param dev_ptr 		pointer to the ch_dev_t config structure for a sensor
+ * 
+ * \return 0 if write to sensor succeeded, non-zero otherwise
+ *
+ * This function resets and halts a sensor device by writing to the control registers.
+ *
+ * In order for the device to respond, the PROG pin for the device must be asserted before this function is called. 
+ */
+static int chdrv_reset_and_halt(ch_dev_t * dev_ptr) {
+	int ch_err = chdrv_prog_write(dev_ptr, CH_PROG_REG_CPU, 0x40);    	// reset asic			// XXX need define
 
-					if (grp_ptr->i2c_drv_flags & I2C_DRV_FLAG_RESET_AFTER_NB) {
-			    		chbsp_i2c_reset(dev_ptr);				// reset I2C bus if BSP requires it
-					}
-			}
-		}
+	ch_err |= chdrv_prog_write(dev_ptr, CH_PROG_REG_CPU, 0x11);   		// halt asic and disable watchdog;			// XXX need define
 
-		q->len = 0;
-		q->idx = 0;
-		q->running = 0;
-		transactions_pending = 0;
+	return ch_err;
+}
 
-		for (i = 0; i < grp_ptr->num_i2c_buses; i++) {
-			if (grp_ptr->i2c_queue[i].len) {
-				transactions_pending = 1;
-				break;
-			}
-		}
+/*!
+ * \brief Detect a connected sensor. 
+ * 
+ * \param dev_ptr 		pointer to the ch_dev_t config structure for a sensor
+ * 
+ * \return 1 if sensor is found, 0 if no sensor is found
+ *
+ * This function checks for a sensor sensor on the I2C bus by attempting to reset, halt, and read from the device using
+ * the programming interface I2C address (0x45). 
+ *
+ * In order for the device to respond, the PROG pin for the device must be asserted before this function is called. 
+ */
+int chdrv_prog_ping(ch_dev_t *dev_ptr) {
+	// Try a dummy write to the sensor to make sure it's connected and working
+	uint8_t probe[] = { (0x80 | CH_PROG_REG_CPU), 0x40 };		// reset asic
+	uint16_t tmp;
+	int ch_err;
+
+	dev_ptr->i2c_address = CH_I2C_ADDR_PROG;
+	ch_err = chbsp_i2c_probe(dev_ptr, probe, sizeof(probe));	// single attempt, NACK = no sensor on this port
+	dev_ptr->i2c_address = dev_ptr->app_i2c_address;
+	if (ch_err) {
+		return 0;
 	}
 
-	if (!transactions_pending) {
-		ch_io_complete_callback_t func_ptr = grp_ptr->io_complete_callback;
+    ch_err = chdrv_reset_and_halt(dev_ptr);
 
-		if (func_ptr != NULL) {
-			(*func_ptr)(grp_ptr);
-		}
+    ch_err |= chdrv_prog_read(dev_ptr, CH_PROG_REG_PING, &tmp);
+
+#ifdef CHDRV_DEBUG
+	if (!ch_err) {
+		char cbuf[80];
+		snprintf(cbuf, sizeof(cbuf), "Test I2C read: %04X\n", tmp);
+		chbsp_print_str(cbuf);
 	}
+#endif
 
+	return !(ch_err);
 }
 
+/* Registered firmware images, see CH_FW_IMAGE_REGISTER() and ch_fw_registry.ld */
+extern const ch_fw_image_t _ch_fw_image_list_start[];
+extern const ch_fw_image_t _ch_fw_image_list_end[];
 
 /*!
- * \brief Wait for an individual sensor to finish start-up procedure.
- * 
- * \param dev_ptr 			pointer to the ch_dev_t config structure for a sensor
- * \param timeout_ms 	number of milliseconds to wait for sensor to finish start-up before returning failure
+ * \brief Bind the registered firmware image for a part to a sensor.
  *
- * \return 0 if startup sequence finished, non-zero if startup sequence timed out or sensor is not connected
+ * \param dev_ptr 		pointer to the ch_dev_t config structure for a sensor
+ * \param part_number	part number of the sensor (0 if not known)
  *
- * After the sensor is programmed, it executes an internal start-up and self-test sequence. This function waits the
- * specified time in milliseconds for the sensor to finish this sequence.
+ * \return 0 if successful, non-zero if no registered image fits
+ *
+ * The first image for the part with all capabilities in \a dev_ptr->fw_caps is used, in the order 
+ * of the registry (sorted by name).  Its init function fills in the device descriptor as 
+ * \a ch_init() would have.
  */
-int chdrv_wait_for_lock(ch_dev_t *dev_ptr, uint16_t timeout_ms) {
-	uint32_t start_time = chbsp_timestamp_ms();
-	int ch_err = !(dev_ptr->sensor_connected);
+static int chdrv_fw_bind(ch_dev_t *dev_ptr, uint16_t part_number) {
+	const ch_fw_image_t *image_ptr;
 
-	while (!ch_err && !(dev_ptr->get_locked_state(dev_ptr))) {
-		chbsp_delay_ms(10);
-		ch_err = ((chbsp_timestamp_ms() - start_time) > timeout_ms);
+	for (image_ptr = _ch_fw_image_list_start; image_ptr < _ch_fw_image_list_end; image_ptr++) {
+		if (((part_number == 0) || (image_ptr->part_number == part_number)) && 
+			((image_ptr->caps & dev_ptr->fw_caps) == dev_ptr->fw_caps)) {
+			break;
+		}
 	}
+	if (image_ptr == _ch_fw_image_list_end) {
+		return 1;
+	}
+
+	dev_ptr->fw_image = image_ptr;
+	return image_ptr->init_func(dev_ptr, dev_ptr->group, dev_ptr->app_i2c_address, dev_ptr->io_index, 
+								dev_ptr->i2c_bus_index);
+}
+
+/*!
+ * \brief Check for a sensor on the programming interface.
+ *
+ * \param dev_ptr 		pointer to the ch_dev_t config structure for a sensor
+ *
+ * \return 0 if no error occurred (sensor found or not), non-zero if the discovery hook failed
+ *
+ * Sets \a sensor_connected according to the result of the ping and calls the group's discovery 
+ * hook for a sensor that was found.  The PROG pin for the device must be asserted.
+ */
+static int chdrv_detect(ch_dev_t *dev_ptr) {
+	const uint32_t start = chdrv_profile_now();
+	int ch_err = 0;
+	int found = chdrv_prog_ping(dev_ptr);
+
+	chdrv_profile_add(dev_ptr, CH_BOOT_PHASE_PING, start, chdrv_profile_now());
+
+	if (found) {									// if device found
+		dev_ptr->sensor_connected = 1;
+
+		/* CH101 and CH201 look the same on the programming interface, the board tells the part */
+		if (dev_ptr->fw_auto && chdrv_fw_bind(dev_ptr, chbsp_part_number(dev_ptr))) {
+			dev_ptr->sensor_connected = 0;			// no registered firmware for this part
+			return ch_err;
+		}
+
+		// Call device discovery hook routine, if any
+		chdrv_discovery_hook_t hook_ptr = dev_ptr->group->disco_hook;
+		if (hook_ptr != NULL) {
+			ch_err = (*hook_ptr)(dev_ptr);		// hook routine can return error, will abort device init
+		}
 
 #ifdef CHDRV_DEBUG
-	if (ch_err) {
 		char cbuf[80];
-		snprintf(cbuf, sizeof(cbuf), "Sensor %hhu initialization timed out or missing\n", dev_ptr->io_index);
-		chbsp_print_str(cbuf);
-	}
+		if (!ch_err) {
+			uint16_t prog_stat = UINT16_MAX;
+			ch_err = chdrv_prog_read(dev_ptr, CH_PROG_REG_STAT, &prog_stat);
+			snprintf(cbuf, sizeof(cbuf), "PROG_STAT: 0x%02X\n", prog_stat);
+			chbsp_print_str(cbuf);
+		}
 #endif
+	} else {
+		dev_ptr->sensor_connected = 0;				// prog_ping failed - no device found
+	}
 
 	return ch_err;
 }
 
 /*!
- * \brief Wait for all sensors to finish start-up procedure.
+ * \brief Load the RAM init data and firmware image into a sensor.
  *
- * \param grp_ptr 		pointer to the ch_group_t config structure for a group of sensors
+ * \param dev_ptr 		pointer to the ch_dev_t config structure for a sensor
  *
- * \return 0 if startup sequence finished on all detected sensors, non-zero if startup sequence 
- * timed out on any sensor(s).
+ * \return 0 if successful, non-zero otherwise
  *
- * After each sensor is programmed, it executes an internal start-up and self-test sequence. This 
- * function waits for all sensor devices to finish this sequence.  For each device, the maximum 
- * time to wait is \a CHDRV_FREQLOCK_TIMEOUT_MS milliseconds.
+ * Every sensor with PROG asserted on the bus receives the data, which is used to load identical 
+ * sensors in one pass (see \a CHDRV_FW_BROADCAST).
  */
-int chdrv_group_wait_for_lock(ch_group_t *grp_ptr) {
-	int ch_err = 0;
+static int chdrv_load(ch_dev_t *dev_ptr) {
+	const uint32_t start = chdrv_profile_now();
+	uint32_t ram_done;
+	int ch_err;
 
-	for (uint8_t i = 0; i < grp_ptr->num_ports; i++) {
-		ch_dev_t *dev_ptr = grp_ptr->device[i];
+	chdrv_reg_cache_invalidate(dev_ptr);			// new firmware, default register values
 
-		if (dev_ptr->sensor_connected) {
-			ch_err |= chdrv_wait_for_lock(dev_ptr, CHDRV_FREQLOCK_TIMEOUT_MS);
-		}
+	ch_err = chdrv_init_ram(dev_ptr);				// init ram values
+	ram_done = chdrv_profile_now();
+	chdrv_profile_add(dev_ptr, CH_BOOT_PHASE_RAM_INIT, start, ram_done);
+
+	if (!ch_err) {
+		ch_err = chdrv_write_firmware(dev_ptr);		// transfer program
+		chdrv_profile_add(dev_ptr, CH_BOOT_PHASE_FW_WRITE, ram_done, chdrv_profile_now());
 	}
+
 	return ch_err;
 }
 
 /*!
- * \brief Start a measurement in hardware triggered mode.
- * 
- * \param grp_ptr 		pointer to the ch_group_t config structure for a group of sensors
+ * \brief Start the firmware loaded in a sensor.
  *
- * \return 0 if success, non-zero if \a grp_ptr pointer is invalid
+ * \param dev_ptr 		pointer to the ch_dev_t config structure for a sensor
  *
- * This function starts a triggered measurement on each sensor in a group, by briefly asserting the INT line to each device.  
- * Each sensor must have already been placed in hardware triggered mode before this function is called.
+ * \return 0 if successful, non-zero otherwise
+ *
+ * Resets the sensor CPU, sets the application I2C address, runs the charge pumps and leaves 
+ * programming mode.  The PROG pin for the device must be asserted.
  */
-int chdrv_group_hw_trigger(ch_group_t *grp_ptr) {
-	int ch_err = !grp_ptr;
+static int chdrv_start_firmware(ch_dev_t *dev_ptr) {
+	int ch_err = chdrv_reset_and_halt(dev_ptr); 		// reset asic, since it was running mystery code before halt
 
+#ifdef CHDRV_DEBUG
+	char cbuf[80];
 	if (!ch_err) {
-		//Disable pin interrupt before triggering pulse
-		chbsp_group_io_interrupt_disable(grp_ptr);
+		snprintf(cbuf, sizeof(cbuf), "Changing I2C address to %u\n", dev_ptr->i2c_address);
+		chbsp_print_str(cbuf);
+	}
+#endif
 
-		// Generate pulse
-		chbsp_group_set_io_dir_out(grp_ptr);
-		chbsp_group_io_set(grp_ptr);
-		chbsp_delay_us(5); 					// Pulse needs to be a minimum of 800ns long
-		chbsp_group_io_clear(grp_ptr);
-		chbsp_group_set_io_dir_in(grp_ptr);
+	if (!ch_err ) {
+		ch_err = chdrv_prog_mem_write(dev_ptr, 0x01C5, &dev_ptr->i2c_address, 1);			// XXX need define
+	}
 
-		// Delay a bit before re-enabling pin interrupt to avoid possibly triggering on falling-edge noise
-		chbsp_delay_us(10);
+	/* Run charge pumps */
+	if (!ch_err) {
+		const uint32_t start = chdrv_profile_now();
+		uint16_t write_val;
+		write_val = 0x0200;			// XXX need defines
+		ch_err |= chdrv_prog_mem_write(dev_ptr, 0x01A6, (uint8_t *)&write_val, 2);		// PMUT.CNTRL4 = HVVSS_FON
+		chbsp_delay_ms(5);
+		write_val = 0x0600;
+		ch_err = chdrv_prog_mem_write(dev_ptr, 0x01A6, (uint8_t *)&write_val, 2);		// PMUT.CNTRL4 = (HVVSS_FON | HVVDD_FON)
+		chbsp_delay_ms(5);
+		write_val = 0x0000;
+		ch_err |= chdrv_prog_mem_write(dev_ptr, 0x01A6, (uint8_t *)&write_val, 2);		// PMUT.CNTRL4 = 0
+		chdrv_profile_add(dev_ptr, CH_BOOT_PHASE_CHARGE_PUMP, start, chdrv_profile_now());
+	}
 
-		chbsp_group_io_interrupt_enable(grp_ptr);
+	if (!ch_err ) {
+		ch_err = chdrv_prog_write(dev_ptr, CH_PROG_REG_CPU, 2);	// Exit programming mode and run the chip
 	}
+
 	return ch_err;
 }
 
 /*!
- * \brief Start a measurement in hardware triggered mode on one sensor.
+ * \brief Finish programming a sensor.
  *
  * \param dev_ptr 		pointer to the ch_dev_t config structure for a sensor
+ * \param ch_err		result of the programming sequence
  *
- * \return 0 if success, non-zero if \a dev_ptr pointer is invalid
+ * \return \a ch_err
  *
- * This function starts a triggered measurement on a single sensor, by briefly asserting the INT line to the device.
- * The sensor must have already been placed in hardware triggered mode before this function is called.
- *
- * \note This function requires implementing the optional BSP functions to control the INT pin direction
- *       and level for individual sensors (\a chbsp_set_io_dir_in(), \a chbsp_set_io_dir_out(), \a chbsp_io_set(), and
- *       \a chbsp_io_clear()).
+ * De-asserts PROG.  After an error, the I2C bus is reset and the sensor is marked as not connected.
  */
-int chdrv_hw_trigger(ch_dev_t *dev_ptr) {
-	int ch_err = !dev_ptr;
+static int chdrv_program_done(ch_dev_t *dev_ptr, int ch_err) {
 
-	if (!ch_err) {
-		//Disable pin interrupt before triggering pulse
-		chbsp_io_interrupt_disable(dev_ptr);
+	chbsp_program_disable(dev_ptr);				// de-assert PROG pin
 
-		// Generate pulse
-		chbsp_set_io_dir_out(dev_ptr);
-		chbsp_io_set(dev_ptr);
-		chbsp_delay_us(5); 					// Pulse needs to be a minimum of 800ns long  // XXX need define
-		chbsp_io_clear(dev_ptr);
-		chbsp_set_io_dir_in(dev_ptr);
+	if (ch_err) { 								// if error, reinitialize I2C bus associated with this device
+		chbsp_debug_toggle(CHDRV_DEBUG_PIN_NUM);
+		chbsp_i2c_reset(dev_ptr);
+		dev_ptr->sensor_connected = 0;     		// only marked as connected if no errors
+	}
+
+	return ch_err;
+}
+
+/*!
+ * \brief Detect, program, and start a sensor.
+ *
+ * \param dev_ptr 		pointer to the ch_dev_t config structure for a sensor
+ *
+ * \return 0 if write to sensor succeeded, non-zero otherwise
+ *
+ * This function probes the I2C bus for the device.  If it is found, the sensor firmware is programmed into the 
+ * device, and the application I2C address is set.  Then the sensor is reset and execution starts.
+ *
+ * Once started, the sensor device will begin an internal initialization and self-test sequence.  The \a chdrv_wait_for_lock()
+ * function may be used to wait for this sequence to complete.
+ *
+ * \note This routine will leave the PROG pin de-asserted when it completes.
+ */
+int chdrv_detect_and_program(ch_dev_t *dev_ptr) {
+	int ch_err = ! dev_ptr;
+	if (ch_err) {
+		return ch_err;
+	}
+
+	chbsp_program_enable(dev_ptr);					// assert PROG pin
 
-		// Delay a bit before re-enabling pin interrupt to avoid possibly triggering on falling-edge noise
-		chbsp_delay_us(10);			// XXX need define
+	ch_err = chdrv_detect(dev_ptr);
 
-		chbsp_io_interrupt_enable(dev_ptr);
+	if (!ch_err && dev_ptr->sensor_connected) {
+		ch_err = chdrv_load(dev_ptr) ||
+				 chdrv_start_firmware(dev_ptr);
 	}
-	return ch_err;
+
+	return chdrv_program_done(dev_ptr, ch_err);
 }
 
 /*!
- * \brief Write to a sensor programming register.
- * 
- * \param dev_ptr 		pointer to the ch_dev_t config structure for a sensor
- * \param reg_addr 	sensor programming register address.
- * \param data 		8-bit or 16-bit data to transmit.
+ * \brief Put the sensors on a bus into an idle state
  *
- * \return 0 if write to sensor succeeded, non-zero otherwise
+ * \param dev_ptr 		pointer to the ch_dev_t config structure for a sensor, used to identify the target I2C bus
  *
- * This local function writes a value to a sensor programming register.
- */
-int chdrv_prog_write(ch_dev_t *dev_ptr, uint8_t reg_addr, uint16_t data) {
-	/* Set register address write bit */
-	reg_addr |= 0x80;
-	
-	/* Write the register address, followed by the value to be written */
-	uint8_t message[] = { reg_addr, (uint8_t) data, (uint8_t) (data >> 8) };
-
-	/* For the 2-byte registers, we also need to also write MSB after the LSB */
-	return chdrv_prog_i2c_write(dev_ptr, message, (1 + CH_PROG_SIZEOF(reg_addr)));
-}
-
-/*!
- * \brief Write to sensor memory.
- * 
- * \param dev_ptr	pointer to the ch_dev_t config structure for a sensor
- * \param addr		sensor programming register start address
- * \param message	pointer to data to transmit
- * \param nbytes	number of bytes to write
+ * \return 0 if successful, non-zero on error
  *
- * \return 0 if write to sensor succeeded, non-zero otherwise
+ * This function loads a tiny idle loop program to all ASICs on a given i2c bus.  This function assumes that all of the devices
+ * on the given bus are halted in programming mode (i.e. PROG line is asserted).
  *
- * This function writes to sensor memory using the low-level programming interface.  The type 
- * of write is automatically determined based on data length and target address alignment.
+ * \note This routine writes to all devices simultaneously, so I2C signalling (i.e. ack's) on the bus may be driven by multiple
+ * slaves at once.
  */
-int chdrv_prog_mem_write(ch_dev_t *dev_ptr, uint16_t addr, uint8_t *message, uint16_t nbytes) {
-	int ch_err = (nbytes == 0);
+int chdrv_set_idle(ch_dev_t * dev_ptr) {
+	static const uint16_t idle_loop[2] = {0x4003,0xFFFC}; 		// XXX need define
 
+	int ch_err = chdrv_prog_mem_write(dev_ptr, 0xFFFC, (uint8_t *) &idle_loop[0], sizeof(idle_loop));
 	if (!ch_err) {
-		ch_err = chdrv_prog_write(dev_ptr, CH_PROG_REG_ADDR, addr);
+		ch_err = chdrv_reset_and_halt(dev_ptr);
 	}
 
-	if (nbytes == 1 || (nbytes == 2 && !(addr & 1))) {
-		uint16_t data = *((uint16_t*) message);
-		if (!ch_err) {
-			ch_err = chdrv_prog_write(dev_ptr, CH_PROG_REG_DATA, data);
-		}
-		if (!ch_err) {
-			uint8_t opcode = (0x03 | ((nbytes == 1) ? 0x08 : 0x00));			// XXX need define
+	// keep wdt stopped after we exit programming mode
+	uint16_t val = 0x5a80;			// XXX need define
+	if (!ch_err) {
+		ch_err = chdrv_prog_mem_write(dev_ptr, 0x0120, (uint8_t *)&val, sizeof(val));			// XXX need define
+	}
 
-			ch_err = chdrv_prog_write(dev_ptr, CH_PROG_REG_CTL, opcode);
-		}
-	} else {
-		static const uint8_t burst_hdr[2] = {0xC4, 0x0B};			// XXX need define
+	return ch_err;
+}
 
-		if (!ch_err) {
-			ch_err = chdrv_prog_write(dev_ptr, CH_PROG_REG_CNT, (nbytes - 1));
+/* Size of the firmware image of a sensor, in bytes */
+static uint16_t chdrv_fw_size(ch_dev_t *dev_ptr) {
+	return (dev_ptr->part_number == CH101_PART_NUMBER) ? CH101_FW_SIZE : CH201_FW_SIZE;
+}
+
+/* Size of the firmware image of a sensor as stored on the host, in bytes */
+static uint16_t chdrv_fw_stored_size(ch_dev_t *dev_ptr) {
+	return (dev_ptr->fw_lz_size != 0) ? dev_ptr->fw_lz_size : chdrv_fw_size(dev_ptr);
+}
+
+/* Bit reader over a compressed firmware image, MSB first */
+typedef struct {
+	const uint8_t *data;
+	uint32_t bit_pos;
+	uint32_t num_bits;
+	uint8_t	 overrun;		// read past the end of the image
+} chdrv_fw_bits_t;
+
+static uint16_t chdrv_fw_get_bits(chdrv_fw_bits_t *bits_ptr, uint8_t count) {
+	uint16_t value = 0;
+
+	while (count-- > 0) {
+		if (bits_ptr->bit_pos >= bits_ptr->num_bits) {
+			bits_ptr->overrun = 1;
+			break;
 		}
-		if (!ch_err) {
-			ch_err = chdrv_prog_i2c_write(dev_ptr, (uint8_t *) burst_hdr, sizeof(burst_hdr));
+		value = (value << 1) | ((bits_ptr->data[bits_ptr->bit_pos >> 3] >> (7 - (bits_ptr->bit_pos & 7))) & 1);
+		bits_ptr->bit_pos++;
+	}
+	return value;
+}
+
+int chdrv_fw_unpack(ch_dev_t *dev_ptr, chdrv_fw_sink_t sink, void *context) {
+	uint8_t window[CHDRV_FW_LZ_WINDOW];
+	chdrv_fw_bits_t bits = { dev_ptr->firmware, 0, 8 * (uint32_t) dev_ptr->fw_lz_size, 0 };
+	const uint16_t fw_size = chdrv_fw_size(dev_ptr);
+	uint16_t out_pos = 0;
+	uint16_t chunk_pos = 0;
+	int ch_err = 0;
+
+	while (!ch_err && (out_pos < fw_size)) {
+		uint16_t offset = 0;
+		uint16_t count = 1;
+
+		if (chdrv_fw_get_bits(&bits, 1)) {
+			window[out_pos % CHDRV_FW_LZ_WINDOW] = (uint8_t) chdrv_fw_get_bits(&bits, 8);
+		} else {
+			offset = chdrv_fw_get_bits(&bits, CHDRV_FW_LZ_WINDOW_BITS) + 1;
+			count  = chdrv_fw_get_bits(&bits, CHDRV_FW_LZ_LENGTH_BITS) + CHDRV_FW_LZ_MIN_MATCH;
+			ch_err = (offset > out_pos) || (count > (fw_size - out_pos));
 		}
-		if (!ch_err) {
-			ch_err = chdrv_prog_i2c_write(dev_ptr, message, nbytes);
+		ch_err = ch_err || bits.overrun;
+
+		while (!ch_err && (count-- > 0)) {
+			if (offset != 0) {
+				window[out_pos % CHDRV_FW_LZ_WINDOW] = window[(out_pos - offset) % CHDRV_FW_LZ_WINDOW];
+			}
+			out_pos++;
+
+			/* Window full or image complete: pass the chunk on before it is overwritten */
+			if (((out_pos - chunk_pos) == CHDRV_FW_LZ_WINDOW) || (out_pos == fw_size)) {
+				ch_err = sink(context, chunk_pos, window, (out_pos - chunk_pos));
+				chunk_pos = out_pos;
+			}
 		}
 	}
 	return ch_err;
 }
 
 /*!
- * \brief Read from a sensor programming register.
- * 
- * \param dev_ptr 		pointer to the ch_dev_t config structure for a sensor
- * \param reg_addr 	sensor programming register address
- * \param data	 	pointer to a buffer where read bytes will be placed
- *
- * \return 0 if read from sensor succeeded, non-zero otherwise
+ * \brief Compare a block of sensor memory with the expected contents.
  *
- * This local function reads a value from a sensor programming register.
+ * \return 0 if the sensor memory matches, non-zero if it differs or could not be read
  */
-static int chdrv_prog_read(ch_dev_t *dev_ptr, uint8_t reg_addr, uint16_t *data) {
-	uint8_t nbytes = CH_PROG_SIZEOF(reg_addr);
-
-	uint8_t read_data[2];
-	uint8_t message[1] = { 0x7F & reg_addr };
+static int chdrv_verify_block(ch_dev_t *dev_ptr, uint16_t addr, const uint8_t *expected, uint16_t nbytes) {
+	uint8_t read_buf[CHDRV_FW_VERIFY_BLOCK];
+	int ch_err = 0;
 
-	int ch_err = chdrv_prog_i2c_write(dev_ptr, message, sizeof(message));
+	while (!ch_err && (nbytes > 0)) {
+		uint16_t block_bytes = (nbytes > sizeof(read_buf)) ? sizeof(read_buf) : nbytes;
 
-	if (!ch_err) {
-		ch_err = chdrv_prog_i2c_read(dev_ptr, read_data, nbytes);
-	}
+		ch_err = chdrv_prog_mem_read(dev_ptr, addr, read_buf, block_bytes) ||
+				 (memcmp(read_buf, expected, block_bytes) != 0);
 
-	if (!ch_err) {
-		*data = read_data[0];
-		if (nbytes > 1) {
-			*data |= (((uint16_t) read_data[1]) << 8);
-		}
+		addr     += block_bytes;
+		expected += block_bytes;
+		nbytes   -= block_bytes;
 	}
-
 	return ch_err;
 }
+
 /*!
- * \brief Transfer firmware to the sensor on-chip memory.
- * 
- * \param dev_ptr 		pointer to the ch_dev_t config structure for a sensor
+ * \brief Compare a part of the firmware image with sensor program memory.
  *
- * \return 0 if firmware write succeeded, non-zero otherwise
+ * \return 0 if the sensor memory matches, non-zero otherwise
  *
- * This local function writes the sensor firmware image to the device.
+ * Called with the whole image, or for each chunk of a compressed image (\a chdrv_fw_sink_t).  The 
+ * part is only sampled if \a CHDRV_FW_VERIFY_SAMPLED is defined (the default), read back in full otherwise.
  */
-/*!
- */
-static int chdrv_write_firmware(ch_dev_t *dev_ptr) {
-	ch_fw_load_func_t func_ptr = dev_ptr->api_funcs.fw_load;	// pointer to firmware load function
-	int ch_err = ((func_ptr == NULL) || (!dev_ptr->sensor_connected));
+static int chdrv_verify_chunk(void *context, uint16_t offset, const uint8_t *data, uint16_t nbytes) {
+	ch_dev_t *dev_ptr = (ch_dev_t *) context;
+	uint16_t fw_addr = (dev_ptr->part_number == CH101_PART_NUMBER) ? CH101_PROG_MEM_ADDR : CH201_PROG_MEM_ADDR;
+#ifndef CHDRV_FW_VERIFY_SAMPLED
+	return chdrv_verify_block(dev_ptr, (fw_addr + offset), data, nbytes);
+#else
+	uint16_t end = offset + nbytes;
+	uint16_t block = ((offset + CHDRV_FW_VERIFY_STRIDE - 1) / CHDRV_FW_VERIFY_STRIDE) * CHDRV_FW_VERIFY_STRIDE;
+	int ch_err = 0;
 
-#ifdef CHDRV_DEBUG
-	char cbuf[80];
-	uint32_t prog_time;
+	for (; !ch_err && (block < end); block += CHDRV_FW_VERIFY_STRIDE) {
+		uint16_t block_bytes = ((end - block) > CHDRV_FW_VERIFY_SAMPLE) ? CHDRV_FW_VERIFY_SAMPLE : (end - block);
 
-	if (!ch_err) {
-		chbsp_print_str("chdrv_write_firmware\n");
+		ch_err = chdrv_verify_block(dev_ptr, (fw_addr + block), (data + (block - offset)), block_bytes);
 	}
-#endif
 
-	if (!ch_err) {
-#ifdef CHDRV_DEBUG
-		chbsp_print_str("Programming Chirp sensor...\n");
-		prog_time = chbsp_timestamp_ms();
-#endif
-		if (func_ptr != NULL) {
-			ch_err = (*func_ptr)(dev_ptr);
-		} else {
-			ch_err = 1;			// indicate error
-		}
-}
+	if (!ch_err && (end == chdrv_fw_size(dev_ptr)) && (nbytes >= CHDRV_FW_VERIFY_SAMPLE)) {
+		block = end - CHDRV_FW_VERIFY_SAMPLE;
 
-#ifdef CHDRV_DEBUG
-	if (!ch_err) {
-		prog_time = chbsp_timestamp_ms() - prog_time;
-		snprintf(cbuf, sizeof(cbuf), "Wrote %u bytes in %lu ms.\n", CH101_FW_SIZE, prog_time);
-		chbsp_print_str(cbuf);
+		ch_err = chdrv_verify_block(dev_ptr, (fw_addr + block), (data + (block - offset)), 
+									CHDRV_FW_VERIFY_SAMPLE);
 	}
-#endif
 
 	return ch_err;
+#endif
 }
 
 /*!
- * \brief Initialize sensor memory contents.
- * 
+ * \brief Check the firmware image in sensor program memory.
+ *
  * \param dev_ptr 		pointer to the ch_dev_t config structure for a sensor
  *
- * \return 0 if memory write succeeded, non-zero otherwise
+ * \return 0 if the sensor memory matches, non-zero otherwise
  *
- * This local function initializes memory locations in the Chirp sensor, as required by the firmware image.
+ * With \a CHDRV_FW_VERIFY_SAMPLED (the default), one block of \a CHDRV_FW_VERIFY_SAMPLE bytes every 
+ * \a CHDRV_FW_VERIFY_STRIDE bytes, plus the last block, is compared: a small fraction of the download, 
+ * so loading identical sensors together stays cheaper than loading them one by one.  Without it, 
+ * the whole image is read back.  A compressed image is decoded again for the comparison.  The PROG 
+ * pin for the device (only) must be asserted.
  */
-static int chdrv_init_ram(ch_dev_t *dev_ptr) {
-	int ch_err = ! dev_ptr || ! dev_ptr->sensor_connected;
+static int chdrv_verify_firmware(ch_dev_t *dev_ptr) {
 
-#ifdef CHDRV_DEBUG
-	char cbuf[80];
-	uint32_t prog_time;
-	if (!ch_err) {
-		chbsp_print_str("chdrv_init_ram\n");
+	if (dev_ptr->fw_lz_size != 0) {
+		return chdrv_fw_unpack(dev_ptr, chdrv_verify_chunk, dev_ptr);
 	}
-#endif
+	return chdrv_verify_chunk(dev_ptr, 0, dev_ptr->firmware, chdrv_fw_size(dev_ptr));
+}
 
-	if ((!ch_err) && (dev_ptr->get_fw_ram_init_size() != 0)) {		// if size is not zero, ram init data exists
-		uint16_t ram_address;
-		uint16_t ram_bytecount;
+/* Results of chdrv_bus_detect_and_program(), one slot per bus so the buses can run concurrently */
+typedef struct {
+	int		err[CHIRP_NUM_I2C_BUSES];
+	uint8_t	sensor_count[CHIRP_NUM_I2C_BUSES];
+} chdrv_bus_results_t;
 
-		ram_address = dev_ptr->get_fw_ram_init_addr();
-		ram_bytecount = dev_ptr->get_fw_ram_init_size();
+#ifdef CHDRV_FW_BROADCAST
+/* Broadcast download state of a port, see chdrv_bus_broadcast_load() */
+#define CHDRV_BCAST_NONE		0		/* not part of a broadcast, loaded alone */
+#define CHDRV_BCAST_LOADED		1		/* took a broadcast download, to be verified */
+#define CHDRV_BCAST_FAILED		2		/* broadcast download failed, to be loaded alone and verified */
 
-		if (!ch_err) {
-#ifdef CHDRV_DEBUG
-			chbsp_print_str("Loading RAM init data...\n");
-			prog_time = chbsp_timestamp_ms();
-#endif
-			ch_err = chdrv_prog_mem_write(dev_ptr, ram_address, (uint8_t *) dev_ptr->ram_init, ram_bytecount);
-#ifdef CHDRV_DEBUG
-			if (!ch_err) {
-				prog_time = chbsp_timestamp_ms() - prog_time;
-				snprintf(cbuf, sizeof(cbuf), "Wrote %u bytes in %lu ms.\n", sizeof(message), prog_time);
-				chbsp_print_str(cbuf);
-			}
-#endif
-		}
-	}
-	return ch_err;
+/*!
+ * \brief Check whether two sensors are loaded with the same data.
+ *
+ * \param dev_a_ptr	pointer to the ch_dev_t config structure for a sensor
+ * \param dev_b_ptr	pointer to the ch_dev_t config structure for another sensor
+ *
+ * \return 1 if the firmware image, RAM init data and load function are the same, 0 otherwise
+ */
+static uint8_t chdrv_same_image(ch_dev_t *dev_a_ptr, ch_dev_t *dev_b_ptr) {
+	return (dev_a_ptr->part_number == dev_b_ptr->part_number) &&
+		   (dev_a_ptr->firmware == dev_b_ptr->firmware) &&
+		   (dev_a_ptr->ram_init == dev_b_ptr->ram_init) &&
+		   (dev_a_ptr->get_fw_ram_init_size == dev_b_ptr->get_fw_ram_init_size) &&
+		   (dev_a_ptr->get_fw_ram_init_addr == dev_b_ptr->get_fw_ram_init_addr) &&
+		   (dev_a_ptr->api_funcs.fw_load == dev_b_ptr->api_funcs.fw_load);
 }
 
 /*!
- * \brief Reset and halt a sensor
- * 
+ * \brief Check the data loaded into a sensor by a broadcast download.
+ *
  * \param dev_ptr 		pointer to the ch_dev_t config structure for a sensor
- * 
- * \return 0 if write to sensor succeeded, non-zero otherwise
  *
- * This function resets and halts a sensor device by writing to the control registers.
+ * \return 0 if the sensor memory matches, non-zero otherwise
  *
- * In order for the device to respond, the PROG pin for the device must be asserted before this function is called. 
+ * The RAM init data and the firmware image are read back (see \a chdrv_verify_firmware()).
+ * The PROG pin for the device (only) must be asserted.
  */
-static int chdrv_reset_and_halt(ch_dev_t * dev_ptr) {
-	int ch_err = chdrv_prog_write(dev_ptr, CH_PROG_REG_CPU, 0x40);    	// reset asic			// XXX need define
+static int chdrv_verify_load(ch_dev_t *dev_ptr) {
+	int ch_err = 0;
 
-	ch_err |= chdrv_prog_write(dev_ptr, CH_PROG_REG_CPU, 0x11);   		// halt asic and disable watchdog;			// XXX need define
+	if (dev_ptr->get_fw_ram_init_size() != 0) {
+		ch_err = chdrv_verify_block(dev_ptr, dev_ptr->get_fw_ram_init_addr(), dev_ptr->ram_init, 
+									dev_ptr->get_fw_ram_init_size());
+	}
 
-	return ch_err;
+	return ch_err || chdrv_verify_firmware(dev_ptr);
 }
 
 /*!
- * \brief Detect a connected sensor. 
- * 
- * \param dev_ptr 		pointer to the ch_dev_t config structure for a sensor
- * 
- * \return 1 if sensor is found, 0 if no sensor is found
- *
- * This function checks for a sensor sensor on the I2C bus by attempting to reset, halt, and read from the device using
- * the programming interface I2C address (0x45). 
+ * \brief Load identical sensors on one I2C bus in one pass.
  *
- * In order for the device to respond, the PROG pin for the device must be asserted before this function is called. 
+ * \param grp_ptr 		pointer to the ch_group_t config structure for a group of sensors
+ * \param bus_index		index of the I2C bus
+ * \param loaded		array, one entry per port, set to the CHDRV_BCAST_* state of each sensor
+ *
+ * Connected sensors on the bus with the same firmware image (see \a chdrv_same_image()) get PROG 
+ * asserted together, and the RAM init data and firmware are written once: every sensor in 
+ * programming mode takes the writes to \a CH_I2C_ADDR_PROG.  Sensors loaded alone are left to 
+ * the normal per-sensor download.  If the broadcast fails, the bus is reset so that the members 
+ * can be loaded one at a time.
  */
-int chdrv_prog_ping(ch_dev_t *dev_ptr) {
-	// Try a dummy write to the sensor to make sure it's connected and working
-	uint16_t tmp;
-	int ch_err;
+static void chdrv_bus_broadcast_load(ch_group_t *grp_ptr, uint8_t bus_index, uint8_t *loaded) {
 
-    ch_err = chdrv_reset_and_halt(dev_ptr);
+	for (uint8_t i = 0; i < grp_ptr->num_ports; i++) {
+		ch_dev_t *lead_ptr = grp_ptr->device[i];
+		uint8_t members[CHIRP_MAX_NUM_SENSORS];
+		uint8_t num_members = 0;
 
-    ch_err |= chdrv_prog_read(dev_ptr, CH_PROG_REG_PING, &tmp);
+		if ((lead_ptr->i2c_bus_index != bus_index) || !lead_ptr->sensor_connected || loaded[i]) {
+			continue;
+		}
 
-#ifdef CHDRV_DEBUG
-	if (!ch_err) {
-		char cbuf[80];
-		snprintf(cbuf, sizeof(cbuf), "Test I2C read: %04X\n", tmp);
-		chbsp_print_str(cbuf);
-	}
-#endif
+		for (uint8_t j = i; j < grp_ptr->num_ports; j++) {
+			ch_dev_t *dev_ptr = grp_ptr->device[j];
 
-	return !(ch_err);
+			if ((dev_ptr->i2c_bus_index == bus_index) && dev_ptr->sensor_connected && !loaded[j] &&
+				chdrv_same_image(lead_ptr, dev_ptr)) {
+				members[num_members++] = j;
+			}
+		}
+
+		if (num_members < 2) {
+			continue;
+		}
+
+		for (uint8_t m = 0; m < num_members; m++) {
+			chbsp_program_enable(grp_ptr->device[members[m]]);		// assert PROG pin
+			chdrv_reg_cache_invalidate(grp_ptr->device[members[m]]);
+		}
+
+		const uint32_t ram_cycles = chdrv_profile_get(lead_ptr, CH_BOOT_PHASE_RAM_INIT);
+		const uint32_t fw_cycles = chdrv_profile_get(lead_ptr, CH_BOOT_PHASE_FW_WRITE);
+		int ch_err = chdrv_load(lead_ptr);
+
+		for (uint8_t m = 0; m < num_members; m++) {
+			ch_dev_t *dev_ptr = grp_ptr->device[members[m]];
+
+			chbsp_program_disable(dev_ptr);			// de-assert PROG pin
+			loaded[members[m]] = ch_err ? CHDRV_BCAST_FAILED : CHDRV_BCAST_LOADED;
+
+			if (dev_ptr != lead_ptr) {				// the download counts for every sensor that took it
+				chdrv_profile_add(dev_ptr, CH_BOOT_PHASE_RAM_INIT, ram_cycles, 
+								  chdrv_profile_get(lead_ptr, CH_BOOT_PHASE_RAM_INIT));
+				chdrv_profile_add(dev_ptr, CH_BOOT_PHASE_FW_WRITE, fw_cycles, 
+								  chdrv_profile_get(lead_ptr, CH_BOOT_PHASE_FW_WRITE));
+			}
+		}
+
+		if (ch_err) {
+			chbsp_i2c_reset(lead_ptr);				// a sensor may still hold the bus mid-transfer
+		}
+	}
 }
 
-/*!
- * \brief Detect, program, and start a sensor.
- *
- * \param dev_ptr 		pointer to the ch_dev_t config structure for a sensor
- *
- * \return 0 if write to sensor succeeded, non-zero otherwise
- *
- * This function probes the I2C bus for the device.  If it is found, the sensor firmware is programmed into the 
- * device, and the application I2C address is set.  Then the sensor is reset and execution starts.
- *
- * Once started, the sensor device will begin an internal initialization and self-test sequence.  The \a chdrv_wait_for_lock()
- * function may be used to wait for this sequence to complete.
+/*!
+ * \brief Detect and program the sensors on one I2C bus.
  *
- * \note This routine will leave the PROG pin de-asserted when it completes.
+ * \param grp_ptr 		pointer to the ch_group_t config structure for a group of sensors
+ * \param bus_index		index of the I2C bus
+ * \param arg			pointer to the chdrv_bus_results_t receiving the bus result
+ *
+ * All sensors on the bus are detected first, then identical sensors are loaded together 
+ * (see \a chdrv_bus_broadcast_load()).  Each sensor is then started on its own, after its memory 
+ * has been checked against the image.  A sensor that does not match, or whose broadcast failed, 
+ * is loaded again by itself after a bus reset and checked again.  Programming stops at the first 
+ * error.  Only the sensors and result slot of this bus are touched, 
+ * so this runs concurrently for different buses.
  */
-int chdrv_detect_and_program(ch_dev_t *dev_ptr) {
-	int ch_err = ! dev_ptr;
-	if (ch_err) {
-		return ch_err;
-	}
+static void chdrv_bus_detect_and_program(ch_group_t *grp_ptr, uint8_t bus_index, void *arg) {
+	chdrv_bus_results_t *results = (chdrv_bus_results_t *) arg;
+	uint8_t loaded[CHIRP_MAX_NUM_SENSORS];
+	int ch_err = 0;
 
-	chbsp_program_enable(dev_ptr);					// assert PROG pin
+	memset(loaded, CHDRV_BCAST_NONE, sizeof(loaded));
 
-	if (chdrv_prog_ping(dev_ptr)) {					// if device found
-		dev_ptr->sensor_connected = 1;
+	for (uint8_t i = 0; !ch_err && (i < grp_ptr->num_ports); i++) {
+		ch_dev_t *dev_ptr = grp_ptr->device[i];
 
-		// Call device discovery hook routine, if any
-		chdrv_discovery_hook_t hook_ptr = dev_ptr->group->disco_hook;
-		if (hook_ptr != NULL) {
-			ch_err = (*hook_ptr)(dev_ptr);		// hook routine can return error, will abort device init
+		if (dev_ptr->i2c_bus_index != bus_index) {
+			continue;
 		}
 
-#ifdef CHDRV_DEBUG
-		char cbuf[80];
-		if (!ch_err) {
-			uint16_t prog_stat = UINT16_MAX;
-			ch_err = chdrv_prog_read(dev_ptr, CH_PROG_REG_STAT, &prog_stat);
-			snprintf(cbuf, sizeof(cbuf), "PROG_STAT: 0x%02X\n", prog_stat);
-			chbsp_print_str(cbuf);
+		chbsp_program_enable(dev_ptr);				// assert PROG pin
+		ch_err = chdrv_detect(dev_ptr);
+		if (ch_err) {
+			chdrv_program_done(dev_ptr, ch_err);
+		} else {
+			chbsp_program_disable(dev_ptr);			// de-assert PROG pin
 		}
-#endif
+	}
 
-		ch_err = chdrv_init_ram(dev_ptr) ||                // init ram values
-				 chdrv_write_firmware(dev_ptr) ||          // transfer program
-				 chdrv_reset_and_halt(dev_ptr); 			// reset asic, since it was running mystery code before halt
+	if (!ch_err) {
+		chdrv_bus_broadcast_load(grp_ptr, bus_index, loaded);
+	}
 
-#ifdef CHDRV_DEBUG
-		if (!ch_err) {
-			snprintf(cbuf, sizeof(cbuf), "Changing I2C address to %u\n", dev_ptr->i2c_address);
-			chbsp_print_str(cbuf);
+	for (uint8_t i = 0; !ch_err && (i < grp_ptr->num_ports); i++) {
+		ch_dev_t *dev_ptr = grp_ptr->device[i];
+
+		if ((dev_ptr->i2c_bus_index != bus_index) || !dev_ptr->sensor_connected) {
+			continue;
 		}
-#endif
 
-		if (!ch_err ) {
-			ch_err = chdrv_prog_mem_write(dev_ptr, 0x01C5, &dev_ptr->i2c_address, 1);			// XXX need define
+		chbsp_program_enable(dev_ptr);				// assert PROG pin
+
+		if (loaded[i] == CHDRV_BCAST_LOADED) {
+			uint32_t start = chdrv_profile_now();	// the readback is part of writing the firmware
+			int verify_err = chdrv_verify_load(dev_ptr);
+
+			chdrv_profile_add(dev_ptr, CH_BOOT_PHASE_FW_WRITE, start, chdrv_profile_now());
+			if (verify_err) {
+				chbsp_i2c_reset(dev_ptr);			// broadcast did not take, start the reload from a clean bus
+				loaded[i] = CHDRV_BCAST_FAILED;
+			}
 		}
+		if (loaded[i] == CHDRV_BCAST_NONE) {
+			ch_err = chdrv_load(dev_ptr);
+		} else if (loaded[i] == CHDRV_BCAST_FAILED) {
+			ch_err = chdrv_load(dev_ptr);
+			if (!ch_err) {
+				uint32_t start = chdrv_profile_now();
 
-		/* Run charge pumps */
+				ch_err = chdrv_verify_load(dev_ptr);
+				chdrv_profile_add(dev_ptr, CH_BOOT_PHASE_FW_WRITE, start, chdrv_profile_now());
+			}
+		}
 		if (!ch_err) {
-			uint16_t write_val;
-			write_val = 0x0200;			// XXX need defines
-            ch_err |= chdrv_prog_mem_write(dev_ptr, 0x01A6, (uint8_t *)&write_val, 2);		// PMUT.CNTRL4 = HVVSS_FON
-			chbsp_delay_ms(5);
-			write_val = 0x0600;
-            ch_err = chdrv_prog_mem_write(dev_ptr, 0x01A6, (uint8_t *)&write_val, 2);		// PMUT.CNTRL4 = (HVVSS_FON | HVVDD_FON)
-			chbsp_delay_ms(5);
-			write_val = 0x0000;
-			ch_err |= chdrv_prog_mem_write(dev_ptr, 0x01A6, (uint8_t *)&write_val, 2);		// PMUT.CNTRL4 = 0
+			ch_err = chdrv_start_firmware(dev_ptr);
 		}
+		ch_err = chdrv_program_done(dev_ptr, ch_err);
 
-		if (!ch_err ) {
-			ch_err = chdrv_prog_write(dev_ptr, CH_PROG_REG_CPU, 2);	// Exit programming mode and run the chip
+		if (!ch_err) {
+			results->sensor_count[bus_index]++;
 		}
-	} else {
-		dev_ptr->sensor_connected = 0;				// prog_ping failed - no device found
-	}
-
-	chbsp_program_disable(dev_ptr);				// de-assert PROG pin
-
-	if (ch_err) { 								// if error, reinitialize I2C bus associated with this device
-		chbsp_debug_toggle(CHDRV_DEBUG_PIN_NUM);
-		chbsp_i2c_reset(dev_ptr);
-	}
-
-	if (ch_err) {
-		dev_ptr->sensor_connected = 0;     		// only marked as connected if no errors
 	}
 
-	return ch_err;
+	results->err[bus_index] = ch_err;
 }
-
+#else
 /*!
- * \brief Put the sensors on a bus into an idle state
- *
- * \param dev_ptr 		pointer to the ch_dev_t config structure for a sensor, used to identify the target I2C bus
+ * \brief Detect and program the sensors on one I2C bus.
  *
- * \return 0 if successful, non-zero on error
- *
- * This function loads a tiny idle loop program to all ASICs on a given i2c bus.  This function assumes that all of the devices
- * on the given bus are halted in programming mode (i.e. PROG line is asserted).
+ * \param grp_ptr 		pointer to the ch_group_t config structure for a group of sensors
+ * \param bus_index		index of the I2C bus
+ * \param arg			pointer to the chdrv_bus_results_t receiving the bus result
  *
- * \note This routine writes to all devices simultaneously, so I2C signalling (i.e. ack's) on the bus may be driven by multiple
- * slaves at once.
+ * Sensors on the bus are programmed one after the other, stopping at the first error.  Only the 
+ * sensors and result slot of this bus are touched, so this runs concurrently for different buses.
  */
-int chdrv_set_idle(ch_dev_t * dev_ptr) {
-	static const uint16_t idle_loop[2] = {0x4003,0xFFFC}; 		// XXX need define
+static void chdrv_bus_detect_and_program(ch_group_t *grp_ptr, uint8_t bus_index, void *arg) {
+	chdrv_bus_results_t *results = (chdrv_bus_results_t *) arg;
 
-	int ch_err = chdrv_prog_mem_write(dev_ptr, 0xFFFC, (uint8_t *) &idle_loop[0], sizeof(idle_loop));
-	if (!ch_err) {
-		ch_err = chdrv_reset_and_halt(dev_ptr);
-	}
+	for (uint8_t i = 0; i < grp_ptr->num_ports; i++) {
+		ch_dev_t *dev_ptr = grp_ptr->device[i];
 
-	// keep wdt stopped after we exit programming mode
-	uint16_t val = 0x5a80;			// XXX need define
-	if (!ch_err) {
-		ch_err = chdrv_prog_mem_write(dev_ptr, 0x0120, (uint8_t *)&val, sizeof(val));			// XXX need define
-	}
+		if (dev_ptr->i2c_bus_index != bus_index) {
+			continue;
+		}
 
-	return ch_err;
+		results->err[bus_index] = chdrv_detect_and_program(dev_ptr);
+
+		if (!results->err[bus_index] && dev_ptr->sensor_connected) {
+			results->sensor_count[bus_index]++;
+		}
+
+		if (results->err[bus_index]) {
+			break;
+		}
+	}
 }
+#endif
 
 /*!
  * \brief Detect, program, and start all sensors in a group.
@@ -971,6 +2683,7 @@ int chdrv_set_idle(ch_dev_t * dev_ptr) {
  *
  * This function probes the I2C bus for each device in the group.  For each detected sensor, the sensor firmware is 
  * programmed into the device, and the application I2C address is set.  Then the sensor is reset and execution starts.
+ * Sensors on different I2C buses are programmed in parallel when the BSP supports it (see \a chbsp_i2c_bus_run()).
  *
  * Once started, each sensor device will begin an internal initialization and self-test sequence.  The 
  * \a chdrv_group_wait_for_lock() function may be used to wait for this sequence to complete on all devices in the group.
@@ -978,24 +2691,63 @@ int chdrv_set_idle(ch_dev_t * dev_ptr) {
  * \note This routine will leave the PROG pin de-asserted for all devices in the group when it completes.
  */
 int chdrv_group_detect_and_program(ch_group_t *grp_ptr) {
+	chdrv_bus_results_t results;
 	int ch_err = 0;
 
-	for (uint8_t i = 0; i < grp_ptr->num_ports; i++) {
-		ch_dev_t *dev_ptr = grp_ptr->device[i];
+	memset(&results, 0, sizeof(results));
+	chbsp_i2c_bus_run(grp_ptr, chdrv_bus_detect_and_program, &results);
 
-		ch_err = chdrv_detect_and_program(dev_ptr);
+	for (uint8_t bus_index = 0; bus_index < grp_ptr->num_i2c_buses; bus_index++) {
+		grp_ptr->sensor_count += results.sensor_count[bus_index];
+		ch_err |= results.err[bus_index];
+	}
+	return ch_err;
+}
 
-		if (!ch_err && dev_ptr->sensor_connected) {
-			grp_ptr->sensor_count++;
-		}
 
-		if (ch_err) {
-			break;
-		}
+/*!
+ * \brief Initialize the group I/O state and the I2C interface.
+ *
+ * \param grp_ptr 		pointer to the ch_group_t config structure for a group of sensors
+ *
+ * \return 0 if successful, non-zero otherwise
+ *
+ * Unlike \a chdrv_group_prepare(), this leaves the sensor pins (and so the running sensors) alone.
+ */
+static int chdrv_group_io_init(ch_group_t *grp_ptr) {
+
+	grp_ptr->sensor_count = 0;
+
+	for (uint8_t i = 0; i < grp_ptr->num_i2c_buses; i++) {
+		grp_ptr->i2c_queue[i].len = 0;
+		grp_ptr->i2c_queue[i].idx = 0;
+		grp_ptr->i2c_queue[i].read_pending = 0;
+		grp_ptr->i2c_queue[i].running = 0;
 	}
-	return ch_err;
+
+	return chbsp_i2c_init();
 }
 
+/*!
+ * \brief Count the connected sensors on each I2C bus.
+ *
+ * \param grp_ptr 		pointer to the ch_group_t config structure for a group of sensors
+ */
+static void chdrv_group_count_connected(ch_group_t *grp_ptr) {
+
+	/* Put counts of connected devices per bus in group struct */
+	for (int bus_num = 0; bus_num < grp_ptr->num_i2c_buses; bus_num++) {
+		grp_ptr->num_connected[bus_num] = 0;						// init all counts
+	}
+
+	for (int dev_num = 0; dev_num < grp_ptr->num_ports; dev_num++) {
+		ch_dev_t *dev_ptr = grp_ptr->device[dev_num];
+
+		if (dev_ptr->sensor_connected) {
+			grp_ptr->num_connected[dev_ptr->i2c_bus_index] += 1;	// count one more on this bus
+		}
+	}
+}
 
 /*!
  * \brief Initialize data structures and hardware for sensor interaction.
@@ -1009,24 +2761,117 @@ int chdrv_group_detect_and_program(ch_group_t *grp_ptr) {
  */
 int chdrv_group_prepare(ch_group_t* grp_ptr) {
 	int ch_err = ! grp_ptr;
-	uint8_t i;
 
 	if (!ch_err) {
-		grp_ptr->sensor_count = 0;
+		chbsp_group_pin_init(grp_ptr);
 
-		for (i = 0; i < grp_ptr->num_i2c_buses; i++) {
-			grp_ptr->i2c_queue[i].len = 0;
-			grp_ptr->i2c_queue[i].idx = 0;
-			grp_ptr->i2c_queue[i].read_pending = 0;
-			grp_ptr->i2c_queue[i].running = 0;
+		ch_err = chdrv_group_io_init(grp_ptr);
+	}
+
+	return ch_err;
+}
+
+#define CHDRV_RETAINED_MAGIC	(0x43485753)	// "CHWS"
+
+/* 32-bit FNV-1a hash */
+static uint32_t chdrv_checksum(const uint8_t *data, uint16_t nbytes) {
+	uint32_t hash = 2166136261u;
+
+	while (nbytes--) {
+		hash = (hash ^ *data++) * 16777619u;
+	}
+	return hash;
+}
+
+/* Checksum of the firmware image of a sensor, kept in the descriptor for chdrv_group_retain() */
+static void chdrv_fw_checksum_update(ch_dev_t *dev_ptr) {
+	dev_ptr->fw_checksum = chdrv_checksum(dev_ptr->firmware, chdrv_fw_stored_size(dev_ptr));
+}
+
+static uint32_t chdrv_retained_checksum(const chdrv_retained_t *saved_ptr) {
+	return chdrv_checksum((const uint8_t *) saved_ptr, (sizeof(chdrv_retained_t) - sizeof(saved_ptr->checksum)));
+}
+
+/*!
+ * \brief Save the start-up state of a group for \a chdrv_group_warm_start().
+ *
+ * \param grp_ptr 		pointer to the ch_group_t config structure for a group of sensors
+ *
+ * Called at the end of \a chdrv_group_start(), and again after every background calibration 
+ * (\a chdrv_group_measure_rtc_finish()) so a warm start restores the current calibration values.
+ */
+static void chdrv_group_retain(ch_group_t *grp_ptr) {
+	chdrv_retained_t *saved_ptr = chbsp_retained_mem(sizeof(chdrv_retained_t));
+
+	if (saved_ptr == NULL) {
+		return;
+	}
+
+	memset(saved_ptr, 0, sizeof(chdrv_retained_t));
+	saved_ptr->magic = CHDRV_RETAINED_MAGIC;
+	saved_ptr->rtc_cal_pulse_ms = grp_ptr->rtc_cal_pulse_ms;
+	saved_ptr->num_ports = grp_ptr->num_ports;
+
+	for (uint8_t i = 0; i < grp_ptr->num_ports; i++) {
+		ch_dev_t *dev_ptr = grp_ptr->device[i];
+		chdrv_retained_dev_t *dev_saved_ptr = &(saved_ptr->dev[i]);
+
+		if (dev_ptr->sensor_connected) {
+			ch_cal_result_t cal;
+
+			chdrv_cal_get(dev_ptr, &cal);
+			dev_saved_ptr->connected = 1;
+			dev_saved_ptr->i2c_address = dev_ptr->app_i2c_address;
+			dev_saved_ptr->part_number = dev_ptr->part_number;
+			dev_saved_ptr->fw_checksum = dev_ptr->fw_checksum;
+			dev_saved_ptr->op_frequency = cal.op_frequency;
+			dev_saved_ptr->rtc_cal_result = cal.rtc_cal_result;
+			dev_saved_ptr->bandwidth = cal.bandwidth;
+			dev_saved_ptr->scale_factor = cal.scale_factor;
 		}
+	}
 
-		chbsp_group_pin_init(grp_ptr);
+	saved_ptr->checksum = chdrv_retained_checksum(saved_ptr);
+}
 
-		ch_err = chbsp_i2c_init();
+/* Drop the saved start-up state, the sensors are about to be restarted */
+static void chdrv_group_forget(void) {
+	chdrv_retained_t *saved_ptr = chbsp_retained_mem(sizeof(chdrv_retained_t));
+
+	if (saved_ptr != NULL) {
+		saved_ptr->magic = 0;
 	}
+}
 
-	return ch_err;
+/*!
+ * \brief Check the saved start-up state against a group.
+ *
+ * \param grp_ptr 		pointer to the ch_group_t config structure for a group of sensors
+ * \param saved_ptr		pointer to the saved state (may be NULL)
+ *
+ * \return 1 if the state is intact and was saved for the same sensor ports, firmware and settings
+ *
+ * The firmware checksum of each sensor saved as connected is computed here, once per warm start.
+ */
+static uint8_t chdrv_retained_valid(ch_group_t *grp_ptr, const chdrv_retained_t *saved_ptr) {
+	uint8_t valid = (saved_ptr != NULL) && 
+					(saved_ptr->magic == CHDRV_RETAINED_MAGIC) &&
+					(saved_ptr->checksum == chdrv_retained_checksum(saved_ptr)) &&
+					(saved_ptr->num_ports == grp_ptr->num_ports) &&
+					(saved_ptr->rtc_cal_pulse_ms == grp_ptr->rtc_cal_pulse_ms);
+
+	for (uint8_t i = 0; valid && (i < grp_ptr->num_ports); i++) {
+		ch_dev_t *dev_ptr = grp_ptr->device[i];
+		const chdrv_retained_dev_t *dev_saved_ptr = &(saved_ptr->dev[i]);
+
+		if (dev_saved_ptr->connected) {
+			chdrv_fw_checksum_update(dev_ptr);
+			valid = (dev_saved_ptr->i2c_address == dev_ptr->app_i2c_address) &&
+					(dev_saved_ptr->part_number == dev_ptr->part_number) &&
+					(dev_saved_ptr->fw_checksum == dev_ptr->fw_checksum);
+		}
+	}
+	return valid;
 }
 
 /*!
@@ -1046,16 +2891,20 @@ int chdrv_group_prepare(ch_group_t* grp_ptr) {
  */
 #define CH_PROG_XFER_RETRY 4
 int chdrv_group_start(ch_group_t *grp_ptr) {
+	const uint32_t boot_start = chdrv_profile_now();
+	uint32_t phase_start;
 	int ch_err = ! grp_ptr;
 	int i;
 	uint8_t prog_tries = 0;
 #ifdef CHDRV_DEBUG
-	uint8_t i;
 	char cbuf[80];
 	const uint32_t start_time = chbsp_timestamp_ms();
 #endif
 
 	if (!ch_err) {
+		chdrv_group_profile_clear(grp_ptr);
+		chdrv_group_measure_rtc_wait(grp_ptr);		// a background calibration must not outlive the reset
+		chdrv_group_forget();
 		ch_err = chdrv_group_prepare(grp_ptr);
 	}
 
@@ -1065,22 +2914,28 @@ int chdrv_group_start(ch_group_t *grp_ptr) {
 
 RESET_AND_LOAD:
 	do {
+		phase_start = chdrv_profile_now();
 		chbsp_reset_assert();
 		for (i = 0; i < grp_ptr->num_ports; i++) {
 			chbsp_program_enable(grp_ptr->device[i]);
 		}
 		chbsp_delay_ms(1);
 		chbsp_reset_release();
+		chdrv_group_profile_add(grp_ptr, CHDRV_PROFILE_ALL_BUSES, CH_BOOT_PHASE_RESET, phase_start, chdrv_profile_now());
 
 		 /* For every i2c bus, set the devices idle in parallel, then disable programming mode for all devices on that bus
 		  * This is kludgey because we don't have a great way of iterating over the i2c buses */
 		ch_dev_t * c_prev = grp_ptr->device[0];
+		phase_start = chdrv_profile_now();
 		chdrv_set_idle(c_prev);
+		chdrv_group_profile_add(grp_ptr, c_prev->i2c_bus_index, CH_BOOT_PHASE_IDLE, phase_start, chdrv_profile_now());
 		for (i = 0; i < grp_ptr->num_ports; i++) {
 			ch_dev_t * c = grp_ptr->device[i];
 
 			if (c->i2c_bus_index != c_prev->i2c_bus_index) {
+				phase_start = chdrv_profile_now();
 				chdrv_set_idle(c);
+				chdrv_group_profile_add(grp_ptr, c->i2c_bus_index, CH_BOOT_PHASE_IDLE, phase_start, chdrv_profile_now());
 			}
 
 			chbsp_program_disable(c);
@@ -1100,10 +2955,10 @@ RESET_AND_LOAD:
 			snprintf(cbuf, sizeof(cbuf), "Sensor count: %u, %lu ms.\n", grp_ptr->sensor_count, chbsp_timestamp_ms() - start_time);
 			chbsp_print_str(cbuf);
 			for (i = 0; i < grp_ptr->num_ports; i++) {
-				if (grp_ptr->device[i].sensor_connected)
+				if (grp_ptr->device[i]->sensor_connected)
 				{
 					snprintf(cbuf, sizeof(cbuf), "Chirp sensor initialized on I2C addr %u:%u.\n", 
-							 grp_ptr->device[i].i2c_bus_index, grp_ptr->device[i].i2c_address);
+							 grp_ptr->device[i]->i2c_bus_index, grp_ptr->device[i]->i2c_address);
 					chbsp_print_str(cbuf);
 				}
 			}
@@ -1126,35 +2981,173 @@ RESET_AND_LOAD:
 
 		chbsp_delay_ms(1);
 
-		chdrv_group_measure_rtc(grp_ptr);
+		phase_start = chdrv_profile_now();
+		chdrv_group_recal_reset(grp_ptr);
+		if (!chdrv_group_cal_restore(grp_ptr)) {
+			chdrv_group_measure_rtc_start(grp_ptr);		// cached values in use, refresh them in the background
+		} else {
+			chdrv_group_measure_rtc(grp_ptr);
+			chdrv_group_cal_store(grp_ptr);
+		}
+		for (i = 0; i < grp_ptr->num_ports; i++) {
+			if (grp_ptr->device[i]->sensor_connected) {
+				chdrv_profile_add(grp_ptr->device[i], CH_BOOT_PHASE_RTC_CAL, phase_start, chdrv_profile_now());
+			}
+		}
 
 #ifdef CHDRV_DEBUG
 		snprintf(cbuf, sizeof(cbuf), "RTC calibrated, %lu ms\n", chbsp_timestamp_ms() - start_time);
 		chbsp_print_str(cbuf);
 
 		for (i = 0; i < grp_ptr->num_ports; i++) {
-			if (grp_ptr->device[i].sensor_connected)
+			if (grp_ptr->device[i]->sensor_connected)
 			{
-				snprintf(cbuf, sizeof(cbuf), "Cal result: %u\n", grp_ptr->device[i].rtc_cal_result);
+				snprintf(cbuf, sizeof(cbuf), "Cal result: %u\n", grp_ptr->device[i]->rtc_cal_result);
 				chbsp_print_str(cbuf);
 			}
 		}
 #endif
 	}
 
-	/* Put counts of connected devices per bus in group struct */
-	for (int bus_num = 0; bus_num < grp_ptr->num_i2c_buses; bus_num++) {
-		grp_ptr->num_connected[bus_num] = 0;						// init all counts
+	chdrv_group_count_connected(grp_ptr);
+
+	if (!ch_err) {
+		for (i = 0; i < grp_ptr->num_ports; i++) {
+			if (grp_ptr->device[i]->sensor_connected) {
+				chdrv_fw_checksum_update(grp_ptr->device[i]);	// once, not at every recalibration
+			}
+		}
+		chdrv_group_retain(grp_ptr);
 	}
 
-	for (int dev_num = 0; dev_num < grp_ptr->num_ports; dev_num++) {
-		ch_dev_t *dev_ptr = grp_ptr->device[dev_num];
+	chdrv_group_profile_end(grp_ptr, boot_start);
 
-		if (dev_ptr->sensor_connected) {
-			grp_ptr->num_connected[dev_ptr->i2c_bus_index] += 1;	// count one more on this bus
+	return ch_err;
+}
+
+/*!
+ * \brief Compare the ends of the firmware image with sensor program memory.
+ *
+ * \return 0 if the sensor memory matches, non-zero otherwise
+ *
+ * Called with the whole image, or for each chunk of a compressed image (\a chdrv_fw_sink_t).  Only 
+ * the first and last \a CHDRV_WARM_VERIFY_SAMPLE bytes are read, the image checksum saved at the 
+ * last full start already matches the host's.
+ */
+static int chdrv_warm_verify_chunk(void *context, uint16_t offset, const uint8_t *data, uint16_t nbytes) {
+	ch_dev_t *dev_ptr = (ch_dev_t *) context;
+	uint16_t fw_addr = (dev_ptr->part_number == CH101_PART_NUMBER) ? CH101_PROG_MEM_ADDR : CH201_PROG_MEM_ADDR;
+	uint16_t sample_bytes = (nbytes > CHDRV_WARM_VERIFY_SAMPLE) ? CHDRV_WARM_VERIFY_SAMPLE : nbytes;
+	int ch_err = 0;
+
+	if (offset == 0) {
+		ch_err = chdrv_verify_block(dev_ptr, fw_addr, data, sample_bytes);
+	}
+	if (!ch_err && ((offset + nbytes) == chdrv_fw_size(dev_ptr))) {
+		ch_err = chdrv_verify_block(dev_ptr, (fw_addr + offset + nbytes - sample_bytes), 
+									(data + nbytes - sample_bytes), sample_bytes);
+	}
+	return ch_err;
+}
+
+/*!
+ * \brief Check whether a sensor is still running its firmware and restore its calibration.
+ *
+ * \param dev_ptr 		pointer to the ch_dev_t config structure for a sensor
+ * \param saved_ptr		pointer to the state saved for the sensor at the last full start
+ *
+ * \return 0 if the sensor is running the expected firmware, non-zero otherwise
+ *
+ * The sensor must answer on its application I2C address with frequency lock, and the ends of its 
+ * program memory must match the firmware image (see \a chdrv_warm_verify_chunk()).  The PROG pin 
+ * is only asserted for those two short reads.
+ */
+static int chdrv_warm_resume(ch_dev_t *dev_ptr, const chdrv_retained_dev_t *saved_ptr) {
+	int ch_err;
+
+	dev_ptr->i2c_address = dev_ptr->app_i2c_address;
+	dev_ptr->sensor_connected = 1;
+	chdrv_reg_cache_invalidate(dev_ptr);			// configuration left by the previous run is unknown
+
+	ch_err = !dev_ptr->get_locked_state(dev_ptr);
+
+	if (!ch_err) {
+		chbsp_program_enable(dev_ptr);				// assert PROG pin
+		if (dev_ptr->fw_lz_size != 0) {
+			ch_err = chdrv_fw_unpack(dev_ptr, chdrv_warm_verify_chunk, dev_ptr);
+		} else {
+			ch_err = chdrv_warm_verify_chunk(dev_ptr, 0, dev_ptr->firmware, chdrv_fw_size(dev_ptr));
+		}
+		chbsp_program_disable(dev_ptr);				// de-assert PROG pin
+	}
+
+	if (!ch_err) {
+		dev_ptr->rtc_cal_result = saved_ptr->rtc_cal_result;
+		dev_ptr->op_frequency   = saved_ptr->op_frequency;
+		dev_ptr->bandwidth      = saved_ptr->bandwidth;
+		dev_ptr->scale_factor   = saved_ptr->scale_factor;
+		chdrv_range_prepare(dev_ptr);
+	} else {
+		dev_ptr->sensor_connected = 0;
+	}
+
+	return ch_err;
+}
+
+/*!
+ * \brief Resume a group of sensors that kept running through a host reset.
+ *
+ * \param grp_ptr 		pointer to the ch_group_t config structure for a group of sensors
+ *
+ * \return 0 if successful, non-zero otherwise
+ *
+ * After a reset of the host only (watchdog, firmware update), the sensors are still running the 
+ * firmware and calibration from the last \a chdrv_group_start().  That function saves what it found 
+ * in memory retained by the BSP (see \a chbsp_retained_mem()).  If the saved state matches the 
+ * group and every sensor found then is still running the same firmware, the calibration values 
+ * are restored and the sensors are used as they are: no reset, download, frequency lock wait or 
+ * RTC calibration pulse.
+ *
+ * Otherwise, the group is started from scratch with \a chdrv_group_start().
+ */
+int chdrv_group_warm_start(ch_group_t *grp_ptr) {
+	chdrv_retained_t *saved_ptr = chbsp_retained_mem(sizeof(chdrv_retained_t));
+	int ch_err = ! grp_ptr || (saved_ptr == NULL) || (saved_ptr->magic != CHDRV_RETAINED_MAGIC);
+
+	/* Firmware chosen at start-up: the one bound to the part found by the last full start */
+	for (uint8_t i = 0; !ch_err && (i < grp_ptr->num_ports); i++) {
+		ch_dev_t *dev_ptr = grp_ptr->device[i];
+
+		if (dev_ptr->fw_auto && saved_ptr->dev[i].connected) {
+			ch_err = chdrv_fw_bind(dev_ptr, saved_ptr->dev[i].part_number);
+		}
+	}
+	ch_err = ch_err || ! chdrv_retained_valid(grp_ptr, saved_ptr);
+
+	if (!ch_err) {
+		ch_err = chdrv_group_io_init(grp_ptr);
+	}
+
+	for (uint8_t i = 0; !ch_err && (i < grp_ptr->num_ports); i++) {
+		ch_dev_t *dev_ptr = grp_ptr->device[i];
+
+		if (saved_ptr->dev[i].connected) {
+			ch_err = chdrv_warm_resume(dev_ptr, &(saved_ptr->dev[i]));
+			if (!ch_err) {
+				grp_ptr->sensor_count++;
+			}
+		} else {
+			dev_ptr->sensor_connected = 0;
 		}
 	}
 
+	if (ch_err) {
+		return chdrv_group_start(grp_ptr);			// sensors not as they were left, full start
+	}
+
+	chdrv_group_count_connected(grp_ptr);
+	chdrv_group_recal_reset(grp_ptr);
+
 	return ch_err;
 }
 
@@ -1170,6 +3163,8 @@ RESET_AND_LOAD:
 int chdrv_soft_reset(ch_dev_t *dev_ptr) {
 	int ch_err = RET_ERR;
 
+	chdrv_reg_cache_invalidate(dev_ptr);			// registers return to firmware defaults
+
 	if (dev_ptr->sensor_connected) {
 		chbsp_program_enable(dev_ptr);
 
@@ -1207,6 +3202,8 @@ int chdrv_group_hard_reset(ch_group_t *grp_ptr) {
     for (uint8_t i = 0; i < grp_ptr->num_ports; i++) {
         ch_dev_t *dev_ptr = grp_ptr->device[i];
 
+        chdrv_reg_cache_invalidate(dev_ptr);
+
         int ch_err = chdrv_soft_reset(dev_ptr);
 
 		if (ch_err) {
@@ -34,10 +34,83 @@ __attribute__((weak)) uint32_t chbsp_timestamp_ms() {
 	return 0;
 }
 
+__attribute__((weak)) uint32_t chbsp_cycle_count(void) {
+	return chbsp_timestamp_ms();
+}
+
+__attribute__((weak)) uint32_t chbsp_cycles_to_us(uint32_t cycles) {
+	return cycles * 1000;
+}
+
+__attribute__((weak)) void chbsp_proc_wakeup(void) {}
+
 __attribute__((weak)) int chbsp_i2c_deinit(void){
 	return 0;
 }
 
+__attribute__((weak)) int chbsp_i2c_probe(ch_dev_t *dev_ptr, uint8_t *data, uint16_t num_bytes) {
+	return chbsp_i2c_write(dev_ptr, data, num_bytes);
+}
+
+__attribute__((weak)) void chbsp_i2c_reset(ch_dev_t *dev_ptr) {
+	(void)(dev_ptr);
+}
+
+__attribute__((weak)) void chbsp_i2c_bus_run(ch_group_t *grp_ptr, ch_bus_task_t task, void *arg) {
+	for (uint8_t bus_index = 0; bus_index < grp_ptr->num_i2c_buses; bus_index++) {
+		task(grp_ptr, bus_index, arg);
+	}
+}
+
+__attribute__((weak)) void *chbsp_retained_mem(uint16_t size) {
+	(void)(size);
+	return NULL;
+}
+
+__attribute__((weak)) uint16_t chbsp_part_number(ch_dev_t *dev_ptr) {
+	(void)(dev_ptr);
+	return 0;
+}
+
+__attribute__((weak)) uint8_t chbsp_rtc_cal_timer_start(ch_group_t *grp_ptr, uint16_t pulse_ms) {
+	(void)(grp_ptr);
+	(void)(pulse_ms);
+	return 1;
+}
+
+__attribute__((weak)) uint8_t chbsp_rtc_cal_work_schedule(ch_group_t *grp_ptr, uint16_t delay_ms) {
+	(void)(grp_ptr);
+	(void)(delay_ms);
+	return 1;
+}
+
+__attribute__((weak)) int chbsp_cal_load(ch_dev_t *dev_ptr, ch_cal_result_t *cal_ptr) {
+	(void)(dev_ptr);
+	(void)(cal_ptr);
+	return 1;
+}
+
+__attribute__((weak)) void chbsp_cal_store(ch_dev_t *dev_ptr, const ch_cal_result_t *cal_ptr) {
+	(void)(dev_ptr);
+	(void)(cal_ptr);
+}
+
+__attribute__((weak)) uint32_t chbsp_critical_enter(void) {
+	return 0;
+}
+
+__attribute__((weak)) void chbsp_critical_exit(uint32_t key) {
+	(void)(key);
+}
+
+__attribute__((weak)) void chbsp_led_on(uint8_t dev_num) {
+	(void)(dev_num);
+}
+
+__attribute__((weak)) void chbsp_led_off(uint8_t dev_num) {
+	(void)(dev_num);
+}
+
 
 /* Functions supporting interrupt-based operation */
 
@@ -67,6 +140,16 @@ __attribute__((weak)) int chbsp_i2c_write_nb(ch_dev_t *dev_ptr, uint8_t *data, u
 	return 1;
 }
 
+__attribute__((weak)) 
+	int chbsp_i2c_write_hdr(ch_dev_t *dev_ptr, uint8_t *hdr, uint16_t hdr_bytes, uint8_t *data, uint16_t num_bytes) {
+	(void)(dev_ptr);
+	(void)(hdr);
+	(void)(hdr_bytes);
+	(void)(data);
+	(void)(num_bytes);
+	return 1;
+}
+
 __attribute__((weak)) 
 	int chbsp_i2c_mem_write_nb(ch_dev_t *dev_ptr, uint16_t mem_addr, uint8_t *data, uint16_t num_bytes) {
 	(void)(dev_ptr);
@@ -9,6 +9,18 @@
 #include "../inc/zy_i2c.h"
 #include "../inc/zy_sleep.h"
 #include "../inc/soniclib.h"
+#include <zephyr/linker/section_tags.h>
+#ifdef CONFIG_TIMING_FUNCTIONS
+#include <zephyr/timing/timing.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#ifdef CONFIG_SETTINGS
+#include <zephyr/settings/settings.h>
+#endif
+#if DT_NODE_HAS_PROP(CHIRP_BOARD_NODE, temperature_sensor)
+#include <zephyr/drivers/sensor.h>
+#endif
 /*
     TODO:
 #include "sleep.h"
@@ -18,98 +30,269 @@
 #include "uart.h"
 */
 
-//void (*ch_io_int_callback_t)(ch_group_t *grp_ptr, uint8_t io_index);
+// Group served by this board, needed to report non-blocking I/O completion through ch_io_notify()
+static ch_group_t *bsp_grp_ptr;
+static ch_io_int_callback_t io_int_callback;
+
+/*
+    Per-bus tasks (chbsp_i2c_bus_run): bus 0 runs in the calling thread, every
+    other bus in its own thread at the caller's priority.
+*/
+#define CHBSP_BUS_TASK_STACK_SIZE   2048
+
+struct chbsp_bus_task {
+    ch_group_t *grp_ptr;
+    ch_bus_task_t task;
+    void *arg;
+    uint8_t bus_index;
+};
+
+K_THREAD_STACK_ARRAY_DEFINE(bsp_bus_task_stack, CHIRP_NUM_I2C_BUSES, CHBSP_BUS_TASK_STACK_SIZE);
+static struct k_thread bsp_bus_task_thread[CHIRP_NUM_I2C_BUSES];
+static struct chbsp_bus_task bsp_bus_task[CHIRP_NUM_I2C_BUSES];
+
+// Periodic timer and wake-up of chbsp_proc_sleep() by chbsp_proc_wakeup()
+static void chbsp_periodic_timer_expiry(struct k_timer *timer);
+static K_TIMER_DEFINE(periodic_timer, chbsp_periodic_timer_expiry, NULL);
+static K_SEM_DEFINE(bsp_wakeup, 0, 1);
+static ch_timer_callback_t periodic_timer_callback;
+static uint16_t periodic_timer_interval_ms;
+static uint8_t periodic_timer_irq_enabled;
+
+/*
+    BSP work queue: calibration readout and storage do blocking I2C and flash
+    writes, too much for the system work queue stack. Same priority as the
+    system work queue, so the readout timing is unchanged.
+*/
+#define CHBSP_WORKQ_STACK_SIZE      2048
+#define CHBSP_WORKQ_PRIORITY        CONFIG_SYSTEM_WORKQUEUE_PRIORITY
+
+K_THREAD_STACK_DEFINE(bsp_workq_stack, CHBSP_WORKQ_STACK_SIZE);
+static struct k_work_q bsp_workq;
+static bool bsp_workq_started;
+
+// Background RTC calibration: the pulse ends in the timer expiry, the results are read from the BSP work queue
+static void chbsp_rtc_cal_timer_expiry(struct k_timer *timer);
+static void chbsp_rtc_cal_work_handler(struct k_work *work);
+static void chbsp_recal_work_handler(struct k_work *work);
+static K_TIMER_DEFINE(rtc_cal_timer, chbsp_rtc_cal_timer_expiry, NULL);
+static K_WORK_DELAYABLE_DEFINE(rtc_cal_work, chbsp_rtc_cal_work_handler);
+static K_WORK_DELAYABLE_DEFINE(recal_work, chbsp_recal_work_handler);
+static ch_group_t *rtc_cal_grp_ptr;
+
+/*
+    Calibration cache, one settings entry "chirp/cal/<port>" per sensor port.
+    An entry only applies to a sensor with the same part number and I2C
+    address, calibrated with the same pulse length.
+*/
+#define CHBSP_CAL_SETTINGS_TREE     "chirp/cal"
+#define CHBSP_CAL_SAVE_MIN_PPM      500         // smaller rtc_cal_result changes are not written to flash
+
+struct chbsp_cal_entry {
+    uint16_t part_number;
+    uint16_t rtc_cal_pulse_ms;
+    uint8_t i2c_address;
+    ch_cal_result_t cal;
+};
+
+static struct chbsp_cal_entry bsp_cal_cache[CHIRP_MAX_NUM_SENSORS];
+static uint32_t bsp_cal_cache_valid;           // bit n = entry of port n loaded or saved
+
+#if DT_NODE_HAS_PROP(CHIRP_BOARD_NODE, temperature_sensor)
+/*
+    Air temperature (and humidity, if the sensor measures it) read from the BSP
+    work queue and fed to the speed of sound model of the group, which only rebuilds
+    its conversion constants when the change is large enough.
+*/
+static const struct device *const bsp_env_dev = DEVICE_DT_GET(DT_PHANDLE(CHIRP_BOARD_NODE, temperature_sensor));
+static void chbsp_env_work_handler(struct k_work *work);
+static K_WORK_DELAYABLE_DEFINE(env_work, chbsp_env_work_handler);
+
+static void chbsp_env_work_handler(struct k_work *work){
+    struct sensor_value temp;
+    struct sensor_value humidity;
+    uint8_t humidity_pct = CH_HUMIDITY_UNKNOWN;
+
+    if(sensor_sample_fetch(bsp_env_dev) == 0 &&
+       sensor_channel_get(bsp_env_dev, SENSOR_CHAN_AMBIENT_TEMP, &temp) == 0){
+        if(sensor_channel_get(bsp_env_dev, SENSOR_CHAN_HUMIDITY, &humidity) == 0 &&
+           humidity.val1 >= 0 && humidity.val1 <= 100){
+            humidity_pct = humidity.val1;
+        }
+        // 0.01 deg C, the driver limits the range further
+        ch_group_set_temperature(bsp_grp_ptr, (int16_t) CLAMP(temp.val1 * 100 + temp.val2 / 10000, INT16_MIN, INT16_MAX),
+                                 humidity_pct);
+    }
+    k_work_schedule_for_queue(&bsp_workq, &env_work, K_MSEC(DT_PROP(CHIRP_BOARD_NODE, temperature_poll_ms)));
+}
+#endif
 
 
 void chbsp_board_init(ch_group_t *grp_ptr){
 
-    grp_ptr->num_ports = 1;
-    grp_ptr->num_i2c_buses = 1;
-    grp_ptr->rtc_cal_pulse_ms = 200;
+    bsp_grp_ptr = grp_ptr;
+    grp_ptr->num_ports = CHIRP_MAX_NUM_SENSORS;
+    grp_ptr->num_i2c_buses = CHIRP_NUM_I2C_BUSES;
+    grp_ptr->rtc_cal_pulse_ms = DT_PROP(CHIRP_BOARD_NODE, rtc_cal_pulse_ms);
 
-    chbsp_program_enable();
-    chbsp_delay_ms(2);
-    uint8_t buffer[2];
-    zy_i2c_recv_chirp_conf(buffer, 2);
+    zy_gpio_init_all();
+    zy_i2c_init();
+    chbsp_reset_release();
 
-    if(buffer[0] == 0x0A && buffer[1] == 0x02){
-        printk("Chirp pattern detected successfully\n\r");
+    if(!bsp_workq_started){
+        k_work_queue_start(&bsp_workq, bsp_workq_stack, K_THREAD_STACK_SIZEOF(bsp_workq_stack),
+                           CHBSP_WORKQ_PRIORITY, NULL);
+        k_thread_name_set(&bsp_workq.thread, "chbsp_workq");
+        bsp_workq_started = true;
+    }
+
+#ifdef CONFIG_TIMING_FUNCTIONS
+    timing_init();
+    timing_start();
+#endif
+
+#ifdef CONFIG_SETTINGS
+    if(settings_subsys_init() == 0){
+        settings_load_subtree(CHBSP_CAL_SETTINGS_TREE);
+    }
+#endif
+
+#if DT_NODE_HAS_PROP(CHIRP_BOARD_NODE, temperature_sensor)
+    if(device_is_ready(bsp_env_dev)){
+        k_work_schedule_for_queue(&bsp_workq, &env_work, K_NO_WAIT);
     }
     else{
-        printk("Pattern is not detected in Chirp initialization\n\rpattern[0]:0x%x\n\rpattern[1]:0x%x", buffer[0], buffer[1]);
+        printk("Temperature sensor %s not ready, ranges use %d m/s\n\r", bsp_env_dev->name, CH_SPEEDOFSOUND_MPS);
+    }
+#endif
+
+    // Probe every port through the programming interface
+    for(uint8_t i = 0; i < CHIRP_MAX_NUM_SENSORS; i++){
+        uint8_t buffer[2] = {0, 0};
+        uint8_t reg = 0x00;
+
+        zy_gpio_write_prg(i, 1);
+        chbsp_delay_ms(1);
+        if(zy_i2c_probe(zy_i2c_sensor_bus(i), CH_I2C_ADDR_PROG, &reg, 1) == 0){     // empty port: NACK, no retries
+            zy_i2c_mem_read(zy_i2c_sensor_bus(i), CH_I2C_ADDR_PROG, reg, buffer, 2);
+        }
+        zy_gpio_write_prg(i, 0);
+
+        if(buffer[0] == 0x0A && buffer[1] == 0x02){
+            printk("Chirp pattern detected successfully on port %d (bus %d)\n\r", i, zy_i2c_sensor_bus(i));
+        }
+        else{
+            printk("Pattern is not detected on port %d\n\rpattern[0]:0x%x\n\rpattern[1]:0x%x\n\r", i, buffer[0], buffer[1]);
+        }
     }
 }
 
 void chbsp_reset_assert(void){
-    zy_gpio_write_prg(0);
+    zy_gpio_write_rst(1);
 }
 
 void chbsp_reset_release(void){
-    zy_gpio_write_prg(1);
+    zy_gpio_write_rst(0);
 }
 
 void chbsp_program_enable(ch_dev_t *dev_ptr){
-    // dev_ptr->io_index // This could be used later to identify the sensor between other sensors
-    zy_gpio_write_prg(1);
+    zy_gpio_write_prg(ch_get_dev_num(dev_ptr), 1);
 }
 
 void chbsp_program_disable(ch_dev_t *dev_ptr){
-    // dev_ptr->io_index // This could be used later to identify the sensor between other sensors
-    zy_gpio_write_prg(0);
+    zy_gpio_write_prg(ch_get_dev_num(dev_ptr), 0);
 }
 
 void chbsp_group_set_io_dir_out(ch_group_t *grp_ptr){
-    // grp_ptr->device // This could be used later
-    zy_gpio_set_int_dir(ZY_GPIO_OUTUPUT);
+    for(uint8_t i = 0; i < grp_ptr->num_ports; i++){
+        zy_gpio_set_int_dir(i, ZY_GPIO_OUTPUT);
+    }
 }
 
 void chbsp_group_set_io_dir_in(ch_group_t *grp_ptr){
-    // grp_ptr->device // This could be used later
-    zy_gpio_set_int_dir(ZY_GPIO_INPUT);
+    for(uint8_t i = 0; i < grp_ptr->num_ports; i++){
+        zy_gpio_set_int_dir(i, ZY_GPIO_INPUT);
+    }
 }
 
 void chbsp_group_pin_init(ch_group_t *grp_ptr){
     /*
         Initialization
     */
-    zy_gpio_set_prg_dir(ZY_GPIO_OUTUPUT);
-    zy_gpio_set_rst_dir(ZY_GPIO_OUTUPUT);
-    zy_gpio_set_int_dir(ZY_GPIO_INPUT);
+    zy_gpio_set_rst_dir(ZY_GPIO_OUTPUT);
+    chbsp_reset_assert();
 
-    zy_gpio_write_prg(1);
-    zy_gpio_write_rst(0);
+    for(uint8_t i = 0; i < grp_ptr->num_ports; i++){
+        zy_gpio_set_prg_dir(i, ZY_GPIO_OUTPUT);
+        zy_gpio_write_prg(i, 0);
+        zy_gpio_set_int_dir(i, ZY_GPIO_INPUT);
+    }
 }
 
 void chbsp_group_io_clear(ch_group_t *grp_ptr){
-    // grp_ptr->device // This could be used later
-    zy_gpio_write_int(0);
+    for(uint8_t i = 0; i < grp_ptr->num_ports; i++){
+        zy_gpio_write_int(i, 0);
+    }
 }
 
 void chbsp_group_io_set(ch_group_t *grp_ptr){
-    // grp_ptr->device // This could be used later
-    zy_gpio_write_int(1);
+    for(uint8_t i = 0; i < grp_ptr->num_ports; i++){
+        zy_gpio_write_int(i, 1);
+    }
+}
+
+void chbsp_set_io_dir_out(ch_dev_t *dev_ptr){
+    zy_gpio_set_int_dir(ch_get_dev_num(dev_ptr), ZY_GPIO_OUTPUT);
+}
+
+void chbsp_set_io_dir_in(ch_dev_t *dev_ptr){
+    zy_gpio_set_int_dir(ch_get_dev_num(dev_ptr), ZY_GPIO_INPUT);
+}
+
+void chbsp_io_clear(ch_dev_t *dev_ptr){
+    zy_gpio_write_int(ch_get_dev_num(dev_ptr), 0);
+}
+
+void chbsp_io_set(ch_dev_t *dev_ptr){
+    zy_gpio_write_int(ch_get_dev_num(dev_ptr), 1);
 }
 
 void chbsp_group_io_interrupt_enable(ch_group_t *grp_ptr){
-    ch_dev_t* dev = grp_ptr->device[0];
-    chbsp_io_interrupt_enable(dev);
+    for(uint8_t i = 0; i < grp_ptr->num_ports; i++){
+        ch_dev_t *dev = grp_ptr->device[i];
+        if(ch_sensor_is_connected(dev)){
+            chbsp_io_interrupt_enable(dev);
+        }
+    }
 }
 
 void chbsp_io_interrupt_enable(ch_dev_t *dev_ptr){
-    zy_gpio_int_enable_int(ZY_GPIO_EDGE_F); // TODO: Check correct direction
+    zy_gpio_int_enable_int(ch_get_dev_num(dev_ptr), ZY_GPIO_EDGE_F); // TODO: Check correct direction
 }
 
 void chbsp_group_io_interrupt_disable(ch_group_t *grp_ptr){
-    ch_dev_t* dev = grp_ptr->device[0];
-    chbsp_io_interrupt_disable(dev);
+    for(uint8_t i = 0; i < grp_ptr->num_ports; i++){
+        ch_dev_t *dev = grp_ptr->device[i];
+        if(ch_sensor_is_connected(dev)){
+            chbsp_io_interrupt_disable(dev);
+        }
+    }
 }
 
 void chbsp_io_interrupt_disable(ch_dev_t *dev_ptr){
-    zy_gpio_int_disable_int();
+    zy_gpio_int_disable_int(ch_get_dev_num(dev_ptr));
+}
+
+// INT line of one sensor fired: forward with the device number to SonicLib
+static void chbsp_io_int_handler(uint8_t sensor){
+    if(io_int_callback != NULL){
+        io_int_callback(bsp_grp_ptr, sensor);
+    }
 }
 
 void chbsp_io_callback_set(ch_io_int_callback_t callback_func_ptr){
-    zy_gpio_set_int_cb(callback_func_ptr);
+    io_int_callback = callback_func_ptr;
+    zy_gpio_set_int_cb(chbsp_io_int_handler);
 }
 
 void chbsp_delay_us(uint32_t us){
@@ -120,90 +303,330 @@ void chbsp_delay_ms(uint32_t ms){
     zy_msleep(ms);
 }
 
+uint32_t chbsp_timestamp_ms(void){
+    return k_uptime_get_32();
+}
+
+/*
+    CPU cycle counter (DWT CYCCNT on the nRF52840, 64 MHz) through the timing
+    API. Without CONFIG_TIMING_FUNCTIONS, the kernel hardware cycle counter,
+    which on the nRF52840 is the 32.768 kHz RTC1 and too coarse for the short
+    boot phases.
+*/
+uint32_t chbsp_cycle_count(void){
+#ifdef CONFIG_TIMING_FUNCTIONS
+    return (uint32_t) timing_counter_get();
+#else
+    return k_cycle_get_32();
+#endif
+}
+
+uint32_t chbsp_cycles_to_us(uint32_t cycles){
+#ifdef CONFIG_TIMING_FUNCTIONS
+    return (uint32_t) (timing_cycles_to_ns(cycles) / NSEC_PER_USEC);
+#else
+    return k_cyc_to_us_floor32(cycles);
+#endif
+}
+
+void chbsp_print_str(char *str){
+    printk("%s", str);
+}
+
 int chbsp_i2c_init(void){
-    zy_i2c_init();
+    return zy_i2c_init() ? 0 : 1;
 }
 
-uint8_t chbsp_i2c_get_info(ch_group_t *grp_ptr, uint8_t dev_num, ch_i2c_info_t *info_ptr){
-    info_ptr->address = zy_i2c_chirp_address();
-    info_ptr->bus_num = 0;
-    printk("INSID:chbsp_i2c_get_info\n\r");
+// Bus clear and controller re-init of the sensor's bus, e.g. after a brown-out left it stuck
+void chbsp_i2c_reset(ch_dev_t *dev_ptr){
+    uint8_t bus = ch_get_i2c_bus(dev_ptr);
+
+    if(zy_i2c_reset(bus) != 0){
+        printk("I2C bus %d recovery failed\n\r", bus);
+    }
 }
 
-int chbsp_i2c_write(ch_dev_t *dev_ptr, uint8_t *data, uint16_t num_bytes){
-    
-    uint8_t address = ch_get_i2c_address(dev_ptr);
-    if(address == zy_i2c_chirp_address()){
-        zy_i2c_send_chirp(data, num_bytes);
+static void chbsp_bus_task_entry(void *p1, void *p2, void *p3){
+    struct chbsp_bus_task *t = p1;
+
+    t->task(t->grp_ptr, t->bus_index, t->arg);
+}
+
+void chbsp_i2c_bus_run(ch_group_t *grp_ptr, ch_bus_task_t task, void *arg){
+    int prio = k_thread_priority_get(k_current_get());
+    uint8_t num_buses = MIN(grp_ptr->num_i2c_buses, CHIRP_NUM_I2C_BUSES);
+
+    for(uint8_t bus = 1; bus < num_buses; bus++){
+        bsp_bus_task[bus] = (struct chbsp_bus_task) { grp_ptr, task, arg, bus };
+        k_thread_create(&bsp_bus_task_thread[bus], bsp_bus_task_stack[bus],
+                        K_THREAD_STACK_SIZEOF(bsp_bus_task_stack[bus]), chbsp_bus_task_entry, &bsp_bus_task[bus],
+                        NULL, NULL, prio, 0, K_NO_WAIT);
     }
-    else if(address == zy_i2c_chirp_conf_address()){
-        zy_i2c_send_chirp_conf(data, num_bytes);
+
+    if(num_buses > 0){
+        task(grp_ptr, 0, arg);
     }
-    else{
-        printk("Uknown address detected! 'i2c_write'\n\r");
-        return 2;
+
+    for(uint8_t bus = 1; bus < num_buses; bus++){
+        k_thread_join(&bsp_bus_task_thread[bus], K_FOREVER);
+    }
+}
+
+/*
+    Sensor start-up state kept for ch_group_warm_start(). The no-init section
+    is not cleared at boot, so it survives a watchdog or software reset.
+*/
+static uint32_t bsp_retained_mem[DIV_ROUND_UP(sizeof(chdrv_retained_t), sizeof(uint32_t))] __noinit;
+
+void *chbsp_retained_mem(uint16_t size){
+    return (size <= sizeof(bsp_retained_mem)) ? bsp_retained_mem : NULL;
+}
+
+// Part fitted on each port, from the optional part-number property of the port node (0 = not given)
+#define CHBSP_PART_NUMBER(node_id)      DT_PROP_OR(node_id, part_number, 0),
+
+static const uint16_t bsp_part_numbers[] = { DT_FOREACH_CHILD(CHIRP_BOARD_NODE, CHBSP_PART_NUMBER) };
+
+uint16_t chbsp_part_number(ch_dev_t *dev_ptr){
+    return bsp_part_numbers[ch_get_dev_num(dev_ptr)];
+}
+
+uint8_t chbsp_i2c_get_info(ch_group_t *grp_ptr, uint8_t dev_num, ch_i2c_info_t *info_ptr){
+    uint8_t bus = zy_i2c_sensor_bus(dev_num);
+
+    if(bus >= CHIRP_NUM_I2C_BUSES){
+        printk("Port %d is on an I2C bus not listed in i2c-buses\n\r", dev_num);
+        return 1;
     }
+    info_ptr->address = zy_i2c_sensor_address(dev_num);
+    info_ptr->bus_num = bus;
+    info_ptr->drv_flags = 0;
     return 0;
 }
 
+int chbsp_i2c_write(ch_dev_t *dev_ptr, uint8_t *data, uint16_t num_bytes){
+    return (zy_i2c_send(ch_get_i2c_bus(dev_ptr), ch_get_i2c_address(dev_ptr), data, num_bytes) != 0);
+}
+
+// Sensor discovery: one attempt, an empty port's NACK is not retried
+int chbsp_i2c_probe(ch_dev_t *dev_ptr, uint8_t *data, uint16_t num_bytes){
+    return (zy_i2c_probe(ch_get_i2c_bus(dev_ptr), ch_get_i2c_address(dev_ptr), data, num_bytes) != 0);
+}
+
 int chbsp_i2c_mem_write(ch_dev_t *dev_ptr, uint16_t mem_addr, uint8_t *data, uint16_t num_bytes){
-    
-    int size = num_bytes + 1;
-    uint8_t msg[size];
-    msg[0] = mem_addr;
-    for(int i=1; i<=size; i++){
-        msg[i] = data[i-1];
+    uint8_t reg = mem_addr;
+
+    return chbsp_i2c_write_hdr(dev_ptr, &reg, 1, data, num_bytes);
+}
+
+// Header and payload go out as separate segments of one transaction, no copy
+int chbsp_i2c_write_hdr(ch_dev_t *dev_ptr, uint8_t *hdr, uint16_t hdr_bytes, uint8_t *data, uint16_t num_bytes){
+    return (zy_i2c_write_hdr(ch_get_i2c_bus(dev_ptr), ch_get_i2c_address(dev_ptr), hdr, hdr_bytes, data, num_bytes) != 0);
+}
+
+int chbsp_i2c_read(ch_dev_t *dev_ptr, uint8_t *data, uint16_t num_bytes){
+    return (zy_i2c_recv(ch_get_i2c_bus(dev_ptr), ch_get_i2c_address(dev_ptr), data, num_bytes) != 0);
+}
+
+// Register address write and data read in one transaction (repeated start)
+int chbsp_i2c_mem_read(ch_dev_t *dev_ptr, uint16_t mem_addr, uint8_t *data, uint16_t num_bytes){
+    return (zy_i2c_mem_read(ch_get_i2c_bus(dev_ptr), ch_get_i2c_address(dev_ptr), mem_addr, data, num_bytes) != 0);
+}
+
+/*
+    Non-blocking I/O
+    Each call starts one background transfer, completion is reported to SonicLib
+    through ch_io_notify() which then starts the next queued transaction on the bus.
+*/
+static void chbsp_i2c_nb_complete(int result, void *user_data){
+    ch_dev_t *dev_ptr = (ch_dev_t *) user_data;
+
+    if(result != 0){
+        printk("Non-blocking I2C transfer failed (%d) on sensor %d\n\r", result, ch_get_dev_num(dev_ptr));
     }
+    ch_io_notify(bsp_grp_ptr, ch_get_i2c_bus(dev_ptr));
+}
+
+int chbsp_i2c_mem_read_nb(ch_dev_t *dev_ptr, uint16_t mem_addr, uint8_t *data, uint16_t num_bytes){
+    return (zy_i2c_mem_read_nb(ch_get_i2c_bus(dev_ptr), ch_get_i2c_address(dev_ptr), mem_addr, data, num_bytes,
+                               chbsp_i2c_nb_complete, dev_ptr) != 0);
+}
 
-    if(address == zy_i2c_chirp_address()){
-        zy_i2c_send_chirp(msg, size);
+int chbsp_i2c_mem_write_nb(ch_dev_t *dev_ptr, uint16_t mem_addr, uint8_t *data, uint16_t num_bytes){
+    return (zy_i2c_mem_write_nb(ch_get_i2c_bus(dev_ptr), ch_get_i2c_address(dev_ptr), mem_addr, data, num_bytes,
+                                chbsp_i2c_nb_complete, dev_ptr) != 0);
+}
+
+int chbsp_i2c_read_nb(ch_dev_t *dev_ptr, uint8_t *data, uint16_t num_bytes){
+    return (zy_i2c_recv_nb(ch_get_i2c_bus(dev_ptr), ch_get_i2c_address(dev_ptr), data, num_bytes,
+                           chbsp_i2c_nb_complete, dev_ptr) != 0);
+}
+
+int chbsp_i2c_write_nb(ch_dev_t *dev_ptr, uint8_t *data, uint16_t num_bytes){
+    return (zy_i2c_send_nb(ch_get_i2c_bus(dev_ptr), ch_get_i2c_address(dev_ptr), data, num_bytes,
+                           chbsp_i2c_nb_complete, dev_ptr) != 0);
+}
+
+/*
+    Periodic timer
+    Runs on a kernel timer, the callback is called from the timer expiry (ISR context).
+*/
+static void chbsp_periodic_timer_expiry(struct k_timer *timer){
+    chbsp_periodic_timer_handler();
+}
+
+uint8_t chbsp_periodic_timer_init(uint16_t interval_ms, ch_timer_callback_t callback_func_ptr){
+    if(interval_ms == 0){
+        return 1;
     }
-    else if(address == zy_i2c_chirp_conf_address()){
-        zy_i2c_send_chirp_conf(msg, size);
+    periodic_timer_interval_ms = interval_ms;
+    periodic_timer_callback = callback_func_ptr;
+    periodic_timer_irq_enabled = 1;
+    return 0;
+}
+
+void chbsp_periodic_timer_irq_enable(void){
+    periodic_timer_irq_enabled = 1;
+}
+
+void chbsp_periodic_timer_irq_disable(void){
+    periodic_timer_irq_enabled = 0;
+}
+
+uint8_t chbsp_periodic_timer_start(void){
+    if(periodic_timer_interval_ms == 0){
+        return 1;
     }
-    else{
-        printk("Uknown address detected! 'i2c_mem_write'\n\r");
-        return 2;
+    k_timer_start(&periodic_timer, K_MSEC(periodic_timer_interval_ms), K_MSEC(periodic_timer_interval_ms));
+    return 0;
+}
+
+uint8_t chbsp_periodic_timer_stop(void){
+    k_timer_stop(&periodic_timer);
+    return 0;
+}
+
+// The kernel timer re-arms itself, only the callback is left to do here
+void chbsp_periodic_timer_handler(void){
+    if(periodic_timer_irq_enabled && periodic_timer_callback != NULL){
+        periodic_timer_callback();
     }
+}
+
+/*
+    Sleep until the application has work: its callbacks call chbsp_proc_wakeup(),
+    so sensor interrupts and I/O completions that only advance a readout do not
+    wake the main loop.
+*/
+void chbsp_proc_sleep(void){
+    k_sem_take(&bsp_wakeup, K_FOREVER);
+}
+
+void chbsp_proc_wakeup(void){
+    k_sem_give(&bsp_wakeup);
+}
 
+/*
+    Background RTC calibration
+    The kernel timer ends the pulse from its expiry (GPIO writes only), the
+    results are read over I2C 1 ms later from the BSP work queue.
+*/
+uint8_t chbsp_rtc_cal_timer_start(ch_group_t *grp_ptr, uint16_t pulse_ms){
+    rtc_cal_grp_ptr = grp_ptr;
+    k_timer_start(&rtc_cal_timer, K_MSEC(pulse_ms), K_NO_WAIT);
     return 0;
 }
 
-int chbsp_i2c_read(ch_dev_t *dev_ptr, uint8_t *data, uint16_t num_bytes){
-    uint8_t address = ch_get_i2c_address();
+static void chbsp_rtc_cal_timer_expiry(struct k_timer *timer){
+    chdrv_group_measure_rtc_end(rtc_cal_grp_ptr);
+    k_work_schedule_for_queue(&bsp_workq, &rtc_cal_work, K_MSEC(1));
+}
+
+static void chbsp_rtc_cal_work_handler(struct k_work *work){
+    chdrv_group_measure_rtc_finish(rtc_cal_grp_ptr);
+}
+
+// Periodic recalibration: the pulse is started from the BSP work queue, after the measurement
+uint8_t chbsp_rtc_cal_work_schedule(ch_group_t *grp_ptr, uint16_t delay_ms){
+    rtc_cal_grp_ptr = grp_ptr;
+    return k_work_schedule_for_queue(&bsp_workq, &recal_work, K_MSEC(delay_ms)) < 0;
+}
+
+static void chbsp_recal_work_handler(struct k_work *work){
+    chdrv_group_recal_run(rtc_cal_grp_ptr);
+}
+
+uint32_t chbsp_critical_enter(void){
+    return irq_lock();
+}
+
+void chbsp_critical_exit(uint32_t key){
+    irq_unlock(key);
+}
 
-    if(address == zy_i2c_chirp_address()){
-        zy_i2c_recv_chirp(data, num_bytes);
+#ifdef CONFIG_SETTINGS
+// Settings handler, called by settings_load_subtree() for every stored "chirp/cal/<port>" entry
+static int chbsp_cal_settings_set(const char *name, size_t len, settings_read_cb read_cb, void *cb_arg){
+    const char *next;
+    int name_len = settings_name_next(name, &next);
+    char *end;
+    unsigned long port = strtoul(name, &end, 10);
+
+    if(next != NULL || end != name + name_len || port >= CHIRP_MAX_NUM_SENSORS){
+        return -ENOENT;
     }
-    else if(address == zy_i2c_chirp_conf_address()){
-        zy_i2c_recv_chirp_conf(data, num_bytes);
+    if(len != sizeof(struct chbsp_cal_entry)){
+        return -EINVAL;
     }
-    else{
-        printk("Uknown address detected! 'i2c_mem_write'\n\r");
-        return 2;
+    if(read_cb(cb_arg, &bsp_cal_cache[port], len) != len){
+        return -EIO;
     }
+    bsp_cal_cache_valid |= BIT(port);
     return 0;
 }
 
-int chbsp_i2c_mem_read(ch_dev_t *dev_ptr, uint16_t mem_addr, uint8_t *data, uint16_t num_bytes){
+SETTINGS_STATIC_HANDLER_DEFINE(chirp_cal, CHBSP_CAL_SETTINGS_TREE, NULL, chbsp_cal_settings_set, NULL, NULL);
+#endif
 
-    uint8_t msg[] = {mem_addr};
-    
-    if(address == zy_i2c_chirp_address()){
-        zy_i2c_send_chirp(msg, sizeof(msg));
-        zy_msleep(2);
-        zy_i2c_recv_chirp(msg, num_bytes);
-    }
-    else if(address == zy_i2c_chirp_conf_address()){
-        zy_i2c_send_chirp_conf(msg, sizeof(msg));
-        zy_msleep(2);
-        zy_i2c_recv_chirp_conf(msg, num_bytes);
-    }
-    else{
-        printk("Uknown address detected! 'i2c_mem_write'\n\r");
-        return 2;
+int chbsp_cal_load(ch_dev_t *dev_ptr, ch_cal_result_t *cal_ptr){
+    uint8_t port = ch_get_dev_num(dev_ptr);
+    const struct chbsp_cal_entry *entry = &bsp_cal_cache[port];
+
+    if(!(bsp_cal_cache_valid & BIT(port)) || entry->part_number != ch_get_part_number(dev_ptr) ||
+       entry->i2c_address != ch_get_i2c_address(dev_ptr) ||
+       entry->rtc_cal_pulse_ms != ch_get_rtc_cal_pulselength(dev_ptr)){
+        return 1;
     }
+    *cal_ptr = entry->cal;
     return 0;
 }
 
- 
\ No newline at end of file
+// Only a new sensor or a real change of calibration is written, to spare the flash
+void chbsp_cal_store(ch_dev_t *dev_ptr, const ch_cal_result_t *cal_ptr){
+    uint8_t port = ch_get_dev_num(dev_ptr);
+    struct chbsp_cal_entry *entry = &bsp_cal_cache[port];
+    ch_cal_result_t cached;
+
+    if(chbsp_cal_load(dev_ptr, &cached) == 0){
+        uint32_t change = abs((int32_t) cal_ptr->rtc_cal_result - (int32_t) cached.rtc_cal_result);
+
+        if((uint64_t) change * 1000000U < (uint64_t) cached.rtc_cal_result * CHBSP_CAL_SAVE_MIN_PPM){
+            return;
+        }
+    }
+
+    entry->part_number = ch_get_part_number(dev_ptr);
+    entry->rtc_cal_pulse_ms = ch_get_rtc_cal_pulselength(dev_ptr);
+    entry->i2c_address = ch_get_i2c_address(dev_ptr);
+    entry->cal = *cal_ptr;
+    bsp_cal_cache_valid |= BIT(port);
+
+#ifdef CONFIG_SETTINGS
+    char name[sizeof(CHBSP_CAL_SETTINGS_TREE) + 4];
+
+    snprintf(name, sizeof(name), CHBSP_CAL_SETTINGS_TREE "/%u", port);
+    if(settings_save_one(name, entry, sizeof(*entry)) != 0){
+        printk("Calibration of port %d not saved\n\r", port);
+    }
+#endif
+}
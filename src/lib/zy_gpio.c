@@ -1,108 +1,112 @@
-
 #include "../inc/zy_gpio.h"
 #include <zephyr/kernel.h>
 #include <zephyr/drivers/gpio.h>
 #include "../inc/soniclib.h"
 
+// Pins of every sensor port, in devicetree child order (= SonicLib device number)
+#define ZY_GPIO_PRG_SPEC(node_id) GPIO_DT_SPEC_GET(node_id, prog_gpios),
+#define ZY_GPIO_INT_SPEC(node_id) GPIO_DT_SPEC_GET(node_id, int_gpios),
+
+static const struct gpio_dt_spec ch_prg[] = { DT_FOREACH_CHILD(CHIRP_BOARD_NODE, ZY_GPIO_PRG_SPEC) };
+static const struct gpio_dt_spec ch_int[] = { DT_FOREACH_CHILD(CHIRP_BOARD_NODE, ZY_GPIO_INT_SPEC) };
+static const struct gpio_dt_spec ch_rst = GPIO_DT_SPEC_GET(CHIRP_BOARD_NODE, reset_gpios);
 
-static struct gpio_dt_spec ch_prg;
-static struct gpio_dt_spec ch_rst;
-static struct gpio_dt_spec ch_int;
+struct zy_gpio_int {
+    struct gpio_callback cb;
+    uint8_t sensor;
+};
+
+static struct zy_gpio_int int_cb_data[CHIRP_MAX_NUM_SENSORS];
+static zy_gpio_int_cb_t int_cb_ptr;
 
-ch_io_int_callback_t int_cb_ptr;
 void zy_int_cb(const struct device *port, struct gpio_callback *cb, uint32_t pin){
+    struct zy_gpio_int *data = CONTAINER_OF(cb, struct zy_gpio_int, cb);
+
     if(int_cb_ptr != NULL){
-        int_cb_ptr(NULL, 0);
+        int_cb_ptr(data->sensor);
     }
 }
 
 
 int zy_gpio_init_all(){
-    zy_gpio_init(&ch_int, ZY_GPIO_INTERRUPT_ENABLE, ZY_GPIO_INPUT, ZY_GPIO_EDGE_R, NULL);
-    zy_gpio_init(&ch_rst, ZY_GPIO_INTERRUPT_DISABLE, ZY_GPIO_OUTPUT, 0, NULL);
-    zy_gpio_init(&ch_prg, ZY_GPIO_INTERRUPT_DISABLE, ZY_GPIO_OUTPUT, 0, NULL);
+    int ret = zy_gpio_init(&ch_rst, ZY_GPIO_INTERRUPT_DISABLE, ZY_GPIO_OUTPUT, 0, NULL, NULL);
+
+    for(uint8_t i = 0; i < ARRAY_SIZE(ch_prg); i++){
+        int_cb_data[i].sensor = i;
+        ret |= zy_gpio_init(&ch_prg[i], ZY_GPIO_INTERRUPT_DISABLE, ZY_GPIO_OUTPUT, 0, NULL, NULL);
+        ret |= zy_gpio_init(&ch_int[i], ZY_GPIO_INTERRUPT_DISABLE, ZY_GPIO_INPUT, 0, &int_cb_data[i].cb, zy_int_cb);
+    }
+    return ret;
 }
 
-int zy_gpio_init(struct gpio_dt_spec *dev, zy_gpio_interrupt_e gpio_int, zy_gpio_direction_e dir, zy_gpio_int_type_e int_type, gpio_callback_handler_t int_cb){
+int zy_gpio_init(const struct gpio_dt_spec *dev, zy_gpio_interrupt_e gpio_int, zy_gpio_direction_e dir, zy_gpio_int_type_e int_type, 
+                 struct gpio_callback *cb_data, gpio_callback_handler_t int_cb){
     
     if(!device_is_ready(dev->port)){
-		return 0;
+		return -ENODEV;
 	}
 
     int ret;
 
     // Setting pin direction
-    int gpio_dir = dir == ZY_GPIO_INPUT ? GPIO_INPUT : GPIO_OUTPUT;
+    int gpio_dir = dir == ZY_GPIO_INPUT ? GPIO_INPUT : GPIO_OUTPUT_INACTIVE;
     ret = gpio_pin_configure_dt(dev, gpio_dir);
 	if(ret != 0){
 		return ret;
 	} 
 
+    // Registering the pin callback, the interrupt itself is enabled separately
+    if(cb_data != NULL && int_cb != NULL){
+        gpio_init_callback(cb_data, int_cb, BIT(dev->pin));
+        ret = gpio_add_callback(dev->port, cb_data);
+        if(ret != 0){
+            return ret;
+        }
+    }
+
     // Setting pin interrupt
     if(gpio_int == ZY_GPIO_INTERRUPT_ENABLE && dir == ZY_GPIO_INPUT){
 
         int gpio_int_type = int_type == ZY_GPIO_EDGE_F ? GPIO_INT_EDGE_FALLING : GPIO_INT_EDGE_RISING;
         ret = gpio_pin_interrupt_configure_dt(dev, gpio_int_type);
-        if(ret != 0){
-            return ret;
-        }
-
-        struct gpio_callback *btn_cb_data = (struct gpio_callback *)k_malloc(sizeof(struct gpio_callback));
-        gpio_init_callback(btn_cb_data, int_cb, BIT(dev->pin));
-        gpio_add_callback(dev->port, btn_cb_data);
     }
+    return ret;
 }
 
-int zy_gpio_write_prg(uint8_t val){
-    gpio_pin_set(ch_prg.port, ch_prg.pin, val);
-    return 0;
+int zy_gpio_write_prg(uint8_t sensor, uint8_t val){
+    return gpio_pin_set_dt(&ch_prg[sensor], val);
 }
 
 int zy_gpio_write_rst(uint8_t val){
-    gpio_pin_set(ch_rst.port, ch_rst.pin, val);
-    return 0;
+    return gpio_pin_set_dt(&ch_rst, val);
 }
 
-int zy_gpio_write_int(uint8_t val){
-    gpio_pin_set(ch_int.port, ch_int.pin, val);
-    return 0;
+int zy_gpio_write_int(uint8_t sensor, uint8_t val){
+    return gpio_pin_set_dt(&ch_int[sensor], val);
 }
 
-int zy_gpio_set_int_dir(zy_gpio_direction_e dir){
-    if(dir == ZY_GPIO_INPUT){
-        gpio_pin_configure_dt(&ch_int, GPIO_INPUT);
-    }
-    else{
-        gpio_pin_configure_dt(&ch_int, GPIO_OUTPUT);
-    }
+int zy_gpio_set_int_dir(uint8_t sensor, zy_gpio_direction_e dir){
+    return gpio_pin_configure_dt(&ch_int[sensor], (dir == ZY_GPIO_INPUT) ? GPIO_INPUT : GPIO_OUTPUT);
 }
 
-int zy_gpio_set_prg_dir(zy_gpio_direction_e dir){
-    if(dir == ZY_GPIO_INPUT){
-        gpio_pin_configure_dt(&ch_int, GPIO_INPUT);
-    }
-    else{
-        gpio_pin_configure_dt(&ch_int, GPIO_OUTPUT);
-    }
+int zy_gpio_set_prg_dir(uint8_t sensor, zy_gpio_direction_e dir){
+    return gpio_pin_configure_dt(&ch_prg[sensor], (dir == ZY_GPIO_INPUT) ? GPIO_INPUT : GPIO_OUTPUT);
 }
 
 int zy_gpio_set_rst_dir(zy_gpio_direction_e dir){
-    if(dir == ZY_GPIO_INPUT){
-        gpio_pin_configure_dt(&ch_int, GPIO_INPUT);
-    }
-    else{
-        gpio_pin_configure_dt(&ch_int, GPIO_OUTPUT);
-    }
+    return gpio_pin_configure_dt(&ch_rst, (dir == ZY_GPIO_INPUT) ? GPIO_INPUT : GPIO_OUTPUT);
 }
 
-int zy_gpio_int_enable_int(zy_gpio_int_type_e int_typ){
-    gpio_pin_configure_dt(&ch_int, int_typ);
+int zy_gpio_int_enable_int(uint8_t sensor, zy_gpio_int_type_e int_typ){
+    int gpio_int_type = int_typ == ZY_GPIO_EDGE_F ? GPIO_INT_EDGE_FALLING : GPIO_INT_EDGE_RISING;
+    return gpio_pin_interrupt_configure_dt(&ch_int[sensor], gpio_int_type);
 }
 
-int zy_gpio_int_disable_int(){
-    gpio_pin_configure_dt(&ch_int, GPIO_INT_DISABLE);
+int zy_gpio_int_disable_int(uint8_t sensor){
+    return gpio_pin_interrupt_configure_dt(&ch_int[sensor], GPIO_INT_DISABLE);
 }
 
-int zy_gpio_set_int_cb(ch_io_int_callback_t int_cb){
+int zy_gpio_set_int_cb(zy_gpio_int_cb_t int_cb){
     int_cb_ptr = int_cb;
-}
\ No newline at end of file
+    return 0;
+}
@@ -2,58 +2,468 @@
 
 #include "zy_i2c.h"
 #include "zephyr/kernel.h"
+#include <string.h>
 
-static const struct i2c_dt_spec iicm = I2C_DT_SPEC_GET(I2C_MAIN_NODE);
-static const struct i2c_dt_spec iicc = I2C_DT_SPEC_GET(I2C_CONF_NODE);
+// I2C controllers in devicetree "i2c-buses" order (= SonicLib bus index)
+#define ZY_I2C_BUS_DEV(node_id, prop, idx)  DEVICE_DT_GET(DT_PHANDLE_BY_IDX(node_id, prop, idx)),
+#define ZY_I2C_BUS_BITRATE(node_id, prop, idx) \
+    DT_PROP_OR(DT_PHANDLE_BY_IDX(node_id, prop, idx), clock_frequency, I2C_BITRATE_STANDARD),
+// Per sensor port: its controller and application address
+#define ZY_I2C_SENSOR_BUS(node_id)          DEVICE_DT_GET(DT_PHANDLE(node_id, i2c_bus)),
+#define ZY_I2C_SENSOR_ADDR(node_id)         DT_PROP(node_id, app_address),
+
+static const struct device *const buses[] = { DT_FOREACH_PROP_ELEM(CHIRP_BOARD_NODE, i2c_buses, ZY_I2C_BUS_DEV) };
+static const uint32_t bus_bitrates[] = { DT_FOREACH_PROP_ELEM(CHIRP_BOARD_NODE, i2c_buses, ZY_I2C_BUS_BITRATE) };
+static const struct device *const sensor_buses[] = { DT_FOREACH_CHILD(CHIRP_BOARD_NODE, ZY_I2C_SENSOR_BUS) };
+static const uint8_t sensor_addrs[] = { DT_FOREACH_CHILD(CHIRP_BOARD_NODE, ZY_I2C_SENSOR_ADDR) };
+
+/*
+    Throughput counters, one set per bus: blocking transfers run on the caller's
+    thread and on the per-bus work queue threads at the same time, so every
+    update is an atomic add. zy_i2c_stats_get() sums the buses.
+*/
+struct zy_i2c_xfer_stats {
+    atomic_t bytes;
+    atomic_t cycles;
+    atomic_t transfers;
+};
+
+// Error counters, one set per bus, updated atomically for the same reason (see struct zy_i2c_bus_stats)
+struct zy_i2c_err_stats {
+    atomic_t errors;
+    atomic_t retries;
+    atomic_t recoveries;
+    atomic_t failures;
+    atomic_t fallbacks;
+};
+
+static struct zy_i2c_xfer_stats xfer_stats[ARRAY_SIZE(buses)];
+static struct zy_i2c_err_stats bus_stats[ARRAY_SIZE(buses)];
+static uint32_t bus_config[ARRAY_SIZE(buses)];     // controller configuration restored after a recovery
+static uint32_t bus_speed_errors[ARRAY_SIZE(buses)];    // transfers recovered by a retry since the last speed change
+
+/*
+    Non-blocking transfer context, one per bus. The message list and register byte
+    must outlive the call that starts the transfer, so they live here and not on
+    the caller's stack. Only one transfer can be in flight per bus, transfers on
+    different buses run in parallel.
+*/
+struct zy_i2c_nb {
+    struct i2c_msg msgs[ZY_I2C_MAX_MSGS];
+    uint8_t num_msgs;
+    uint8_t reg;
+    uint8_t bus;
+    uint16_t addr;
+    zy_i2c_nb_cb_t cb;
+    void *user_data;
+    int result;
+    uint8_t retried;            // retries already done for this transfer
+    atomic_t busy;
+    struct k_work xfer_work;    // runs a blocking transfer when the driver has no callback API
+    struct k_work done_work;    // delivers the completion outside of the ISR
+};
+
+static struct zy_i2c_nb nb[ARRAY_SIZE(buses)];
+static struct k_work_q zy_i2c_nb_workq[ARRAY_SIZE(buses)];
+K_THREAD_STACK_ARRAY_DEFINE(zy_i2c_nb_stack, ARRAY_SIZE(buses), ZY_I2C_NB_STACK_SIZE);
+static uint8_t nb_initialized;
+
+/*
+    Build the message list of one transaction: optional header write, then the
+    data in one message. Reads after a header use a repeated start.
+    Returns the number of messages, or -EINVAL if the data is empty or larger
+    than ZY_I2C_MAX_XFER_SIZE.
+*/
+static int zy_i2c_build_msgs(struct i2c_msg *msgs, uint8_t *hdr, uint8_t hdr_len, uint8_t *data, uint32_t size,
+                             uint8_t read){
+    int n = 0;
+
+    if(size == 0 || size > ZY_I2C_MAX_XFER_SIZE){
+        return -EINVAL;
+    }
+
+    if(hdr != NULL){
+        msgs[n].buf = hdr;
+        msgs[n].len = hdr_len;
+        msgs[n].flags = I2C_MSG_WRITE;
+        n++;
+    }
+
+    msgs[n].buf = data;
+    msgs[n].len = size;
+    msgs[n].flags = (read ? I2C_MSG_READ : I2C_MSG_WRITE) | I2C_MSG_STOP;
+    if(read && hdr != NULL){
+        msgs[n].flags |= I2C_MSG_RESTART;
+    }
+    n++;
+
+    return n;
+}
+
+/*
+    Bus clear and controller re-init: the driver clocks SCL until a device
+    holding SDA low (e.g. interrupted mid-byte by a brown-out) releases it,
+    then generates a STOP. The controller is configured again in any case,
+    which also recovers a controller left in an error state.
+*/
+static int zy_i2c_recover(uint8_t bus){
+    int ret = i2c_recover_bus(buses[bus]);
+
+    if(ret == -ENOSYS){
+        ret = 0;                // no bus clear in this driver, re-init only
+    }
+    return ret | i2c_configure(buses[bus], bus_config[bus]);
+}
+
+// Recovery after an error, counted in the bus statistics
+int zy_i2c_reset(uint8_t bus){
+
+    if(bus >= ARRAY_SIZE(buses)){
+        return -EINVAL;
+    }
+
+    atomic_inc(&bus_stats[bus].recoveries);
+    return zy_i2c_recover(bus);
+}
+
+int zy_i2c_set_speed(uint8_t bus, uint32_t speed){
+    uint32_t config = I2C_MODE_CONTROLLER | I2C_SPEED_SET(speed);
+    int ret;
+
+    if(bus >= ARRAY_SIZE(buses)){
+        return -EINVAL;
+    }
+
+    ret = i2c_configure(buses[bus], config);
+    if(ret == 0){
+        bus_config[bus] = config;
+        bus_speed_errors[bus] = 0;
+    }
+
+    return ret;
+}
+
+uint32_t zy_i2c_get_speed(uint8_t bus){
+    return I2C_SPEED_GET(bus_config[bus]);
+}
+
+// Too many intermittent errors at the current speed: continue one speed lower
+static void zy_i2c_speed_fallback(uint8_t bus){
+    uint32_t speed = I2C_SPEED_GET(bus_config[bus]);
+
+    if(++bus_speed_errors[bus] < ZY_I2C_FALLBACK_ERRORS || speed <= I2C_SPEED_STANDARD){
+        return;
+    }
+    if(zy_i2c_set_speed(bus, speed - 1) != 0){
+        return;
+    }
+    atomic_inc(&bus_stats[bus].fallbacks);
+    printk("I2C bus %d: too many errors, speed reduced to mode %d\n\r", bus, speed - 1);
+}
+
+/*
+    Transaction with bounded retries: after each failure the bus is recovered
+    and the next attempt waits twice as long, up to ZY_I2C_BACKOFF_MAX_US.
+    Only called from thread context: the backoff sleeps, so other threads
+    (e.g. the other buses) run meanwhile.
+*/
+static int zy_i2c_transfer(uint8_t bus, struct i2c_msg *msgs, uint8_t num_msgs, uint16_t addr){
+    uint32_t backoff_us = ZY_I2C_BACKOFF_MIN_US;
+    uint8_t attempt;
+    int ret = i2c_transfer(buses[bus], msgs, num_msgs, addr);
+
+    for(attempt = 0; ret != 0 && attempt < ZY_I2C_MAX_RETRIES; attempt++){
+        atomic_inc(&bus_stats[bus].errors);
+        zy_i2c_reset(bus);
+        k_usleep(backoff_us);
+        backoff_us = MIN(backoff_us * 2, ZY_I2C_BACKOFF_MAX_US);
+
+        atomic_inc(&bus_stats[bus].retries);
+        ret = i2c_transfer(buses[bus], msgs, num_msgs, addr);
+    }
+    if(ret != 0){
+        atomic_inc(&bus_stats[bus].errors);
+        atomic_inc(&bus_stats[bus].failures);
+    }
+    else if(attempt > 0){
+        zy_i2c_speed_fallback(bus);         // succeeded, but only after a retry
+    }
+
+    return ret;
+}
+
+// Blocking transaction, accounted in the transfer statistics. Without retry, a failure is returned at once.
+static int zy_i2c_xfer(uint8_t bus, uint16_t addr, uint8_t *hdr, uint8_t hdr_len, uint8_t *data, uint32_t size,
+                       uint8_t read, uint8_t retry){
+    struct i2c_msg msgs[ZY_I2C_MAX_MSGS];
+    int n = zy_i2c_build_msgs(msgs, hdr, hdr_len, data, size, read);
+    uint32_t start;
+    int ret;
+
+    if(n < 0){
+        return n;
+    }
+    if(bus >= ARRAY_SIZE(buses)){
+        return -EINVAL;
+    }
+
+    start = k_cycle_get_32();
+    ret = retry ? zy_i2c_transfer(bus, msgs, n, addr) : i2c_transfer(buses[bus], msgs, n, addr);
+    if(ret == 0){
+        atomic_add(&xfer_stats[bus].cycles, k_cycle_get_32() - start);
+        atomic_add(&xfer_stats[bus].bytes, hdr_len + size);
+        atomic_inc(&xfer_stats[bus].transfers);
+    }
+
+    return ret;
+}
+
+static void zy_i2c_nb_done_handler(struct k_work *work){
+    struct zy_i2c_nb *ctx = CONTAINER_OF(work, struct zy_i2c_nb, done_work);
+    zy_i2c_nb_cb_t cb = ctx->cb;
+
+    if(ctx->result != 0 && !ctx->retried){
+        // Failed in the driver's callback path: recover and retry from this thread
+        atomic_inc(&bus_stats[ctx->bus].errors);
+        ctx->retried = 1;
+        ctx->result = zy_i2c_transfer(ctx->bus, ctx->msgs, ctx->num_msgs, ctx->addr);
+        if(ctx->result == 0){
+            zy_i2c_speed_fallback(ctx->bus);
+        }
+    }
+
+    atomic_set(&ctx->busy, 0);  // release before the callback so it can queue the next transfer
+    if(cb != NULL){
+        cb(ctx->result, ctx->user_data);
+    }
+}
+
+static void zy_i2c_nb_xfer_handler(struct k_work *work){
+    struct zy_i2c_nb *ctx = CONTAINER_OF(work, struct zy_i2c_nb, xfer_work);
+
+    ctx->result = zy_i2c_transfer(ctx->bus, ctx->msgs, ctx->num_msgs, ctx->addr);
+    ctx->retried = 1;
+    zy_i2c_nb_done_handler(&ctx->done_work);
+}
+
+#ifdef CONFIG_I2C_CALLBACK
+static void zy_i2c_nb_isr_cb(const struct device *dev, int result, void *data){
+    struct zy_i2c_nb *ctx = data;
+
+    ctx->result = result;
+    k_work_submit_to_queue(&zy_i2c_nb_workq[ctx->bus], &ctx->done_work);
+}
+#endif
+
+/*
+    Start a transfer in the background: optional register address write followed
+    (after a repeated start for reads) by the data phase.
+    Uses the driver's callback API when available, otherwise the blocking transfer
+    is moved to the zy_i2c work queue thread so the caller is still free to continue.
+    Transfers started from an interrupt (e.g. a group result readout started by the
+    last sensor interrupt) always go through the work queue.
+*/
+static int zy_i2c_nb_start(uint8_t bus, uint16_t addr, const uint8_t *reg, uint8_t *data, uint32_t size,
+                           uint8_t read, zy_i2c_nb_cb_t cb, void *user_data){
+    struct zy_i2c_nb *ctx;
+    int n;
+
+    if(!nb_initialized){
+        return -ENODEV;
+    }
+    if(bus >= ARRAY_SIZE(buses)){
+        return -EINVAL;
+    }
+    ctx = &nb[bus];
+
+    if(!atomic_cas(&ctx->busy, 0, 1)){
+        return -EBUSY;
+    }
+
+    if(reg != NULL){
+        ctx->reg = *reg;
+    }
+    n = zy_i2c_build_msgs(ctx->msgs, (reg != NULL) ? &ctx->reg : NULL, 1, data, size, read);
+    if(n < 0){
+        atomic_set(&ctx->busy, 0);
+        return n;
+    }
+
+    ctx->num_msgs = n;
+    ctx->bus = bus;
+    ctx->addr = addr;
+    ctx->cb = cb;
+    ctx->user_data = user_data;
+    ctx->retried = 0;
+
+#ifdef CONFIG_I2C_CALLBACK
+    if(!k_is_in_isr()){
+        int ret = i2c_transfer_cb(buses[bus], ctx->msgs, ctx->num_msgs, addr, zy_i2c_nb_isr_cb, ctx);
+        if(ret != -ENOSYS){
+            if(ret != 0){
+                atomic_set(&ctx->busy, 0);
+            }
+            return ret;
+        }
+    }
+#endif
+
+    k_work_submit_to_queue(&zy_i2c_nb_workq[bus], &ctx->xfer_work);
+    return 0;
+}
 
 int zy_i2c_init(){
-    
-    if (!device_is_ready(iicm.bus)) {
-		printk("I2C Main bus %s is not ready!\n\r",iicm.bus->name);
-		return 0;
-	}
 
-	if (!device_is_ready(iicc.bus)) {
-		printk("I2C Conf bus %s is not ready!\n\r",iicc.bus->name);
-		return 0;
-	}
+    for(uint8_t i = 0; i < ARRAY_SIZE(buses); i++){
+        if (!device_is_ready(buses[i])) {
+            printk("I2C bus %s is not ready!\n\r", buses[i]->name);
+            return 0;
+        }
+    }
+
+    for(uint8_t i = 0; i < ARRAY_SIZE(buses); i++){
+        if(i2c_get_config(buses[i], &bus_config[i]) != 0){
+            bus_config[i] = I2C_MODE_CONTROLLER | i2c_map_dt_bitrate(bus_bitrates[i]);
+        }
+        // Release a line left stuck before the reset, so that a failed probe can be taken as "no device"
+        // (not counted: no error was seen on this bus)
+        zy_i2c_recover(i);
+    }
+
+    if(!nb_initialized){
+        for(uint8_t i = 0; i < ARRAY_SIZE(buses); i++){
+            k_work_init(&nb[i].xfer_work, zy_i2c_nb_xfer_handler);
+            k_work_init(&nb[i].done_work, zy_i2c_nb_done_handler);
+            k_work_queue_start(&zy_i2c_nb_workq[i], zy_i2c_nb_stack[i], K_THREAD_STACK_SIZEOF(zy_i2c_nb_stack[i]),
+                               ZY_I2C_NB_PRIORITY, NULL);
+        }
+        nb_initialized = 1;
+    }
 
     return 1;
 }
 
-int zy_i2c_send_chirp(char* const msg, uint8_t size){
+uint8_t zy_i2c_num_buses(){
+    return ARRAY_SIZE(buses);
+}
+
+uint8_t zy_i2c_sensor_address(uint8_t sensor){
+    return sensor_addrs[sensor];
+}
+
+// Position of the sensor's controller in the bus list, 0xFF if it is not listed
+uint8_t zy_i2c_sensor_bus(uint8_t sensor){
+    for(uint8_t i = 0; i < ARRAY_SIZE(buses); i++){
+        if(buses[i] == sensor_buses[sensor]){
+            return i;
+        }
+    }
+    return 0xFF;
+}
 
-    ret = i2c_write_dt(&iicm, msg, size);
+int zy_i2c_send(uint8_t bus, uint16_t addr, uint8_t *msg, uint32_t size){
+
+    int ret = zy_i2c_xfer(bus, addr, NULL, 0, msg, size, 0, 1);
     if(ret != 0){
-        printk("Failed to write to I2C Conf device address %x at reg. %x n", iicm.addr,config[0]);
+        printk("Failed to write to I2C device address %x on bus %d\n\r", addr, bus);
     }
 
     return ret;
 }
 
-int zy_i2c_send_chirp_conf(char* const msg, uint8_t size){
+/*
+    Single write attempt to check whether a device answers at this address
+    (sensor discovery). An address NACK from an empty port is the expected
+    answer there, so it is neither retried nor counted as a bus error.
+*/
+int zy_i2c_probe(uint8_t bus, uint16_t addr, uint8_t *msg, uint32_t size){
+    return zy_i2c_xfer(bus, addr, NULL, 0, msg, size, 0, 0);
+}
+
+/*
+    Header (register address, count...) and payload sent as two messages of one
+    write transaction, so the payload never has to be copied behind the header
+    (the nRF TWIM driver merges them in its concatenation buffer).
+*/
+int zy_i2c_write_hdr(uint8_t bus, uint16_t addr, uint8_t *hdr, uint8_t hdr_len, uint8_t *data, uint32_t size){
+
+    int ret = zy_i2c_xfer(bus, addr, hdr, hdr_len, data, size, 0, 1);
+    if(ret != 0){
+        printk("Failed to write to I2C device address %x on bus %d at reg. %x\n\r", addr, bus, hdr[0]);
+    }
+
+    return ret;
+}
+
+int zy_i2c_recv(uint8_t bus, uint16_t addr, uint8_t *msg, uint32_t size){
+    return zy_i2c_xfer(bus, addr, NULL, 0, msg, size, 1, 1);
+}
+
+int zy_i2c_mem_read(uint8_t bus, uint16_t addr, uint8_t reg, uint8_t *data, uint32_t size){
 
-    ret = i2c_write_dt(&iicc, msg, size);
+    int ret = zy_i2c_xfer(bus, addr, &reg, 1, data, size, 1, 1);
     if(ret != 0){
-        printk("Failed to write to I2C Conf device address %x at reg. %x n", iicc.addr,config[0]);
+        printk("Failed to read from I2C device address %x on bus %d at reg. %x\n\r", addr, bus, reg);
     }
-    
+
     return ret;
 }
 
-uint8_t zy_i2c_chirp_address(){
-    return iicm->address;
+int zy_i2c_mem_read_nb(uint8_t bus, uint16_t addr, uint8_t reg, uint8_t *data, uint32_t size,
+                       zy_i2c_nb_cb_t cb, void *user_data){
+    return zy_i2c_nb_start(bus, addr, &reg, data, size, 1, cb, user_data);
+}
+
+int zy_i2c_mem_write_nb(uint8_t bus, uint16_t addr, uint8_t reg, uint8_t *data, uint32_t size,
+                        zy_i2c_nb_cb_t cb, void *user_data){
+    return zy_i2c_nb_start(bus, addr, &reg, data, size, 0, cb, user_data);
 }
 
-uint8_t zy_i2c_chirp_conf_address(){
-    return iicc->address;
+int zy_i2c_recv_nb(uint8_t bus, uint16_t addr, uint8_t *data, uint32_t size, zy_i2c_nb_cb_t cb, void *user_data){
+    return zy_i2c_nb_start(bus, addr, NULL, data, size, 1, cb, user_data);
 }
 
-int zy_i2c_recv_chirp(char* msg, uint8_t size){
-    return i2c_read_dt(iicm, msg, size);
+int zy_i2c_send_nb(uint8_t bus, uint16_t addr, uint8_t *data, uint32_t size, zy_i2c_nb_cb_t cb, void *user_data){
+    return zy_i2c_nb_start(bus, addr, NULL, data, size, 0, cb, user_data);
 }
 
-int zy_i2c_recv_chirp_conf(char* msg, uint8_t size){
-    return i2c_read_dt(iicc, msg, size);
+void zy_i2c_stats_get(struct zy_i2c_stats *out){
+    memset(out, 0, sizeof(*out));
+    for(uint8_t i = 0; i < ARRAY_SIZE(buses); i++){
+        out->bytes += (uint32_t) atomic_get(&xfer_stats[i].bytes);
+        out->cycles += (uint32_t) atomic_get(&xfer_stats[i].cycles);
+        out->transfers += (uint32_t) atomic_get(&xfer_stats[i].transfers);
+    }
+}
+
+void zy_i2c_stats_reset(){
+    for(uint8_t i = 0; i < ARRAY_SIZE(buses); i++){
+        atomic_clear(&xfer_stats[i].bytes);
+        atomic_clear(&xfer_stats[i].cycles);
+        atomic_clear(&xfer_stats[i].transfers);
+    }
 }
 
+uint32_t zy_i2c_stats_bytes_per_sec(const struct zy_i2c_stats *s){
+    uint64_t us = k_cyc_to_us_floor64(s->cycles);
+
+    return (us == 0) ? 0 : (uint32_t) (((uint64_t) s->bytes * USEC_PER_SEC) / us);
+}
+
+void zy_i2c_bus_stats_get(uint8_t bus, struct zy_i2c_bus_stats *out){
+    out->errors = (uint32_t) atomic_get(&bus_stats[bus].errors);
+    out->retries = (uint32_t) atomic_get(&bus_stats[bus].retries);
+    out->recoveries = (uint32_t) atomic_get(&bus_stats[bus].recoveries);
+    out->failures = (uint32_t) atomic_get(&bus_stats[bus].failures);
+    out->fallbacks = (uint32_t) atomic_get(&bus_stats[bus].fallbacks);
+}
+
+void zy_i2c_bus_stats_reset(){
+    for(uint8_t i = 0; i < ARRAY_SIZE(buses); i++){
+        atomic_clear(&bus_stats[i].errors);
+        atomic_clear(&bus_stats[i].retries);
+        atomic_clear(&bus_stats[i].recoveries);
+        atomic_clear(&bus_stats[i].failures);
+        atomic_clear(&bus_stats[i].fallbacks);
+    }
+}
@@ -8,6 +8,13 @@
 #include <zephyr/drivers/gpio.h>
 #include <zephyr/drivers/i2c.h>
 #include "soniclib.h"
+#include "chirp_bsp.h"
+#include "ch101_gpr_open.h"
+#include "ch201_gprmt.h"
+#include "chirp_bench.h"
+#ifdef CONFIG_SHELL
+#include "chirp_shell.h"
+#endif
 
 // Driver includes
 // #include "inc/soniclib.h"
@@ -42,8 +49,19 @@ static uint32_t data_ready_devices;
 ch_dev_t	chirp_devices[CHIRP_MAX_NUM_SENSORS];
 ch_group_t 	chirp_group;
 
+/* Define to also read the I/Q data of every sensor after each measurement, in the background 
+ *   (one more wake-up per measurement, and a buffer of CH201_MAX_NUM_SAMPLES samples per sensor).
+ */
+// #define READ_IQ_DATA_NONBLOCK
+
+static ch_result_t		chirp_results[CHIRP_MAX_NUM_SENSORS];	// from ch_group_get_results_nb()
+#ifdef READ_IQ_DATA_NONBLOCK
+static ch_iq_sample_t	chirp_iq_data[CHIRP_MAX_NUM_SENSORS][CH201_MAX_NUM_SAMPLES];	// from ch_get_iq_data()
+#endif
+
 #define DATA_READY_FLAG		(1 << 0)
 #define IQ_READY_FLAG		(1 << 1)
+#define RESULTS_READY_FLAG	(1 << 2)
 
 #define	CHIRP_SENSOR_MAX_RANGE_MM		750	/* maximum range, in mm */
 
@@ -66,28 +84,123 @@ static void sensor_int_callback(ch_group_t *grp_ptr, uint8_t dev_num) {
 		/* All active sensors have interrupted after performing a measurement */
 		data_ready_devices = 0;
 
-		/* Set data-ready flag - it will be checked in main() loop */
-		taskflags |= DATA_READY_FLAG;
-
 		/* Disable interrupt unless in free-running mode
 		 *   It will automatically be re-enabled during the next trigger 
 		 */
 		if (ch_get_mode(dev_ptr) != CH_MODE_FREERUN) {
 			chbsp_group_io_interrupt_disable(grp_ptr);
 		}
+
+		/* Read range and amplitude of all sensors in the background, 
+		 *   result_callback() sets the results-ready flag.  If the readout 
+		 *   cannot start (e.g. an I/Q readout is still running), set the 
+		 *   data-ready flag so that the main() loop reads them.
+		 */
+		if (ch_group_get_results_nb(grp_ptr, CH_RANGE_ECHO_ONE_WAY, chirp_results) != 0) {
+			taskflags |= DATA_READY_FLAG;
+			chbsp_proc_wakeup();
+		}
 	}
 }
 
+static void result_callback(ch_group_t *grp_ptr, ch_result_t *results_ptr) {
+
+	taskflags |= RESULTS_READY_FLAG;
+	chbsp_proc_wakeup();
+}
+
+#ifdef READ_IQ_DATA_NONBLOCK
 static void io_complete_callback(ch_group_t *grp_ptr) {
 
 	taskflags |= IQ_READY_FLAG;
+	chbsp_proc_wakeup();
+}
+#endif
+
+static uint8_t display_config_info(ch_dev_t *dev_ptr) {
+	ch_config_t read_config;
+	uint8_t 	chirp_error;
+	uint8_t 	dev_num = ch_get_dev_num(dev_ptr);
+
+	chirp_error = ch_get_config(dev_ptr, &read_config);
+
+	if (!chirp_error) {
+		printf("Sensor %d:\tmax_range=%dmm \tmode=%d", dev_num, read_config.max_range, read_config.mode);
+
+		if (read_config.static_range != 0) {
+			printf("  static_range=%d samples", read_config.static_range);
+		}
+		printf("\n");
+	} else {
+		printf("Device %d: Error during ch_get_config()\n", dev_num);
+	}
+
+	return chirp_error;
+}
+
+/* Blocking readout, only used when ch_group_get_results_nb() could not start */
+static void read_results(ch_group_t *grp_ptr) {
+
+	for (uint8_t dev_num = 0; dev_num < ch_get_num_ports(grp_ptr); dev_num++) {
+		ch_dev_t *dev_ptr = ch_get_dev_ptr(grp_ptr, dev_num);
+
+		if (ch_get_mode(dev_ptr) == CH_MODE_TRIGGERED_RX_ONLY) {
+			ch_get_result(dev_ptr, CH_RANGE_DIRECT, &chirp_results[dev_num], 0);
+		} else {
+			ch_get_result(dev_ptr, CH_RANGE_ECHO_ONE_WAY, &chirp_results[dev_num], 0);
+		}
+	}
+}
+
+/* Display the results of all sensors, and queue a non-blocking I/Q readout if READ_IQ_DATA_NONBLOCK is defined */
+static uint8_t handle_data_ready(ch_group_t *grp_ptr) {
+	int num_queued = 0;
+
+	for (uint8_t dev_num = 0; dev_num < ch_get_num_ports(grp_ptr); dev_num++) {
+		ch_dev_t *dev_ptr = ch_get_dev_ptr(grp_ptr, dev_num);
+
+		if (ch_sensor_is_connected(dev_ptr)) {
+			if (chirp_results[dev_num].range == CH_NO_TARGET) {
+				printf("Port %d:          no target found\n", dev_num);
+			} else {
+				printf("Port %d:  Range: %0.1f mm  Amplitude: %u\n", dev_num, 
+						(float) chirp_results[dev_num].range/32.0f, chirp_results[dev_num].amplitude);
+			}
+
+#ifdef READ_IQ_DATA_NONBLOCK
+			if (ch_get_iq_data(dev_ptr, chirp_iq_data[dev_num], 0, ch_get_num_samples(dev_ptr), 
+							   CH_IO_MODE_NONBLOCK) == 0) {
+				num_queued++;
+			}
+#endif
+		}
+	}
+
+	return (num_queued != 0) ? ch_io_start_nb(grp_ptr) : 0;
 }
 
+#ifdef READ_IQ_DATA_NONBLOCK
+static uint8_t handle_iq_data(ch_group_t *grp_ptr) {
 
-//#define	 CHIRP_SENSOR_FW_INIT_FUNC	ch101_gpr_open_init		/* CH101 GPR OPEN firmware */
-#define	 CHIRP_SENSOR_FW_INIT_FUNC	ch201_gprmt_init	/* CH201 GPR Multi-Threshold firmware */
+	for (uint8_t dev_num = 0; dev_num < ch_get_num_ports(grp_ptr); dev_num++) {
+		ch_dev_t *dev_ptr = ch_get_dev_ptr(grp_ptr, dev_num);
+
+		if (ch_sensor_is_connected(dev_ptr)) {
+			printf("Read %d samples from device %d\n", ch_get_num_samples(dev_ptr), dev_num);
+		}
+	}
+
+	return 0;
+}
+#endif
+
+
+/* Firmware for each part, picked per port from the part number given by the board */
+CH_FW_IMAGE_REGISTER(ch101_gpr_open, CH101_PART_NUMBER, CH_FW_CAP_STATIC_RANGE);	/* CH101 GPR OPEN firmware */
+CH_FW_IMAGE_REGISTER(ch201_gprmt, CH201_PART_NUMBER, CH_FW_CAP_THRESHOLDS);		/* CH201 GPR Multi-Threshold firmware */
 
 #define	MEASUREMENT_INTERVAL_MS		100		// 100ms interval = 10Hz sampling
+#define	RECAL_PERIOD_MS				60000	// initial period of the RTC recalibration between measurements
 
 ch_thresholds_t chirp_ch201_thresholds = {0, 	5000,		/* threshold 0 */
 										 26,	2000,		/* threshold 1 */
@@ -108,90 +221,108 @@ int main(void)
 
 	
 	num_ports = ch_get_num_ports(grp_ptr);
-	ch_dev_t *dev_ptr = &(chirp_devices[dev_num]);	// init struct in array
-	chirp_error |= ch_init(dev_ptr, grp_ptr, dev_num, CHIRP_SENSOR_FW_INIT_FUNC);
+	for (dev_num = 0; dev_num < num_ports; dev_num++) {
+		ch_dev_t *dev_ptr = &(chirp_devices[dev_num]);	// init struct in array
+		chirp_error |= ch_init_auto(dev_ptr, grp_ptr, dev_num, 0);
+	}
 
 	if (chirp_error == 0) {
 		printf("starting group... ");
-		chirp_error = ch_group_start(grp_ptr);
+		chirp_error = ch_group_warm_start(grp_ptr);		// full start unless the sensors kept running through an MCU reset
 	}
 
-	dev_ptr = ch_get_dev_ptr(grp_ptr, 0);
-	if (ch_sensor_is_connected(dev_ptr)) {
+	for (dev_num = 0; dev_num < num_ports; dev_num++) {
+		ch_dev_t *dev_ptr = ch_get_dev_ptr(grp_ptr, dev_num);
+
+		if (ch_sensor_is_connected(dev_ptr)) {
 
-		printf("%d\tCH%d\t %u Hz\t%lu@%ums\t%s\n", dev_num,
-										ch_get_part_number(dev_ptr),
-										ch_get_frequency(dev_ptr),
-										ch_get_rtc_cal_result(dev_ptr),
-										ch_get_rtc_cal_pulselength(dev_ptr),
-										ch_get_fw_version_string(dev_ptr));
+			printf("%d\tCH%d\t %u Hz\t%lu@%ums\t%s\n", dev_num,
+											ch_get_part_number(dev_ptr),
+											ch_get_frequency(dev_ptr),
+											ch_get_rtc_cal_result(dev_ptr),
+											ch_get_rtc_cal_pulselength(dev_ptr),
+											ch_get_fw_version_string(dev_ptr));
+		}
 	}
 	printf("\n\r");
 
 	chbsp_periodic_timer_init(MEASUREMENT_INTERVAL_MS, periodic_timer_callback);
 	ch_io_int_callback_set(grp_ptr, sensor_int_callback);
+#ifdef READ_IQ_DATA_NONBLOCK
 	ch_io_complete_callback_set(grp_ptr, io_complete_callback);
+#endif
+	ch_result_callback_set(grp_ptr, result_callback);
 
 
 	// Configure sensors with operation parameter
 	ch_config_t dev_config;
-	dev_ptr = ch_get_dev_ptr(grp_ptr, 0);
 
-	if (ch_sensor_is_connected(dev_ptr)) {
+	for (dev_num = 0; dev_num < num_ports; dev_num++) {
+		ch_dev_t *dev_ptr = ch_get_dev_ptr(grp_ptr, dev_num);
+
+		if (ch_sensor_is_connected(dev_ptr)) {
 
-		/* Select sensor mode 
-			*   All connected sensors are placed in hardware triggered mode.
-			*   The first connected (lowest numbered) sensor will transmit and 
-			*   receive, all others will only receive.
-			*/
+			/* Select sensor mode 
+				*   All connected sensors are placed in hardware triggered mode.
+				*   The first connected (lowest numbered) sensor will transmit and 
+				*   receive, all others will only receive.
+				*/
 
-		num_connected++;					// count one more connected
-		active_devices |= (1 << dev_num);	// add to active device bit mask
+			num_connected++;					// count one more connected
+			active_devices |= (1 << dev_num);	// add to active device bit mask
 		
-		dev_config.mode = CH_MODE_TRIGGERED_TX_RX;
-		// if (num_connected == 1) {			// if this is the first sensor
-		// 	dev_config.mode = CH_MODE_TRIGGERED_TX_RX;
-		// } else {									
-		// 	dev_config.mode = CH_MODE_TRIGGERED_RX_ONLY;
-		// }
-
-		/* Init config structure with values from hello_chirp.h */
-		dev_config.max_range       = CHIRP_SENSOR_MAX_RANGE_MM;
-		dev_config.static_range    = CHIRP_SENSOR_STATIC_RANGE;
-		dev_config.sample_interval = CHIRP_SENSOR_SAMPLE_INTERVAL;
-
-		/* Set detection thresholds (CH201 only) */
-		if (ch_get_part_number(dev_ptr) == CH201_PART_NUMBER) {
-			/* Set pointer to struct containing detection thresholds */
-			dev_config.thresh_ptr = &chirp_ch201_thresholds;	
-		} else {
-			dev_config.thresh_ptr = 0;							
+			if (num_connected == 1) {			// if this is the first sensor
+				dev_config.mode = CH_MODE_TRIGGERED_TX_RX;
+			} else {									
+				dev_config.mode = CH_MODE_TRIGGERED_RX_ONLY;
+			}
+
+			/* Init config structure with values from hello_chirp.h */
+			dev_config.max_range       = CHIRP_SENSOR_MAX_RANGE_MM;
+			dev_config.static_range    = CHIRP_SENSOR_STATIC_RANGE;
+			dev_config.sample_interval = CHIRP_SENSOR_SAMPLE_INTERVAL;
+
+			/* Set detection thresholds (CH201 only) */
+			if (ch_get_part_number(dev_ptr) == CH201_PART_NUMBER) {
+				/* Set pointer to struct containing detection thresholds */
+				dev_config.thresh_ptr = &chirp_ch201_thresholds;	
+			} else {
+				dev_config.thresh_ptr = 0;							
+			}
+
+			/* Apply sensor configuration */
+			chirp_error = ch_set_config(dev_ptr, &dev_config);
+
+			/* Enable sensor interrupt if using free-running mode 
+				*   Note that interrupt is automatically enabled if using 
+				*   triggered modes.
+				*/
+			if ((!chirp_error) && (dev_config.mode == CH_MODE_FREERUN)) {
+				chbsp_io_interrupt_enable(dev_ptr);
+			}
+
+			/* Read back and display config settings */
+			if (!chirp_error) {
+				display_config_info(dev_ptr);
+			} else {
+				printf("Device %d: Error during ch_set_config()\n", dev_num);
+			}
+
+			/* Turn on an LED to indicate device connected */
+			if (chirp_error) {
+				// chbsp_led_on(dev_num);
+				printk("Error in configuring sensor %d\n\r", dev_num);
+			}
 		}
+	}
 
-		/* Apply sensor configuration */
-		chirp_error = ch_set_config(dev_ptr, &dev_config);
+	chirp_bench_run(grp_ptr);
 
-		/* Enable sensor interrupt if using free-running mode 
-			*   Note that interrupt is automatically enabled if using 
-			*   triggered modes.
-			*/
-		if ((!chirp_error) && (dev_config.mode == CH_MODE_FREERUN)) {
-			chbsp_io_interrupt_enable(dev_ptr);
-		}
+#ifdef CONFIG_SHELL
+	chirp_shell_init(grp_ptr);			// "chirp boot" shows where ch_group_start() spent its time
+#endif
 
-		/* Read back and display config settings */
-		if (!chirp_error) {
-			display_config_info(dev_ptr);
-		} else {
-			printf("Device %d: Error during ch_set_config()\n", dev_num);
-		}
-
-		/* Turn on an LED to indicate device connected */
-		if (!chirp_error) {
-			// chbsp_led_on(dev_num);
-			printk("Error in configuring the sensor\n\r");
-		}
-	}
+	ch_group_set_recal_period(grp_ptr, RECAL_PERIOD_MS);
 
 	chbsp_periodic_timer_irq_enable();
 	chbsp_periodic_timer_start();
@@ -205,14 +336,23 @@ int main(void)
 			/* We only continue here after an interrupt wakes the processor */
 		}
 
-		/* Check for sensor data-ready interrupt(s) */
+		/* Check for results of all sensors read in the background */
+		if (taskflags & RESULTS_READY_FLAG) {
+
+			taskflags &= ~RESULTS_READY_FLAG;	// clear flag
+			handle_data_ready(grp_ptr);			// display measurement
+		}
+
+		/* Check for sensor data-ready interrupt(s) without a background readout */
 		if (taskflags & DATA_READY_FLAG) {
 
 			/* All sensors have interrupted - handle sensor data */
 			taskflags &= ~DATA_READY_FLAG;		// clear flag
-			handle_data_ready(grp_ptr);			// read and display measurement
+			read_results(grp_ptr);				// blocking readout
+			handle_data_ready(grp_ptr);			// display measurement
 		}
 
+#ifdef READ_IQ_DATA_NONBLOCK
 		/* Check for non-blocking I/Q readout complete */
 		if (taskflags & IQ_READY_FLAG) {
 
@@ -220,6 +360,7 @@ int main(void)
 			taskflags &= ~IQ_READY_FLAG;		// clear flag
 			handle_iq_data(grp_ptr);			// display I/Q data
 		}
+#endif
 	}
 }
 	// irq_enable();
@@ -0,0 +1,188 @@
+/*
+    Simulated GPIO controller for native_sim builds, see zy_sim.h.
+
+    Pins configured as outputs by the host report their level to the sensor
+    model (RESET_N, PROG, and INT while the host drives it for triggering or
+    RTC calibration). Pins configured as inputs follow the level driven by the
+    sensor model and raise the configured edge interrupts.
+*/
+
+#define DT_DRV_COMPAT zy_sim_gpio
+
+#include "zy_sim.h"
+#include <zephyr/drivers/gpio/gpio_utils.h>
+
+struct zy_sim_gpio_config {
+    struct gpio_driver_config common;       // must be first
+};
+
+struct zy_sim_gpio_data {
+    struct gpio_driver_data common;         // must be first
+    gpio_port_value_t output;
+    gpio_port_value_t input;
+    gpio_port_pins_t dir_out;
+    gpio_port_pins_t int_rising;
+    gpio_port_pins_t int_falling;
+    sys_slist_t callbacks;
+    struct k_spinlock lock;
+};
+
+static const struct device *const zy_sim_gpio_dev = DEVICE_DT_INST_GET(0);
+
+// Tell the sensor model about every pin whose driven level changed
+static void zy_sim_gpio_notify(gpio_port_value_t before, gpio_port_value_t after, gpio_port_pins_t pins){
+    gpio_port_pins_t changed = (before ^ after) & pins;
+
+    for(gpio_pin_t pin = 0; changed != 0; pin++, changed >>= 1){
+        if(changed & 1){
+            zy_sim_sensor_pin_changed(pin, (after >> pin) & 1);
+        }
+    }
+}
+
+// Level seen by the sensors: the output latch on output pins, low (pulled down) otherwise
+static gpio_port_value_t zy_sim_gpio_driven(struct zy_sim_gpio_data *data){
+    return data->output & data->dir_out;
+}
+
+static void zy_sim_gpio_update(const struct device *dev, gpio_port_value_t output, gpio_port_pins_t dir_out){
+    struct zy_sim_gpio_data *data = dev->data;
+    k_spinlock_key_t key = k_spin_lock(&data->lock);
+    gpio_port_value_t before = zy_sim_gpio_driven(data);
+    gpio_port_value_t after;
+
+    data->output = output;
+    data->dir_out = dir_out;
+    after = zy_sim_gpio_driven(data);
+    k_spin_unlock(&data->lock, key);
+
+    zy_sim_gpio_notify(before, after, UINT32_MAX);
+}
+
+static int zy_sim_gpio_pin_configure(const struct device *dev, gpio_pin_t pin, gpio_flags_t flags){
+    struct zy_sim_gpio_data *data = dev->data;
+    gpio_port_value_t output = data->output;
+    gpio_port_pins_t dir_out = data->dir_out;
+
+    if(flags & GPIO_OUTPUT){
+        if(flags & GPIO_OUTPUT_INIT_HIGH){
+            output |= BIT(pin);
+        }
+        else if(flags & GPIO_OUTPUT_INIT_LOW){
+            output &= ~BIT(pin);
+        }
+        dir_out |= BIT(pin);
+    }
+    else{
+        dir_out &= ~BIT(pin);
+    }
+    zy_sim_gpio_update(dev, output, dir_out);
+    return 0;
+}
+
+static int zy_sim_gpio_port_get_raw(const struct device *dev, gpio_port_value_t *value){
+    struct zy_sim_gpio_data *data = dev->data;
+
+    *value = (data->output & data->dir_out) | (data->input & ~data->dir_out);
+    return 0;
+}
+
+static int zy_sim_gpio_port_set_masked_raw(const struct device *dev, gpio_port_pins_t mask, gpio_port_value_t value){
+    struct zy_sim_gpio_data *data = dev->data;
+
+    zy_sim_gpio_update(dev, (data->output & ~mask) | (value & mask), data->dir_out);
+    return 0;
+}
+
+static int zy_sim_gpio_port_set_bits_raw(const struct device *dev, gpio_port_pins_t pins){
+    return zy_sim_gpio_port_set_masked_raw(dev, pins, pins);
+}
+
+static int zy_sim_gpio_port_clear_bits_raw(const struct device *dev, gpio_port_pins_t pins){
+    return zy_sim_gpio_port_set_masked_raw(dev, pins, 0);
+}
+
+static int zy_sim_gpio_port_toggle_bits(const struct device *dev, gpio_port_pins_t pins){
+    struct zy_sim_gpio_data *data = dev->data;
+
+    return zy_sim_gpio_port_set_masked_raw(dev, pins, ~data->output);
+}
+
+static int zy_sim_gpio_pin_interrupt_configure(const struct device *dev, gpio_pin_t pin,
+                                               enum gpio_int_mode mode, enum gpio_int_trig trig){
+    struct zy_sim_gpio_data *data = dev->data;
+    k_spinlock_key_t key;
+
+    if(mode == GPIO_INT_MODE_LEVEL){
+        return -ENOTSUP;
+    }
+
+    key = k_spin_lock(&data->lock);
+    data->int_rising &= ~BIT(pin);
+    data->int_falling &= ~BIT(pin);
+    if(mode != GPIO_INT_MODE_DISABLED){
+        if(trig & GPIO_INT_TRIG_HIGH){
+            data->int_rising |= BIT(pin);
+        }
+        if(trig & GPIO_INT_TRIG_LOW){
+            data->int_falling |= BIT(pin);
+        }
+    }
+    k_spin_unlock(&data->lock, key);
+    return 0;
+}
+
+static int zy_sim_gpio_manage_callback(const struct device *dev, struct gpio_callback *callback, bool set){
+    struct zy_sim_gpio_data *data = dev->data;
+
+    return gpio_manage_callback(&data->callbacks, callback, set);
+}
+
+/*
+    Level driven on a pin by a sensor. Ignored while the host drives the pin
+    itself, otherwise fires the host's edge interrupt (in the caller's context).
+*/
+void zy_sim_gpio_drive(gpio_pin_t pin, int level){
+    struct zy_sim_gpio_data *data = zy_sim_gpio_dev->data;
+    k_spinlock_key_t key = k_spin_lock(&data->lock);
+    gpio_port_value_t before = data->input;
+    gpio_port_pins_t edge;
+
+    if(data->dir_out & BIT(pin)){
+        k_spin_unlock(&data->lock, key);
+        return;
+    }
+    WRITE_BIT(data->input, pin, level);
+    edge = (before ^ data->input) & (level ? data->int_rising : data->int_falling) & BIT(pin);
+    k_spin_unlock(&data->lock, key);
+
+    if(edge){
+        gpio_fire_callbacks(&data->callbacks, zy_sim_gpio_dev, edge);
+    }
+}
+
+static const struct gpio_driver_api zy_sim_gpio_api = {
+    .pin_configure = zy_sim_gpio_pin_configure,
+    .port_get_raw = zy_sim_gpio_port_get_raw,
+    .port_set_masked_raw = zy_sim_gpio_port_set_masked_raw,
+    .port_set_bits_raw = zy_sim_gpio_port_set_bits_raw,
+    .port_clear_bits_raw = zy_sim_gpio_port_clear_bits_raw,
+    .port_toggle_bits = zy_sim_gpio_port_toggle_bits,
+    .pin_interrupt_configure = zy_sim_gpio_pin_interrupt_configure,
+    .manage_callback = zy_sim_gpio_manage_callback,
+};
+
+static int zy_sim_gpio_init(const struct device *dev){
+    return 0;
+}
+
+static const struct zy_sim_gpio_config zy_sim_gpio_config_0 = {
+    .common = {
+        .port_pin_mask = GPIO_PORT_PIN_MASK_FROM_DT_INST(0),
+    },
+};
+
+static struct zy_sim_gpio_data zy_sim_gpio_data_0;
+
+DEVICE_DT_INST_DEFINE(0, zy_sim_gpio_init, NULL, &zy_sim_gpio_data_0, &zy_sim_gpio_config_0,
+                      PRE_KERNEL_1, CONFIG_GPIO_INIT_PRIORITY, &zy_sim_gpio_api);
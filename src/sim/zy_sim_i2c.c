@@ -0,0 +1,122 @@
+/*
+    Simulated I2C controller for native_sim builds, see zy_sim.h.
+
+    Transfers are handed to the sensor model, then the calling thread is held
+    for the time the transfer would take on a real bus: a fixed latency per
+    transfer (driver and interrupt overhead, busy) plus 9 clocks per byte,
+    address bytes included, at the configured bit rate. Like with a DMA
+    controller, the thread sleeps during the bus time, so transfers on
+    different buses overlap.
+*/
+
+#define DT_DRV_COMPAT zy_sim_i2c
+
+#include "zy_sim.h"
+
+#define ZY_SIM_I2C_BITS_PER_BYTE    9           // 8 data bits + ACK
+#define ZY_SIM_I2C_BITS_START_STOP  2
+#define ZY_SIM_I2C_RECOVERY_CLOCKS  9           // clock pulses of a bus clear, STOP excluded
+
+struct zy_sim_i2c_config {
+    uint32_t bus_ord;           // devicetree ordinal, identifies the bus in the sensor model
+    uint32_t bitrate;
+    uint32_t latency_us;
+};
+
+struct zy_sim_i2c_data {
+    uint32_t bitrate;
+    struct k_sem lock;
+};
+
+static int zy_sim_i2c_configure(const struct device *dev, uint32_t dev_config){
+    struct zy_sim_i2c_data *data = dev->data;
+
+    switch(I2C_SPEED_GET(dev_config)){
+        case I2C_SPEED_STANDARD:
+            data->bitrate = I2C_BITRATE_STANDARD;
+            break;
+        case I2C_SPEED_FAST:
+            data->bitrate = I2C_BITRATE_FAST;
+            break;
+        case I2C_SPEED_FAST_PLUS:
+            data->bitrate = I2C_BITRATE_FAST_PLUS;
+            break;
+        case I2C_SPEED_HIGH:
+            data->bitrate = I2C_BITRATE_HIGH;
+            break;
+        default:
+            return -ENOTSUP;
+    }
+    return 0;
+}
+
+static int zy_sim_i2c_get_config(const struct device *dev, uint32_t *dev_config){
+    struct zy_sim_i2c_data *data = dev->data;
+
+    *dev_config = I2C_MODE_CONTROLLER | i2c_map_dt_bitrate(data->bitrate);
+    return 0;
+}
+
+static int zy_sim_i2c_transfer(const struct device *dev, struct i2c_msg *msgs, uint8_t num_msgs, uint16_t addr){
+    const struct zy_sim_i2c_config *config = dev->config;
+    struct zy_sim_i2c_data *data = dev->data;
+    uint64_t bits = ZY_SIM_I2C_BITS_START_STOP;
+    int ret;
+
+    for(uint8_t i = 0; i < num_msgs; i++){
+        if(i == 0 || (msgs[i].flags & I2C_MSG_RESTART)){
+            bits += ZY_SIM_I2C_BITS_PER_BYTE;       // address byte
+        }
+        bits += (uint64_t) msgs[i].len * ZY_SIM_I2C_BITS_PER_BYTE;
+    }
+
+    k_sem_take(&data->lock, K_FOREVER);
+    ret = zy_sim_sensor_transfer(config->bus_ord, msgs, num_msgs, addr);
+    k_busy_wait(config->latency_us);
+    k_usleep((int32_t) ((bits * USEC_PER_SEC) / data->bitrate));
+    k_sem_give(&data->lock);
+
+    return ret;
+}
+
+// Bus clear: SCL pulses until SDA is released, then STOP
+static int zy_sim_i2c_recover_bus(const struct device *dev){
+    const struct zy_sim_i2c_config *config = dev->config;
+    struct zy_sim_i2c_data *data = dev->data;
+
+    k_sem_take(&data->lock, K_FOREVER);
+    zy_sim_sensor_bus_clear(config->bus_ord);
+    k_busy_wait(((ZY_SIM_I2C_RECOVERY_CLOCKS + 1) * USEC_PER_SEC) / data->bitrate);
+    k_sem_give(&data->lock);
+
+    return 0;
+}
+
+static const struct i2c_driver_api zy_sim_i2c_api = {
+    .configure = zy_sim_i2c_configure,
+    .get_config = zy_sim_i2c_get_config,
+    .transfer = zy_sim_i2c_transfer,
+    .recover_bus = zy_sim_i2c_recover_bus,
+};
+
+static int zy_sim_i2c_init(const struct device *dev){
+    const struct zy_sim_i2c_config *config = dev->config;
+    struct zy_sim_i2c_data *data = dev->data;
+
+    data->bitrate = config->bitrate;
+    k_sem_init(&data->lock, 1, 1);
+    return 0;
+}
+
+#define ZY_SIM_I2C_INIT(n)                                                          \
+    static const struct zy_sim_i2c_config zy_sim_i2c_config_##n = {                 \
+        .bus_ord = DT_DEP_ORD(DT_DRV_INST(n)),                                      \
+        .bitrate = DT_INST_PROP_OR(n, clock_frequency, I2C_BITRATE_STANDARD),       \
+        .latency_us = DT_INST_PROP(n, latency_us),                                  \
+    };                                                                              \
+    static struct zy_sim_i2c_data zy_sim_i2c_data_##n;                              \
+    I2C_DEVICE_DT_INST_DEFINE(n, zy_sim_i2c_init, NULL, &zy_sim_i2c_data_##n,       \
+                              &zy_sim_i2c_config_##n, POST_KERNEL,                  \
+                              CONFIG_I2C_INIT_PRIORITY, &zy_sim_i2c_api);
+
+DT_INST_FOREACH_STATUS_OKAY(ZY_SIM_I2C_INIT)
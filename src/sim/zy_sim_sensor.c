@@ -0,0 +1,725 @@
+/*
+    Simulated CH101 / CH201 sensors, see zy_sim.h.
+
+    One model per sensor port of the chirp_board devicetree node. The model is
+    driven by the simulated I2C controller (bus transfers) and GPIO controller
+    (RESET_N, PROG and INT levels driven by the host), and drives INT itself
+    when a measurement is complete.
+*/
+
+#include "zy_sim.h"
+#include <stdlib.h>
+#include <string.h>
+#include "chirp_board_config.h"
+#include "soniclib.h"
+#include "ch_driver.h"
+
+// Sensor memory map, identical for CH101 and CH201
+#define ZY_SIM_SYS_MEM_ADDR         0x0100          // control registers (WDT, PMUT, I2C address...)
+#define ZY_SIM_SYS_MEM_SIZE         0x100
+#define ZY_SIM_DATA_MEM_ADDR        CH201_DATA_MEM_ADDR
+#define ZY_SIM_DATA_MEM_SIZE        CH201_DATA_MEM_SIZE
+#define ZY_SIM_PROG_MEM_ADDR        CH201_PROG_MEM_ADDR
+#define ZY_SIM_PROG_MEM_SIZE        CH201_PROG_MEM_SIZE
+#define ZY_SIM_APP_ADDR_LOC         0x01C5          // application I2C address, set by the driver
+
+#define ZY_SIM_PING_0               CH_SIG_BYTE_0   // CH_PROG_REG_PING reads back the signature
+#define ZY_SIM_PING_1               CH_SIG_BYTE_1
+
+// CH_PROG_REG_CPU bits
+#define ZY_SIM_CPU_RESET            0x40
+#define ZY_SIM_CPU_HALT             0x10
+#define ZY_SIM_CPU_RUN              0x02
+
+// CH_PROG_REG_CTL commands
+#define ZY_SIM_CTL_WRITE_WORD       0x03
+#define ZY_SIM_CTL_WRITE_BYTE       0x0B            // burst write when CH_PROG_REG_CNT was set just before
+#define ZY_SIM_CTL_READ_BURST       0x09
+
+#define ZY_SIM_READY_FREQ_LOCKED    0x02
+#define ZY_SIM_NO_TARGET            0xFFFF
+
+#define ZY_SIM_MAX_IQ_SAMPLES       ((ZY_SIM_DATA_MEM_SIZE - CH201_GPRMT_REG_DATA) / sizeof(ch_iq_sample_t))
+
+// Application register map of one firmware image
+struct zy_sim_regmap {
+    const uint8_t *fw;
+    uint16_t part_number;
+    uint8_t oversample;         // TOF and sample positions are scaled by 2^oversample
+    uint8_t opmode;
+    uint8_t tick_interval;
+    uint8_t period;
+    uint8_t cal_trig;
+    uint8_t max_range;
+    uint8_t cal_result;
+    uint8_t st_range;
+    uint8_t ready;
+    uint8_t tof_sf;
+    uint8_t tof;
+    uint8_t amplitude;
+    uint8_t data;
+    uint8_t thresh_len[CH201_GPRMT_NUM_THRESHOLDS - 1];    // CH201 only
+    uint8_t thresholds;                                     // 0 if the firmware has no thresholds
+};
+
+static const struct zy_sim_regmap regmaps[] = {
+    {
+        .fw = ch101_gpr_open_fw, .part_number = CH101_PART_NUMBER, .oversample = 0,
+        .opmode = CH101_GPR_OPEN_REG_OPMODE, .tick_interval = CH101_GPR_OPEN_REG_TICK_INTERVAL,
+        .period = CH101_GPR_OPEN_REG_PERIOD, .cal_trig = CH101_GPR_OPEN_REG_CAL_TRIG,
+        .max_range = CH101_GPR_OPEN_REG_MAX_RANGE, .cal_result = CH101_GPR_OPEN_REG_CAL_RESULT,
+        .st_range = CH101_GPR_OPEN_REG_ST_RANGE, .ready = CH101_GPR_OPEN_REG_READY,
+        .tof_sf = CH101_GPR_OPEN_REG_TOF_SF, .tof = CH101_GPR_OPEN_REG_TOF,
+        .amplitude = CH101_GPR_OPEN_REG_AMPLITUDE, .data = CH101_GPR_OPEN_REG_DATA,
+    },
+    {
+        .fw = ch101_gpr_sr_open_fw, .part_number = CH101_PART_NUMBER, .oversample = 2,
+        .opmode = CH101_GPR_SR_OPEN_REG_OPMODE, .tick_interval = CH101_GPR_SR_OPEN_REG_TICK_INTERVAL,
+        .period = CH101_GPR_SR_OPEN_REG_PERIOD, .cal_trig = CH101_GPR_SR_OPEN_REG_CAL_TRIG,
+        .max_range = CH101_GPR_SR_OPEN_REG_MAX_RANGE, .cal_result = CH101_GPR_SR_OPEN_REG_CAL_RESULT,
+        .st_range = CH101_GPR_SR_OPEN_REG_ST_RANGE, .ready = CH101_GPR_SR_OPEN_REG_READY,
+        .tof_sf = CH101_GPR_SR_OPEN_REG_TOF_SF, .tof = CH101_GPR_SR_OPEN_REG_TOF,
+        .amplitude = CH101_GPR_SR_OPEN_REG_AMPLITUDE, .data = CH101_GPR_SR_OPEN_REG_DATA,
+    },
+    {
+        .fw = ch201_gprmt_fw, .part_number = CH201_PART_NUMBER, .oversample = 0,
+        .opmode = CH201_GPRMT_REG_OPMODE, .tick_interval = CH201_GPRMT_REG_TICK_INTERVAL,
+        .period = CH201_GPRMT_REG_PERIOD, .cal_trig = CH201_GPRMT_REG_CAL_TRIG,
+        .max_range = CH201_GPRMT_REG_MAX_RANGE, .cal_result = CH201_GPRMT_REG_CAL_RESULT,
+        .st_range = CH201_GPRMT_REG_ST_RANGE, .ready = CH201_GPRMT_REG_READY,
+        .tof_sf = CH201_GPRMT_REG_TOF_SF, .tof = CH201_GPRMT_REG_TOF,
+        .amplitude = CH201_GPRMT_REG_AMPLITUDE, .data = CH201_GPRMT_REG_DATA,
+        .thresh_len = { CH201_GPRMT_REG_THRESH_LEN_0, CH201_GPRMT_REG_THRESH_LEN_1, CH201_GPRMT_REG_THRESH_LEN_2,
+                        CH201_GPRMT_REG_THRESH_LEN_3, CH201_GPRMT_REG_THRESH_LEN_4 },
+        .thresholds = CH201_GPRMT_REG_THRESHOLDS,
+    },
+};
+
+enum zy_sim_burst {
+    ZY_SIM_BURST_NONE,
+    ZY_SIM_BURST_WRITE,
+    ZY_SIM_BURST_READ
+};
+
+struct zy_sim_sensor {
+    uint8_t index;
+    uint8_t present;
+    uint8_t prog;               // PROG line asserted by the host
+    uint8_t int_level;          // INT level driven by the host
+    uint8_t holds_sda;          // stuck in the middle of a byte, see zy_sim_hold_sda()
+
+    // Programming interface
+    uint16_t prog_addr;
+    uint16_t prog_cnt;
+    uint16_t prog_data;
+    uint8_t prog_cpu;
+    uint8_t prog_ptr;           // register selected for reading
+    uint8_t cnt_written;
+    enum zy_sim_burst burst;
+    uint16_t burst_pos;
+    uint8_t in_burst;           // current write phase carries burst data
+
+    // Transfer state, reset at every start / repeated start
+    uint8_t cmd;
+    uint16_t cmd_val;
+    uint8_t rd_pos;
+
+    // Firmware
+    const struct zy_sim_regmap *map;
+    uint8_t running;
+    uint8_t app_addr;
+    uint8_t app_ptr;
+    uint8_t mode_dirty;
+    uint8_t freerun;
+    uint8_t measuring;
+    uint8_t cal_armed;
+    uint8_t cal_running;
+    uint32_t cal_start;
+    int64_t run_time;
+    uint32_t op_freq;
+    uint32_t meas_count;
+    uint32_t seed;
+    struct k_timer meas_timer;
+
+    struct zy_sim_scene scene;
+
+    uint8_t sys_mem[ZY_SIM_SYS_MEM_SIZE];
+    uint8_t data_mem[ZY_SIM_DATA_MEM_SIZE];     // application registers start at offset 0
+    uint8_t prog_mem[ZY_SIM_PROG_MEM_SIZE];
+};
+
+// Sensor ports in devicetree child order (= SonicLib device number)
+#define ZY_SIM_SENSOR_BUS(node_id)      DT_DEP_ORD(DT_PHANDLE(node_id, i2c_bus)),
+#define ZY_SIM_SENSOR_PRG(node_id)      DT_GPIO_PIN(node_id, prog_gpios),
+#define ZY_SIM_SENSOR_INT(node_id)      DT_GPIO_PIN(node_id, int_gpios),
+
+static const uint32_t sensor_bus_ord[] = { DT_FOREACH_CHILD(CHIRP_BOARD_NODE, ZY_SIM_SENSOR_BUS) };
+static const gpio_pin_t sensor_prg_pin[] = { DT_FOREACH_CHILD(CHIRP_BOARD_NODE, ZY_SIM_SENSOR_PRG) };
+static const gpio_pin_t sensor_int_pin[] = { DT_FOREACH_CHILD(CHIRP_BOARD_NODE, ZY_SIM_SENSOR_INT) };
+
+#define ZY_SIM_RST_PIN          DT_GPIO_PIN(CHIRP_BOARD_NODE, reset_gpios)
+#define ZY_SIM_RST_ACTIVE_LOW   (DT_GPIO_FLAGS(CHIRP_BOARD_NODE, reset_gpios) & GPIO_ACTIVE_LOW)
+
+static struct zy_sim_sensor sensors[CHIRP_MAX_NUM_SENSORS];
+static uint8_t rst_asserted;
+static struct k_spinlock zy_sim_lock;
+
+static const struct zy_sim_scene default_scene = {
+    .num_targets = 1,
+    .targets = { { .range_mm = 500, .amplitude = 2000 } },
+    .noise = 20,
+};
+
+static uint8_t *zy_sim_mem(struct zy_sim_sensor *s, uint16_t addr){
+    if(addr >= ZY_SIM_PROG_MEM_ADDR){
+        return &s->prog_mem[addr - ZY_SIM_PROG_MEM_ADDR];
+    }
+    if(addr >= ZY_SIM_DATA_MEM_ADDR && addr < ZY_SIM_DATA_MEM_ADDR + ZY_SIM_DATA_MEM_SIZE){
+        return &s->data_mem[addr - ZY_SIM_DATA_MEM_ADDR];
+    }
+    if(addr >= ZY_SIM_SYS_MEM_ADDR && addr < ZY_SIM_SYS_MEM_ADDR + ZY_SIM_SYS_MEM_SIZE){
+        return &s->sys_mem[addr - ZY_SIM_SYS_MEM_ADDR];
+    }
+    return NULL;
+}
+
+static uint16_t zy_sim_reg_word(struct zy_sim_sensor *s, uint8_t reg){
+    return s->data_mem[reg] | (s->data_mem[reg + 1] << 8);
+}
+
+static void zy_sim_set_reg_word(struct zy_sim_sensor *s, uint8_t reg, uint16_t val){
+    s->data_mem[reg] = (uint8_t) val;
+    s->data_mem[reg + 1] = (uint8_t) (val >> 8);
+}
+
+static void zy_sim_halt(struct zy_sim_sensor *s){
+    k_timer_stop(&s->meas_timer);
+    s->running = 0;
+    s->measuring = 0;
+    s->freerun = 0;
+    s->cal_armed = 0;
+    s->cal_running = 0;
+}
+
+// CPU leaves programming mode: start the firmware found in program memory
+static void zy_sim_run(struct zy_sim_sensor *s){
+    s->map = NULL;
+    for(uint8_t i = 0; i < ARRAY_SIZE(regmaps); i++){
+        if(memcmp(s->prog_mem, regmaps[i].fw, ZY_SIM_PROG_MEM_SIZE) == 0){
+            s->map = &regmaps[i];
+            break;
+        }
+    }
+
+    s->running = 1;
+    s->run_time = k_uptime_get();
+    s->app_addr = *zy_sim_mem(s, ZY_SIM_APP_ADDR_LOC);
+    if(s->map == NULL){
+        return;                 // idle loop or unknown image: nothing answers on the application address
+    }
+
+    s->op_freq = (s->map->part_number == CH101_PART_NUMBER) ? ZY_SIM_CH101_OP_FREQ : ZY_SIM_CH201_OP_FREQ;
+    s->data_mem[s->map->opmode] = CH_MODE_IDLE;
+    s->data_mem[s->map->ready] = 0;
+    zy_sim_set_reg_word(s, s->map->tof, ZY_SIM_NO_TARGET);
+    zy_sim_set_reg_word(s, s->map->amplitude, 0);
+    // Frequency counter result, see ch_common_store_op_freq()
+    zy_sim_set_reg_word(s, s->map->tof_sf, (s->op_freq * 16U * CH201_FREQCOUNTERCYCLES) / ZY_SIM_RTC_HZ);
+}
+
+static void zy_sim_update(struct zy_sim_sensor *s){
+    if(s->running && s->map != NULL && (k_uptime_get() - s->run_time) >= ZY_SIM_LOCK_MS){
+        s->data_mem[s->map->ready] |= ZY_SIM_READY_FREQ_LOCKED;
+    }
+}
+
+static uint16_t zy_sim_num_samples(struct zy_sim_sensor *s){
+    uint32_t n = s->data_mem[s->map->max_range];
+
+    if(s->map->part_number == CH201_PART_NUMBER){
+        n *= 2;                 // each count is 2 samples on CH201
+    }
+    return MIN(n, ZY_SIM_MAX_IQ_SAMPLES);
+}
+
+// Position of an echo in 1/16 sample, see ch_common_samples_to_mm()
+static uint32_t zy_sim_sample_q4(struct zy_sim_sensor *s, uint16_t range_mm){
+    uint64_t q4 = ((uint64_t) range_mm * 2U * s->op_freq * 16U) / (CH_SPEEDOFSOUND_MPS * 8U * 1000U);
+
+    return (uint32_t) (q4 << s->map->oversample);
+}
+
+// TOF register value for a one-way range, inverse of ch_common_get_range()
+static uint16_t zy_sim_tof(struct zy_sim_sensor *s, uint16_t range_mm){
+    uint32_t div = (s->map->part_number == CH201_PART_NUMBER) ? 2 : 1;
+    uint64_t tof = ((uint64_t) range_mm * 64U * s->op_freq) / (CH_SPEEDOFSOUND_MPS * 1000U * div);
+
+    tof <<= s->map->oversample;
+    return (tof >= ZY_SIM_NO_TARGET) ? (ZY_SIM_NO_TARGET - 1) : (uint16_t) tof;
+}
+
+static uint16_t zy_sim_threshold(struct zy_sim_sensor *s, uint16_t sample){
+    uint16_t start = 0;
+
+    if(s->map->thresholds == 0){
+        return ZY_SIM_CH101_THRESHOLD;
+    }
+    for(uint8_t t = 0; t < ARRAY_SIZE(s->map->thresh_len); t++){
+        start += s->data_mem[s->map->thresh_len[t]];
+        if(sample < start){
+            return zy_sim_reg_word(s, s->map->thresholds + t * sizeof(uint16_t));
+        }
+    }
+    return zy_sim_reg_word(s, s->map->thresholds + (CH201_GPRMT_NUM_THRESHOLDS - 1) * sizeof(uint16_t));
+}
+
+static int16_t zy_sim_noise(struct zy_sim_sensor *s){
+    if(s->scene.noise == 0){
+        return 0;
+    }
+    s->seed = s->seed * 1103515245U + 12345U;
+    return (int16_t) (((s->seed >> 16) % (2U * s->scene.noise + 1U)) - s->scene.noise);
+}
+
+// Produce the result of one measurement from the echo scene
+static void zy_sim_measure(struct zy_sim_sensor *s){
+    uint16_t num_samples = zy_sim_num_samples(s);
+    uint16_t st_range = (s->map->thresholds == 0) ? s->data_mem[s->map->st_range] : 0;
+    const struct zy_sim_target *hit = NULL;
+    ch_iq_sample_t *iq = (ch_iq_sample_t *) &s->data_mem[s->map->data];
+
+    // Reported target: nearest echo above the detection threshold
+    for(uint8_t t = 0; t < s->scene.num_targets; t++){
+        const struct zy_sim_target *tgt = &s->scene.targets[t];
+        uint32_t sample = (zy_sim_sample_q4(s, tgt->range_mm) + 8) / 16;
+
+        if(sample >= num_samples || sample < st_range || tgt->amplitude < zy_sim_threshold(s, sample)){
+            continue;
+        }
+        if(hit == NULL || tgt->range_mm < hit->range_mm){
+            hit = tgt;
+        }
+    }
+    zy_sim_set_reg_word(s, s->map->tof, (hit != NULL) ? zy_sim_tof(s, hit->range_mm) : ZY_SIM_NO_TARGET);
+    zy_sim_set_reg_word(s, s->map->amplitude, (hit != NULL) ? hit->amplitude : 0);
+
+    // I/Q: triangular envelope around each echo, carrier turning a quarter period per sample
+    for(uint16_t n = 0; n < num_samples; n++){
+        int32_t i_val = zy_sim_noise(s);
+        int32_t q_val = zy_sim_noise(s);
+
+        for(uint8_t t = 0; t < s->scene.num_targets; t++){
+            const struct zy_sim_target *tgt = &s->scene.targets[t];
+            int32_t half_q4 = ((tgt->width != 0) ? tgt->width : ZY_SIM_ECHO_WIDTH) * 16;
+            int32_t dist_q4 = abs((int32_t) (n * 16) - (int32_t) zy_sim_sample_q4(s, tgt->range_mm));
+            int32_t env;
+
+            if(dist_q4 >= half_q4){
+                continue;
+            }
+            env = (tgt->amplitude * (half_q4 - dist_q4)) / half_q4;
+            switch((n + t) & 3){
+                case 0: i_val += env; break;
+                case 1: q_val += env; break;
+                case 2: i_val -= env; break;
+                default: q_val -= env; break;
+            }
+        }
+        iq[n].i = (int16_t) CLAMP(i_val, INT16_MIN, INT16_MAX);
+        iq[n].q = (int16_t) CLAMP(q_val, INT16_MIN, INT16_MAX);
+    }
+    s->meas_count++;
+}
+
+static void zy_sim_meas_expiry(struct k_timer *timer){
+    struct zy_sim_sensor *s = k_timer_user_data_get(timer);
+    k_spinlock_key_t key = k_spin_lock(&zy_sim_lock);
+    uint8_t done = s->running && s->map != NULL;
+
+    if(done){
+        zy_sim_measure(s);
+    }
+    s->measuring = 0;
+    k_spin_unlock(&zy_sim_lock, key);
+
+    // Data ready: pulse on INT, the host interrupts on the falling edge
+    if(done){
+        zy_sim_gpio_drive(sensor_int_pin[s->index], 1);
+        zy_sim_gpio_drive(sensor_int_pin[s->index], 0);
+    }
+}
+
+// Operating mode or sample interval changed by the host
+static void zy_sim_apply_mode(struct zy_sim_sensor *s){
+    uint8_t opmode = s->data_mem[s->map->opmode];
+
+    if(opmode == CH_MODE_FREERUN){
+        uint32_t ticks = s->data_mem[s->map->period] * zy_sim_reg_word(s, s->map->tick_interval);
+
+        if(ticks != 0){
+            uint64_t us = ((uint64_t) ticks * USEC_PER_SEC) / ZY_SIM_RTC_HZ;
+
+            k_timer_start(&s->meas_timer, K_USEC(us), K_USEC(us));
+            s->freerun = 1;
+        }
+    }
+    else if(s->freerun){
+        k_timer_stop(&s->meas_timer);
+        s->freerun = 0;
+    }
+}
+
+static void zy_sim_trigger(struct zy_sim_sensor *s){
+    uint8_t opmode = s->data_mem[s->map->opmode];
+
+    if((opmode == CH_MODE_TRIGGERED_TX_RX || opmode == CH_MODE_TRIGGERED_RX_ONLY) && !s->measuring){
+        // One sample takes 8 periods of the operating frequency
+        uint32_t us = (zy_sim_num_samples(s) * 8U * USEC_PER_SEC) / s->op_freq;
+
+        s->measuring = 1;
+        k_timer_start(&s->meas_timer, K_USEC(MAX(us, 1)), K_NO_WAIT);
+    }
+}
+
+static void zy_sim_prog_reg_write(struct zy_sim_sensor *s, uint8_t reg, uint16_t val){
+    uint8_t *mem;
+
+    switch(reg){
+        case CH_PROG_REG_CPU:
+            s->prog_cpu = (uint8_t) val;
+            if(val & (ZY_SIM_CPU_RESET | ZY_SIM_CPU_HALT)){
+                zy_sim_halt(s);
+            }
+            else if(val & ZY_SIM_CPU_RUN){
+                zy_sim_run(s);
+            }
+            break;
+        case CH_PROG_REG_ADDR:
+            s->prog_addr = val;
+            break;
+        case CH_PROG_REG_CNT:
+            s->prog_cnt = val;
+            s->cnt_written = 1;
+            break;
+        case CH_PROG_REG_DATA:
+            s->prog_data = val;
+            break;
+        case CH_PROG_REG_CTL:
+            if(val == ZY_SIM_CTL_WRITE_BYTE && s->cnt_written){
+                s->burst = ZY_SIM_BURST_WRITE;
+                s->burst_pos = 0;
+            }
+            else if(val == ZY_SIM_CTL_READ_BURST){
+                s->burst = ZY_SIM_BURST_READ;
+                s->burst_pos = 0;
+            }
+            else if(val == ZY_SIM_CTL_WRITE_BYTE || val == ZY_SIM_CTL_WRITE_WORD){
+                mem = zy_sim_mem(s, s->prog_addr);
+                if(mem != NULL){
+                    mem[0] = (uint8_t) s->prog_data;
+                }
+                mem = zy_sim_mem(s, s->prog_addr + 1);
+                if(mem != NULL && val == ZY_SIM_CTL_WRITE_WORD){
+                    mem[0] = (uint8_t) (s->prog_data >> 8);
+                }
+            }
+            s->cnt_written = 0;
+            break;
+        default:
+            break;
+    }
+}
+
+static uint8_t zy_sim_prog_reg_read(struct zy_sim_sensor *s, uint8_t reg, uint8_t byte){
+    uint16_t val;
+
+    switch(reg){
+        case CH_PROG_REG_PING:  return (byte == 0) ? ZY_SIM_PING_0 : ZY_SIM_PING_1;
+        case CH_PROG_REG_CPU:   val = s->prog_cpu; break;
+        case CH_PROG_REG_ADDR:  val = s->prog_addr; break;
+        case CH_PROG_REG_CNT:   val = s->prog_cnt; break;
+        case CH_PROG_REG_DATA:  val = s->prog_data; break;
+        default:                val = 0; break;
+    }
+    return (uint8_t) (val >> (8 * byte));
+}
+
+// Byte written at position pos of the current write phase
+static void zy_sim_write_byte(struct zy_sim_sensor *s, uint8_t prog, uint32_t pos, uint8_t byte){
+    if(prog){
+        if(pos == 0){
+            s->in_burst = (s->burst == ZY_SIM_BURST_WRITE);
+        }
+        if(s->in_burst){
+            uint8_t *mem = zy_sim_mem(s, s->prog_addr + s->burst_pos);
+
+            if(mem != NULL){
+                *mem = byte;
+            }
+            if(++s->burst_pos > s->prog_cnt){
+                s->burst = ZY_SIM_BURST_NONE;
+                s->in_burst = 0;
+            }
+            return;
+        }
+        if(pos == 0){
+            s->cmd = byte;
+            if(!(byte & 0x80)){
+                s->prog_ptr = byte;             // register selected for the following read
+            }
+        }
+        else if(s->cmd & 0x80){
+            uint8_t reg = s->cmd & 0x7F;
+
+            if(pos == 1){
+                s->cmd_val = byte;
+            }
+            else{
+                s->cmd_val |= byte << 8;
+            }
+            if(pos == CH_PROG_SIZEOF(reg)){
+                zy_sim_prog_reg_write(s, reg, s->cmd_val);
+            }
+        }
+        return;
+    }
+
+    // Application registers: register address, byte count, data
+    if(pos == 0){
+        s->app_ptr = byte;
+    }
+    else if(pos >= 2){
+        uint8_t reg = s->app_ptr + (pos - 2);
+
+        if(reg < ZY_SIM_DATA_MEM_SIZE){
+            s->data_mem[reg] = byte;
+        }
+        if(reg == s->map->cal_trig){
+            s->cal_armed = 1;
+        }
+        if(reg == s->map->opmode || reg == s->map->period ||
+           reg == s->map->tick_interval || reg == s->map->tick_interval + 1){
+            s->mode_dirty = 1;
+        }
+    }
+}
+
+static uint8_t zy_sim_read_byte(struct zy_sim_sensor *s, uint8_t prog){
+    uint8_t byte = 0xFF;
+
+    if(prog){
+        if(s->burst == ZY_SIM_BURST_READ){
+            uint8_t *mem = zy_sim_mem(s, s->prog_addr + s->burst_pos);
+
+            byte = (mem != NULL) ? *mem : 0;
+            if(++s->burst_pos > s->prog_cnt){
+                s->burst = ZY_SIM_BURST_NONE;
+            }
+        }
+        else{
+            byte = zy_sim_prog_reg_read(s, s->prog_ptr, s->rd_pos++);
+        }
+        return byte;
+    }
+
+    if((uint16_t) s->app_ptr + s->rd_pos < ZY_SIM_DATA_MEM_SIZE){
+        byte = s->data_mem[s->app_ptr + s->rd_pos];
+    }
+    s->rd_pos++;
+    return byte;
+}
+
+// Start or repeated start: the next byte written is a command / register address again
+static void zy_sim_phase_end(struct zy_sim_sensor *s){
+    s->in_burst = 0;
+    s->rd_pos = 0;
+    if(s->mode_dirty && s->map != NULL){
+        s->mode_dirty = 0;
+        zy_sim_apply_mode(s);
+    }
+}
+
+static uint8_t zy_sim_responds(struct zy_sim_sensor *s, uint16_t addr){
+    if(!s->present || rst_asserted){
+        return 0;
+    }
+    if(addr == CH_I2C_ADDR_PROG){
+        return s->prog;
+    }
+    return !s->prog && s->running && s->map != NULL && s->app_addr == addr;
+}
+
+/*
+    One I2C transaction on the bus identified by its devicetree ordinal.
+    Every sensor that answers the address takes part: writes reach all of them
+    (the driver relies on this to set all halted sensors of a bus idle at once)
+    and read data is the wired-AND of their outputs, as on the open-drain bus.
+    Returns -EIO when nobody acknowledges the address.
+*/
+int zy_sim_sensor_transfer(uint32_t bus_ord, struct i2c_msg *msgs, uint8_t num_msgs, uint16_t addr){
+    struct zy_sim_sensor *resp[CHIRP_MAX_NUM_SENSORS];
+    uint8_t num_resp = 0;
+    uint8_t prog = (addr == CH_I2C_ADDR_PROG);
+    uint32_t pos = 0;
+    k_spinlock_key_t key = k_spin_lock(&zy_sim_lock);
+
+    for(uint8_t i = 0; i < ARRAY_SIZE(sensors); i++){
+        if(sensor_bus_ord[i] == bus_ord && sensors[i].holds_sda){
+            k_spin_unlock(&zy_sim_lock, key);
+            return -EIO;            // SDA stuck low: arbitration lost / no ACK
+        }
+    }
+    for(uint8_t i = 0; i < ARRAY_SIZE(sensors); i++){
+        if(sensor_bus_ord[i] == bus_ord && zy_sim_responds(&sensors[i], addr)){
+            resp[num_resp++] = &sensors[i];
+            zy_sim_update(&sensors[i]);
+        }
+    }
+    if(num_resp == 0){
+        k_spin_unlock(&zy_sim_lock, key);
+        return -EIO;
+    }
+
+    for(uint8_t m = 0; m < num_msgs; m++){
+        struct i2c_msg *msg = &msgs[m];
+        uint8_t read = (msg->flags & I2C_MSG_RW_MASK) == I2C_MSG_READ;
+
+        if(m > 0 && (msg->flags & I2C_MSG_RESTART)){
+            for(uint8_t r = 0; r < num_resp; r++){
+                zy_sim_phase_end(resp[r]);
+            }
+            pos = 0;
+        }
+
+        for(uint32_t j = 0; j < msg->len; j++){
+            if(read){
+                uint8_t byte = 0xFF;
+
+                for(uint8_t r = 0; r < num_resp; r++){
+                    byte &= zy_sim_read_byte(resp[r], prog);
+                }
+                msg->buf[j] = byte;
+            }
+            else{
+                for(uint8_t r = 0; r < num_resp; r++){
+                    zy_sim_write_byte(resp[r], prog, pos, msg->buf[j]);
+                }
+                pos++;
+            }
+        }
+    }
+
+    for(uint8_t r = 0; r < num_resp; r++){
+        zy_sim_phase_end(resp[r]);
+    }
+    k_spin_unlock(&zy_sim_lock, key);
+    return 0;
+}
+
+// Clock pulses and STOP from the controller: every sensor on the bus releases SDA
+void zy_sim_sensor_bus_clear(uint32_t bus_ord){
+    k_spinlock_key_t key = k_spin_lock(&zy_sim_lock);
+
+    for(uint8_t i = 0; i < ARRAY_SIZE(sensors); i++){
+        if(sensor_bus_ord[i] == bus_ord){
+            sensors[i].holds_sda = 0;
+            sensors[i].in_burst = 0;
+            sensors[i].rd_pos = 0;
+        }
+    }
+    k_spin_unlock(&zy_sim_lock, key);
+}
+
+// Level of a host output changed (RESET_N, PROG or INT driven by the host)
+void zy_sim_sensor_pin_changed(gpio_pin_t pin, int level){
+    k_spinlock_key_t key = k_spin_lock(&zy_sim_lock);
+
+    if(pin == ZY_SIM_RST_PIN){
+        rst_asserted = ZY_SIM_RST_ACTIVE_LOW ? !level : level;
+        if(rst_asserted){
+            for(uint8_t i = 0; i < ARRAY_SIZE(sensors); i++){
+                zy_sim_halt(&sensors[i]);       // memory is kept, like the on-chip SRAM
+                sensors[i].burst = ZY_SIM_BURST_NONE;
+            }
+        }
+    }
+
+    for(uint8_t i = 0; i < ARRAY_SIZE(sensors); i++){
+        struct zy_sim_sensor *s = &sensors[i];
+
+        if(pin == sensor_prg_pin[i]){
+            s->prog = level;
+        }
+        if(pin == sensor_int_pin[i] && level != s->int_level){
+            s->int_level = level;
+            if(!s->running || s->map == NULL){
+                continue;
+            }
+            if(level && s->cal_armed){
+                s->cal_running = 1;
+                s->cal_start = k_cycle_get_32();
+            }
+            else if(!level && s->cal_running){
+                // RTC calibration: sensor clock cycles counted during the host pulse
+                uint64_t us = k_cyc_to_us_floor64(k_cycle_get_32() - s->cal_start);
+
+                zy_sim_set_reg_word(s, s->map->cal_result, (uint16_t) ((us * ZY_SIM_RTC_HZ) / USEC_PER_SEC));
+                s->cal_running = 0;
+                s->cal_armed = 0;
+            }
+            else if(level){
+                zy_sim_trigger(s);
+            }
+        }
+    }
+    k_spin_unlock(&zy_sim_lock, key);
+}
+
+void zy_sim_set_scene(uint8_t sensor, const struct zy_sim_scene *scene){
+    k_spinlock_key_t key = k_spin_lock(&zy_sim_lock);
+
+    sensors[sensor].scene = *scene;
+    sensors[sensor].scene.num_targets = MIN(scene->num_targets, ZY_SIM_MAX_TARGETS);
+    k_spin_unlock(&zy_sim_lock, key);
+}
+
+void zy_sim_get_scene(uint8_t sensor, struct zy_sim_scene *scene){
+    k_spinlock_key_t key = k_spin_lock(&zy_sim_lock);
+
+    *scene = sensors[sensor].scene;
+    k_spin_unlock(&zy_sim_lock, key);
+}
+
+void zy_sim_set_present(uint8_t sensor, uint8_t present){
+    k_spinlock_key_t key = k_spin_lock(&zy_sim_lock);
+
+    sensors[sensor].present = present;
+    k_spin_unlock(&zy_sim_lock, key);
+}
+
+void zy_sim_hold_sda(uint8_t sensor){
+    k_spinlock_key_t key = k_spin_lock(&zy_sim_lock);
+
+    sensors[sensor].holds_sda = 1;
+    k_spin_unlock(&zy_sim_lock, key);
+}
+
+uint32_t zy_sim_measurement_count(uint8_t sensor){
+    return sensors[sensor].meas_count;
+}
+
+static int zy_sim_sensor_init(void){
+    for(uint8_t i = 0; i < ARRAY_SIZE(sensors); i++){
+        struct zy_sim_sensor *s = &sensors[i];
+
+        s->index = i;
+        s->present = 1;
+        s->seed = i + 1;
+        s->scene = default_scene;
+        k_timer_init(&s->meas_timer, zy_sim_meas_expiry, NULL);
+        k_timer_user_data_set(&s->meas_timer, s);
+    }
+    return 0;
+}
+
+SYS_INIT(zy_sim_sensor_init, POST_KERNEL, CONFIG_KERNEL_INIT_PRIORITY_DEFAULT);
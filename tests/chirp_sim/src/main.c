@@ -0,0 +1,369 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * SonicLib and the BSP against the simulated sensors of native_sim.overlay:
+ * group start, firmware broadcast to identical sensors, triggered measurement
+ * with blocking readout, non-blocking group result readout, non-blocking
+ * I/Q readout and target extraction from the I/Q data.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/ztest.h>
+#include "soniclib.h"
+#include "chirp_bsp.h"
+#include "ch101_gpr_open.h"
+#include "ch201_gprmt.h"
+#include "zy_i2c.h"
+#include "zy_sim.h"
+
+CH_FW_IMAGE_REGISTER(ch101_gpr_open, CH101_PART_NUMBER, CH_FW_CAP_STATIC_RANGE);
+CH_FW_IMAGE_REGISTER(ch201_gprmt, CH201_PART_NUMBER, CH_FW_CAP_THRESHOLDS);
+
+#define TEST_MAX_RANGE_MM		750
+#define TEST_TARGET_MM			300
+#define TEST_TARGET_AMPLITUDE	2000
+#define TEST_RANGE_TOL_MM		5
+#define TEST_TIMEOUT			K_MSEC(500)
+
+/* Two separated echoes for ch_get_targets(), each above the threshold of its own segment */
+#define TEST_NEAR_AMPLITUDE		3000
+#define TEST_NEAR_HALF_WIDTH	3
+#define TEST_NEAR_LEVEL			600
+#define TEST_FAR_AMPLITUDE		1500
+#define TEST_FAR_HALF_WIDTH		6
+#define TEST_FAR_LEVEL			300
+
+static ch_dev_t		chirp_devices[CHIRP_MAX_NUM_SENSORS];
+static ch_group_t	chirp_group;
+
+static ch_result_t		chirp_results[CHIRP_MAX_NUM_SENSORS];
+static ch_iq_sample_t	chirp_iq_data[CHIRP_MAX_NUM_SENSORS][CH201_MAX_NUM_SAMPLES];
+
+static uint32_t active_devices;
+static uint32_t data_ready_devices;
+static uint8_t	start_results_nb;			// start ch_group_get_results_nb() from the interrupt
+static uint8_t	results_nb_error;
+
+K_SEM_DEFINE(data_ready_sem, 0, 1);
+K_SEM_DEFINE(results_ready_sem, 0, 1);
+K_SEM_DEFINE(iq_ready_sem, 0, 1);
+
+static void sensor_int_callback(ch_group_t *grp_ptr, uint8_t dev_num) {
+
+	data_ready_devices |= (1 << dev_num);
+
+	if (data_ready_devices == active_devices) {
+		data_ready_devices = 0;
+		chbsp_group_io_interrupt_disable(grp_ptr);
+
+		if (start_results_nb) {
+			results_nb_error = ch_group_get_results_nb(grp_ptr, CH_RANGE_ECHO_ONE_WAY, chirp_results);
+		}
+		k_sem_give(&data_ready_sem);
+	}
+}
+
+static void result_callback(ch_group_t *grp_ptr, ch_result_t *results_ptr) {
+
+	k_sem_give(&results_ready_sem);
+}
+
+static void io_complete_callback(ch_group_t *grp_ptr) {
+
+	k_sem_give(&iq_ready_sem);
+}
+
+static void check_result(uint8_t dev_num, const ch_result_t *result) {
+
+	zassert_not_equal(result->range, CH_NO_TARGET, "port %d: no target", dev_num);
+	zassert_within(result->range / 32, TEST_TARGET_MM, TEST_RANGE_TOL_MM,
+				   "port %d: range %u mm", dev_num, result->range / 32);
+	zassert_equal(result->amplitude, TEST_TARGET_AMPLITUDE, "port %d: amplitude %u", dev_num, result->amplitude);
+}
+
+/*
+ * A target found by ch_get_targets() from a simulated echo (triangular envelope of half width 
+ * echo->width samples): at the echo range within a sample, with the envelope at the sample nearest 
+ * to the echo center, and as many samples as the envelope spends above the threshold level.
+ */
+static void check_target(ch_dev_t *dev_ptr, const ch_target_t *target, const struct zy_sim_target *echo, 
+						 uint16_t level) {
+	uint8_t	 dev_num = ch_get_dev_num(dev_ptr);
+	uint16_t min_amplitude = (echo->amplitude * (2 * echo->width - 1)) / (2 * echo->width);
+	uint16_t width = (2 * echo->width * (echo->amplitude - level)) / echo->amplitude;
+
+	zassert_within(target->range / 32, echo->range_mm, ch_samples_to_mm(dev_ptr, 1),
+				   "port %d: target at %u mm, echo at %u mm", dev_num, target->range / 32, echo->range_mm);
+	zassert_true((target->amplitude >= min_amplitude) && (target->amplitude <= echo->amplitude),
+				 "port %d: target amplitude %u, echo %u", dev_num, target->amplitude, echo->amplitude);
+	zassert_within(target->width, width, 1, "port %d: target width %u, expected %u", dev_num, target->width, width);
+}
+
+/* Trigger one measurement on all sensors and wait until they have all interrupted */
+static void measure(ch_group_t *grp_ptr) {
+
+	k_sem_reset(&data_ready_sem);
+	ch_group_trigger(grp_ptr);
+	zassert_ok(k_sem_take(&data_ready_sem, TEST_TIMEOUT), "sensors did not interrupt");
+}
+
+/* Put every connected sensor in triggered mode and rebuild the active device mask */
+static void configure_sensors(ch_group_t *grp_ptr) {
+	ch_config_t dev_config = {
+		.mode = CH_MODE_TRIGGERED_TX_RX,
+		.max_range = TEST_MAX_RANGE_MM,
+	};
+
+	active_devices = 0;
+	for (uint8_t dev_num = 0; dev_num < ch_get_num_ports(grp_ptr); dev_num++) {
+		ch_dev_t *dev_ptr = ch_get_dev_ptr(grp_ptr, dev_num);
+
+		if (ch_sensor_is_connected(dev_ptr)) {
+			zassert_ok(ch_set_config(dev_ptr, &dev_config), "port %d: ch_set_config()", dev_num);
+			active_devices |= (1 << dev_num);
+		}
+	}
+}
+
+/* One target at TEST_TARGET_MM, no noise, in front of every sensor */
+static void set_default_scene(ch_group_t *grp_ptr) {
+	struct zy_sim_scene scene = {
+		.num_targets = 1,
+		.targets = { { .range_mm = TEST_TARGET_MM, .amplitude = TEST_TARGET_AMPLITUDE } },
+		.noise = 0,
+	};
+
+	for (uint8_t dev_num = 0; dev_num < ch_get_num_ports(grp_ptr); dev_num++) {
+		zy_sim_set_scene(dev_num, &scene);
+	}
+}
+
+static void *chirp_sim_setup(void) {
+	ch_group_t	*grp_ptr = &chirp_group;
+
+	chbsp_board_init(grp_ptr);
+
+	for (uint8_t dev_num = 0; dev_num < ch_get_num_ports(grp_ptr); dev_num++) {
+		zassert_ok(ch_init_auto(&chirp_devices[dev_num], grp_ptr, dev_num, 0), "port %d: ch_init_auto()", dev_num);
+	}
+	set_default_scene(grp_ptr);
+	zassert_ok(ch_group_start(grp_ptr), "ch_group_start()");
+
+	ch_io_int_callback_set(grp_ptr, sensor_int_callback);
+	ch_io_complete_callback_set(grp_ptr, io_complete_callback);
+	ch_result_callback_set(grp_ptr, result_callback);
+
+	configure_sensors(grp_ptr);
+
+	return NULL;
+}
+
+static void chirp_sim_before(void *fixture) {
+
+	set_default_scene(&chirp_group);				// a failed test may have left another one
+	start_results_nb = 0;
+	results_nb_error = 0;
+	memset(chirp_results, 0, sizeof(chirp_results));
+	k_sem_reset(&results_ready_sem);
+	k_sem_reset(&iq_ready_sem);
+}
+
+ZTEST(chirp_sim, test_group_start) {
+	ch_group_t *grp_ptr = &chirp_group;
+
+	zassert_equal(ch_get_num_ports(grp_ptr), CHIRP_MAX_NUM_SENSORS);
+
+	for (uint8_t dev_num = 0; dev_num < ch_get_num_ports(grp_ptr); dev_num++) {
+		ch_dev_t *dev_ptr = ch_get_dev_ptr(grp_ptr, dev_num);
+		uint32_t op_freq = (ch_get_part_number(dev_ptr) == CH201_PART_NUMBER) ?
+						   ZY_SIM_CH201_OP_FREQ : ZY_SIM_CH101_OP_FREQ;
+
+		zassert_true(ch_sensor_is_connected(dev_ptr), "port %d not connected", dev_num);
+		zassert_within(ch_get_frequency(dev_ptr), op_freq, op_freq / 100,
+					   "port %d: %u Hz", dev_num, ch_get_frequency(dev_ptr));
+		zassert_not_equal(ch_get_rtc_cal_result(dev_ptr), 0, "port %d not calibrated", dev_num);
+	}
+}
+
+/*
+ * ch_group_start() with 1, 4 and 8 identical sensors on one bus (as many as the board has).  The 
+ * firmware goes out once per bus, each further sensor only adds its detection, sampled readback 
+ * and start: its I2C traffic must stay well below that of a firmware download.
+ */
+ZTEST(chirp_sim, test_broadcast_load) {
+	static const uint8_t sensor_counts[] = { 1, 4, 8 };
+	ch_group_t	*grp_ptr = &chirp_group;
+	ch_dev_t	*lead_ptr = ch_get_dev_ptr(grp_ptr, 0);
+	uint8_t		identical[CHIRP_MAX_NUM_SENSORS];
+	uint8_t		num_identical = 0;
+	uint32_t	first_bytes = 0;
+	uint32_t	fw_size = (ch_get_part_number(lead_ptr) == CH201_PART_NUMBER) ? CH201_FW_SIZE : CH101_FW_SIZE;
+
+	for (uint8_t dev_num = 0; dev_num < ch_get_num_ports(grp_ptr); dev_num++) {
+		ch_dev_t *dev_ptr = ch_get_dev_ptr(grp_ptr, dev_num);
+
+		if ((dev_ptr->i2c_bus_index == lead_ptr->i2c_bus_index) && 
+			(ch_get_part_number(dev_ptr) == ch_get_part_number(lead_ptr))) {
+			identical[num_identical++] = dev_num;
+		}
+	}
+
+	for (uint8_t n = 0; n < ARRAY_SIZE(sensor_counts); n++) {
+		uint8_t count = MIN(sensor_counts[n], num_identical);
+		struct zy_i2c_stats stats;
+
+		if ((n > 0) && (count == MIN(sensor_counts[n - 1], num_identical))) {
+			break;								// no more identical sensors on this board
+		}
+
+		for (uint8_t dev_num = 0; dev_num < ch_get_num_ports(grp_ptr); dev_num++) {
+			zy_sim_set_present(dev_num, 0);
+		}
+		for (uint8_t i = 0; i < count; i++) {
+			zy_sim_set_present(identical[i], 1);
+		}
+
+		zy_i2c_stats_reset();
+		zassert_ok(ch_group_start(grp_ptr), "ch_group_start() with %u sensors", count);
+		zy_i2c_stats_get(&stats);
+
+		zassert_equal(grp_ptr->sensor_count, count);
+		TC_PRINT("%u identical sensors: ch_group_start %u us, I2C %u bytes in %u us\n", count, 
+				 ch_group_get_boot_time(grp_ptr), stats.bytes, k_cyc_to_us_floor32(stats.cycles));
+
+		if (n == 0) {
+			first_bytes = stats.bytes;
+		} else {
+			zassert_true((stats.bytes - first_bytes) < ((count - 1) * fw_size) / 2, 
+						 "%u sensors: %u more bytes than 1 sensor", count, stats.bytes - first_bytes);
+		}
+	}
+
+	for (uint8_t dev_num = 0; dev_num < ch_get_num_ports(grp_ptr); dev_num++) {
+		zy_sim_set_present(dev_num, 1);
+	}
+	zassert_ok(ch_group_start(grp_ptr), "ch_group_start()");
+	configure_sensors(grp_ptr);
+}
+
+ZTEST(chirp_sim, test_trigger_readout) {
+	ch_group_t *grp_ptr = &chirp_group;
+
+	measure(grp_ptr);
+
+	for (uint8_t dev_num = 0; dev_num < ch_get_num_ports(grp_ptr); dev_num++) {
+		ch_result_t result;
+
+		zassert_ok(ch_get_result(ch_get_dev_ptr(grp_ptr, dev_num), CH_RANGE_ECHO_ONE_WAY, &result, 0));
+		check_result(dev_num, &result);
+	}
+}
+
+ZTEST(chirp_sim, test_results_nb) {
+	ch_group_t *grp_ptr = &chirp_group;
+
+	start_results_nb = 1;
+	measure(grp_ptr);
+
+	zassert_ok(results_nb_error, "ch_group_get_results_nb() did not start");
+	zassert_ok(k_sem_take(&results_ready_sem, TEST_TIMEOUT), "no result callback");
+	zassert_equal(k_sem_count_get(&iq_ready_sem), 0, "I/O complete callback without I/Q reads");
+
+	for (uint8_t dev_num = 0; dev_num < ch_get_num_ports(grp_ptr); dev_num++) {
+		check_result(dev_num, &chirp_results[dev_num]);
+	}
+}
+
+ZTEST(chirp_sim, test_iq_nb) {
+	ch_group_t *grp_ptr = &chirp_group;
+
+	memset(chirp_iq_data, 0, sizeof(chirp_iq_data));
+	measure(grp_ptr);
+
+	for (uint8_t dev_num = 0; dev_num < ch_get_num_ports(grp_ptr); dev_num++) {
+		ch_dev_t *dev_ptr = ch_get_dev_ptr(grp_ptr, dev_num);
+
+		zassert_ok(ch_get_iq_data(dev_ptr, chirp_iq_data[dev_num], 0, ch_get_num_samples(dev_ptr),
+								  CH_IO_MODE_NONBLOCK), "port %d: ch_get_iq_data()", dev_num);
+	}
+	zassert_ok(ch_io_start_nb(grp_ptr), "ch_io_start_nb()");
+	zassert_ok(k_sem_take(&iq_ready_sem, TEST_TIMEOUT), "no I/O complete callback");
+
+	/* Without noise, the I/Q data is zero except around the echo, whose peak is the target amplitude */
+	for (uint8_t dev_num = 0; dev_num < ch_get_num_ports(grp_ptr); dev_num++) {
+		ch_dev_t *dev_ptr = ch_get_dev_ptr(grp_ptr, dev_num);
+		uint16_t num_samples = ch_get_num_samples(dev_ptr);
+		uint16_t peak_sample = 0;
+		int32_t	 peak = 0;
+
+		for (uint16_t n = 0; n < num_samples; n++) {
+			int32_t mag = abs(chirp_iq_data[dev_num][n].i) + abs(chirp_iq_data[dev_num][n].q);
+
+			if (mag > peak) {
+				peak = mag;
+				peak_sample = n;
+			}
+		}
+		zassert_true(peak > (TEST_TARGET_AMPLITUDE * 3) / 4 && peak <= TEST_TARGET_AMPLITUDE,
+					 "port %d: I/Q peak %d", dev_num, peak);
+		zassert_within(ch_samples_to_mm(dev_ptr, peak_sample), TEST_TARGET_MM, ch_samples_to_mm(dev_ptr, 1),
+					   "port %d: echo at sample %u", dev_num, peak_sample);
+		zassert_equal(chirp_iq_data[dev_num][0].i, 0, "port %d: I/Q before the echo", dev_num);
+		zassert_equal(chirp_iq_data[dev_num][0].q, 0, "port %d: I/Q before the echo", dev_num);
+	}
+}
+
+/*
+ * Two echoes in separate threshold segments (the remaining, zeroed, segments must not apply): 
+ * ch_get_targets() finds both, nearest first.  A frame length beyond the maximum of the sensor is 
+ * reduced to it.
+ */
+ZTEST(chirp_sim, test_targets) {
+	ch_group_t		*grp_ptr = &chirp_group;
+	struct zy_sim_scene scenes[CHIRP_MAX_NUM_SENSORS];
+	uint16_t		split[CHIRP_MAX_NUM_SENSORS];	// first sample of the far segment
+
+	for (uint8_t dev_num = 0; dev_num < ch_get_num_ports(grp_ptr); dev_num++) {
+		ch_dev_t *dev_ptr = ch_get_dev_ptr(grp_ptr, dev_num);
+		uint16_t num_samples = ch_get_num_samples(dev_ptr);
+		struct zy_sim_scene *scene = &scenes[dev_num];
+
+		memset(scene, 0, sizeof(*scene));
+		scene->num_targets = 2;
+		scene->targets[0].range_mm = ch_samples_to_mm(dev_ptr, num_samples / 4);
+		scene->targets[0].amplitude = TEST_NEAR_AMPLITUDE;
+		scene->targets[0].width = TEST_NEAR_HALF_WIDTH;
+		scene->targets[1].range_mm = ch_samples_to_mm(dev_ptr, (num_samples * 2) / 3);
+		scene->targets[1].amplitude = TEST_FAR_AMPLITUDE;
+		scene->targets[1].width = TEST_FAR_HALF_WIDTH;
+		split[dev_num] = (num_samples / 4 + (num_samples * 2) / 3) / 2;
+		zy_sim_set_scene(dev_num, scene);
+	}
+	measure(grp_ptr);
+
+	for (uint8_t dev_num = 0; dev_num < ch_get_num_ports(grp_ptr); dev_num++) {
+		ch_dev_t *dev_ptr = ch_get_dev_ptr(grp_ptr, dev_num);
+		uint16_t num_samples = ch_get_num_samples(dev_ptr);
+		ch_thresholds_t thresholds = { .threshold = { { 0, TEST_NEAR_LEVEL }, { split[dev_num], TEST_FAR_LEVEL } } };
+		ch_target_t targets[ZY_SIM_MAX_TARGETS];
+		uint8_t num_targets;
+
+		memset(chirp_iq_data[dev_num], 0, sizeof(chirp_iq_data[dev_num]));
+		zassert_ok(ch_get_iq_data(dev_ptr, chirp_iq_data[dev_num], 0, num_samples, CH_IO_MODE_BLOCK),
+				   "port %d: ch_get_iq_data()", dev_num);
+
+		num_targets = ch_get_targets(dev_ptr, CH_RANGE_ECHO_ONE_WAY, chirp_iq_data[dev_num], num_samples, 
+									 &thresholds, targets, ARRAY_SIZE(targets));
+		zassert_equal(num_targets, 2, "port %d: %u targets", dev_num, num_targets);
+		check_target(dev_ptr, &targets[0], &scenes[dev_num].targets[0], TEST_NEAR_LEVEL);
+		check_target(dev_ptr, &targets[1], &scenes[dev_num].targets[1], TEST_FAR_LEVEL);
+
+		num_targets = ch_get_targets(dev_ptr, CH_RANGE_ECHO_ONE_WAY, chirp_iq_data[dev_num], UINT16_MAX, 
+									 &thresholds, targets, ARRAY_SIZE(targets));
+		zassert_equal(num_targets, 2, "port %d: %u targets in a frame of UINT16_MAX samples", dev_num, num_targets);
+	}
+}
+
+ZTEST_SUITE(chirp_sim, NULL, chirp_sim_setup, chirp_sim_before, NULL, NULL);